@@ -2,14 +2,27 @@
 /////////////////////////////////////////////////////////////////////////////
 //
 //  Class for compressing ADC data internally represented
-//  as 16 bit unsigned int 
+//  as 16 bit unsigned int
 //  Max ADC resolution, however, cannot be greater than 15bits as
-//  1bit is reserved to signal whether the packet is compressed or not 
+//  1bit is reserved to signal whether the packet is compressed or not
 //
 //  The Huffman encoding scheme used here is the one developed by uBooNE
 //
-//  The basic idea is to handle binnary codes as strings --> maybe not 
-//  the most performant, but hopefully easier to understand ;-)
+//  The codes are defined as strings of '0' and '1' in SetEncoding and
+//  converted once to bit patterns.  Compression writes them through a
+//  64 bit accumulator; decompression walks a lookup table indexed by the
+//  next 8 bits of the stream.  All state is set up in the constructor,
+//  so the (de)compression functions are const and can be called from
+//  several threads at once.
+//
+//  Stream format (one channel, starting on a byte boundary):
+//    packets of nbadc+1 bits, most significant bit first
+//    flag 0: uncompressed packet, followed by nbadc bits of raw ADC
+//    flag 1: compressed packet, followed by up to nbadc bits of codes;
+//            a code may continue in the next compressed packet, and the
+//            packet is padded with 0 if it is followed by a raw packet
+//    the last packet is not padded; the channel is padded with 0 to the
+//    next byte boundary
 //
 /////////////////////////////////////////////////////////////////////////////
 /////////////////////////////////////////////////////////////////////////////
@@ -19,10 +32,10 @@
 
 #include <map>
 #include <vector>
-#include <deque>
-#include <bitset>
+#include <string>
 #include <fstream>
 #include <utility>
+#include <cstdint>
 
 #include "dlardaq.h"
 
@@ -39,51 +52,50 @@ namespace dlardaq
       static HuffDataCompressor inst;
       return inst;
     }
-    
+
     // compress single sequence
     // need to provide number of bits of the ADC
     // and the raw data vector
     // outputs compressed stream packed into 8 bit vector
-    // 
+    //
     void CompressChData( short nbadc, std::vector<adc16_t> &raw_in,
-			 std::vector<BYTE> &bin_out );
-    
+			 std::vector<BYTE> &bin_out ) const;
+
     // the raw adc should just be adc values without event header
     // these data are in 1D array: [tdc + ch x ntdc]
     void CompressEventData( short nbadc, size_t nch, size_t seqlen,
 			    std::vector<adc16_t> &raw_in,
-			    std::vector<BYTE> &bin_out );
+			    std::vector<BYTE> &bin_out ) const;
 
     // the raw adc should just be adc values without event header
     // these data are in 2D array: [ch, tdc]
     void CompressEventData( short nbadc, size_t nch, size_t seqlen,
 			    std::vector< std::vector<adc16_t> > &raw_in,
-			    std::vector<BYTE> &bin_out );
+			    std::vector<BYTE> &bin_out ) const;
+
 
-    
     // decompress event from binary sequence in memory
-    // 
-    void DecompressEventData( short nbadc,       
+    // byteidx is set to the number of bytes used
+    void DecompressEventData( short nbadc,
 			      size_t nch,
-			      size_t seqlen, 
+			      size_t seqlen,
 			      const char *buf, size_t bufsize, size_t &byteidx,
-			      std::vector<adc16_t>  &adc );
+			      std::vector<adc16_t>  &adc ) const;
 
-    // NOTE: Before calling this function 
-    //       one must ensure that the position of the input file 
+    // NOTE: Before calling this function
+    //       one must ensure that the position of the input file
     //       is always set at the begining of the event data
-    //       This function reads the file byte by byte so it could 
-    //       be rather slow
-    void DecompressEventData( std::ifstream &fin, 
-			      short nbadc, 
+    //       On return the file is positioned after the event data
+    void DecompressEventData( std::ifstream &fin,
+			      short nbadc,
 			      size_t nch,
 			      size_t seqlen,
-			      std::vector< adc16_t > &adc);
-			      
+			      std::vector< adc16_t > &adc) const;
+
 
     //
-    void PrintEncoding();
-    
+    void PrintEncoding() const;
+
     void SetVerbosity(int val){ m_Verbosity = val; }
 
   private:
@@ -94,72 +106,58 @@ namespace dlardaq
     HuffDataCompressor& operator=(const HuffDataCompressor&);
     // Prevent unwanted destruction
     ~HuffDataCompressor(){;}
-    
+
     // define encoding scheme
     void SetEncoding();
 
-    // structure to collect Huffman codes
-    struct HuffAccum_t
+    // a code: the len low bits of bits, most significant bit first
+    struct HuffCode_t
     {
-      std::string codestr;  // binary code; leave empty for raw data
-      short value;            // value: diff / or raw adc
-      short nrep;           // number of repetitions of this code
-    };  
+      uint32_t bits;
+      unsigned len;
+    };
 
-    //
-    std::vector<HuffAccum_t> HuffBuffer;  // buffer for Huffman codes
+    // decoding table entry: the code that starts the next kTableBits bits
+    // of the stream; len is 0 if there is none
+    struct HuffDecode_t
+    {
+      short value;
+      unsigned char len;
+    };
 
-    // add to buffer
-    void AddToHuffBuffer(short val, bool rawadc);
-    
-    
-    //
-    bool SetNbitsAdc( short nbadc );
+    static const unsigned kTableBits = 8;  // longest code supported
 
     //
-    void AddWordsToByteBuffer(std::string words, 
-			      std::vector<BYTE> &buf, 
-			      std::string &partbyte);
-    
-    //
-    void ReadNextByte( size_t &byteidx, const char *buf,
-		       std::deque< std::bitset<1> > &bits );
-
-    // read next byte from file stream
-    void ReadNextByte( std::ifstream &fin, std::deque< std::bitset<1> > &bits, bool &status );
-    
-    
-    // get code from value
-    std::string GetCodeFromValue(short val); 
-    
-    // get value from code
-    //short GetValueFromCode(std::string code, bool &ok);
-    
-    std::string GetBinaryString(short val, size_t strsize);
-        
+    bool CheckNbitsAdc( short nbadc ) const;
+
+    // get code from value, nullptr if there is none
+    const HuffCode_t* GetCodeFromValue(short val) const;
+
+    // decompress nch channels read from a byte source
+    template<class Source>
+    bool DecompressChannels( Source &src, short nbadc, size_t nch, size_t seqlen,
+                             std::vector<adc16_t> &adc, size_t &bytesleft ) const;
+
     //
     //
-    std::map<short, std::string> m_CmMap;     // map to compresss
-    //std::map<std::string, short> m_UCmMap;    // map to decompress
+    std::map<short, std::string> m_CmMap;     // encoding scheme as strings
 
-    // map to decompress is in the sorted vector of codes
-    std::vector< std::pair<std::string, short> >  m_UCmMap;    
+    std::vector<HuffCode_t>   m_EncTable;     // codes indexed by value + m_MaxDiff
+    std::vector<HuffDecode_t> m_DecTable;     // 2^kTableBits entries
 
     int    m_Verbosity;                       //
 
     short  m_MaxAdcBits;                      // max ADC bits
     short  m_MaxDiff;                         // max difference
-    size_t m_PacketSize;                      // size of packet in bits
     size_t m_MinCodeSize;                     // shortest code length
     size_t m_MaxCodeSize;                     // longest code length
 
     size_t m_NbitsByte;    // size in bits of buffer
     size_t m_NbitsHead;   // number of header bits
-    size_t m_NbitsHC;     // number of bits for huffman codes
 
     short  m_NSeqRep;     // encode sequence repetition
     short  m_NSeqRepVal;  // dummy value
-    bool   m_SeqEnable;   // flag to encode repetitions 
+    bool   m_SeqEnable;   // flag to encode repetitions
   };
 }
 
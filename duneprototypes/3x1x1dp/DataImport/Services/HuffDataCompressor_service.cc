@@ -2,20 +2,19 @@
 /////////////////////////////////////////////////////////////////////////////
 //
 //  Class for compressing ADC data internally represented
-//  as 16 bit unsigned int 
+//  as 16 bit unsigned int
 //  Max ADC resolution, however, cannot be greater than 15bits as
-//  1bit is reserved to signal whether the packet is compressed or not 
+//  1bit is reserved to signal whether the packet is compressed or not
 //
 //  The Huffman encoding scheme used here is the one developed by uBooNE
 //
-//  The basic idea is to handle binnary codes as strings --> maybe not 
-//  the most performant, but maybe easier to understand
+//  See HuffDataCompressor.h for the stream format
 //
 /////////////////////////////////////////////////////////////////////////////
 /////////////////////////////////////////////////////////////////////////////
 #include <iostream>
 #include <iomanip>
-#include <sstream>
+#include <algorithm>
 #include <cstdlib>
 
 #include "LogMsg.h"
@@ -25,6 +24,111 @@
 using namespace std;
 using namespace dlardaq;
 
+namespace
+{
+  //
+  // write bits most significant first into a byte vector
+  //
+  class BitWriter
+  {
+  public:
+    BitWriter(std::vector<BYTE> &out) : m_out(out), m_acc(0), m_nacc(0) {;}
+
+    // write the n (<= 32) low bits of bits
+    void Write(uint32_t bits, unsigned n)
+    {
+      if(n == 0) return;
+      m_acc   = (m_acc << n) | (bits & (0xFFFFFFFFu >> (32 - n)));
+      m_nacc += n;
+      while(m_nacc >= 8)
+	{
+	  m_nacc -= 8;
+	  m_out.push_back( (BYTE)((m_acc >> m_nacc) & 0xff) );
+	}
+    }
+
+    // pad with 0 to the next byte boundary
+    void Flush(){ if(m_nacc > 0) Write(0, 8 - m_nacc); }
+
+  private:
+    std::vector<BYTE> &m_out;
+    uint64_t m_acc;
+    unsigned m_nacc;
+  };
+
+  //
+  // read bits most significant first from a byte source
+  // Source::Next() returns the next byte or -1 if there is none
+  //
+  template<class Source>
+  class BitReader
+  {
+  public:
+    BitReader(Source &src) : m_src(src), m_acc(0), m_nacc(0) {;}
+
+    // try to have n (<= 32) bits available; false if the source ran out
+    bool Fill(unsigned n)
+    {
+      while(m_nacc < n)
+	{
+	  int b = m_src.Next();
+	  if(b < 0) return false;
+	  m_acc   = (m_acc << 8) | (unsigned)b;
+	  m_nacc += 8;
+	}
+      return true;
+    }
+
+    unsigned Available() const { return m_nacc; }
+
+    // next n (<= 32, <= Available()) bits without consuming them
+    uint32_t Peek(unsigned n) const
+    {
+      if(n == 0) return 0;
+      return (m_acc >> (m_nacc - n)) & (0xFFFFFFFFu >> (32 - n));
+    }
+
+    void Skip(unsigned n){ m_nacc -= n; }
+
+    uint32_t Read(unsigned n)
+    {
+      uint32_t val = Peek(n);
+      Skip(n);
+      return val;
+    }
+
+    // drop the bits up to the next byte boundary
+    void AlignToByte(){ m_nacc -= m_nacc % 8; }
+
+    // whole bytes read from the source but not consumed
+    size_t BytesLeft() const { return m_nacc / 8; }
+
+  private:
+    Source  &m_src;
+    uint64_t m_acc;
+    unsigned m_nacc;
+  };
+
+  struct MemorySource
+  {
+    const char *buf;
+    size_t      size;
+    size_t      idx;
+    int Next(){ return idx < size ? (unsigned char)buf[idx++] : -1; }
+  };
+
+  struct StreamSource
+  {
+    std::ifstream &fin;
+    int Next()
+    {
+      char c;
+      if(!fin.get(c)) return -1;
+      return (unsigned char)c;
+    }
+  };
+}
+
 //
 //
 //
@@ -37,13 +141,13 @@ HuffDataCompressor::HuffDataCompressor()
   // note that we will use "short" to store either ADC or diff
   // for 16 bit short goes between -/+ 32767 or 15 bits
   m_MaxAdcBits = 15; //+1 bit is reserved for compression flag
-  
+
   // number of reserved bits
-  m_NbitsHead  = 1; 
-  
+  m_NbitsHead  = 1;
+
   // we use 8 bit words on the output
   m_NbitsByte  = 8;  //sizeof(BYTE)*8;
-  
+
   m_Verbosity  = 0;
 
   // define encoding map
@@ -52,8 +156,8 @@ HuffDataCompressor::HuffDataCompressor()
 
 
 //
-// The Huffman encoding scheme 
-// Needless to say it should not change 
+// The Huffman encoding scheme
+// Needless to say it should not change
 // between comression/decompression steps
 //
 // set encoding system
@@ -71,40 +175,39 @@ void HuffDataCompressor::SetEncoding()
   codeMap[-3] = "000001";
   codeMap[3]  = "0000001";
 
-  // max difference 
+  // max difference
   m_MaxDiff     = 3;
 
   // 0 no repetion encoding >MaxDiff repetion encoding
-  m_NSeqRep    = 4; 
+  m_NSeqRep    = 4;
   m_NSeqRepVal = 0;
   m_SeqEnable  = (m_NSeqRep > 0); // && (m_NSeqRep > m_MaxDiff);
 
   m_CmMap.clear();
-  m_UCmMap.clear();
-  
+
   //
   m_MinCodeSize  = 999;
   m_MaxCodeSize  = 0;
-  
+
   std::map<short, std::string>::iterator it;
   for(it = codeMap.begin();it!=codeMap.end();it++)
     {
-      
+
       short deltaval = it->first;
       string bincode = it->second;
-      
-      if(m_SeqEnable) 
+
+      if(m_SeqEnable)
 	{
 	  // add zeros to nominal huffman codes
 	  bincode = "0" + bincode;
 	}
-      
+
       size_t codesize = (bincode).size();
       if(codesize > m_MaxCodeSize)
 	m_MaxCodeSize = codesize;
       if(codesize < m_MinCodeSize)
 	m_MinCodeSize = codesize;
-      
+
       // set code map
       m_CmMap[deltaval] = bincode;
     }
@@ -114,17 +217,43 @@ void HuffDataCompressor::SetEncoding()
     {
       m_NSeqRepVal          = m_MaxDiff + m_NSeqRep;
       m_CmMap[m_NSeqRepVal] = "1";
-      //m_UCmMap["1"]         = m_NSeqRepVal;
       m_MinCodeSize         = 1;
     }
 
-  // !!! m_MinCodeSize should be 1 !!!
-  m_UCmMap.resize( m_MaxCodeSize );
+  if(m_MaxCodeSize > kTableBits)
+    {
+      msg_err<<__FILE__<<", "<<__LINE__<<" codes longer than "<<kTableBits
+	     <<" bits are not supported"<<endl;
+      abort();
+    }
+
+  // bit patterns for compression, indexed by value + m_MaxDiff
+  short maxval = std::max(m_MaxDiff, m_NSeqRepVal);
+  m_EncTable.assign( maxval + m_MaxDiff + 1, HuffCode_t{0, 0} );
   for(it = m_CmMap.begin();it!=m_CmMap.end();it++)
     {
-      short deltaval = it->first;
-      string bincode = it->second;
-      m_UCmMap[bincode.size()-1] = std::make_pair(bincode, deltaval);
+      HuffCode_t code{0, (unsigned)it->second.size()};
+      for(char c : it->second) code.bits = (code.bits << 1) | (c == '1');
+      m_EncTable[it->first + m_MaxDiff] = code;
+    }
+
+  // decoding table: every index that starts with a code points to it
+  m_DecTable.assign( 1u << kTableBits, HuffDecode_t{0, 0} );
+  for(it = m_CmMap.begin();it!=m_CmMap.end();it++)
+    {
+      const HuffCode_t &code = m_EncTable[it->first + m_MaxDiff];
+      unsigned nfree = kTableBits - code.len;
+      for(unsigned tail = 0; tail < (1u << nfree); ++tail)
+	{
+	  HuffDecode_t &entry = m_DecTable[(code.bits << nfree) | tail];
+	  if(entry.len != 0)
+	    {
+	      msg_err<<__FILE__<<", "<<__LINE__<<" the encoding is not a prefix code"<<endl;
+	      abort();
+	    }
+	  entry.value = it->first;
+	  entry.len   = code.len;
+	}
     }
 }
 
@@ -132,26 +261,33 @@ void HuffDataCompressor::SetEncoding()
 //
 //
 // Print encoding
-void HuffDataCompressor::PrintEncoding()
+void HuffDataCompressor::PrintEncoding() const
 {
   cout<<endl<<"Huffman coding scheme: "<<endl;
 
-  
-  for(size_t i=0;i<m_UCmMap.size();i++)
+  // one code per length, shortest first
+  std::vector< std::pair<std::string, short> > codes;
+  for(auto it = m_CmMap.begin();it!=m_CmMap.end();it++)
+    codes.push_back( std::make_pair(it->second, it->first) );
+  std::sort(codes.begin(), codes.end(),
+	    [](const std::pair<std::string, short> &a, const std::pair<std::string, short> &b)
+	    { return a.first.size() < b.first.size(); });
+
+  for(size_t i=0;i<codes.size();i++)
     {
-      if(i == 0 && m_SeqEnable)
+      if(codes[i].second == m_NSeqRepVal && m_SeqEnable)
 	{
-	  cout<<setw(10)<<m_UCmMap[i].first
+	  cout<<setw(10)<<codes[i].first
 	      <<setw(5)<<m_NSeqRep<<" x no change"
-	      <<setw(4)<<i+1<<" bit code length"<<endl;
-	  
+	      <<setw(4)<<codes[i].first.size()<<" bit code length"<<endl;
+
 	}
       else
 	{
-	  cout<<setw(10)<<m_UCmMap[i].first<<setw(5)<<m_UCmMap[i].second
-	      <<setw(4)<<i+1<<" bit code length"<<endl;
+	  cout<<setw(10)<<codes[i].first<<setw(5)<<codes[i].second
+	      <<setw(4)<<codes[i].first.size()<<" bit code length"<<endl;
 	}
-      
+
     }
 
   cout<<endl;
@@ -164,132 +300,31 @@ void HuffDataCompressor::PrintEncoding()
 //
 //
 // access map to compress
-std::string HuffDataCompressor::GetCodeFromValue(short val)
+const HuffDataCompressor::HuffCode_t* HuffDataCompressor::GetCodeFromValue(short val) const
 {
-  string emptystr = "";
-  
   if(std::abs(val) > m_MaxDiff && val != m_NSeqRepVal)
     {
       msg_err<<__FILE__<<", "<<__LINE__<<" the value '"<<val<<"' exceeds range"<<endl;
-      return emptystr;
+      return nullptr;
     }
 
-  std::map<short, std::string>::iterator it;
-  it = m_CmMap.find( val );
-  if(it != m_CmMap.end())
-    return it->second;
-  
+  int idx = val + m_MaxDiff;
+  if(idx >= 0 && idx < (int)m_EncTable.size() && m_EncTable[idx].len > 0)
+    return &m_EncTable[idx];
+
   //
   msg_err<<__FILE__<<", "<<__LINE__<<" the value '"<<val<<"' could not be found"<<endl;
-  return emptystr;
+  return nullptr;
 }
 
 
 //
-// Internal buffer to store raw adc / adc differences
 //
-// Add to huff buffer
-void HuffDataCompressor::AddToHuffBuffer(short val, bool rawadc)
-{
-  HuffAccum_t tmp;
-  tmp.value   = val;
-  tmp.nrep    = 0;
-  tmp.codestr = "";
-
-  if(!rawadc) 
-    tmp.codestr = GetCodeFromValue(val);
-  else
-    {
-      HuffBuffer.push_back( tmp );
-      return;
-    }
-  
-  // check if the last value was the same
-  if( HuffBuffer.back().value == tmp.value && 
-      !HuffBuffer.back().codestr.empty() )
-    {
-      // just increment repetition counter
-      HuffBuffer.back().nrep += 1;
-    }
-  else
-    {
-      // add new entry
-      HuffBuffer.push_back( tmp );
-    }
-}
-
 //
-//
-//
-// get binary string
-std::string HuffDataCompressor::GetBinaryString(short val, size_t strsize)
+// check number of ADC bits
+bool HuffDataCompressor::CheckNbitsAdc( short nbadc ) const
 {
-  std::string s = bitset<16> ( val ).to_string();
-
-  if(strsize < 16)
-    return s.substr(s.size() - strsize); //crop to required size
-    
-  // ok we have a long string. Why?
-  msg_warn<<__FILE__<<", "<<__LINE__<<" the string looks too long"<<endl;
-  while(s.size() < strsize) s = "0" + s; //pad 0 to front
-  return s;
-}
-
-//
-//
-//
-// set number of ADC bits
-bool HuffDataCompressor::SetNbitsAdc( short nbadc )
-{
-  if( nbadc > m_MaxAdcBits ) return false;
-  
-  // this is max bits that can be occupied by data
-  m_NbitsHC    = nbadc;
-  
-  // our basic packet size (should not exceed m_MaxAdcBits)
-  m_PacketSize = m_NbitsHC + m_NbitsHead;
-
-  return true;
-}
-
-//
-//
-//
-// add words to byte buffer keeping track of the remainder
-// partbyte ("partial byte") contains the remainder string
-void HuffDataCompressor::AddWordsToByteBuffer(std::string words, 
-					      std::vector<BYTE> &buf, 
-					      std::string &partbyte)
-{
-  if( words.empty() && partbyte.empty() ) return;
-
-  // nothing to add yet
-  if( words.size() < m_NbitsByte && partbyte.empty() )
-    {
-      partbyte = words;
-      return;
-    }
-  
-  // just pad with 0 and finish
-  if(words.empty() && !partbyte.empty())
-    {
-      // pad partial byte until we get to a full byte
-      while(partbyte.size() < m_NbitsByte) partbyte += "0";
-      buf.push_back( (strtoul(partbyte.c_str(), 0, 2) & 0xff) );
-      partbyte.clear();
-      return;
-    }
-  
-  for(size_t i=0;i<words.size();i++)
-    {
-      if(partbyte.size() == m_NbitsByte)
-	{
-	  buf.push_back( (strtoul(partbyte.c_str(), 0, 2) & 0xff) );
-	  partbyte.clear();
-	}
-      
-      partbyte += words[i];
-    }
+  return nbadc > 0 && nbadc <= m_MaxAdcBits;
 }
 
 
@@ -299,132 +334,113 @@ void HuffDataCompressor::AddWordsToByteBuffer(std::string words,
 //
 // compress ch data using huffman codes
 void HuffDataCompressor::CompressChData( short nbadc, std::vector<adc16_t> &raw_in,
-					 std::vector<BYTE> &bin_out )
+					 std::vector<BYTE> &bin_out ) const
 {
-  if(!SetNbitsAdc( nbadc ))
+  if(!CheckNbitsAdc( nbadc ))
     {
       bin_out.clear();
       msg_err<<"ADC "<<nbadc<<" bits exceeds max supported "<<m_MaxAdcBits<<endl;
       return;
     }
-  
-  
-  HuffBuffer.clear();
-  
-  // calculate differences and fill our HC buffer
-  short delta;
-  for(size_t i=0;i<raw_in.size();i++)
-    {
-      if(i==0) delta = m_MaxDiff + 1;
-      else delta = raw_in[i] - raw_in[i-1];
-      
-      if(std::abs(delta) > m_MaxDiff)  // store uncompressed raw data
-	AddToHuffBuffer( (short)raw_in[i], true );
-      else
-	AddToHuffBuffer( delta, false );
-    }
-  
-  
+
   // not defined unless SeqEnable is set
-  string bitrepcode = "";
-  if(m_SeqEnable) 
+  const HuffCode_t *repcode = nullptr;
+  if(m_SeqEnable)
     {
-      bitrepcode = GetCodeFromValue( m_NSeqRepVal ); //NSeqRep );
-      if(bitrepcode.empty())
+      repcode = GetCodeFromValue( m_NSeqRepVal );
+      if(!repcode)
 	{
 	  msg_err<<__FILE__<<", "<<__LINE__
 		 <<" encoding repetion failed. Aborting ..."<<endl;
 	  return;
 	}
-    }  
-  
-  // now compress stream
-  short nhcrep;  //repetition 
-  string bitword, bitcode, partbyte;
-  bitword  = "";
-  partbyte = ""; // string to hold ramainder of byte
-
-  for(size_t i=0;i<HuffBuffer.size();i++)
+    }
+
+  const unsigned ncodebits = nbadc;  // code bits in a compressed packet
+  BitWriter writer( bin_out );
+  bool     inpacket = false;         // a compressed packet has been started
+  unsigned nused    = 0;             // code bits used in that packet
+
+  // write a code, splitting it across compressed packets as needed
+  auto putCode = [&](const HuffCode_t &code)
     {
-      
-      //cout<<i
-      //<<" "<<HuffBuffer[i].value
-      //<<" "<<HuffBuffer[i].nrep;
-      //if( !HuffBuffer[i].codestr.empty() ) cout<<" "<<HuffBuffer[i].codestr<<endl;
-      //else cout<<" rawadc "<<endl;
-	
-      if(HuffBuffer[i].codestr.empty()) //raw adc
+      unsigned left = code.len;
+      while(left > 0)
 	{
-	  // write out whatever we have in the buffer
-	  if(bitword.size() > m_NbitsHead) // more than just a header
+	  if(!inpacket)
 	    {
-	      // pad with zero's to buffer length
-	      while(bitword.size() < m_PacketSize) bitword += "0"; 
-	      AddWordsToByteBuffer( bitword, bin_out, partbyte );
+	      writer.Write( 1, m_NbitsHead );
+	      inpacket = true;
+	      nused    = 0;
 	    }
-	  
-	  // uncompressed data
-	  bitword = "0" + GetBinaryString( HuffBuffer[i].value, m_NbitsHC );
-	  
-	  //
-	  AddWordsToByteBuffer( bitword, bin_out, partbyte );
-	  bitword = "1";
-	  continue;
+	  unsigned nput = std::min(left, ncodebits - nused);
+	  writer.Write( code.bits >> (left - nput), nput );
+	  left  -= nput;
+	  nused += nput;
+	  if(nused == ncodebits) inpacket = false;
 	}
+    };
 
-      // compress data
-      bitcode  = HuffBuffer[i].codestr;
-      nhcrep   = HuffBuffer[i].nrep;
+  // write an uncompressed packet, padding any open compressed one
+  auto putRaw = [&](adc16_t val)
+    {
+      if(inpacket)
+	{
+	  writer.Write( 0, ncodebits - nused );
+	  inpacket = false;
+	}
+      writer.Write( 0, m_NbitsHead );
+      writer.Write( val, nbadc );
+    };
 
-      for(short jj=0;jj<=nhcrep;jj++)
+  // write a run of nrep+1 identical differences
+  auto putRun = [&](short delta, int nrep)
+    {
+      const HuffCode_t *code = GetCodeFromValue( delta );
+      if(!code) return;
+      for(int jj=0;jj<=nrep;jj++)
 	{
-	  //
-	  if(jj==0)
-	    bitword += bitcode;
-	  else if(jj+m_NSeqRep <= nhcrep && m_SeqEnable)
+	  if(jj > 0 && jj+m_NSeqRep <= nrep && m_SeqEnable)
 	    {
-	      bitword += bitrepcode;
+	      putCode( *repcode );
 	      jj += (m_NSeqRep-1);
 	    }
 	  else
-	    bitword += bitcode;
-	  
-	  
-	  // attempt to write to compresssed stream
-	  if(bitword.size() >= m_PacketSize) // check the size
-	    {
-	      if(bitword.size() == m_PacketSize) //write it out
-		{
-		  AddWordsToByteBuffer( bitword, bin_out, partbyte );
-		  bitword = "1"; //next iteration of compression
-		}
-	      else
-		{
-		  // too large for one packet 
-		  string towrite = bitword.substr(0, m_PacketSize);
-		  string tosave  = bitword.substr(m_PacketSize);
-		  
-		  // write out
-		  AddWordsToByteBuffer( towrite, bin_out, partbyte );
-		  
-		  // carry over for next iteration
-		  bitword = "1" + tosave; 
-		}
-	    }
-	} // end for
-
-    } // end i-loop
-  
-  //cout<<"Last bitword and partial byte"<<bitword<<" "<<partbyte<<endl;
-  
-  // write whatever is left
-  if(bitword.size() > m_NbitsHead) // more than just a header
-    AddWordsToByteBuffer( bitword, bin_out, partbyte );
-  
-  //cout<<"Last partial byte word "<<partbyte<<endl;
-  
+	    putCode( *code );
+	}
+    };
+
+  // calculate differences and collect runs of identical ones
+  short rundelta = 0;
+  int   runrep   = -1;  // no run
+  for(size_t i=0;i<raw_in.size();i++)
+    {
+      short delta;
+      if(i==0) delta = m_MaxDiff + 1;
+      else delta = raw_in[i] - raw_in[i-1];
+
+      if(std::abs(delta) > m_MaxDiff)  // store uncompressed raw data
+	{
+	  if(runrep >= 0) putRun( rundelta, runrep );
+	  runrep = -1;
+	  putRaw( raw_in[i] );
+	}
+      else if(runrep >= 0 && delta == rundelta)
+	{
+	  // just increment repetition counter
+	  runrep++;
+	}
+      else
+	{
+	  if(runrep >= 0) putRun( rundelta, runrep );
+	  rundelta = delta;
+	  runrep   = 0;
+	}
+    }
+  if(runrep >= 0) putRun( rundelta, runrep );
+
   // write out remaning byte padded with 0s to next byte boundary
-  AddWordsToByteBuffer( "", bin_out, partbyte );
+  writer.Flush();
 }
 
 
@@ -434,10 +450,10 @@ void HuffDataCompressor::CompressChData( short nbadc, std::vector<adc16_t> &raw_
 // compress event data using huffman codes
 void HuffDataCompressor::CompressEventData( short nbadc, size_t nch, size_t seqlen,
 					    std::vector<adc16_t> &raw_in,
-					    std::vector<BYTE> &bin_out )
+					    std::vector<BYTE> &bin_out ) const
 {
   bin_out.clear();
-  if(!SetNbitsAdc( nbadc ))
+  if(!CheckNbitsAdc( nbadc ))
     {
       msg_err<<"ADC "<<nbadc<<" bits exceeds max supported "<<m_MaxAdcBits<<endl;
       return;
@@ -448,12 +464,13 @@ void HuffDataCompressor::CompressEventData( short nbadc, size_t nch, size_t seql
       msg_err<<"Length of raw data vector does not match with expected "<<endl;
       return;
     }
-  
+
+  std::vector<adc16_t> chdata;
   for(size_t i=0;i<nch;i++)
     {
       size_t istart = i*seqlen;
       // get ch data
-      std::vector<adc16_t> chdata(&raw_in[istart], &raw_in[istart+seqlen]);
+      chdata.assign(raw_in.begin() + istart, raw_in.begin() + istart + seqlen);
       CompressChData( nbadc, chdata, bin_out );
     }
 }
@@ -464,10 +481,10 @@ void HuffDataCompressor::CompressEventData( short nbadc, size_t nch, size_t seql
 // compress event data using huffman codes
 void HuffDataCompressor::CompressEventData( short nbadc, size_t nch, size_t seqlen,
 					    std::vector< std::vector<adc16_t> > &raw_in,
-					    std::vector<BYTE> &bin_out )
+					    std::vector<BYTE> &bin_out ) const
 {
   bin_out.clear();
-  if(!SetNbitsAdc( nbadc ))
+  if(!CheckNbitsAdc( nbadc ))
     {
       msg_err<<"ADC "<<nbadc<<" bits exceeds max supported "<<m_MaxAdcBits<<endl;
       return;
@@ -478,10 +495,10 @@ void HuffDataCompressor::CompressEventData( short nbadc, size_t nch, size_t seql
       msg_err<<"Number of ch in raw data vector does not match with expected "<<endl;
       return;
     }
-  
+
   for(size_t i=0;i<nch;i++)
     {
-      if( raw_in[i].size() != seqlen ) 
+      if( raw_in[i].size() != seqlen )
 	{
 	  msg_err<<"No support for compression of unequal sequence lenghts at the moment"<<endl;
 	  bin_out.clear();
@@ -496,458 +513,221 @@ void HuffDataCompressor::CompressEventData( short nbadc, size_t nch, size_t seql
 //
 //
 //
-// decode individual bits from a byte
-void HuffDataCompressor::ReadNextByte(size_t &byteidx, const char *buf,
-				      std::deque<bitset<1> > &bits)
-{
-  unsigned short bitmask = 1 << (m_NbitsByte - 1);
-  
-  // decode individual bits
-  for(size_t i=0;i<m_NbitsByte;i++)
-    bits.push_back( bitset<1>( (buf[byteidx] & (bitmask >> i)) != 0) );
-  
-  byteidx++;
-}
-
-
-//
-//
-//
-// decode individual bits from a byte
-void HuffDataCompressor::ReadNextByte(std::ifstream &fin, std::deque< std::bitset<1> > &bits, 
-				      bool &status)
-{
-  status = true;
-  char byteword;
-  
-  if(!fin.get(byteword))
-    {
-      status = false;
-      return;
-    }
-
-  unsigned short bitmask = 1 << (m_NbitsByte - 1);
-  
-  // decode individual bits
-  for(size_t i=0;i<m_NbitsByte;i++)
-    bits.push_back( bitset<1>( (byteword & (bitmask >> i)) != 0) );
-}
-
-
-//
-//
-// 
-// Decompress event from binary sequence (only single event)
+// Decompress nch channels of seqlen samples each
+// Returns false on a decoding error; adc then holds the samples decoded so far
+// bytesleft is set to the number of bytes taken from the source but not used
 //
-void HuffDataCompressor::DecompressEventData( short nbadc,
-					      size_t nch,
-					      size_t seqlen, 
-					      const char *buf, size_t bufsize, size_t &byteidx,
-					      std::vector<adc16_t> &adc )
+template<class Source>
+bool HuffDataCompressor::DecompressChannels( Source &src, short nbadc, size_t nch, size_t seqlen,
+					     std::vector<adc16_t> &adc, size_t &bytesleft ) const
 {
-  if(!SetNbitsAdc( nbadc ))
-    {
-      msg_err<<"ADC "<<nbadc<<" bits exceeds max supported "<<m_MaxAdcBits<<endl;
-      return;
-    }
-  adc.clear();
-
-  vector< adc16_t > chdata;
-  deque< bitset<1> > bitqueue;
+  BitReader<Source> reader( src );
+  bytesleft = 0;
+  adc.reserve( nch*seqlen );
 
-  stringstream ss;
+  const unsigned ncodebits = nbadc;
   short lastdelta  = -999;
-  size_t bitsread  = 0;
-  int noread       = 0;
 
-  size_t chread  = 0;
-
-  byteidx   = 0;
-  // basic idea is to read bits one byte at a time from the input buffer
-  // the first entry in the bitqueue deck should always be aligned on the 
-  // compressed / raw flag and the deck should contain at least m_PacketSize bits
-  while( adc.size() != nch*seqlen )
+  for(size_t ich=0;ich<nch;ich++)
     {
-      if(byteidx<bufsize) ReadNextByte(byteidx, buf, bitqueue);
-      else noread++;
-      
-      if(noread > 1) //loopcounter == 1, we process last bits but not read new byte
+      size_t   chstart = adc.size();
+      size_t   nsample = 0;
+      uint32_t carry   = 0;  // bits of a code continued in the next packet
+      unsigned ncarry  = 0;
+      bool     nocode  = false; // the last compressed packet ended with bits that
+                                // cannot start a code: only valid as padding
+
+      while( nsample < seqlen )
 	{
-	  msg_err<<"There seems to be a problem with decoding"<<endl
-		 <<"Bytes read "<<byteidx<<" out of "<<bufsize<<endl
-		 <<"Samples accumulated in this channel "<<chdata.size()<<endl
-		 <<"Remaining bits are "<<bitqueue.size()<<" "<<bitqueue.empty()<<endl;
-	  break;
-	}
-      
-      //read more bytes if possible
-      if( bitqueue.size() < m_PacketSize && byteidx != bufsize) 
-	continue;
+	  if( !reader.Fill( m_NbitsHead ) )
+	    {
+	      msg_err<<"There seems to be a problem with decoding"<<endl
+		     <<"Ran out of data in channel "<<ich<<endl
+		     <<"Samples accumulated in this channel "<<nsample<<endl;
+	      bytesleft = reader.BytesLeft();
+	      return false;
+	    }
 
-      bool iscomp = bitqueue.front().test(0);
-      bitsread++;
-      bitqueue.pop_front(); // compressed / raw flag      
+	  bool iscomp = reader.Read( m_NbitsHead );
 
-      if(!iscomp) // uncompressed
-	{
-	  ss.str(""); //clear our code string (could carry over from compressed)
-	  
-	  if( bitqueue.size() < m_NbitsHC ) 
+	  if(!iscomp) // uncompressed
 	    {
-	      msg_err<<"Fatal decoding error has been encountered : "<<endl
-		     <<" Number of bits in the uncompressed stream should be at least "
-		     <<m_NbitsHC<<" the current value is "<<bitqueue.size()<<endl;
-	      abort();
+	      if( !reader.Fill( nbadc ) )
+		{
+		  msg_err<<"Fatal decoding error has been encountered : "<<endl
+			 <<" Number of bits in the uncompressed stream should be at least "
+			 <<nbadc<<" the current value is "<<reader.Available()<<endl;
+		  bytesleft = reader.BytesLeft();
+		  return false;
+		}
+	      adc.push_back( reader.Read( nbadc ) & 0x7FFF );
+	      nsample++;
+	      ncarry = 0; // a partial code does not carry over raw data
+	      nocode = false;
+	      continue;
 	    }
-	  
-	  size_t bitcounter = 0;
-	  while(bitcounter < m_NbitsHC) 
+
+	  // compressed packet: walk the decoding table over the codes it holds
+	  // (the last packet of a channel may be shorter)
+	  reader.Fill( ncodebits );
+	  unsigned nbits = std::min( ncodebits, reader.Available() );
+	  if( nbits == 0 )
 	    {
-	      ss << bitqueue.front();
-	      bitqueue.pop_front();
-	      bitcounter++;
+	      msg_err<<"There seems to be a problem with decoding"<<endl
+		     <<"Ran out of data in channel "<<ich<<endl
+		     <<"Samples accumulated in this channel "<<nsample<<endl;
+	      bytesleft = reader.BytesLeft();
+	      return false;
 	    }
-	  bitsread += bitcounter;
-
-	  adc16_t val = ( strtoul(ss.str().c_str(), 0, 2) & 0x7FFF );
-	  chdata.push_back( val );
-	  ss.str("");
-	}
-      else // handle compressed bits
-	{
-	  size_t bitcounter = 0;
-	  size_t bitstoread = m_NbitsHC;
-	  if( bitqueue.size() < m_NbitsHC ) 
-	    bitstoread = bitqueue.size();
-	  
-	  while( bitcounter < bitstoread )
-	    {	      
-	      ss << bitqueue.front();
-	      bitqueue.pop_front();
-	      bitcounter++;
-	      bitsread++;
-	      // check if we have a good code
-	      size_t strsize = ss.str().size();
-	      if( strsize >= m_MinCodeSize && strsize <= m_MaxCodeSize ) 
+	  uint32_t win   = (carry << nbits) | reader.Peek( nbits );
+	  unsigned nwin  = ncarry + nbits;
+	  unsigned nleft = nwin;
+	  bool     error = false;
+	  while( nleft > 0 && nsample < seqlen )
+	    {
+	      uint32_t idx = nleft >= kTableBits ?
+		(win >> (nleft - kTableBits)) : (win << (kTableBits - nleft));
+	      const HuffDecode_t &entry = m_DecTable[ idx & ((1u << kTableBits) - 1) ];
+	      if( entry.len == 0 || entry.len > nleft ) break; // code continues in next packet
+	      nleft -= entry.len;
+
+	      short val = entry.value;
+	      if( nsample == 0 )
+		error = true;
+	      else if( std::abs(val) <= m_MaxDiff )
 		{
-		  bool ok = (m_UCmMap[strsize-1].first == ss.str());
-		  if(!ok) continue; //not a good code
-		  short val = m_UCmMap[strsize-1].second;
-		  
-		  ss.str(""); //reset string code
-
-		  
-		  // add to our adc vector
-		  if( std::abs(val) <= m_MaxDiff)
-		    {
-		      adc16_t newval = chdata.back() + val;
-		      chdata.push_back( newval );
-		      lastdelta = val;
-		    }
-		  else if(val == m_NSeqRepVal)
+		  adc.push_back( adc.back() + val );
+		  nsample++;
+		  lastdelta = val;
+		}
+	      else if( val == m_NSeqRepVal )
+		{
+		  if( nsample + m_NSeqRep > seqlen || std::abs(lastdelta) > m_MaxDiff )
+		    error = true;
+		  else
 		    {
 		      for(short j=0;j<m_NSeqRep;j++)
-			{
-			  adc16_t newval = chdata.back() + lastdelta; //add same value
-			  chdata.push_back( newval );
-			}
-		    }		
-		}// end of if
-	      
-	      // we got the whole sequence now
-	      if(chdata.size() == seqlen) break;
-
-	    } // end while bitcounter
-	} // end else 
-      
-      // check if we finished decoding data for a given channel
-      if(chdata.size() == seqlen)
-	{
-	  
-	  // calculate number of padded bits to the byte boundary
-	  size_t padbits = bitsread % m_NbitsByte;
-	  if(padbits > 0) padbits = m_NbitsByte - padbits;
-	  
-	  if(m_Verbosity > 1)
-	    {
-	      msg_info<<"Bytes read : "<<byteidx<<endl
-		      <<"Bits read  : "<<bitsread<<endl
-		      <<"Bits to boundary : "<<padbits<<endl
-		      <<"Last value : "<<chdata.back()<<" ADC "<<endl;
+			adc.push_back( adc.back() + lastdelta ); //add same value
+		      nsample += m_NSeqRep;
+		    }
+		}
+	      if( error ) break;
 	    }
-	  
-	  // error checking
-	  if( bitqueue.size() < padbits )
+
+	  if( error || nocode )
 	    {
 	      msg_err<<"Fatal decoding error has been encountered : "<<endl
-		     <<"Byte boundary does not appear to be valid"<<endl
-		     <<"Check that the codes are padded with 0 to the next byte boundary"<<endl;
-	      abort();
+		     <<" Invalid code sequence in channel "<<ich
+		     <<" after "<<nsample<<" samples"<<endl;
+	      bytesleft = reader.BytesLeft();
+	      return false;
 	    }
-	  
-	  // remove padded bits
-	  while(padbits > 0)
+
+	  if( nsample == seqlen )
 	    {
-	      bitqueue.pop_front();
-	      padbits--;
+	      // only the bits up to the last code belong to this channel
+	      reader.Skip( nbits - std::min( nbits, nleft ) );
+	      break;
 	    }
-	  
-	  // some basic check
-	  if(!bitqueue.empty())
-	    {
-	      if(bitqueue.front().test(0) && chread <= (nch-1) )
-		{
-		  msg_err<<"Fatal decoding error had been encounter : "<<endl
-			 <<"The first bit of the next ch sequence should always be 0 and not "
-			 <<bitqueue.front()<<endl;
-		  abort();
-		}
-	    }
-
-	  // reset the bitsread counter
-	  bitsread = 0;
-	  
-	  // save channel data
-	  adc.insert(adc.end(), chdata.begin(), chdata.end() );
-	  chread++;
-	  chdata.clear();
-	  
-	  if(m_Verbosity > 1)
-	    cout<<"Decoded "<<adc.size()<<" samples"<<endl<<endl;
-	}
-      
-      // basic consistency check
-      if(chread == nch)
-	{
-	  // let's see if we grabbed more bytes than needed
-	  if(bitqueue.size() > 0) // should be no more than 8
+	  reader.Skip( nbits );
+	  if( nleft >= kTableBits )
 	    {
-	      msg_info<<"Bits remaning in the queue "<<bitqueue.size()<<endl;
-	      byteidx--;
+	      // zero padding before a raw packet, otherwise an error
+	      nocode = true;
+	      ncarry = 0;
 	    }
-	  
-	  
-	  if(m_Verbosity > 0)
+	  else
 	    {
-	      if(m_Verbosity > 1) 	      
-		msg_info<<"Bits remaning in the queue "<<bitqueue.size()<<endl;
-	      msg_info<<"DECOMPRESSED EVENT STATUS: OK "<<endl;
+	      carry  = win & ((1u << nleft) - 1);
+	      ncarry = nleft;
 	    }
+	}
+
+      // channels are padded with 0 to the byte boundary
+      reader.AlignToByte();
+
+      if(m_Verbosity > 1)
+	{
+	  msg_info<<"Channel "<<ich<<" : "<<nsample<<" samples"<<endl
+		  <<"Last value : "<<adc.back()<<" ADC "<<endl;
+	}
 
-	  // ok we are done
-	  break;
+      // some basic check
+      if( ich + 1 < nch && reader.Fill( m_NbitsHead ) && reader.Peek( m_NbitsHead ) != 0 )
+	{
+	  msg_err<<"Fatal decoding error had been encounter : "<<endl
+		 <<"The first bit of the next ch sequence should always be 0 and not 1"<<endl;
+	  bytesleft = reader.BytesLeft();
+	  return false;
 	}
-    } // end while loop
+
+      if(m_Verbosity > 1)
+	cout<<"Decoded "<<adc.size() - chstart<<" samples"<<endl<<endl;
+    }
+
+  if(m_Verbosity > 0)
+    msg_info<<"DECOMPRESSED EVENT STATUS: OK "<<endl;
+
+  bytesleft = reader.BytesLeft();
+  return true;
 }
 
+
 //
 //
-// 
-// Decompress event data from binary file
-// It IS MANDATORY that the position in the file is 
-// set to the beginning of the event data before calling this function
 //
-void HuffDataCompressor::DecompressEventData( std::ifstream &fin, 
-					      short nbadc, 
+// Decompress event from binary sequence (only single event)
+//
+void HuffDataCompressor::DecompressEventData( short nbadc,
 					      size_t nch,
 					      size_t seqlen,
-					      std::vector< adc16_t > &adc)
+					      const char *buf, size_t bufsize, size_t &byteidx,
+					      std::vector<adc16_t> &adc ) const
 {
-  if(!SetNbitsAdc( nbadc ))
+  byteidx = 0;
+  if(!CheckNbitsAdc( nbadc ))
     {
       msg_err<<"ADC "<<nbadc<<" bits exceeds max supported "<<m_MaxAdcBits<<endl;
       return;
     }
   adc.clear();
-  
-  vector< adc16_t > chdata;
-  deque< bitset<1> > bitqueue;
-
-  stringstream ss;
-  short lastdelta  = -999;
-  size_t byteidx   = 0;
-  size_t bitsread  = 0;
-
-  int noread = 0;  
-  bool flag;
-  
-  size_t chread  = 0;
-  
-  // basic idea is to read bits one byte at a time from the input buffer
-  // the first entry in the bitqueue deck should always be aligned on the 
-  // compressed / raw flag and the deck should contain at least m_PacketSize bits
-  while( adc.size() != nch*seqlen )
-    {
-      ReadNextByte(fin, bitqueue, flag);
-      if(!flag) noread++;
-      
-      if(noread > 1) //noread == 1, we process last bits but not read new byte
-	{
-	  msg_err<<"There seems to be a problem with decoding"<<endl
-		 <<"Samples accumulated in this channel "<<chdata.size()<<endl
-		 <<"Remaining bits are "<<bitqueue.size()<<" "<<bitqueue.empty()<<endl;
-	  break;
-	}
-      
-      //read more bytes if possible
-      if( bitqueue.size() < m_PacketSize && noread < 1) 
-	continue;
 
-      bool iscomp = bitqueue.front().test(0);
-      bitsread++;
-      bitqueue.pop_front(); // compressed / raw flag      
+  MemorySource src{buf, bufsize, 0};
+  size_t bytesleft;
+  if( !DecompressChannels( src, nbadc, nch, seqlen, adc, bytesleft ) )
+    msg_err<<"Bytes read "<<src.idx<<" out of "<<bufsize<<endl;
 
-      if(!iscomp) // uncompressed
-	{
-	  ss.str(""); //clear our code string (could carry over from compressed)
-	  
-	  if( bitqueue.size() < m_NbitsHC ) 
-	    {
-	      msg_err<<"Fatal decoding error has been encountered : "<<endl
-		     <<"Number of bits in the uncompressed stream should be at least "
-		     <<m_NbitsHC<<" the current value is "<<bitqueue.size()<<endl;
-	      abort();
-	    }
-	  
-	  size_t bitcounter = 0;
-	  while(bitcounter < m_NbitsHC) 
-	    {
-	      ss << bitqueue.front();
-	      bitqueue.pop_front();
-	      bitcounter++;
-	    }
-	  bitsread += bitcounter;
+  byteidx = src.idx - bytesleft;
+}
 
-	  adc16_t val = ( strtoul(ss.str().c_str(), 0, 2) & 0x7FFF );
-	  chdata.push_back( val );
-	  ss.str("");
-	}
-      else // handle compressed bits
-	{
-	  size_t bitcounter = 0;
-	  size_t bitstoread = m_NbitsHC;
-	  if( bitqueue.size() < m_NbitsHC ) 
-	    bitstoread = bitqueue.size();
-	  
-	  while( bitcounter < bitstoread )
-	    {	      
-	      ss << bitqueue.front();
-	      bitqueue.pop_front();
-	      bitcounter++;
-	      bitsread++;
-	      // check if we have a good code
-	      size_t strsize = ss.str().size();
-	      if( strsize >= m_MinCodeSize && strsize <= m_MaxCodeSize ) 
-		{
-		  bool ok = (m_UCmMap[strsize-1].first == ss.str());
-		  if(!ok) continue; //not a good code
-		  short val = m_UCmMap[strsize-1].second;
-		  
-		  // otherwise reset the code
-		  ss.str(""); //reset string code
-		  
-		  // add to our adc vector
-		  if( std::abs(val) <= m_MaxDiff)
-		    {
-		      adc16_t newval = chdata.back() + val;
-		      chdata.push_back( newval );
-		      lastdelta = val;
-		    }
-		  else if(val == m_NSeqRepVal)
-		    {
-		      for(short j=0;j<m_NSeqRep;j++)
-			{
-			  adc16_t newval = chdata.back() + lastdelta; //add same value
-			  chdata.push_back( newval );
-			}
-		    }		
-		}// end of if
-	      
-	      // we got the whole sequence now
-	      if(chdata.size() == seqlen) break;
-
-	    } // end while bitcounter
-	} // end else 
-      
-      // check if we finished decoding data for a given channel
-      if(chdata.size() == seqlen)
-	{
-	  
-	  // calculate number of padded bits to the byte boundary
-	  size_t padbits = bitsread % m_NbitsByte;
-	  if(padbits > 0) padbits = m_NbitsByte - padbits;
-	  
-	  if(m_Verbosity > 1)
-	    {
-	      msg_info<<"Bytes read : "<<byteidx<<endl
-		      <<"Bits read  : "<<bitsread<<endl
-		      <<"Bits to boundary : "<<padbits<<endl
-		      <<"Last value : "<<chdata.back()<<" ADC "<<endl;
-	    }
-	  
-	  // error checking
-	  if( bitqueue.size() < padbits )
-	    {
-	      msg_err<<"Fatal decoding error has been encountered : "<<endl
-		     <<" Byte boundary does not appear to be valid"<<endl
-		     <<" Check that the codes are padded with 0 to the next byte boundary"<<endl;
-	      abort();
-	    }
-	  
-	  // remove padded bits
-	  while(padbits > 0)
-	    {
-	      bitqueue.pop_front();
-	      padbits--;
-	    }
-	  
-	  // some basic check
-	  if(!bitqueue.empty())
-	    {
-	      if(bitqueue.front().test(0) && chread <= (nch-1) )
-		{
-		  msg_err<<"Fatal decoding error had been encounter : "<<endl
-			 <<" The first bit of the next ch sequence should always be 0 and not "
-			 <<bitqueue.front()<<endl;
-		  abort();
-		}
-	    }
+//
+//
+//
+// Decompress event data from binary file
+// It IS MANDATORY that the position in the file is
+// set to the beginning of the event data before calling this function
+//
+void HuffDataCompressor::DecompressEventData( std::ifstream &fin,
+					      short nbadc,
+					      size_t nch,
+					      size_t seqlen,
+					      std::vector< adc16_t > &adc) const
+{
+  if(!CheckNbitsAdc( nbadc ))
+    {
+      msg_err<<"ADC "<<nbadc<<" bits exceeds max supported "<<m_MaxAdcBits<<endl;
+      return;
+    }
+  adc.clear();
 
-	  // reset the bitsread counter
-	  bitsread = 0;
-	  
-	  // save channel data
-	  adc.insert(adc.end(), chdata.begin(), chdata.end() );
-	  chread++;
-	  chdata.clear();
-	  
-	  if(m_Verbosity > 1)
-	    msg_info<<"Decoded "<<adc.size()<<" samples"<<endl<<endl;
-	}
-      
-      // basic consistency check
-      if(chread == nch)
-	{
-	  // let's see if we grabbed more bytes than needed
-	  if(bitqueue.size() > 0) // should be no more than 8
-	    {
-	      msg_info<<"Bits remaning in the queue "<<bitqueue.size()<<endl;
-	      msg_info<<"Current position in file "<<fin.tellg();
-	      fin.seekg( -1, std::ios::cur );
-	      msg_info<<" Prv position in the file "<<fin.tellg()<<endl;
-	    }
-	  
-	  
-	  if(m_Verbosity > 0)
-	    {
-	      if(m_Verbosity > 1) 	      
-		msg_info<<"Bits remaning in the queue "<<bitqueue.size()<<endl;
-	      msg_info<<"DECOMPRESSED EVENT STATUS: OK "<<endl;
-	    }
+  StreamSource src{fin};
+  size_t bytesleft;
+  DecompressChannels( src, nbadc, nch, seqlen, adc, bytesleft );
 
-	  // ok we are done
-	  break;
-	}
-      
-    } // end while 
+  // put back the bytes read ahead of the end of the event
+  if( bytesleft > 0 )
+    {
+      fin.clear();
+      fin.seekg( -(std::streamoff)bytesleft, std::ios::cur );
+    }
 }
@@ -0,0 +1,76 @@
+// bench_HuffDataCompressor.cxx
+//
+// Measure the compression and decompression throughput of the Huffman codec
+// on simulated 12-bit waveforms.
+//
+// Usage: bench_HuffDataCompressor [NCH [NSAMPLE [NREP]]]
+
+#include <string>
+#include <iostream>
+#include <random>
+#include <vector>
+#include <chrono>
+#include "duneprototypes/3x1x1dp/DataImport/Services/HuffDataCompressor.h"
+
+using std::string;
+using std::cout;
+using std::endl;
+using std::vector;
+using Clock = std::chrono::steady_clock;
+using dlardaq::HuffDataCompressor;
+using dlardaq::adc16_t;
+using dlardaq::BYTE;
+
+//**********************************************************************
+
+int main(int argc, char* argv[]) {
+  const string myname = "bench_HuffDataCompressor: ";
+  if ( argc > 1 && string(argv[1]) == "-h" ) {
+    cout << "Usage: " << argv[0] << " [NCH [NSAMPLE [NREP]]]" << endl;
+    return 0;
+  }
+  size_t nch = argc > 1 ? std::stoi(argv[1]) : 1280;
+  size_t nsam = argc > 2 ? std::stoi(argv[2]) : 1667;
+  unsigned int nrep = argc > 3 ? std::stoi(argv[3]) : 10;
+
+  // Noise around a pedestal with occasional pulses.
+  std::mt19937 gen(12345);
+  std::normal_distribution<double> noise(0.0, 1.5);
+  vector<adc16_t> raw(nch*nsam);
+  for ( size_t ich=0; ich<nch; ++ich ) {
+    double ped = 400 + gen() % 200;
+    for ( size_t isam=0; isam<nsam; ++isam ) {
+      double adc = ped + noise(gen);
+      if ( isam % 500 > 480 ) adc += 200;
+      raw[ich*nsam + isam] = adc16_t(adc + 0.5);
+    }
+  }
+
+  const HuffDataCompressor& hc = HuffDataCompressor::Instance();
+  vector<BYTE> comp;
+  vector<adc16_t> adcs;
+  size_t byteidx = 0;
+
+  Clock::time_point t0 = Clock::now();
+  for ( unsigned int irep=0; irep<nrep; ++irep ) hc.CompressEventData(12, nch, nsam, raw, comp);
+  Clock::time_point t1 = Clock::now();
+  for ( unsigned int irep=0; irep<nrep; ++irep ) {
+    hc.DecompressEventData(12, nch, nsam, comp.data(), comp.size(), byteidx, adcs);
+  }
+  Clock::time_point t2 = Clock::now();
+  if ( adcs != raw ) {
+    cout << myname << "ERROR: round trip failed." << endl;
+    return 1;
+  }
+
+  double mb = nrep*raw.size()*sizeof(adc16_t)/1.0e6;
+  double tcom = std::chrono::duration<double>(t1 - t0).count();
+  double tdec = std::chrono::duration<double>(t2 - t1).count();
+  cout << myname << nch << " channels x " << nsam << " samples" << endl;
+  cout << myname << "Compression ratio: " << double(comp.size())/(raw.size()*sizeof(adc16_t)) << endl;
+  cout << myname << "Compress:   " << mb/tcom << " MB/s (uncompressed)" << endl;
+  cout << myname << "Decompress: " << mb/tdec << " MB/s (uncompressed)" << endl;
+  return 0;
+}
+
+//**********************************************************************
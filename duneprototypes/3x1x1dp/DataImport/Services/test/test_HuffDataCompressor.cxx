@@ -0,0 +1,194 @@
+// test_HuffDataCompressor.cxx
+//
+// Round-trip and format tests for the Huffman codec used for 3x1x1 data.
+
+#include <string>
+#include <iostream>
+#include <fstream>
+#include <random>
+#include <vector>
+#include <thread>
+#include <cstdio>
+#include "duneprototypes/3x1x1dp/DataImport/Services/HuffDataCompressor.h"
+
+#undef NDEBUG
+#include <cassert>
+
+using std::string;
+using std::cout;
+using std::endl;
+using std::vector;
+using dlardaq::HuffDataCompressor;
+using dlardaq::adc16_t;
+using dlardaq::BYTE;
+
+//**********************************************************************
+
+namespace {
+
+// Random waveform with nbadc bit samples.  mode selects how often the
+// differences stay within the code range and how often they repeat.
+vector<adc16_t> makeWaveform(std::mt19937& gen, short nbadc, size_t len, int mode) {
+  vector<adc16_t> wf(len);
+  int maxadc = (1 << nbadc) - 1;
+  int x = gen() % (maxadc + 1);
+  for ( adc16_t& adc : wf ) {
+    int r = gen() % 100;
+    if ( mode == 0 || r < 5 ) x = gen() % (maxadc + 1);
+    else if ( mode == 1 ) x += int(gen() % 7) - 3;
+    else if ( mode == 2 ) { if ( r < 30 ) x += int(gen() % 7) - 3; }
+    else { if ( r < 10 ) x += int(gen() % 3) - 1; }
+    x = std::max(0, std::min(x, maxadc));
+    adc = x;
+  }
+  return wf;
+}
+
+}  // end unnamed namespace
+
+//**********************************************************************
+
+int test_HuffDataCompressor(unsigned int ncase) {
+  const string myname = "test_HuffDataCompressor: ";
+#ifdef NDEBUG
+  cout << myname << "NDEBUG must be off." << endl;
+  abort();
+#endif
+  string line = "-----------------------------";
+  const HuffDataCompressor& hc = HuffDataCompressor::Instance();
+
+  cout << myname << line << endl;
+  cout << myname << "Checking the stream format." << endl;
+  // Made with the original string-based implementation.
+  vector<adc16_t> ref = {2048, 2048, 2049, 2049, 2049, 2049, 2049, 2049, 2049, 2049, 2046,
+                         2100, 2101, 2101, 2099, 2099, 2102, 2102, 2102, 2102, 2102, 2102};
+  vector<unsigned char> refbytes = {0x40, 0x05, 0x16, 0xb0, 0x20, 0x83, 0x48, 0xa1, 0x60, 0x2b, 0x54};
+  vector<BYTE> bytes;
+  hc.CompressChData(12, ref, bytes);
+  assert( bytes.size() == refbytes.size() );
+  for ( size_t ibyt=0; ibyt<bytes.size(); ++ibyt ) assert( (unsigned char)bytes[ibyt] == refbytes[ibyt] );
+  vector<adc16_t> adcs;
+  size_t byteidx = 0;
+  hc.DecompressEventData(12, 1, ref.size(), bytes.data(), bytes.size(), byteidx, adcs);
+  assert( adcs == ref );
+  assert( byteidx == bytes.size() );
+
+  cout << myname << line << endl;
+  cout << myname << "Checking " << ncase << " random round trips." << endl;
+  std::mt19937 gen(20240601);
+  for ( unsigned int icas=0; icas<ncase; ++icas ) {
+    short nbadc = 8 + gen() % 8;
+    size_t nch = 1 + gen() % 8;
+    size_t len = gen() % 500;
+    int mode = gen() % 4;
+    vector<adc16_t> raw;
+    for ( size_t ich=0; ich<nch; ++ich ) {
+      vector<adc16_t> wf = makeWaveform(gen, nbadc, len, mode);
+      raw.insert(raw.end(), wf.begin(), wf.end());
+    }
+    vector<BYTE> comp;
+    hc.CompressEventData(nbadc, nch, len, raw, comp);
+    // Trailing bytes must not be used.
+    size_t ncomp = comp.size();
+    comp.push_back(0x5a);
+    adcs.clear();
+    hc.DecompressEventData(nbadc, nch, len, comp.data(), comp.size(), byteidx, adcs);
+    if ( adcs != raw || byteidx != ncomp ) {
+      cout << myname << "Round trip failed for case " << icas << ": nbadc=" << nbadc
+           << " nch=" << nch << " len=" << len << " mode=" << mode << endl;
+      assert( false );
+    }
+  }
+
+  cout << myname << line << endl;
+  cout << myname << "Checking decompression from a file." << endl;
+  {
+    vector<adc16_t> raw;
+    for ( int ich=0; ich<4; ++ich ) {
+      vector<adc16_t> wf = makeWaveform(gen, 12, 1000, 2);
+      raw.insert(raw.end(), wf.begin(), wf.end());
+    }
+    vector<BYTE> comp;
+    hc.CompressEventData(12, 4, 1000, raw, comp);
+    string fname = "test_HuffDataCompressor.dat";
+    {
+      std::ofstream fout(fname, std::ios::binary);
+      fout.write(comp.data(), comp.size());
+      fout.write(comp.data(), comp.size());
+    }
+    std::ifstream fin(fname, std::ios::binary);
+    for ( int ieve=0; ieve<2; ++ieve ) {
+      hc.DecompressEventData(fin, 12, 4, 1000, adcs);
+      assert( adcs == raw );
+      assert( size_t(fin.tellg()) == (ieve + 1)*comp.size() );
+    }
+    fin.close();
+    std::remove(fname.c_str());
+  }
+
+  cout << myname << line << endl;
+  cout << myname << "Checking truncated and corrupt input is rejected." << endl;
+  {
+    vector<adc16_t> raw = makeWaveform(gen, 12, 2000, 3);
+    vector<BYTE> comp;
+    hc.CompressChData(12, raw, comp);
+    hc.DecompressEventData(12, 1, raw.size(), comp.data(), comp.size()/2, byteidx, adcs);
+    assert( adcs.size() < raw.size() );
+    for ( unsigned int itry=0; itry<200; ++itry ) {
+      vector<BYTE> bad = comp;
+      bad[gen() % bad.size()] ^= BYTE(1 << (gen() % 8));
+      hc.DecompressEventData(12, 1, raw.size(), bad.data(), bad.size(), byteidx, adcs);
+      assert( adcs.size() <= raw.size() );
+      assert( byteidx <= bad.size() );
+    }
+  }
+
+  cout << myname << line << endl;
+  cout << myname << "Checking concurrent use." << endl;
+  {
+    vector<vector<adc16_t>> raws;
+    vector<vector<BYTE>> comps(8);
+    for ( size_t ithr=0; ithr<comps.size(); ++ithr ) {
+      raws.push_back(makeWaveform(gen, 12, 20000, ithr % 4));
+      hc.CompressChData(12, raws.back(), comps[ithr]);
+    }
+    vector<int> ok(comps.size(), 0);
+    vector<std::thread> threads;
+    for ( size_t ithr=0; ithr<comps.size(); ++ithr ) {
+      threads.emplace_back([&, ithr]() {
+        for ( int irep=0; irep<20; ++irep ) {
+          vector<BYTE> comp;
+          vector<adc16_t> out;
+          size_t idx = 0;
+          hc.CompressChData(12, raws[ithr], comp);
+          hc.DecompressEventData(12, 1, raws[ithr].size(), comp.data(), comp.size(), idx, out);
+          if ( comp != comps[ithr] || out != raws[ithr] ) return;
+        }
+        ok[ithr] = 1;
+      });
+    }
+    for ( std::thread& thr : threads ) thr.join();
+    for ( int iok : ok ) assert( iok == 1 );
+  }
+
+  cout << myname << line << endl;
+  cout << myname << "Done." << endl;
+  return 0;
+}
+
+//**********************************************************************
+
+int main(int argc, char* argv[]) {
+  unsigned int ncase = 2000;
+  if ( argc > 1 ) {
+    string sarg(argv[1]);
+    if ( sarg == "-h" ) {
+      cout << "Usage: " << argv[0] << " [NCASE]" << endl;
+      return 0;
+    }
+    ncase = std::stoi(sarg);
+  }
+  return test_HuffDataCompressor(ncase);
+}
+
+//**********************************************************************
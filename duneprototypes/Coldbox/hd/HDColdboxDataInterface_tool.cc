@@ -7,7 +7,7 @@
 #include <sstream>
 #include <cstring>
 #include <string>
-#include "TMath.h"
+#include "duneprototypes/Protodune/singlephase/RawDecoding/MedianSigma.h"
 #include "TString.h"
 
 #include "art/Framework/Services/Registry/ServiceHandle.h"
@@ -248,37 +248,13 @@ void HDColdboxDataInterface::getFragmentsForEvent(hid_t the_group, RawDigits& ra
 void HDColdboxDataInterface::getMedianSigma(
 					    const raw::RawDigit::ADCvector_t &v_adc, float &median,
 					    float &sigma) {
-  size_t asiz = v_adc.size();
-  int imed=0;
-  if (asiz == 0) {
-    median = 0;
-    sigma = 0;
-  }
-  else {
-    // the RMS includes tails from bad samples and signals and may not be the best RMS calc.
-
-    imed = TMath::Median(asiz,v_adc.data()) + 0.01;  // add an offset to make sure the floor gets the right integer
-    median = imed;
-    sigma = TMath::RMS(asiz,v_adc.data());
-
-    // add in a correction suggested by David Adams, May 6, 2019
-
-    size_t s1 = 0;
-    size_t sm = 0;
-    for (size_t i = 0; i < asiz; ++i) {
-      if (v_adc.at(i) < imed) s1++;
-      if (v_adc.at(i) == imed) sm++;
-    }
-    if (sm > 0) {
-      float mcorr = (-0.5 + (0.5*(float) asiz - (float) s1)/ ((float) sm) );
-      if (fDebugLevel > 0)
-	{
-	  if (std::abs(mcorr)>1.0) std::cout << "mcorr: " << mcorr << std::endl;
-	}
-      median += mcorr;
+  // median with the correction suggested by David Adams, May 6, 2019, and RMS
+  float mcorr = 0;
+  dune::computeMedianSigma(v_adc, median, sigma, &mcorr);
+  if (fDebugLevel > 0)
+    {
+      if (std::abs(mcorr)>1.0) std::cout << "mcorr: " << mcorr << std::endl;
     }
-  }
-  
 }
 
 DEFINE_ART_CLASS_TOOL(HDColdboxDataInterface)
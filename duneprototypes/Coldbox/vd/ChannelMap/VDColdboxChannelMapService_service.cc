@@ -8,8 +8,11 @@
 ///////////////////////////////////////////////////////////////////////////////////////////////////
 
 #include "VDColdboxChannelMapService.h"
+#include "duneprototypes/Protodune/hd/ChannelMap/ChannelMapCache.h"
 #include "messagefacility/MessageLogger/MessageLogger.h"
 
+#include <sys/stat.h>
+
 
 dune::VDColdboxChannelMapService::VDColdboxChannelMapService(fhicl::ParameterSet const& pset) {
 
@@ -25,6 +28,35 @@ dune::VDColdboxChannelMapService::VDColdboxChannelMapService(fhicl::ParameterSet
   else
     std::cout << "VD Coldbox Channel Map: Building TPC wiremap from file " << channelMapFile << std::endl;
 
+  // use the binary cache made from the text file if there is a valid one (see ChannelMapCache.h)
+
+  std::string cachename = chanmapcache::cacheFileName(fullname);
+  struct stat st;
+  if (stat(cachename.c_str(), &st) == 0) {
+    chanmapcache::MappedTable table;
+    std::string err;
+    if (table.open(cachename, fullname, 9, 1u << 8, err)) {
+      std::cout << "VD Coldbox Channel Map: used binary cache " << cachename << std::endl;
+      for (uint32_t irow = 0; irow < table.nrows(); ++irow) {
+        VDCBChanInfo chinfo;
+        chinfo.offlchan = table.value(irow, 0);
+        chinfo.wib = table.value(irow, 1);
+        chinfo.wibconnector = table.value(irow, 2);
+        chinfo.cebchan = table.value(irow, 3);
+        chinfo.femb = table.value(irow, 4);
+        chinfo.asic = table.value(irow, 5);
+        chinfo.asicchan = table.value(irow, 6);
+        chinfo.connector = table.value(irow, 7);
+        chinfo.stripid = table.str(irow, 8);
+        chinfo.valid = true;
+        chantoinfomap[chinfo.offlchan] = chinfo;
+        infotochanmap[chinfo.wib][chinfo.wibconnector][chinfo.cebchan] = chinfo.offlchan; 
+      }
+      return;
+    }
+    std::cout << "VD Coldbox Channel Map: ignoring channel map cache " << cachename << ": " << err << std::endl;
+  }
+
   std::ifstream inFile(fullname, std::ios::in);
   std::string line;
   while (std::getline(inFile,line)) {
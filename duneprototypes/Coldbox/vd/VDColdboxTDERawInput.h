@@ -16,8 +16,11 @@
 
 #include "lardataobj/RawData/RawDigit.h"
 
+#include "duneprototypes/Protodune/dualphase/RawDecoding/DaqReadEngine.h"
+
 #include <fstream>
 #include <string>
+#include <memory>
 
 namespace raw {
   //Forward declare the class
@@ -103,9 +106,6 @@ class raw::VDColdboxTDERawInput
   std::string                 __prodlbl_status;
   std::string                 __prodlbl_rdtime;
 
-  uint32_t 		      __eventCtr; 
-  uint32_t                    __eventNum;
-  
   int                         __maxEvents;
 
   // number of uncompressed samples per channel
@@ -115,11 +115,19 @@ class raw::VDColdboxTDERawInput
   // close binary file
   void __close();
 
-  // read a chunk of binary data
-  void __readChunk( std::vector<BYTE> &bytes, size_t sz );
-
   // unpack binary data written by each L1 evb builder
-  bool __unpackEvent( std::vector<BYTE> &buf, DaqEvent &event );
+  bool __unpackEvent( const BYTE *buf, size_t nb, DaqEvent &event );
+
+  // threads to unpack the fragments of L1 evb builders
+  std::unique_ptr<lris::UnpackPool> __pool;
+
+  // input file: event table, selected records, read-ahead or memory map
+  std::unique_ptr<lris::DaqRecordFile> __recfile;
+
+  // event selection: records to skip at the start of each file
+  // and event numbers to keep (all if empty)
+  unsigned __skipEvents;
+  std::vector<uint32_t> __eventList;
 
   //
   std::string __getProducerLabel( std::string &lbl );
@@ -128,15 +136,10 @@ class raw::VDColdboxTDERawInput
   std::vector<unsigned> __daqch;
   std::vector<bool>     __keepch;
   // ped inversion to deal with the inverted signal polarity
-  std::vector<unsigned> __invped; 
+  // indexed by daq channel and applied when the data are unpacked
+  std::vector<uint16_t> __invped;
 
-  // file locations
-  std::vector<std::streampos> __events;
-  std::vector<uint32_t> __evsz;
-    
   // input file
-  size_t __filesz;
-  std::ifstream __file;
   unsigned __file_seqno;
 
   // header sizes
@@ -172,7 +175,6 @@ class raw::VDColdboxTDERawInput
   } fragment_t;
 
   //
-  unsigned __unpack_evtable();
   unsigned __unpack_eve_info( const char *buf, eveinfo_t &ei );
   unsigned __get_file_seqno( std::string s);
 };
@@ -0,0 +1,134 @@
+// FELIXBufferFile.cxx
+
+#include "FELIXBufferFile.h"
+#include "duneprototypes/Protodune/hd/RawDecoding/WIBEthUnpack.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace wibeth = pdhd::rawdecoding::wibeth;
+
+namespace iceberg {
+
+namespace {
+
+// Byte offset of the first ADC word in a frame.
+constexpr size_t kPayloadOffset = 16;
+// Rows of the WIBEth kernels in a frame: two per 128-channel block.
+constexpr size_t kRows = FELIXBufferFile::kChannels/wibeth::kChannels;
+
+}  // end unnamed namespace
+
+//**********************************************************************
+
+FELIXBufferFile::FELIXBufferFile(const std::string& fname, size_t indexStride)
+: m_name(fname), m_stride(std::max<size_t>(indexStride, 1)) {
+  int fd = ::open(fname.c_str(), O_RDONLY);
+  if ( fd < 0 ) {
+    throw std::runtime_error("FELIXBufferFile: Unable to open " + fname + ": " + std::strerror(errno));
+  }
+  struct stat st;
+  if ( ::fstat(fd, &st) != 0 ) {
+    int err = errno;
+    ::close(fd);
+    throw std::runtime_error("FELIXBufferFile: Unable to stat " + fname + ": " + std::strerror(err));
+  }
+  m_bytes = st.st_size;
+  m_nframe = m_bytes/kFrameBytes;
+  if ( m_bytes > 0 ) {
+    void* pmap = ::mmap(nullptr, m_bytes, PROT_READ, MAP_PRIVATE, fd, 0);
+    int err = errno;
+    ::close(fd);
+    if ( pmap == MAP_FAILED ) {
+      throw std::runtime_error("FELIXBufferFile: Unable to map " + fname + ": " + std::strerror(err));
+    }
+    m_data = static_cast<const uint8_t*>(pmap);
+  } else {
+    ::close(fd);
+  }
+  for ( size_t ifrm=0; ifrm<m_nframe; ifrm+=m_stride ) {
+    m_index.push_back(timestamp(ifrm));
+    if ( m_index.size() > 1 && m_index.back() < m_index[m_index.size() - 2] ) m_sorted = false;
+  }
+}
+
+//**********************************************************************
+
+FELIXBufferFile::~FELIXBufferFile() {
+  if ( m_data != nullptr ) ::munmap(const_cast<uint8_t*>(m_data), m_bytes);
+}
+
+//**********************************************************************
+
+size_t FELIXBufferFile::findTimestamp(size_t from, uint64_t ts, uint64_t slack) const {
+  size_t ifrm = from;
+  if ( m_sorted ) {
+    // First indexed frame after from that is not before ts. The one we want
+    // is at most one stride before it.
+    size_t jfirst = from/m_stride + 1;
+    if ( jfirst < m_index.size() ) {
+      auto ient = std::partition_point(m_index.begin() + jfirst, m_index.end(),
+                                       [&](uint64_t its) { return its + slack < ts; });
+      size_t jent = ient - m_index.begin();
+      ifrm = std::max(from, (jent - 1)*m_stride);
+    }
+  }
+  while ( ifrm < m_nframe && timestamp(ifrm) + slack < ts ) ++ifrm;
+  return ifrm;
+}
+
+//**********************************************************************
+
+void FELIXBufferFile::unpack(size_t first, size_t n, std::vector<std::vector<short>>& adcs) const {
+  if ( first + n > m_nframe ) {
+    throw std::runtime_error("FELIXBufferFile: Frames beyond the end of " + m_name);
+  }
+  if ( adcs.size() < kChannels ) adcs.resize(kChannels);
+  if ( n == 0 ) return;
+  const uint8_t* pbeg = m_data + first*kFrameBytes;
+  const size_t nbytes = n*kFrameBytes;
+  // Hint the kernel to read the window ahead. The mapping must start on a page.
+  const size_t page = ::sysconf(_SC_PAGESIZE);
+  size_t off = (pbeg - m_data)/page*page;
+  ::madvise(const_cast<uint8_t*>(m_data + off), pbeg + nbytes - (m_data + off), MADV_WILLNEED);
+
+  wibeth::RowKernel unpackRow = wibeth::rowKernel();
+  size_t nold = adcs[0].size();
+  for ( size_t icha=0; icha<kChannels; ++icha ) adcs[icha].resize(nold + n);
+  // Unpack a chunk of frames sample-major, then copy each channel out.
+  constexpr size_t kChunk = 16;
+  alignas(32) uint16_t rows[kChunk*kChannels];
+  uint8_t padded[kFrameBytes + wibeth::kRowOverread];
+  for ( size_t ifrm0=0; ifrm0<n; ifrm0+=kChunk ) {
+    size_t nchunk = std::min(kChunk, n - ifrm0);
+    for ( size_t ifrm=0; ifrm<nchunk; ++ifrm ) {
+      const uint8_t* pfrm = pbeg + (ifrm0 + ifrm)*kFrameBytes;
+      // The vector kernels read past the last row, which must stay within
+      // the mapping.
+      if ( pfrm + kFrameBytes + wibeth::kRowOverread > m_data + m_bytes ) {
+        std::memset(padded, 0, sizeof(padded));
+        std::memcpy(padded, pfrm, kFrameBytes);
+        pfrm = padded;
+      }
+      for ( size_t irow=0; irow<kRows; ++irow ) {
+        unpackRow(pfrm + kPayloadOffset + irow*wibeth::kBytesPerRow,
+                  rows + ifrm*kChannels + irow*wibeth::kChannels);
+      }
+    }
+    for ( size_t icha=0; icha<kChannels; ++icha ) {
+      short* pout = adcs[icha].data() + nold + ifrm0;
+      for ( size_t ifrm=0; ifrm<nchunk; ++ifrm ) pout[ifrm] = rows[ifrm*kChannels + icha];
+    }
+  }
+}
+
+//**********************************************************************
+
+}  // end namespace iceberg
@@ -0,0 +1,96 @@
+// FELIXBufferFile.h
+//
+// Read-only access to an ICEBERG FELIX buffer dump, as decoded by
+// IcebergFELIXBufferDecoderMarch2021 and the FELIXBufferMarch2021 data
+// interface tool.
+//
+// A dump is a sequence of 117-word (32-bit) frames, one per tick:
+//
+//   word 0        : slot in bits 12-14, fiber in bit 15
+//   words 2, 3    : timestamp, low and high word
+//   words 4-59    : 128 channels of 14-bit ADCs, packed LSB first
+//   words 60-115  : the next 128 channels
+//
+// The file is mapped into memory rather than read frame by frame. A trailing
+// partial frame is ignored, as fread would have hit the end of the file on
+// it. A sparse index holds the timestamp of every indexStride-th frame, so
+// building it touches one page per stride. findTimestamp uses it to locate
+// a timestamp by binary search and then scans at most one stride of frames.
+// This gives the same frame as scanning from the start provided the
+// timestamps increase; if the indexed ones do not, every search scans.
+//
+// unpack() writes the ADCs of a range of frames straight from the mapped
+// pages into per-channel vectors, using the 14-bit row kernels of
+// WIBEthUnpack.h: each 128-channel block is two of its 112-byte rows.
+//
+// Errors opening or mapping the file are reported by throwing
+// std::runtime_error.
+
+#ifndef FELIXBufferFile_H
+#define FELIXBufferFile_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace iceberg {
+
+class FELIXBufferFile {
+
+public:
+
+  static constexpr size_t kFrameWords = 117;
+  static constexpr size_t kFrameBytes = 4*kFrameWords;
+  static constexpr size_t kChannels = 256;
+
+  explicit FELIXBufferFile(const std::string& fname, size_t indexStride = 1024);
+  ~FELIXBufferFile();
+
+  FELIXBufferFile(const FELIXBufferFile&) = delete;
+  FELIXBufferFile& operator=(const FELIXBufferFile&) = delete;
+
+  const std::string& name() const { return m_name; }
+
+  // Number of complete frames.
+  size_t size() const { return m_nframe; }
+
+  // Words of frame iframe < size().
+  const uint32_t* frame(size_t iframe) const {
+    return reinterpret_cast<const uint32_t*>(m_data + iframe*kFrameBytes);
+  }
+
+  uint64_t timestamp(size_t iframe) const {
+    const uint32_t* fr = frame(iframe);
+    return (uint64_t(fr[3]) << 32) + fr[2];
+  }
+
+  static int slot(const uint32_t* fr) { return (fr[0] & 0x7000) >> 12; }
+  static int fiber(const uint32_t* fr) { return (fr[0] & 0x8000) >> 15; }
+
+  // First frame at or after from with timestamp + slack >= ts, or size() if
+  // there is none.
+  size_t findTimestamp(size_t from, uint64_t ts, uint64_t slack = 0) const;
+
+  // Append the ADCs of frames [first, first + n) to adcs[0..kChannels).
+  // The range must be within size().
+  void unpack(size_t first, size_t n, std::vector<std::vector<short>>& adcs) const;
+
+  // Whether the indexed timestamps increase, i.e. the index is used.
+  bool indexed() const { return m_sorted; }
+
+private:
+
+  std::string m_name;
+  const uint8_t* m_data = nullptr;
+  size_t m_bytes = 0;
+  size_t m_nframe = 0;
+  size_t m_stride;
+  std::vector<uint64_t> m_index;   // timestamp of frame j*m_stride
+  bool m_sorted = true;
+
+};
+
+}  // end namespace iceberg
+
+#endif
@@ -16,6 +16,7 @@
 #ifndef IcebergDataInterfaceFELIXBufferMarch2021_H
 #define IcebergDataInterfaceFELIXBufferMarch2021_H
 
+#include <memory>
 #include <vector>
 
 #include "art/Utilities/ToolMacros.h"
@@ -30,6 +31,7 @@
 #include "lardataobj/RawData/RawDigit.h"
 #include "lardataobj/RawData/RDTimeStamp.h"
 #include "dunecore/DuneObj/PDSPTPCDataInterfaceParent.h"
+#include "FELIXBufferFile.h"
 
 class IcebergDataInterfaceFELIXBufferMarch2021 : public PDSPTPCDataInterfaceParent {
 
@@ -59,9 +61,10 @@ class IcebergDataInterfaceFELIXBufferMarch2021 : public PDSPTPCDataInterfacePare
 
  private:
 
-  // open files
+  // open files, and the next frame to read in each.  A null file is closed.
 
-  std::vector<FILE*> fInputFilePointers;
+  std::vector<std::unique_ptr<iceberg::FELIXBufferFile>> fBufferFiles;
+  std::vector<size_t> fNextFrame;
 
   // configuration parameters
 
@@ -79,7 +82,7 @@ class IcebergDataInterfaceFELIXBufferMarch2021 : public PDSPTPCDataInterfacePare
 
   // private methods
 
-  void unpack14(const uint32_t *packed, uint16_t *unpacked);
+  void closeFiles();
 
   void computeMedianSigma(raw::RawDigit::ADCvector_t &v_adc, 
                           float &median, 
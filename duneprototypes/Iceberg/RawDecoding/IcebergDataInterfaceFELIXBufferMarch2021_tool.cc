@@ -1,10 +1,11 @@
 // IcebergDataInterfaceFELIXBufferMarch2021_tool.cc
 
 #include "IcebergDataInterfaceFELIXBufferMarch2021.h"
-#include "TMath.h"
+#include "duneprototypes/Protodune/singlephase/RawDecoding/MedianSigma.h"
 #include "TString.h"
 #include <iostream>
 #include <set>
+#include <algorithm>
 #include "lardataobj/RawData/raw.h"
 
 #include "art/Framework/Services/Registry/ServiceHandle.h"
@@ -19,11 +20,22 @@ IcebergDataInterfaceFELIXBufferMarch2021::IcebergDataInterfaceFELIXBufferMarch20
   fCompressHuffman = p.get<bool>("CompressHuffman",false);
   fDesiredStartTimestamp = p.get<ULong64_t>("StartTimestamp",0);
 
-  fInputFilePointers.clear();
+  fBufferFiles.clear();
   for (size_t ifile=0; ifile<fInputFiles.size(); ++ifile)
     {
-      fInputFilePointers.push_back(fopen(fInputFiles.at(ifile).data(),"r"));
+      // a file that cannot be opened is left closed, and no data are returned
+      std::unique_ptr<iceberg::FELIXBufferFile> file;
+      try
+        {
+          file = std::make_unique<iceberg::FELIXBufferFile>(fInputFiles.at(ifile));
+        }
+      catch (const std::runtime_error &err)
+        {
+          MF_LOG_WARNING("IcebergDataInterfaceFELIXBufferMarch2021") << err.what();
+        }
+      fBufferFiles.push_back(std::move(file));
     }
+  fNextFrame.assign(fInputFiles.size(), 0);
   fFirstRead = true;
 }
 
@@ -39,10 +51,7 @@ int IcebergDataInterfaceFELIXBufferMarch2021::retrieveData(art::Event &e,
 
   art::ServiceHandle<dune::IcebergChannelMapService> channelMap;
 
-  uint32_t framebuf[117];
-  uint16_t databuf[128];
   uint64_t timestampstart=0;
-  uint64_t timestamp=0;
 
   raw_digits.clear();
   rd_timestamps.clear();
@@ -51,129 +60,78 @@ int IcebergDataInterfaceFELIXBufferMarch2021::retrieveData(art::Event &e,
   size_t nfiles = fInputFiles.size();
 
   // search for the first timestamp on the first read
-  // don't do on subsequent reads so we don't always read in a frame just to see what
-  // the timestamp is.
 
   if (fFirstRead)
     {
       for (size_t ifile=0; ifile < nfiles; ++ ifile)
         {
-          do
+          if (!fBufferFiles.at(ifile)) return 0;
+          size_t iframe = fBufferFiles.at(ifile)->findTimestamp(fNextFrame.at(ifile), fDesiredStartTimestamp, 16);
+          if (iframe >= fBufferFiles.at(ifile)->size())
             {
-              if (fInputFilePointers.at(ifile) == 0) return 0;
-              fread(framebuf, sizeof(uint32_t), 117, fInputFilePointers.at(ifile));
-              if (feof(fInputFilePointers.at(ifile)))
-                {
-                  // close all the input files and return nothing if we hit eof here
-                  for (size_t jfile = 0; jfile < nfiles; ++jfile)
-                    {
-                      fclose(fInputFilePointers.at(jfile));
-                      fInputFilePointers.at(jfile) = 0;
-                    }
-                  return 0;
-                }
-              timestamp= framebuf[3];
-              timestamp <<= 32;
-              timestamp += framebuf[2];
+              // close all the input files and return nothing if we hit eof here
+              closeFiles();
+              return 0;
             }
-          while (timestamp+16 < fDesiredStartTimestamp);
+          fNextFrame.at(ifile) = iframe + 1;
         }
       fFirstRead = false;
     }
 
   // align the readin
 
-  std::vector<std::vector<uint32_t>> fbcache(nfiles);
-  std::vector<uint64_t> tscache;
+  std::vector<size_t> firstframe(nfiles);
   uint64_t latest_timestamp=0;
 
-  // read one frame in from each file to see what the latest timestamp is
+  // look at the next frame in each file to see what the latest timestamp is
 
   for (size_t ifile=0; ifile<nfiles; ++ifile)
     {
-      fbcache.at(ifile).resize(117);
-      if (fInputFilePointers.at(ifile) == 0) return 0;
-      fread(fbcache.at(ifile).data(), sizeof(uint32_t), 117, fInputFilePointers.at(ifile));
-      if (feof(fInputFilePointers.at(ifile)))
+      if (!fBufferFiles.at(ifile)) return 0;
+      if (fNextFrame.at(ifile) >= fBufferFiles.at(ifile)->size())
         {
           //  close all the input files and return nothing if we hit eof here
-          for (size_t jfile = 0; jfile < nfiles; ++jfile)
-            {
-              fclose(fInputFilePointers.at(jfile));
-              fInputFilePointers.at(jfile) = 0;
-            }
+          closeFiles();
           return 0;
         }
-      timestamp= fbcache.at(ifile)[3];
-      timestamp <<= 32;
-      timestamp += fbcache.at(ifile)[2];
-      tscache.push_back(timestamp);
+      uint64_t timestamp = fBufferFiles.at(ifile)->timestamp(fNextFrame.at(ifile));
       if (timestamp > latest_timestamp)
         {
           latest_timestamp = timestamp;
         }
     }
 
-  // read enough frames from the other files so that we align the frames to +- 16 ticks
+  // skip enough frames in the other files so that we align the frames to +- 16 ticks
 
   for (size_t ifile=0; ifile<nfiles; ++ifile)
     {
-      while (tscache.at(ifile) + 16 < latest_timestamp)
+      firstframe.at(ifile) = fBufferFiles.at(ifile)->findTimestamp(fNextFrame.at(ifile), latest_timestamp, 16);
+      if (firstframe.at(ifile) >= fBufferFiles.at(ifile)->size())
         {
-          if (fInputFilePointers.at(ifile) == 0) return 0;
-          fread(fbcache.at(ifile).data(), sizeof(uint32_t), 117, fInputFilePointers.at(ifile));
-          if (feof(fInputFilePointers.at(ifile)))
-            {
-              // close all the input files and return nohting if we hit eof here
-              for (size_t jfile = 0; jfile < nfiles; ++jfile)
-                {
-                  fclose(fInputFilePointers.at(jfile));
-                  fInputFilePointers.at(jfile) = 0;
-                }
-              return 0;
-            }
-          timestamp= fbcache.at(ifile)[3];
-          timestamp <<= 32;
-          timestamp += fbcache.at(ifile)[2];
-          tscache.at(ifile) = timestamp;
+          // close all the input files and return nothing if we hit eof here
+          closeFiles();
+          return 0;
         }
     }  
 
-  // actually read in the data now -- we already have the first tick read.
+  // actually read in the data now
 
   for (size_t ifile=0; ifile < nfiles; ++ ifile)
     {
-      if (fInputFilePointers.at(ifile) == 0) break;
+      if (!fBufferFiles.at(ifile)) break;
+      const iceberg::FELIXBufferFile &file = *fBufferFiles.at(ifile);
+      size_t first = firstframe.at(ifile);
       int slot = 0;
       int fiber = 0;
 
-      std::vector<raw::RawDigit::ADCvector_t> adcvv(256);
-      for (size_t itick=0; itick<fNSamples; ++itick)
-        {
-          if (itick == 0)  // already read in the first frame
-            {
-              for (size_t i=0; i<117; ++i)
-                {
-                  framebuf[i] = fbcache.at(ifile).at(i);
-                }
-            }
-          else
-            {
-              fread(framebuf, sizeof(uint32_t), 117, fInputFilePointers.at(ifile));
-              if (feof(fInputFilePointers.at(ifile)))
-                {
-                  // close all the input files and return what we have.
-                  for (size_t jfile = 0; jfile < nfiles; ++jfile)
-                    {
-                      fclose(fInputFilePointers.at(jfile));
-                      fInputFilePointers.at(jfile) = 0;
-                    }
-                  break;
-                }
-            }
+      // a window cut short by the end of the file is returned as it is
 
-          int curslot = (framebuf[0] & 0x7000) >> 12;   // assume these are all the same
-          int curfiber = (framebuf[0] & 0x8000) >> 15;
+      size_t nticks = std::min(fNSamples, file.size() - first);
+      for (size_t itick=0; itick<nticks; ++itick)
+        {
+          const uint32_t *frame = file.frame(first + itick);
+          int curslot = iceberg::FELIXBufferFile::slot(frame);   // assume these are all the same
+          int curfiber = iceberg::FELIXBufferFile::fiber(frame);
           if (itick>0)
             {
               if (curslot != slot)
@@ -191,31 +149,19 @@ int IcebergDataInterfaceFELIXBufferMarch2021::retrieveData(art::Event &e,
             {
               slot = curslot;
               fiber = curfiber;
+              timestampstart = file.timestamp(first);
             }
+        }
 
-          timestamp= framebuf[3];
-          timestamp <<= 32;
-          timestamp += framebuf[2];
-          //std::cout << std::dec << "   Slot: " << slot << " Fiber: " << fiber 
-          //        << " Timestamp: " << std::dec << timestamp <<std::endl;
-          if (itick == 0) 
-            {
-              timestampstart = timestamp;
-            }
+      // do the data-rearrangement transpose straight from the file
 
-          // do the data-rearrangement transpose
+      std::vector<raw::RawDigit::ADCvector_t> adcvv(256);
+      file.unpack(first, nticks, adcvv);
+      fNextFrame.at(ifile) = first + nticks;
 
-          unpack14(&(framebuf[4]),databuf);
-          for (size_t ichan=0; ichan<128; ++ichan)
-            {
-              adcvv.at(ichan).push_back(databuf[ichan]);
-            }
-          unpack14(&(framebuf[4+56]),databuf);
-          for (size_t ichan=0; ichan<128; ++ichan)
-            {
-              adcvv.at(ichan+128).push_back(databuf[ichan]);
-            }
-        }
+      // close all the input files after this one if we hit eof
+
+      if (nticks < fNSamples) closeFiles();
 
       for (size_t ichan=0; ichan<256; ++ichan)
         {
@@ -342,56 +288,16 @@ int IcebergDataInterfaceFELIXBufferMarch2021::retrieveDataAPAListWithLabels(art:
 
 void IcebergDataInterfaceFELIXBufferMarch2021::computeMedianSigma(raw::RawDigit::ADCvector_t &v_adc, float &median, float &sigma)
 {
-  size_t asiz = v_adc.size();
-  int imed=0;
-  if (asiz == 0)
-    {
-      median = 0;
-      sigma = 0;
-    }
-  else
-    {
-      // the RMS includes tails from bad samples and signals and may not be the best RMS calc.
-
-      imed = TMath::Median(asiz,v_adc.data()) + 0.01;  // add an offset to make sure the floor gets the right integer
-      median = imed;
-      sigma = TMath::RMS(asiz,v_adc.data());
-
-      // add in a correction suggested by David Adams, May 6, 2019
-
-      size_t s1 = 0;
-      size_t sm = 0;
-      for (size_t i=0; i<asiz; ++i)
-        {
-          if (v_adc[i] < imed) s1++;
-          if (v_adc[i] == imed) sm++;
-        }
-      if (sm > 0)
-        {
-          float mcorr = (-0.5 + (0.5*(float) asiz - (float) s1)/ ((float) sm) );
-          //if (std::abs(mcorr)>1.0) std::cout << "mcorr: " << mcorr << std::endl;
-          median += mcorr;
-        }
-    }
+  // median with the correction suggested by David Adams, May 6, 2019, and RMS
+  dune::computeMedianSigma(v_adc, median, sigma);
 }
 
-void IcebergDataInterfaceFELIXBufferMarch2021::unpack14(const uint32_t *packed, uint16_t *unpacked) {
-  for (size_t i = 0; i < 128; i++) { // i == n'th U,V,X value
-    const size_t low_bit = i*14;
-    const size_t low_word = low_bit / 32;
-    const size_t high_bit = (i+1)*14-1;
-    const size_t high_word = high_bit / 32;
-    //std::cout << "low_word, high_word: " << low_word << " " << high_word << std::endl;
-    //glog.log("word %li :: low %li (%li[%li]) high %li (%li[%li])\n",i,low_bit,low_word,low_bit%32,high_bit,high_word,high_bit%32);
-    if (low_word == high_word) { //all the bits are in the same word
-      unpacked[i] = (packed[low_word] >> (low_bit%32)) & 0x3FFF;
-    } else { //some of the bits are in the next word
-      size_t high_off = high_word*32-low_bit;
-      //glog.log("pre_mask 0x%X post_mask 0x%X\n", (0x3FFF >> (14-high_off)), ((0x3FFF << high_off) & 0x3FFF) );
-      unpacked[i] = (packed[low_word] >> (low_bit%32)) & (0x3FFF >> (14-high_off));
-      unpacked[i] |= (packed[high_word] << high_off) & ((0x3FFF << high_off) & 0x3FFF);
+void IcebergDataInterfaceFELIXBufferMarch2021::closeFiles()
+{
+  for (auto &file : fBufferFiles)
+    {
+      file.reset();
     }
-  }
 }
 
 DEFINE_ART_CLASS_TOOL(IcebergDataInterfaceFELIXBufferMarch2021)
@@ -24,7 +24,7 @@
 #include <cmath>
 
 // ROOT includes
-#include "TMath.h"
+#include "duneprototypes/Protodune/singlephase/RawDecoding/MedianSigma.h"
 
 // artdaq and dunepdlegacy includes
 #include "dunepdlegacy/Services/ChannelMap/IcebergChannelMapService.h"
@@ -37,7 +37,9 @@
 // DUNE includes
 #include "dunecore/DuneObj/RDStatus.h"
 
-#include <stdio.h>
+#include "FELIXBufferFile.h"
+
+#include <memory>
 
 class IcebergFELIXBufferDecoderMarch2021 : public art::EDProducer {
 
@@ -57,9 +59,10 @@ private:
   typedef art::PtrMaker<raw::RDTimeStamp> TSPmkr;
   typedef std::vector<raw::RDStatus> RDStatuses;
 
-  // open files
+  // open files, and the next frame to read in each
 
-  std::vector<FILE*> fInputFilePointers;
+  std::vector<std::unique_ptr<iceberg::FELIXBufferFile>> fBufferFiles;
+  std::vector<size_t> fNextFrame;
 
   // configuration parameters
 
@@ -71,8 +74,8 @@ private:
   bool                       fFirstRead;
 
   void computeMedianSigma(raw::RawDigit::ADCvector_t &v_adc, float &median, float &sigma);
-  // Converts 14 bit packed channel data (56 uint32 words from the WIB) to byte-aligned 16 bit arrays (128 uint16 values)
-  void unpack14(const uint32_t *packed, uint16_t *unpacked);
+  // Throws if iframe is past the end of input file ifile
+  void checkFrame(size_t ifile, size_t iframe) const;
 };
 
 
@@ -90,11 +93,19 @@ IcebergFELIXBufferDecoderMarch2021::IcebergFELIXBufferDecoderMarch2021(fhicl::Pa
   produces<RDTsAssocs>( fOutputLabel );
   produces<RDStatuses>( fOutputLabel );
 
-  fInputFilePointers.clear();
+  fBufferFiles.clear();
   for (size_t ifile=0; ifile<fInputFiles.size(); ++ifile)
     {
-      fInputFilePointers.push_back(fopen(fInputFiles.at(ifile).data(),"r"));
+      try
+        {
+          fBufferFiles.push_back(std::make_unique<iceberg::FELIXBufferFile>(fInputFiles.at(ifile)));
+        }
+      catch (const std::runtime_error &err)
+        {
+          throw cet::exception("IcebergFELXIBufferDecoderMarch2021") << err.what();
+        }
     }
+  fNextFrame.assign(fInputFiles.size(), 0);
   fFirstRead = true;
 }
 
@@ -111,115 +122,62 @@ void IcebergFELIXBufferDecoderMarch2021::produce(art::Event &e)
 
   bool discard_data = false;
 
-  uint32_t framebuf[117];
-  uint16_t databuf[128];
   uint64_t timestampstart=0;
-  uint64_t timestamp=0;
 
   size_t nfiles = fInputFiles.size();
 
-  // search for the first timestamp on the first read
-  // don't do on subsequent reads so we don't always read in a frame just to see what
-  // the timestamp is.
+  // search for the first timestamp on the first read.  The frame found is
+  // skipped, so that the next timestamp (+32) will be the one we want
 
   if (fFirstRead)
     {
       for (size_t ifile=0; ifile < nfiles; ++ ifile)
         {
-          do
-            {
-              fread(framebuf, sizeof(uint32_t), 117, fInputFilePointers.at(ifile));
-              if (feof(fInputFilePointers.at(ifile)))
-                {
-                  // don't handle this too gracefully at the moment
-                  throw cet::exception("IcebergFELXIBufferDecoderMarch2021") <<
-                    "Attempt to read off the end of file " << fInputFiles.at(ifile);
-                }
-              timestamp= framebuf[3];
-              timestamp <<= 32;
-              timestamp += framebuf[2];
-            }
-          while (timestamp+47 < fDesiredStartTimestamp);  
-          // criterion so the next timestamp (+32) will be the one we want
+          size_t iframe = fBufferFiles.at(ifile)->findTimestamp(fNextFrame.at(ifile), fDesiredStartTimestamp, 47);
+          checkFrame(ifile, iframe);
+          fNextFrame.at(ifile) = iframe + 1;
         }
       fFirstRead = false;
     }
 
   // align the readin
 
-  std::vector<std::vector<uint32_t>> fbcache(nfiles);
-  std::vector<uint64_t> tscache;
+  std::vector<size_t> firstframe(nfiles);
   uint64_t latest_timestamp=0;
 
-  // read one frame in from each file to see what the latest timestamp is
+  // look at the next frame in each file to see what the latest timestamp is
 
   for (size_t ifile=0; ifile<nfiles; ++ifile)
     {
-      fbcache.at(ifile).resize(117);
-      fread(fbcache.at(ifile).data(), sizeof(uint32_t), 117, fInputFilePointers.at(ifile));
-      if (feof(fInputFilePointers.at(ifile)))
-        {
-          // don't handle this too gracefully at the moment
-          throw cet::exception("IcebergFELXIBufferDecoderMarch2021") <<
-            "Attempt to read off the end of file " << fInputFiles.at(ifile);
-        }
-      timestamp= fbcache.at(ifile)[3];
-      timestamp <<= 32;
-      timestamp += fbcache.at(ifile)[2];
-      tscache.push_back(timestamp);
+      checkFrame(ifile, fNextFrame.at(ifile));
+      uint64_t timestamp = fBufferFiles.at(ifile)->timestamp(fNextFrame.at(ifile));
       if (timestamp > latest_timestamp)
         {
           latest_timestamp = timestamp;
         }
     }
 
-  // read enough frames from the other files so that we align the frames to +- 16 ticks
+  // skip enough frames in the other files so that we align the frames to +- 16 ticks
 
   for (size_t ifile=0; ifile<nfiles; ++ifile)
     {
-      while (tscache.at(ifile) + 16 < latest_timestamp)
-        {
-          fread(fbcache.at(ifile).data(), sizeof(uint32_t), 117, fInputFilePointers.at(ifile));
-          if (feof(fInputFilePointers.at(ifile)))
-            {
-              // don't handle this too gracefully at the moment
-              throw cet::exception("IcebergFELXIBufferDecoderMarch2021") <<
-                "Attempt to read off the end of file " << fInputFiles.at(ifile);
-            }
-          timestamp= fbcache.at(ifile)[3];
-          timestamp <<= 32;
-          timestamp += fbcache.at(ifile)[2];
-          tscache.at(ifile) = timestamp;
-        }
+      firstframe.at(ifile) = fBufferFiles.at(ifile)->findTimestamp(fNextFrame.at(ifile), latest_timestamp, 16);
+      checkFrame(ifile, firstframe.at(ifile));
     }  
 
   for (size_t ifile=0; ifile < nfiles; ++ ifile)
     {
+      const iceberg::FELIXBufferFile &file = *fBufferFiles.at(ifile);
+      size_t first = firstframe.at(ifile);
       int slot = 0;
       int fiber = 0;
 
-      std::vector<raw::RawDigit::ADCvector_t> adcvv(256);
       for (size_t itick=0; itick<fNSamples; ++itick)
         {
-          if (itick == 0)  // already read in the first frame
-            {
-              for (size_t i=0; i<117; ++i)
-                {
-                  framebuf[i] = fbcache.at(ifile).at(i);
-                }
-            }
-          else
-            {
-              fread(framebuf, sizeof(uint32_t), 117, fInputFilePointers.at(ifile));
-              if (feof(fInputFilePointers.at(ifile)))
-                {
-                  // don't handle this too gracefully at the moment
-                  throw cet::exception("IcebergFELXIBufferDecoderMarch2021") <<
-                    "Attempt to read off the end of file " << fInputFiles.at(ifile);
-                }
-            }
-          int curslot = (framebuf[0] & 0x7000) >> 12;   // assume these are all the same
-          int curfiber = (framebuf[0] & 0x8000) >> 15;
+          checkFrame(ifile, first + itick);
+          const uint32_t *frame = file.frame(first + itick);
+          int curslot = iceberg::FELIXBufferFile::slot(frame);   // assume these are all the same
+          int curfiber = iceberg::FELIXBufferFile::fiber(frame);
           if (itick>0)
             {
               if (curslot != slot)
@@ -237,31 +195,15 @@ void IcebergFELIXBufferDecoderMarch2021::produce(art::Event &e)
             {
               slot = curslot;
               fiber = curfiber;
+              timestampstart = file.timestamp(first);
             }
+        }
 
-          uint64_t timestamp= framebuf[3];
-          timestamp <<= 32;
-          timestamp += framebuf[2];
-          //std::cout << std::dec << "   Slot: " << slot << " Fiber: " << fiber 
-          //        << " Timestamp: " << std::dec << timestamp <<std::endl;
-          if (itick == 0) 
-            {
-              timestampstart = timestamp;
-            }
-
-          // do the data-rearrangement transpose
+      // do the data-rearrangement transpose straight from the file
 
-          unpack14(&(framebuf[4]),databuf);
-          for (size_t ichan=0; ichan<128; ++ichan)
-            {
-              adcvv.at(ichan).push_back(databuf[ichan]);
-            }
-          unpack14(&(framebuf[4+56]),databuf);
-          for (size_t ichan=0; ichan<128; ++ichan)
-            {
-              adcvv.at(ichan+128).push_back(databuf[ichan]);
-            }
-        }
+      std::vector<raw::RawDigit::ADCvector_t> adcvv(256);
+      file.unpack(first, fNSamples, adcvv);
+      fNextFrame.at(ifile) = first + fNSamples;
 
       for (size_t ichan=0; ichan<256; ++ichan)
         {
@@ -385,40 +327,17 @@ void IcebergFELIXBufferDecoderMarch2021::produce(art::Event &e)
 
 void IcebergFELIXBufferDecoderMarch2021::computeMedianSigma(raw::RawDigit::ADCvector_t &v_adc, float &median, float &sigma)
 {
-  size_t asiz = v_adc.size();
-  if (asiz == 0)
-    {
-      median = 0;
-      sigma = 0;
-    }
-  else
-    {
-      // this is actually faster than the code below by about one second per event.
-      // the RMS includes tails from bad samples and signals and may not be the best RMS calc.
-
-      median = TMath::Median(asiz,v_adc.data());
-      sigma = TMath::RMS(asiz,v_adc.data());
-    }
-
-  //  std::cout << "sigma: " << sigma << std::endl;
+  dune::computeMedianRMS(v_adc, median, sigma);
 }
 
-void IcebergFELIXBufferDecoderMarch2021::unpack14(const uint32_t *packed, uint16_t *unpacked) {
-  for (size_t i = 0; i < 128; i++) { // i == n'th U,V,X value
-    const size_t low_bit = i*14;
-    const size_t low_word = low_bit / 32;
-    const size_t high_bit = (i+1)*14-1;
-    const size_t high_word = high_bit / 32;
-    //std::cout << "low_word, high_word: " << low_word << " " << high_word << std::endl;
-    //glog.log("word %li :: low %li (%li[%li]) high %li (%li[%li])\n",i,low_bit,low_word,low_bit%32,high_bit,high_word,high_bit%32);
-    if (low_word == high_word) { //all the bits are in the same word
-      unpacked[i] = (packed[low_word] >> (low_bit%32)) & 0x3FFF;
-    } else { //some of the bits are in the next word
-      size_t high_off = high_word*32-low_bit;
-      //glog.log("pre_mask 0x%X post_mask 0x%X\n", (0x3FFF >> (14-high_off)), ((0x3FFF << high_off) & 0x3FFF) );
-      unpacked[i] = (packed[low_word] >> (low_bit%32)) & (0x3FFF >> (14-high_off));
-      unpacked[i] |= (packed[high_word] << high_off) & ((0x3FFF << high_off) & 0x3FFF);
+void IcebergFELIXBufferDecoderMarch2021::checkFrame(size_t ifile, size_t iframe) const
+{
+  if (iframe >= fBufferFiles.at(ifile)->size())
+    {
+      // don't handle this too gracefully at the moment
+      throw cet::exception("IcebergFELXIBufferDecoderMarch2021") <<
+        "Attempt to read off the end of file " << fInputFiles.at(ifile);
     }
-  }
 }
+
 DEFINE_ART_MODULE(IcebergFELIXBufferDecoderMarch2021)
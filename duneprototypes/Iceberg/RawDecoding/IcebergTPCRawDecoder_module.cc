@@ -25,7 +25,7 @@
 // ROOT includes
 #include "TH1.h"
 #include "TStyle.h"
-#include "TMath.h"
+#include "duneprototypes/Protodune/singlephase/RawDecoding/MedianSigma.h"
 
 // artdaq and dunepdlegacy includes
 #include "dunepdlegacy/Overlays/RceFragment.hh"
@@ -1470,22 +1470,7 @@ bool IcebergTPCRawDecoder::_process_FELIX_AUX(const artdaq::Fragment& frag, RawD
 
 void IcebergTPCRawDecoder::computeMedianSigma(raw::RawDigit::ADCvector_t &v_adc, float &median, float &sigma)
 {
-  size_t asiz = v_adc.size();
-  if (asiz == 0)
-    {
-      median = 0;
-      sigma = 0;
-    }
-  else
-    {
-      // this is actually faster than the code below by about one second per event.
-      // the RMS includes tails from bad samples and signals and may not be the best RMS calc.
-
-      median = TMath::Median(asiz,v_adc.data());
-      sigma = TMath::RMS(asiz,v_adc.data());
-    }
-
-  //  std::cout << "sigma: " << sigma << std::endl;
+  dune::computeMedianRMS(v_adc, median, sigma);
 }
 
 DEFINE_ART_MODULE(IcebergTPCRawDecoder)
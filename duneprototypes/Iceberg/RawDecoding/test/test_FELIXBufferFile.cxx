@@ -0,0 +1,199 @@
+// test_FELIXBufferFile.cxx
+//
+// Check the mapped FELIX buffer reader: frame count with a partial trailing
+// frame, timestamp searches against a frame-by-frame scan, and unpacking
+// against the unpack14 of the FELIX buffer decoders.
+
+#include <string>
+#include <iostream>
+#include <fstream>
+#include <random>
+#include <vector>
+#include <stdexcept>
+#include "duneprototypes/Iceberg/RawDecoding/FELIXBufferFile.h"
+
+#undef NDEBUG
+#include <cassert>
+
+using std::string;
+using std::cout;
+using std::endl;
+using std::vector;
+using iceberg::FELIXBufferFile;
+
+namespace {
+
+// As IcebergFELIXBufferDecoderMarch2021 unpacked the frames.
+void unpack14(const uint32_t *packed, uint16_t *unpacked) {
+  for (size_t i = 0; i < 128; i++) {
+    const size_t low_bit = i*14;
+    const size_t low_word = low_bit / 32;
+    const size_t high_bit = (i+1)*14-1;
+    const size_t high_word = high_bit / 32;
+    if (low_word == high_word) {
+      unpacked[i] = (packed[low_word] >> (low_bit%32)) & 0x3FFF;
+    } else {
+      size_t high_off = high_word*32-low_bit;
+      unpacked[i] = (packed[low_word] >> (low_bit%32)) & (0x3FFF >> (14-high_off));
+      unpacked[i] |= (packed[high_word] << high_off) & ((0x3FFF << high_off) & 0x3FFF);
+    }
+  }
+}
+
+// Write nframe frames with timestamps from ts0 in steps of 25, and extra
+// trailing bytes.
+vector<vector<uint32_t>> writeFile(const string& fname, size_t nframe, uint64_t ts0,
+                                   size_t extra, std::mt19937& gen) {
+  vector<vector<uint32_t>> frames(nframe, vector<uint32_t>(FELIXBufferFile::kFrameWords));
+  std::ofstream fout(fname, std::ios::binary);
+  for ( size_t ifrm=0; ifrm<nframe; ++ifrm ) {
+    vector<uint32_t>& fr = frames[ifrm];
+    for ( uint32_t& wrd : fr ) wrd = gen();
+    fr[0] = (fr[0] & ~0xf000u) | (1u << 12) | (1u << 15);
+    uint64_t ts = ts0 + 25*ifrm;
+    fr[2] = ts & 0xffffffff;
+    fr[3] = ts >> 32;
+    fout.write(reinterpret_cast<const char*>(fr.data()), FELIXBufferFile::kFrameBytes);
+  }
+  for ( size_t ibyt=0; ibyt<extra; ++ibyt ) fout.put(char(gen()));
+  return frames;
+}
+
+// The frame-by-frame scan of the decoders.
+size_t scan(const FELIXBufferFile& file, size_t from, uint64_t ts, uint64_t slack) {
+  size_t ifrm = from;
+  while ( ifrm < file.size() && file.timestamp(ifrm) + slack < ts ) ++ifrm;
+  return ifrm;
+}
+
+}  // end unnamed namespace
+
+//**********************************************************************
+
+int test_FELIXBufferFile(size_t nframe) {
+  const string myname = "test_FELIXBufferFile: ";
+#ifdef NDEBUG
+  cout << myname << "NDEBUG must be off." << endl;
+  abort();
+#endif
+  string line = "-----------------------------";
+  std::mt19937 gen(2021);
+  const uint64_t ts0 = 0xfffff000ull;   // the high word changes in the file
+
+  cout << myname << line << endl;
+  cout << myname << "Reading " << nframe << " frames." << endl;
+  string fname = "test_FELIXBufferFile.dat";
+  vector<vector<uint32_t>> frames = writeFile(fname, nframe, ts0, 100, gen);
+  FELIXBufferFile file(fname, 64);
+  assert( file.size() == nframe );
+  assert( file.indexed() );
+  for ( size_t ifrm=0; ifrm<nframe; ++ifrm ) {
+    assert( file.timestamp(ifrm) == ts0 + 25*ifrm );
+    assert( FELIXBufferFile::slot(file.frame(ifrm)) == 1 );
+    assert( FELIXBufferFile::fiber(file.frame(ifrm)) == 1 );
+  }
+
+  cout << myname << line << endl;
+  cout << myname << "Timestamp searches." << endl;
+  std::uniform_int_distribution<size_t> froms(0, nframe);
+  std::uniform_int_distribution<uint64_t> tss(0, 25*nframe + 3000);
+  for ( unsigned int itry=0; itry<2000; ++itry ) {
+    size_t from = froms(gen);
+    uint64_t ts = ts0 + tss(gen) - 1000;
+    for ( uint64_t slack : {0, 16, 47} ) {
+      assert( file.findTimestamp(from, ts, slack) == scan(file, from, ts, slack) );
+    }
+  }
+  assert( file.findTimestamp(0, 0, 16) == 0 );
+  assert( file.findTimestamp(0, ts0 + 25*nframe + 100, 16) == nframe );
+
+  cout << myname << line << endl;
+  cout << myname << "Unpacking." << endl;
+  vector<vector<short>> adcs(256);
+  size_t first = nframe/3;
+  size_t n = nframe - first;
+  file.unpack(0, 5, adcs);
+  file.unpack(first, n, adcs);
+  assert( adcs[255].size() == 5 + n );
+  uint16_t databuf[128];
+  size_t nbad = 0;
+  for ( size_t itck=0; itck<5 + n; ++itck ) {
+    const vector<uint32_t>& fr = frames[itck < 5 ? itck : first + itck - 5];
+    unpack14(&fr[4], databuf);
+    for ( size_t icha=0; icha<128; ++icha ) if ( adcs[icha][itck] != databuf[icha] ) ++nbad;
+    unpack14(&fr[4+56], databuf);
+    for ( size_t icha=0; icha<128; ++icha ) if ( adcs[128 + icha][itck] != databuf[icha] ) ++nbad;
+  }
+  cout << myname << "Mismatches: " << nbad << endl;
+  assert( nbad == 0 );
+  bool threw = false;
+  try {
+    file.unpack(nframe - 1, 2, adcs);
+  } catch ( const std::runtime_error& ) {
+    threw = true;
+  }
+  assert( threw );
+
+  cout << myname << line << endl;
+  cout << myname << "Unordered and missing files." << endl;
+  {
+    string fname2 = "test_FELIXBufferFile_unordered.dat";
+    std::mt19937 gen2(7);
+    vector<vector<uint32_t>> frames2 = writeFile(fname2, 300, 5000, 0, gen2);
+    // Restart the timestamps half way.
+    std::fstream fio(fname2, std::ios::binary | std::ios::in | std::ios::out);
+    for ( size_t ifrm=150; ifrm<300; ++ifrm ) {
+      uint32_t ts[2] = {uint32_t(25*ifrm), 0};
+      fio.seekp(ifrm*FELIXBufferFile::kFrameBytes + 8);
+      fio.write(reinterpret_cast<const char*>(ts), 8);
+    }
+    fio.close();
+    FELIXBufferFile file2(fname2, 32);
+    assert( file2.size() == 300 );
+    assert( ! file2.indexed() );
+    // The last frame ends the file.
+    vector<vector<short>> adcs2;
+    file2.unpack(299, 1, adcs2);
+    unpack14(&frames2[299][4+56], databuf);
+    for ( size_t icha=0; icha<128; ++icha ) assert( adcs2[128 + icha][0] == databuf[icha] );
+    for ( uint64_t ts : {0ul, 3000ul, 4000ul, 6000ul, 9000ul} ) {
+      for ( size_t from : {0ul, 100ul, 160ul} ) {
+        assert( file2.findTimestamp(from, ts, 16) == scan(file2, from, ts, 16) );
+      }
+    }
+  }
+  {
+    std::ofstream("test_FELIXBufferFile_empty.dat");
+    FELIXBufferFile empty("test_FELIXBufferFile_empty.dat");
+    assert( empty.size() == 0 );
+    assert( empty.findTimestamp(0, 100, 16) == 0 );
+  }
+  bool missing = false;
+  try {
+    FELIXBufferFile nofile("test_FELIXBufferFile_missing.dat");
+  } catch ( const std::runtime_error& ) {
+    missing = true;
+  }
+  assert( missing );
+
+  cout << myname << line << endl;
+  cout << myname << "Done." << endl;
+  return 0;
+}
+
+//**********************************************************************
+
+int main(int argc, char* argv[]) {
+  size_t nframe = 5000;
+  if ( argc > 1 ) {
+    string sarg(argv[1]);
+    if ( sarg == "-h" ) {
+      cout << "Usage: " << argv[0] << " [NFRAME]" << endl;
+      return 0;
+    }
+    nframe = std::stoi(sarg);
+  }
+  return test_FELIXBufferFile(nframe);
+}
+
+//**********************************************************************
@@ -90,8 +90,6 @@ constexpr int kMaxExternCounts = 1000;   //maximum number of External Counters
 constexpr int kMaxShowerHits   = 10000;  //maximum number of hits on a shower
 constexpr int kMaxTruth        = 10;     //maximum number of neutrino truth interactions
 constexpr int kMaxClusters     = 1000;   //maximum number of clusters;
-constexpr int kMaxReadoutTicksInAllChannels = 76800000; //protoDUNE: 10 000 ticks * (8*960) channel
-constexpr int kMaxChannels = 7680; //protoDUNE: (8*960) channel
 
 constexpr int kMaxNDaughtersPerPFP = 10; //maximum number of daughters per PFParticle
 constexpr int kMaxNClustersPerPFP  = 10; //maximum number of clusters per PFParticle
@@ -563,36 +561,37 @@ namespace dune {
       Double_t     potnumitgt;         //pot per event (NuMI E:TORTGT)
       Double_t     potnumi101;         //pot per event (NuMI E:TOR101)
 
-      // hit information (non-resizeable, 45x kMaxHits = 900k bytes worth)
+      // hit information, sized to the hits of the event
+      size_t MaxHits = 0; ///! how many hits there is currently room for
       Int_t    no_hits;                  //number of hits
       Int_t    NHitsInAllTracks;        //number of hits in all tracks
       Int_t    no_hits_stored;           //number of hits actually stored in the tree
-      Short_t  hit_tpc[kMaxHits];        //tpc number
-      Short_t  hit_view[kMaxHits];      //plane number
-      Short_t  hit_wire[kMaxHits];       //wire number
-      Short_t  hit_channel[kMaxHits];    //channel ID
-      Float_t  hit_peakT[kMaxHits];      //peak time
-      Float_t  hit_chargesum[kMaxHits];     //charge (sum)
-      Float_t  hit_chargeintegral[kMaxHits];     //charge (integral)
-      Float_t  hit_ph[kMaxHits];         //amplitude
-      Float_t  hit_startT[kMaxHits];     //hit start time
-      Float_t  hit_endT[kMaxHits];       //hit end time
-      Float_t  hit_rms[kMaxHits];       //hit rms from the hit object
-      Float_t  hit_goodnessOfFit[kMaxHits]; //chi2/dof goodness of fit
-      Float_t  hit_fitparamampl[kMaxHits]; //dual phase hit fit
-      Float_t  hit_fitparamt0[kMaxHits]; //dual phase hit fit
-      Float_t  hit_fitparamtau1[kMaxHits]; //dual phase hit fit
-      Float_t  hit_fitparamtau2[kMaxHits]; //dual phase hit fit
-      Short_t  hit_multiplicity[kMaxHits];  //multiplicity of the given hit
-      Int_t    hit_trueID[kMaxHits];  //true mctackID form backtracker
-      Float_t  hit_trueEnergyMax[kMaxHits]; //energy deposited from that mctrackID
-      Float_t  hit_trueEnergyFraction[kMaxHits]; //maxe/tote
+      std::vector<Short_t>  hit_tpc;        //tpc number
+      std::vector<Short_t>  hit_view;      //plane number
+      std::vector<Short_t>  hit_wire;       //wire number
+      std::vector<Short_t>  hit_channel;    //channel ID
+      std::vector<Float_t>  hit_peakT;      //peak time
+      std::vector<Float_t>  hit_chargesum;     //charge (sum)
+      std::vector<Float_t>  hit_chargeintegral;     //charge (integral)
+      std::vector<Float_t>  hit_ph;         //amplitude
+      std::vector<Float_t>  hit_startT;     //hit start time
+      std::vector<Float_t>  hit_endT;       //hit end time
+      std::vector<Float_t>  hit_rms;       //hit rms from the hit object
+      std::vector<Float_t>  hit_goodnessOfFit; //chi2/dof goodness of fit
+      std::vector<Float_t>  hit_fitparamampl; //dual phase hit fit
+      std::vector<Float_t>  hit_fitparamt0; //dual phase hit fit
+      std::vector<Float_t>  hit_fitparamtau1; //dual phase hit fit
+      std::vector<Float_t>  hit_fitparamtau2; //dual phase hit fit
+      std::vector<Short_t>  hit_multiplicity;  //multiplicity of the given hit
+      std::vector<Int_t>    hit_trueID;  //true mctackID form backtracker
+      std::vector<Float_t>  hit_trueEnergyMax; //energy deposited from that mctrackID
+      std::vector<Float_t>  hit_trueEnergyFraction; //maxe/tote
       //    Float_t  hit_trueX[kMaxHits];      // hit true X (cm)
       //    Float_t  hit_nelec[kMaxHits];     //hit number of electrons
       //    Float_t  hit_energy[kMaxHits];       //hit energy
-      Short_t  hit_trkid[kMaxHits];      //is this hit associated with a reco track?
+      std::vector<Short_t>  hit_trkid;      //is this hit associated with a reco track?
       //    Short_t  hit_trkKey[kMaxHits];      //is this hit associated with a reco track,  if so associate a unique track key ID?
-      Short_t  hit_clusterid[kMaxHits];  //is this hit associated with a reco cluster?
+      std::vector<Short_t>  hit_clusterid;  //is this hit associated with a reco cluster?
       //    Short_t  hit_clusterKey[kMaxHits];  //is this hit associated with a reco cluster, if so associate a unique cluster key ID?
 /*
       Float_t rawD_ph[kMaxHits];
@@ -605,16 +604,17 @@ namespace dune {
       Int_t no_ticks;                  //number of readout ticks for raw waveform
       Int_t no_ticksinallchannels;     //number of readout ticks multiplied by no_channels
 
-      Int_t rawD_Channel[kMaxChannels];
-      Short_t rawD_ADC[kMaxReadoutTicksInAllChannels];
+      // waveforms, sized to the channels and ticks of the event
+      std::vector<Int_t> rawD_Channel;
+      std::vector<Short_t> rawD_ADC;
 
       Int_t no_recochannels;               //number of readout channels with "reco" waveform (can be different from number of max channels in simulation)
-      Int_t recoW_Channel[kMaxChannels];
-      Int_t recoW_NTicks[kMaxChannels];
+      std::vector<Int_t> recoW_Channel;
+      std::vector<Int_t> recoW_NTicks;
 
       Int_t no_recoticksinallchannels;     //number of readout ticks multiplied by no_channels
-      Int_t recoW_Tick[kMaxReadoutTicksInAllChannels];
-      Float_t recoW_ADC[kMaxReadoutTicksInAllChannels];
+      std::vector<Int_t> recoW_Tick;
+      std::vector<Float_t> recoW_ADC;
 
       //Light information
       size_t MaxPhotons = 0;
@@ -629,26 +629,26 @@ namespace dune {
       Float_t nuvtxz[kMaxVertices];
       Short_t nuvtxpdg[kMaxVertices];
 
-      //Cluster Information
+      //Cluster Information, sized to the clusters of the event
       Short_t nclusters;				      //number of clusters in a given event
-      Short_t clusterId[kMaxClusters];		      //ID of this cluster
-      Short_t clusterView[kMaxClusters];	      //which plane this cluster belongs to
-      Int_t   cluster_isValid[kMaxClusters];	      //is this cluster valid? will have a value of -1 if it is not valid
-      Float_t cluster_StartCharge[kMaxClusters];	       //charge on the first wire of the cluster in ADC
-      Float_t cluster_StartAngle[kMaxClusters];	      //starting angle of the cluster
-      Float_t cluster_EndCharge[kMaxClusters];	      //charge on the last wire of the cluster in ADC
-      Float_t cluster_EndAngle[kMaxClusters];	      //ending angle of the cluster
-      Float_t cluster_Integral[kMaxClusters];	      //returns the total charge of the cluster from hit shape in ADC
-      Float_t cluster_IntegralAverage[kMaxClusters];    //average charge of the cluster hits in ADC
-      Float_t cluster_SummedADC[kMaxClusters];	      //total charge of the cluster from signal ADC counts
-      Float_t cluster_SummedADCaverage[kMaxClusters];   //average signal ADC counts of the cluster hits.
-      Float_t cluster_MultipleHitDensity[kMaxClusters]; //Density of wires in the cluster with more than one hit.
-      Float_t cluster_Width[kMaxClusters];	      //cluster width in ? units
-      Short_t cluster_NHits[kMaxClusters];	      //Number of hits in the cluster
-      Short_t cluster_StartWire[kMaxClusters];	      //wire coordinate of the start of the cluster
-      Short_t cluster_StartTick[kMaxClusters];	      //tick coordinate of the start of the cluster in time ticks
-      Short_t cluster_EndWire[kMaxClusters];	      //wire coordinate of the end of the cluster
-      Short_t cluster_EndTick[kMaxClusters];            //tick coordinate of the end of the cluster in time ticks
+      std::vector<Short_t> clusterId;		      //ID of this cluster
+      std::vector<Short_t> clusterView;	      //which plane this cluster belongs to
+      std::vector<Int_t>   cluster_isValid;	      //is this cluster valid? will have a value of -1 if it is not valid
+      std::vector<Float_t> cluster_StartCharge;	       //charge on the first wire of the cluster in ADC
+      std::vector<Float_t> cluster_StartAngle;	      //starting angle of the cluster
+      std::vector<Float_t> cluster_EndCharge;	      //charge on the last wire of the cluster in ADC
+      std::vector<Float_t> cluster_EndAngle;	      //ending angle of the cluster
+      std::vector<Float_t> cluster_Integral;	      //returns the total charge of the cluster from hit shape in ADC
+      std::vector<Float_t> cluster_IntegralAverage;    //average charge of the cluster hits in ADC
+      std::vector<Float_t> cluster_SummedADC;	      //total charge of the cluster from signal ADC counts
+      std::vector<Float_t> cluster_SummedADCaverage;   //average signal ADC counts of the cluster hits.
+      std::vector<Float_t> cluster_MultipleHitDensity; //Density of wires in the cluster with more than one hit.
+      std::vector<Float_t> cluster_Width;	      //cluster width in ? units
+      std::vector<Short_t> cluster_NHits;	      //Number of hits in the cluster
+      std::vector<Short_t> cluster_StartWire;	      //wire coordinate of the start of the cluster
+      std::vector<Short_t> cluster_StartTick;	      //tick coordinate of the start of the cluster in time ticks
+      std::vector<Short_t> cluster_EndWire;	      //wire coordinate of the end of the cluster
+      std::vector<Short_t> cluster_EndTick;            //tick coordinate of the end of the cluster in time ticks
       //Cluster cosmic tagging information
       //    Short_t cluncosmictags_tagger[kMaxClusters];      //No. of cosmic tags associated to this cluster
       //    Float_t clucosmicscore_tagger[kMaxClusters];      //Cosmic score associated to this cluster. In the case of more than one tag, the first one is associated.
@@ -1169,6 +1169,18 @@ namespace dune {
       /// Allocates data structures for the given number of trackers (no Clear())
       void SetShowerAlgos(std::vector<std::string> const& ShowerAlgos);
 
+      /// Resize the data strutcure for hits
+      void ResizeHits(int nHits);
+
+      /// Resize the data strutcure for raw waveforms
+      void ResizeRawDigits(int nChannels, int nTicksInAllChannels);
+
+      /// Resize the data strutcure for reco waveforms
+      void ResizeRecobWires(int nChannels, int nTicksInAllChannels);
+
+      /// Resize the data strutcure for clusters
+      void ResizeClusters(int nClusters);
+
       /// Resize the data strutcure for Generator particles
       void ResizePhotons(int nPhotons);
 
@@ -1222,7 +1234,7 @@ namespace dune {
       size_t GetNShowerAlgos() const { return ShowerData.size(); }
 
       /// Returns the number of hits for which memory is allocated
-      size_t GetMaxHits() const { return kMaxHits; }
+      size_t GetMaxHits() const { return MaxHits; }
 
       /// Returns the number of trackers for which memory is allocated
       size_t GetMaxTrackers() const { return TrackData.capacity(); }
@@ -2666,30 +2678,30 @@ void dune::AnaRootParserDataStruct::ClearLocalData() {
   no_hits_stored = 0;
   NHitsInAllTracks = 0;
 
-  std::fill(hit_tpc, hit_tpc + sizeof(hit_tpc)/sizeof(hit_tpc[0]), -999);
-  std::fill(hit_view, hit_view + sizeof(hit_view)/sizeof(hit_view[0]), -999);
-  std::fill(hit_wire, hit_wire + sizeof(hit_wire)/sizeof(hit_wire[0]), -999);
-  std::fill(hit_channel, hit_channel + sizeof(hit_channel)/sizeof(hit_channel[0]), -999);
-  std::fill(hit_peakT, hit_peakT + sizeof(hit_peakT)/sizeof(hit_peakT[0]), -999.);
-  std::fill(hit_chargesum, hit_chargesum + sizeof(hit_chargesum)/sizeof(hit_chargesum[0]), -999.);
-  std::fill(hit_chargeintegral, hit_chargeintegral + sizeof(hit_chargeintegral)/sizeof(hit_chargeintegral[0]), -999.);
-  std::fill(hit_ph, hit_ph + sizeof(hit_ph)/sizeof(hit_ph[0]), -999.);
-  std::fill(hit_startT, hit_startT + sizeof(hit_startT)/sizeof(hit_startT[0]), -999.);
-  std::fill(hit_endT, hit_endT + sizeof(hit_endT)/sizeof(hit_endT[0]), -999.);
-  std::fill(hit_rms, hit_rms + sizeof(hit_rms)/sizeof(hit_rms[0]), -999.);
+  FillWith(hit_tpc, -999);
+  FillWith(hit_view, -999);
+  FillWith(hit_wire, -999);
+  FillWith(hit_channel, -999);
+  FillWith(hit_peakT, -999.);
+  FillWith(hit_chargesum, -999.);
+  FillWith(hit_chargeintegral, -999.);
+  FillWith(hit_ph, -999.);
+  FillWith(hit_startT, -999.);
+  FillWith(hit_endT, -999.);
+  FillWith(hit_rms, -999.);
   //  std::fill(hit_trueX, hit_trueX + sizeof(hit_trueX)/sizeof(hit_trueX[0]), -999.);
-  std::fill(hit_goodnessOfFit, hit_goodnessOfFit + sizeof(hit_goodnessOfFit)/sizeof(hit_goodnessOfFit[0]), -999.);
-  std::fill(hit_fitparamampl, hit_fitparamampl + sizeof(hit_fitparamampl)/sizeof(hit_fitparamampl[0]), -999.);
-  std::fill(hit_fitparamt0, hit_fitparamt0 + sizeof(hit_fitparamt0)/sizeof(hit_fitparamt0[0]), -999.);
-  std::fill(hit_fitparamtau1, hit_fitparamtau1 + sizeof(hit_fitparamtau1)/sizeof(hit_fitparamtau1[0]), -999.);
-  std::fill(hit_fitparamtau2, hit_fitparamtau2 + sizeof(hit_fitparamtau2)/sizeof(hit_fitparamtau2[0]), -999.);
-  std::fill(hit_multiplicity, hit_multiplicity + sizeof(hit_multiplicity)/sizeof(hit_multiplicity[0]), -999.);
-  std::fill(hit_trueID, hit_trueID + sizeof(hit_trueID)/sizeof(hit_trueID[0]), -999.);
-  std::fill(hit_trueEnergyMax, hit_trueEnergyMax + sizeof(hit_trueEnergyMax)/sizeof(hit_trueEnergyMax[0]), -999.);
-  std::fill(hit_trueEnergyFraction, hit_trueEnergyFraction + sizeof(hit_trueEnergyFraction)/sizeof(hit_trueEnergyFraction[0]), -999.);
-  std::fill(hit_trkid, hit_trkid + sizeof(hit_trkid)/sizeof(hit_trkid[0]), -999);
+  FillWith(hit_goodnessOfFit, -999.);
+  FillWith(hit_fitparamampl, -999.);
+  FillWith(hit_fitparamt0, -999.);
+  FillWith(hit_fitparamtau1, -999.);
+  FillWith(hit_fitparamtau2, -999.);
+  FillWith(hit_multiplicity, -999.);
+  FillWith(hit_trueID, -999.);
+  FillWith(hit_trueEnergyMax, -999.);
+  FillWith(hit_trueEnergyFraction, -999.);
+  FillWith(hit_trkid, -999);
   //  std::fill(hit_trkKey, hit_trkKey + sizeof(hit_trkKey)/sizeof(hit_trkKey[0]), -999);
-  std::fill(hit_clusterid, hit_clusterid + sizeof(hit_clusterid)/sizeof(hit_clusterid[0]), -9999);
+  FillWith(hit_clusterid, -9999);
   //  std::fill(hit_clusterKey, hit_clusterKey + sizeof(hit_clusterKey)/sizeof(hit_clusterKey[0]), -999);
   //  std::fill(hit_nelec, hit_nelec + sizeof(hit_nelec)/sizeof(hit_nelec[0]), -999.);
   //  std::fill(hit_energy, hit_energy + sizeof(hit_energy)/sizeof(hit_energy[0]), -999.);
@@ -2704,16 +2716,16 @@ void dune::AnaRootParserDataStruct::ClearLocalData() {
   no_channels = 0;
   no_ticks = 0;
   no_ticksinallchannels = 0;
-  std::fill(rawD_ADC, rawD_ADC + sizeof(rawD_ADC)/sizeof(rawD_ADC[0]), -999);
-  std::fill(rawD_Channel, rawD_Channel + sizeof(rawD_Channel)/sizeof(rawD_Channel[0]), -999);
+  FillWith(rawD_ADC, -999);
+  FillWith(rawD_Channel, -999);
 
   no_recochannels=0;
-  std::fill(recoW_Channel, recoW_Channel + sizeof(recoW_Channel)/sizeof(recoW_Channel[0]), -999);
-  std::fill(recoW_NTicks, recoW_NTicks + sizeof(recoW_NTicks)/sizeof(recoW_NTicks[0]), -999);
+  FillWith(recoW_Channel, -999);
+  FillWith(recoW_NTicks, -999);
 
   no_recoticksinallchannels=0;
-  std::fill(recoW_Tick, recoW_Tick + sizeof(recoW_Tick)/sizeof(recoW_Tick[0]), -999);
-  std::fill(recoW_ADC, recoW_ADC + sizeof(recoW_ADC)/sizeof(recoW_ADC[0]), -999);
+  FillWith(recoW_Tick, -999);
+  FillWith(recoW_ADC, -999);
 
   numberofphotons=0;
   FillWith(photons_time,-999);
@@ -2733,24 +2745,24 @@ void dune::AnaRootParserDataStruct::ClearLocalData() {
   std::fill(externcounts_id, externcounts_id + sizeof(externcounts_id)/sizeof(externcounts_id[0]), -999);
 
   nclusters = 0;
-  std::fill(clusterId, clusterId + sizeof(clusterId)/sizeof(clusterId[0]), -999);
-  std::fill(clusterView, clusterView + sizeof(clusterView)/sizeof(clusterView[0]), -999);
-  std::fill(cluster_isValid, cluster_isValid + sizeof(cluster_isValid)/sizeof(cluster_isValid[0]), -1);
-  std::fill(cluster_StartCharge, cluster_StartCharge +  sizeof(cluster_StartCharge)/sizeof(cluster_StartCharge[0]), -999.);
-  std::fill(cluster_StartAngle, cluster_StartAngle + sizeof(cluster_StartAngle)/sizeof(cluster_StartAngle[0]), -999.);
-  std::fill(cluster_EndCharge, cluster_EndCharge + sizeof(cluster_EndCharge)/sizeof(cluster_EndCharge[0]), -999.);
-  std::fill(cluster_EndAngle , cluster_EndAngle + sizeof(cluster_EndAngle)/sizeof(cluster_EndAngle[0]), -999.);
-  std::fill(cluster_Integral , cluster_Integral + sizeof(cluster_Integral)/sizeof(cluster_Integral[0]), -999.);
-  std::fill(cluster_IntegralAverage, cluster_IntegralAverage + sizeof(cluster_IntegralAverage)/sizeof(cluster_IntegralAverage[0]), -999.);
-  std::fill(cluster_SummedADC, cluster_SummedADC + sizeof(cluster_SummedADC)/sizeof(cluster_SummedADC[0]), -999.);
-  std::fill(cluster_SummedADCaverage, cluster_SummedADCaverage + sizeof(cluster_SummedADCaverage)/sizeof(cluster_SummedADCaverage[0]), -999.);
-  std::fill(cluster_MultipleHitDensity, cluster_MultipleHitDensity + sizeof(cluster_MultipleHitDensity)/sizeof(cluster_MultipleHitDensity[0]), -999.);
-  std::fill(cluster_Width, cluster_Width + sizeof(cluster_Width)/sizeof(cluster_Width[0]), -999.);
-  std::fill(cluster_NHits, cluster_NHits + sizeof(cluster_NHits)/sizeof(cluster_NHits[0]), -999);
-  std::fill(cluster_StartWire, cluster_StartWire + sizeof(cluster_StartWire)/sizeof(cluster_StartWire[0]), -999);
-  std::fill(cluster_StartTick, cluster_StartTick + sizeof(cluster_StartTick)/sizeof(cluster_StartTick[0]), -999);
-  std::fill(cluster_EndWire, cluster_EndWire + sizeof(cluster_EndWire)/sizeof(cluster_EndWire[0]), -999);
-  std::fill(cluster_EndTick, cluster_EndTick + sizeof(cluster_EndTick)/sizeof(cluster_EndTick[0]), -999);
+  FillWith(clusterId, -999);
+  FillWith(clusterView, -999);
+  FillWith(cluster_isValid, -1);
+  FillWith(cluster_StartCharge, -999.);
+  FillWith(cluster_StartAngle, -999.);
+  FillWith(cluster_EndCharge, -999.);
+  FillWith(cluster_EndAngle, -999.);
+  FillWith(cluster_Integral, -999.);
+  FillWith(cluster_IntegralAverage, -999.);
+  FillWith(cluster_SummedADC, -999.);
+  FillWith(cluster_SummedADCaverage, -999.);
+  FillWith(cluster_MultipleHitDensity, -999.);
+  FillWith(cluster_Width, -999.);
+  FillWith(cluster_NHits, -999);
+  FillWith(cluster_StartWire, -999);
+  FillWith(cluster_StartTick, -999);
+  FillWith(cluster_EndWire, -999);
+  FillWith(cluster_EndTick, -999);
   //  std::fill(cluncosmictags_tagger, cluncosmictags_tagger + sizeof(cluncosmictags_tagger)/sizeof(cluncosmictags_tagger[0]), -999);
   //  std::fill(clucosmicscore_tagger, clucosmicscore_tagger + sizeof(clucosmicscore_tagger)/sizeof(clucosmicscore_tagger[0]), -999.);
   //  std::fill(clucosmictype_tagger , clucosmictype_tagger  + sizeof(clucosmictype_tagger )/sizeof(clucosmictype_tagger [0]), -999);
@@ -3077,6 +3089,83 @@ void dune::AnaRootParserDataStruct::Clear() {
 } // dune::AnaRootParserDataStruct::SetShowerAlgos()
 
 
+void dune::AnaRootParserDataStruct::ResizeHits(int nHits) {
+
+  // minimum size is 1, so that we always have an address
+  MaxHits = (size_t) std::max(nHits, 1);
+
+  hit_tpc.resize(MaxHits);
+  hit_view.resize(MaxHits);
+  hit_wire.resize(MaxHits);
+  hit_channel.resize(MaxHits);
+  hit_peakT.resize(MaxHits);
+  hit_chargesum.resize(MaxHits);
+  hit_chargeintegral.resize(MaxHits);
+  hit_ph.resize(MaxHits);
+  hit_startT.resize(MaxHits);
+  hit_endT.resize(MaxHits);
+  hit_rms.resize(MaxHits);
+  hit_goodnessOfFit.resize(MaxHits);
+  hit_fitparamampl.resize(MaxHits);
+  hit_fitparamt0.resize(MaxHits);
+  hit_fitparamtau1.resize(MaxHits);
+  hit_fitparamtau2.resize(MaxHits);
+  hit_multiplicity.resize(MaxHits);
+  hit_trueID.resize(MaxHits);
+  hit_trueEnergyMax.resize(MaxHits);
+  hit_trueEnergyFraction.resize(MaxHits);
+  hit_trkid.resize(MaxHits);
+  hit_clusterid.resize(MaxHits);
+} // dune::AnaRootParserDataStruct::ResizeHits
+
+
+void dune::AnaRootParserDataStruct::ResizeRawDigits(int nChannels, int nTicksInAllChannels) {
+
+  // minimum size is 1, so that we always have an address
+  rawD_Channel.resize((size_t) std::max(nChannels, 1));
+  rawD_ADC.resize((size_t) std::max(nTicksInAllChannels, 1));
+} // dune::AnaRootParserDataStruct::ResizeRawDigits
+
+
+void dune::AnaRootParserDataStruct::ResizeRecobWires(int nChannels, int nTicksInAllChannels) {
+
+  // minimum size is 1, so that we always have an address
+  size_t const nMaxChannels = (size_t) std::max(nChannels, 1);
+  recoW_Channel.resize(nMaxChannels);
+  recoW_NTicks.resize(nMaxChannels);
+
+  size_t const nMaxTicks = (size_t) std::max(nTicksInAllChannels, 1);
+  recoW_Tick.resize(nMaxTicks);
+  recoW_ADC.resize(nMaxTicks);
+} // dune::AnaRootParserDataStruct::ResizeRecobWires
+
+
+void dune::AnaRootParserDataStruct::ResizeClusters(int nClusters) {
+
+  // minimum size is 1, so that we always have an address
+  size_t const nMax = (size_t) std::max(nClusters, 1);
+
+  clusterId.resize(nMax);
+  clusterView.resize(nMax);
+  cluster_isValid.resize(nMax);
+  cluster_StartCharge.resize(nMax);
+  cluster_StartAngle.resize(nMax);
+  cluster_EndCharge.resize(nMax);
+  cluster_EndAngle.resize(nMax);
+  cluster_Integral.resize(nMax);
+  cluster_IntegralAverage.resize(nMax);
+  cluster_SummedADC.resize(nMax);
+  cluster_SummedADCaverage.resize(nMax);
+  cluster_MultipleHitDensity.resize(nMax);
+  cluster_Width.resize(nMax);
+  cluster_NHits.resize(nMax);
+  cluster_StartWire.resize(nMax);
+  cluster_StartTick.resize(nMax);
+  cluster_EndWire.resize(nMax);
+  cluster_EndTick.resize(nMax);
+} // dune::AnaRootParserDataStruct::ResizeClusters
+
+
 void dune::AnaRootParserDataStruct::ResizePhotons(int nPhotons) {
 
   // minimum size is 1, so that we always have an address
@@ -4491,8 +4580,6 @@ if(fLogLevel >= 1)
   std::cout << "nPhotons: " << nPhotons << std::endl;
 }
 
-  fData->ClearLocalData(); // don't bother clearing tracker data yet
-
   const size_t NTrackers = GetNTrackers(); // number of trackers passed into fTrackModuleLabel
   const size_t NShowerAlgos = GetNShowerAlgos(); // number of shower algorithms into fShowerModuleLabel
   const size_t NChannels = rawdigitlist.size(); //number of channels holding raw waveforms
@@ -4502,6 +4589,24 @@ if(fLogLevel >= 1)
   const size_t NClusters = clusterlist.size(); //number of clusters
   const size_t NFlashes  = flashlist.size(); // number of flashes
   const size_t NExternCounts = countlist.size(); // number of External Counters
+
+  // the event-level blocks hold exactly what is stored for this event
+  size_t NRawTicks = 0; //number of raw ticks in all channels
+  if (NChannels > 0) NRawTicks = NChannels*rawdigitlist[0]->Samples();
+  size_t NRecoTicks = 0; //number of ticks in all ROI's
+  if (fSaveRecobWireInfo){
+    for (auto const& wire : recobwirelist){
+      for (const auto& range : wire->SignalROI().get_ranges())
+        NRecoTicks += range.end_index() - range.begin_index();
+    }
+  }
+  if (fSaveHitInfo){  fData->ResizeHits(NHits);}
+  if (fSaveRawDigitInfo){  fData->ResizeRawDigits(NChannels, NRawTicks);}
+  if (fSaveRecobWireInfo){  fData->ResizeRecobWires(NRecoChannels, NRecoTicks);}
+  if (fSaveClusterInfo){  fData->ResizeClusters(NClusters);}
+
+  fData->ClearLocalData(); // don't bother clearing tracker data yet
+
   // make sure there is the data, the tree and everything;
   CreateTree();
 
@@ -4650,7 +4755,7 @@ if (fSaveRawDigitInfo){
     fData->rawD_Channel[i] = (int) rawdigitlist[i]->Channel();
     int k=0;
 
-    for (int j = fData->no_ticks*i; j < (fData->no_ticks*(i+1)) && j < kMaxReadoutTicksInAllChannels ; j++) //loop over ticks
+    for (int j = fData->no_ticks*i; j < (fData->no_ticks*(i+1)) ; j++) //loop over ticks
     {
       fData->rawD_ADC[j] = rawdigitlist[i]->ADC(k);
       k++;
@@ -4695,13 +4800,7 @@ if (fSaveHitInfo){
 
   fData->no_hits = (int) NHits;
   fData->NHitsInAllTracks = (int) NHits;
-  fData->no_hits_stored = TMath::Min( (int) NHits, (int) kMaxHits);
-  if (NHits > kMaxHits) {
-    // got this error? consider increasing kMaxHits
-    // (or ask for a redesign using vectors)
-    mf::LogError("AnaRootParser:limits") << "event has " << NHits
-      << " hits, only kMaxHits=" << kMaxHits << " stored in tree";
-  }
+  fData->no_hits_stored = (int) NHits;
 
 // trying to assign a space point to those recob::Hits t hat were assigned to a track, checking for every hit. Not really working yet.
 //    art::FindManyP<recob::SpacePoint> fmsp(hitlist,evt,"pmtrack");
@@ -4709,7 +4808,7 @@ if (fSaveHitInfo){
   auto hitResults = anab::FVectorReader<recob::Hit, 4>::create(evt, "dprawhit");
   const auto & fitParams = hitResults->vectors();
 
-  for (size_t i = 0; i < NHits && i < kMaxHits ; ++i){//loop over hits
+  for (size_t i = 0; i < NHits ; ++i){//loop over hits
     fData->hit_channel[i] = hitlist[i]->Channel();
     fData->hit_tpc[i]   = hitlist[i]->WireID().TPC;
     fData->hit_view[i]   = hitlist[i]->WireID().Plane;
@@ -4859,7 +4958,7 @@ if (fSaveHitInfo){
   if (hitListHandle){
     //Find tracks associated with hits
     art::FindManyP<recob::Track> fmtk(hitListHandle,evt,fTrackModuleLabel[0]);
-    for (size_t i = 0; i < NHits && i < kMaxHits ; ++i){//loop over hits
+    for (size_t i = 0; i < NHits ; ++i){//loop over hits
       if (fmtk.isValid()){
         if (fmtk.at(i).size()!=0){
           fData->hit_trkid[i] = fmtk.at(i)[0]->ID();
@@ -4879,7 +4978,7 @@ if (fSaveHitInfo){
   if (hitListHandle){
     //Find clusters associated with hits
     art::FindManyP<recob::Cluster> fmcl(hitListHandle,evt,fClusterModuleLabel);
-    for (size_t i = 0; i < NHits && i < kMaxHits ; ++i){//loop over hits
+    for (size_t i = 0; i < NHits ; ++i){//loop over hits
       if (fmcl.isValid()){
         if (fmcl.at(i).size()!=0){
           fData->hit_clusterid[i] = fmcl.at(i)[0]->ID();
@@ -4940,12 +5039,6 @@ if(fSavePandoraNuVertexInfo) {
 
 if (fSaveClusterInfo){
   fData->nclusters = (int) NClusters;
-  if (NClusters > kMaxClusters){
-    // got this error? consider increasing kMaxClusters
-    // (or ask for a redesign using vectors)
-    mf::LogError("AnaRootParser:limits") << "event has " << NClusters
-      << " clusters, only kMaxClusters=" << kMaxClusters << " stored in tree";
-  }
   for(unsigned int ic=0; ic<NClusters;++ic){//loop over clusters
     art::Ptr<recob::Cluster> clusterholder(clusterListHandle, ic);
     const recob::Cluster& cluster = *clusterholder;
@@ -0,0 +1,559 @@
+/*
+    Helpers shared by the dual-phase style raw input sources
+    (PDDPRawInputDriver, VDColdboxTDERawInput)
+
+    UnpackPool     : persistent set of worker threads used to unpack the
+                     fragments of each L1 event builder in parallel
+    EventReadAhead : background reader that fetches the next event record
+                     while the current one is unpacked
+    MappedDaqFile  : read-only memory map of a raw file giving direct views
+                     of the event records
+    DaqRecordFile  : event table, record selection and record fetching for
+                     a raw file, built on the three helpers above
+
+ */
+#ifndef __DAQREADENGINE_H__
+#define __DAQREADENGINE_H__
+
+#include <fstream>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <exception>
+#include <string>
+#include <memory>
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+namespace lris
+{
+  //
+  // read sz bytes from the current position of the file
+  // on a short read the buffer is truncated to what was available
+  // and the stream error state is cleared
+  inline void readDaqChunk( std::ifstream &file, std::vector<char> &bytes, size_t sz )
+  {
+    bytes.resize( sz );
+    file.read( bytes.data(), sz );
+    if( !file )
+      {
+	bytes.resize( file.gcount() );
+	file.clear();
+      }
+  }
+
+  //
+  // Fixed set of threads created once and reused for every event.
+  // run(n, f) calls f(0) ... f(n-1) with the calling thread taking part,
+  // and returns once all calls are done. The first exception thrown by
+  // a task is passed on to the caller.
+  class UnpackPool
+  {
+  public:
+    // nthreads is the total number of threads including the caller
+    explicit UnpackPool( unsigned nthreads )
+    {
+      for( unsigned i = 1; i < nthreads; ++i )
+	__workers.emplace_back( [this]{ __loop(); } );
+    }
+
+    ~UnpackPool()
+    {
+      {
+	std::lock_guard<std::mutex> lock( __mutex );
+	__stop = true;
+      }
+      __wake.notify_all();
+      for( auto &t : __workers ) t.join();
+    }
+
+    UnpackPool( const UnpackPool& ) = delete;
+    UnpackPool& operator=( const UnpackPool& ) = delete;
+
+    // total number of threads including the caller
+    unsigned size() const { return __workers.size() + 1; }
+
+    void run( size_t n, const std::function<void(size_t)> &f )
+    {
+      if( n == 0 ) return;
+      if( __workers.empty() || n == 1 )
+	{
+	  for( size_t i = 0; i < n; ++i ) f( i );
+	  return;
+	}
+
+      {
+	std::lock_guard<std::mutex> lock( __mutex );
+	__task  = &f;
+	__ntask = n;
+	__next  = 0;
+	__ndone = 0;
+	__error = nullptr;
+	__generation++;
+      }
+      __wake.notify_all();
+
+      __work();
+
+      std::unique_lock<std::mutex> lock( __mutex );
+      __done.wait( lock, [this]{ return __ndone == __ntask; } );
+      __task = nullptr;
+      if( __error ) std::rethrow_exception( __error );
+    }
+
+  private:
+    // take tasks until none are left
+    void __work()
+    {
+      for(;;)
+	{
+	  size_t i;
+	  const std::function<void(size_t)> *task;
+	  {
+	    std::lock_guard<std::mutex> lock( __mutex );
+	    if( __next >= __ntask ) return;
+	    i    = __next++;
+	    task = __task;
+	  }
+
+	  std::exception_ptr err;
+	  try { (*task)( i ); }
+	  catch(...) { err = std::current_exception(); }
+
+	  std::lock_guard<std::mutex> lock( __mutex );
+	  if( err && !__error ) __error = err;
+	  if( ++__ndone == __ntask ) __done.notify_all();
+	}
+    }
+
+    void __loop()
+    {
+      unsigned long seen = 0;
+      for(;;)
+	{
+	  {
+	    std::unique_lock<std::mutex> lock( __mutex );
+	    __wake.wait( lock, [&]{ return __stop || __generation != seen; } );
+	    if( __stop ) return;
+	    seen = __generation;
+	  }
+	  __work();
+	}
+    }
+
+    std::vector<std::thread> __workers;
+    std::mutex               __mutex;
+    std::condition_variable  __wake;
+    std::condition_variable  __done;
+
+    const std::function<void(size_t)> *__task = nullptr;
+    size_t        __ntask      = 0;
+    size_t        __next       = 0;
+    size_t        __ndone      = 0;
+    unsigned long __generation = 0;
+    bool          __stop       = false;
+    std::exception_ptr __error;
+  };
+
+  //
+  // Double-buffered reader for the event records of a raw file.
+  // prefetch() starts reading a record into the spare buffer on a
+  // dedicated thread; take() waits for it and swaps it with the caller's
+  // buffer, so the two buffers are recycled from event to event.
+  // The stream must not be touched by the caller while a read is pending:
+  // call cancel() before seeking, reading or closing it.
+  class EventReadAhead
+  {
+  public:
+    EventReadAhead() : __iothread( [this]{ __loop(); } ) {}
+
+    ~EventReadAhead()
+    {
+      {
+	std::lock_guard<std::mutex> lock( __mutex );
+	__stop = true;
+      }
+      __wake.notify_all();
+      __iothread.join();
+    }
+
+    EventReadAhead( const EventReadAhead& ) = delete;
+    EventReadAhead& operator=( const EventReadAhead& ) = delete;
+
+    // start reading record iev of sz bytes at pos
+    void prefetch( std::ifstream &file, size_t iev, std::streampos pos, size_t sz )
+    {
+      cancel();
+      std::lock_guard<std::mutex> lock( __mutex );
+      __file    = &file;
+      __iev     = iev;
+      __pos     = pos;
+      __sz      = sz;
+      __pending = true;
+      __wake.notify_all();
+    }
+
+    // get record iev if it was prefetched, false otherwise
+    bool take( size_t iev, std::vector<char> &bytes )
+    {
+      std::unique_lock<std::mutex> lock( __mutex );
+      __idle.wait( lock, [this]{ return !__pending; } );
+      if( !__ready || __iev != iev ) return false;
+      bytes.swap( __buf );
+      __ready = false;
+      return true;
+    }
+
+    // wait for any pending read and drop its result
+    void cancel()
+    {
+      std::unique_lock<std::mutex> lock( __mutex );
+      __idle.wait( lock, [this]{ return !__pending; } );
+      __ready = false;
+    }
+
+  private:
+    void __loop()
+    {
+      std::unique_lock<std::mutex> lock( __mutex );
+      for(;;)
+	{
+	  __wake.wait( lock, [this]{ return __stop || __pending; } );
+	  if( __stop ) return;
+
+	  // the buffer and the stream belong to this thread until
+	  // __pending is cleared
+	  lock.unlock();
+	  __file->seekg( __pos, std::ios::beg );
+	  readDaqChunk( *__file, __buf, __sz );
+	  lock.lock();
+
+	  __pending = false;
+	  __ready   = true;
+	  __idle.notify_all();
+	}
+    }
+
+    std::mutex              __mutex;
+    std::condition_variable __wake;
+    std::condition_variable __idle;
+
+    std::ifstream    *__file = nullptr;
+    size_t            __iev  = 0;
+    std::streampos    __pos  = 0;
+    size_t            __sz   = 0;
+    std::vector<char> __buf;
+    bool              __pending = false;
+    bool              __ready   = false;
+    bool              __stop    = false;
+
+    // started last, once the members above are initialized
+    std::thread       __iothread;
+  };
+
+  //
+  // Read-only memory map of a whole raw file.
+  // view() returns a pointer to the record at pos without copying it;
+  // the pointer stays valid until close() or destruction.
+  class MappedDaqFile
+  {
+  public:
+    MappedDaqFile() {}
+    ~MappedDaqFile() { close(); }
+
+    MappedDaqFile( const MappedDaqFile& ) = delete;
+    MappedDaqFile& operator=( const MappedDaqFile& ) = delete;
+
+    // map the file, false on failure
+    // sequential selects the access pattern hint given to the kernel
+    bool open( const std::string &name, bool sequential = true )
+    {
+      close();
+      int fd = ::open( name.c_str(), O_RDONLY );
+      if( fd < 0 ) return false;
+      struct stat st;
+      if( fstat( fd, &st ) != 0 || st.st_size <= 0 )
+	{
+	  ::close( fd );
+	  return false;
+	}
+      void *addr = mmap( nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0 );
+      ::close( fd );
+      if( addr == MAP_FAILED ) return false;
+      __data = static_cast<const char*>( addr );
+      __size = st.st_size;
+      madvise( addr, __size, sequential ? MADV_SEQUENTIAL : MADV_RANDOM );
+      return true;
+    }
+
+    void close()
+    {
+      if( __data ) munmap( const_cast<char*>(__data), __size );
+      __data = nullptr;
+      __size = 0;
+    }
+
+    bool is_open() const { return __data != nullptr; }
+    size_t size() const { return __size; }
+
+    // view of sz bytes at pos; sz is reduced to what is in the file
+    const char* view( std::streampos pos, size_t &sz ) const
+    {
+      size_t off = std::streamoff( pos );
+      if( off >= __size ) { sz = 0; return __data + __size; }
+      if( sz > __size - off ) sz = __size - off;
+      return __data + off;
+    }
+
+    // ask the kernel to start reading a record that will be used soon
+    void willneed( std::streampos pos, size_t sz ) const
+    {
+      size_t off = std::streamoff( pos );
+      if( off >= __size ) return;
+      if( sz > __size - off ) sz = __size - off;
+      // madvise wants a page aligned address
+      static const size_t page = sysconf( _SC_PAGESIZE );
+      size_t start = off - off % page;
+      madvise( const_cast<char*>(__data) + start, sz + off - start, MADV_WILLNEED );
+    }
+
+  private:
+    const char *__data = nullptr;
+    size_t      __size = 0;
+  };
+
+  //
+  // Event records of a raw file.
+  // The file starts with the number of records and a table of their
+  // sizes; the records follow one after the other. select() makes the
+  // list of records to read and next() returns them in turn, either as a
+  // view into a memory map of the file or from a buffer filled by the
+  // read-ahead thread or by a plain read. Each call to next() starts
+  // fetching the following selected record while the caller unpacks the
+  // current one.
+  // Nothing is logged here: open(), readTable() and map() return false on
+  // failure and the reason, or a warning, is left in message().
+  class DaqRecordFile
+  {
+  public:
+    // readahead : read the next record on a background thread
+    //             (only used when the file is not mapped)
+    // mmap      : take the records directly from a memory map of the file
+    DaqRecordFile( bool readahead, bool mmap ) : __mmap( mmap )
+    {
+      if( readahead && !mmap ) __reader.reset( new EventReadAhead() );
+    }
+    ~DaqRecordFile() { close(); }
+
+    DaqRecordFile( const DaqRecordFile& ) = delete;
+    DaqRecordFile& operator=( const DaqRecordFile& ) = delete;
+
+    // open the file for reading
+    bool open( const std::string &name )
+    {
+      close();
+      __name = name;
+      __file.open( name.c_str(), std::ios::in | std::ios::binary | std::ios::ate );
+      if( !__file.is_open() )
+	{
+	  __message = "Error opening binary file " + name;
+	  return false;
+	}
+      __filesz = __file.tellg();
+      __file.seekg( 0, std::ios::beg );
+      return true;
+    }
+
+    // unpack the table of records at the start of the file
+    bool readTable()
+    {
+      std::vector<char> buf;
+      size_t msz = 2*sizeof(uint32_t);
+      readDaqChunk( __file, buf, msz );
+      if( buf.size() != msz )
+	{
+	  __message = "Could not read number of events";
+	  return false;
+	}
+
+      // number of events in the file
+      uint32_t nev;
+      std::memcpy( &nev, &buf[4], sizeof(nev) );
+      if( nev == 0 )
+	{
+	  __message = "File does not contain any events";
+	  return false;
+	}
+
+      size_t evtsz = size_t(nev) * 4 * sizeof(uint32_t);
+      if( evtsz + msz >= __filesz )
+	{
+	  __message = "Cannot find event table";
+	  return false;
+	}
+
+      // sizes of events in sequence, 16 bytes per entry
+      readDaqChunk( __file, buf, evtsz );
+      __evsz.clear();
+      for( size_t i = 0; i < buf.size(); i += 16 )
+	{
+	  uint32_t sz;
+	  std::memcpy( &sz, &buf[i+4], sizeof(sz) );
+	  __evsz.push_back( sz );
+	}
+
+      // positions of the events: the first one is at the current position
+      __events.clear();
+      __events.push_back( __file.tellg() );
+      for( size_t i = 0; i < __evsz.size()-1; i++ )
+	{
+	  __file.seekg( __evsz[i], std::ios::cur );
+	  if( !__file )
+	    {
+	      __message = "Event table does not match file size";
+	      __file.clear();
+	      __evsz.resize( __events.size() );
+	      break;
+	    }
+	  __events.push_back( __file.tellg() );
+	}
+      return true;
+    }
+
+    // map the file if the records are to be taken from memory
+    // sequential selects the access pattern hint given to the kernel
+    bool map( bool sequential )
+    {
+      if( !__mmap ) return true;
+      if( __map.open( __name, sequential ) ) return true;
+      __message = "Error mapping binary file " + __name;
+      return false;
+    }
+
+    //
+    // make the list of records to read: skip the first records, then, if
+    // evlist is not empty, keep those whose event number is in it; evlist
+    // must be sorted. The event number is decoded by evnum from the first
+    // hdrsz bytes of a record, which is dropped if evnum returns false.
+    // maxrec > 0 limits the number of records kept.
+    size_t select( size_t skip, const std::vector<uint32_t> &evlist, size_t hdrsz,
+		   const std::function<bool(const char*, uint32_t&)> &evnum,
+		   size_t maxrec = 0 )
+    {
+      __records.clear();
+      __next = 0;
+      std::vector<char> hdr;
+      for( size_t i = skip; i < __evsz.size(); ++i )
+	{
+	  if( maxrec > 0 && __records.size() == maxrec ) break;
+	  if( !evlist.empty() )
+	    {
+	      const char *phdr;
+	      size_t nhdr = hdrsz;
+	      if( __map.is_open() )
+		phdr = __map.view( __events[i], nhdr );
+	      else
+		{
+		  __file.seekg( __events[i], std::ios::beg );
+		  readDaqChunk( __file, hdr, nhdr );
+		  phdr = hdr.data();
+		  nhdr = hdr.size();
+		}
+	      uint32_t num;
+	      if( nhdr < hdrsz || !evnum( phdr, num ) ) continue;
+	      if( !std::binary_search( evlist.begin(), evlist.end(), num ) ) continue;
+	    }
+	  __records.push_back( i );
+	}
+      return __records.size();
+    }
+
+    //
+    // next selected record: nb bytes at bytes, valid until the next call
+    // or close(); false once all selected records have been read
+    bool next( const char* &bytes, size_t &nb )
+    {
+      if( __next == __records.size() ) return false;
+      size_t irec = __records[ __next++ ];
+
+      nb = __evsz[ irec ];
+      if( __map.is_open() )
+	bytes = __map.view( __events[ irec ], nb );
+      else
+	{
+	  if( !__reader || !__reader->take( irec, __evbuf ) )
+	    {
+	      if( __events[ irec ] != __file.tellg() )
+		__file.seekg( __events[ irec ], std::ios::beg );
+	      readDaqChunk( __file, __evbuf, nb );
+	    }
+	  bytes = __evbuf.data();
+	  nb    = __evbuf.size();
+	}
+
+      // fetch the next record while this one is unpacked
+      if( __next < __records.size() )
+	{
+	  size_t inext = __records[ __next ];
+	  if( __map.is_open() )
+	    __map.willneed( __events[ inext ], __evsz[ inext ] );
+	  else if( __reader )
+	    __reader->prefetch( __file, inext, __events[ inext ], __evsz[ inext ] );
+	}
+      return true;
+    }
+
+    void close()
+    {
+      // a pending read still uses the file
+      if( __reader ) __reader->cancel();
+      if( __file.is_open() ) __file.close();
+      __file.clear();
+      __map.close();
+      __filesz = 0;
+      __events.clear();
+      __evsz.clear();
+      __records.clear();
+      __next = 0;
+      __message.clear();
+    }
+
+    // number of records in the event table
+    size_t size() const { return __evsz.size(); }
+    // number of records selected and number returned by next() so far
+    size_t nselected() const { return __records.size(); }
+    size_t nread() const { return __next; }
+
+    const std::string& message() const { return __message; }
+
+  private:
+    bool                            __mmap;
+    std::string                     __name;
+    std::ifstream                   __file;
+    size_t                          __filesz = 0;
+    MappedDaqFile                   __map;
+    std::unique_ptr<EventReadAhead> __reader;
+    std::vector<char>               __evbuf;
+
+    // file locations and sizes of the records
+    std::vector<std::streampos> __events;
+    std::vector<uint32_t>       __evsz;
+
+    // indices in the event table of the records to read
+    std::vector<size_t> __records;
+    size_t              __next = 0;
+
+    std::string __message;
+  };
+}
+
+#endif
@@ -21,9 +21,9 @@
 
 #include "PDDPChannelMap.h"
 
+#include "duneprototypes/Protodune/dualphase/RawDecoding/Unpack12bit.h"
+
 #include <exception>
-#include <thread>
-#include <mutex>
 #include <regex>
 #include <sstream>
 #include <iterator>
@@ -49,41 +49,13 @@ using UIntVec = std::vector<unsigned>;
 namespace 
 {
   void unpackCroData( const char *buf, size_t nb, bool cflag, 
-		      unsigned nsa, adcbuf_t &data )
+		      unsigned nsa, adcbuf_t &data,
+		      const uint16_t *invped, size_t ninvped )
   {
     //data.clear();
     if( !cflag ) // unpack the uncompressed data into RawDigit
       {
-	data.push_back( raw::RawDigit::ADCvector_t(nsa) );
-	size_t sz = 0;
-	const BYTE* start = buf;
-	const BYTE* stop  = start + nb;
-	while(start!=stop)
-	  {
-	    BYTE v1 = *start++;
-	    BYTE v2 = *start++;
-	    BYTE v3 = *start++;
-	    
-	    uint16_t tmp1 = ((v1 << 4) + ((v2 >> 4) & 0xf)) & 0xfff;
-	    uint16_t tmp2 = (((v2 & 0xf) << 8 ) + (v3 & 0xff)) & 0xfff;
-	    
-	    // if( offset > 0 ) // invert baseline: tmp fix for the signal inversion
-	    //   {
-	    // 	float ftmp1 = offset - tmp1;
-	    // 	if( ftmp1 < 0 ) ftmp1 = 0;
-	    // 	tmp1 = (uint16_t)(ftmp1);
-		
-	    // 	float ftmp2 = offset - tmp2;
-	    // 	if( ftmp2 < 0 ) ftmp2 = 0;
-	    // 	tmp2 = (uint16_t)(ftmp2);
-	    //   }
-	    
-	    if( sz == nsa ){ data.push_back(raw::RawDigit::ADCvector_t(nsa)); sz = 0; }
-	    data.back()[sz++] = (short)tmp1;
-	    
-	    if( sz == nsa ){ data.push_back(raw::RawDigit::ADCvector_t(nsa)); sz = 0; }
-	    data.back()[sz++] = (short)tmp2;
-	  }
+	lris::adc12::unpackChannels( buf, nb, nsa, data, invped, ninvped );
       }
     else
       //TODO finalize the format of compressed data
@@ -125,9 +97,7 @@ namespace lris
 					  art::ProductRegistryHelper &helper,
 					  art::SourceHelper const &pm ) :
     __sourceHelper( pm ),
-    __currentSubRunID(),
-    __eventCtr( 0 ),
-    __eventNum( 0 )
+    __currentSubRunID()
   {
     const std::string myname = "PDDPRawInputDriver::ctor: ";
     
@@ -137,6 +107,12 @@ namespace lris
     __outlbl_status  = pset.get<std::string>("OutputLabelRDStatus", "daq");
     auto vecped_crps = pset.get<std::vector<UIntVec>>("InvertBaseline", std::vector<UIntVec>());
     auto select_crps = pset.get<std::vector<unsigned>>("SelectCRPs", std::vector<unsigned>());
+    auto nthreads    = pset.get<unsigned>("UnpackThreads", 4);
+    auto readAhead   = pset.get<bool>("ReadAhead", true);
+    auto memoryMap   = pset.get<bool>("MemoryMap", false);
+    __skipEvents     = pset.get<unsigned>("SkipEvents", 0);
+    __eventList      = pset.get<std::vector<uint32_t>>("EventList", std::vector<uint32_t>());
+    std::sort( __eventList.begin(), __eventList.end() );
         
     std::map<unsigned, unsigned> invped_crps;
     if( !vecped_crps.empty() ){
@@ -158,6 +134,13 @@ namespace lris
 	std::cout << myname << "       OutputLabelRawDigits : " << __outlbl_digits << std::endl;
 	std::cout << myname << "       OutputLabelRDStatus  : " << __outlbl_status << std::endl;
 	std::cout << myname << "       OutputLabelRDtime    : " << __outlbl_rdtime << std::endl;
+	std::cout << myname << "       UnpackThreads        : " << nthreads << std::endl;
+	std::cout << myname << "       ReadAhead            : " << readAhead << std::endl;
+	std::cout << myname << "       MemoryMap            : " << memoryMap << std::endl;
+	std::cout << myname << "       SkipEvents           : " << __skipEvents << std::endl;
+	std::cout << myname << "       EventList            : ";
+	if( __eventList.empty() ) std::cout<<"all"<<std::endl;
+	else std::cout << __eventList.size() << " events" << std::endl;
 	std::cout << myname << "       SelectCRPs           : ";
 	if( select_crps.empty() ) std::cout<<"all"<<std::endl;
 	else
@@ -197,6 +180,10 @@ namespace lris
 
     // could also use pset if more parametres are needed (e.g., for LRO data)
     
+    //
+    __pool.reset( new UnpackPool( std::max( nthreads, 1u ) ) );
+    __recfile.reset( new DaqRecordFile( readAhead, memoryMap ) );
+
     //
     // channel map order by CRP View 
     auto cmap = &*(art::ServiceHandle<dune::PDDPChannelMap>());
@@ -235,7 +222,11 @@ namespace lris
 	  {
 	    __daqch.push_back( id.seqn() );
 	    __keepch.push_back( keep );
-	    __invped.push_back( invped );
+	    if( keep && invped > 0 )
+	      {
+		if( __invped.size() <= id.seqn() ) __invped.resize( id.seqn() + 1, 0 );
+		__invped[ id.seqn() ] = invped;
+	      }
 	  }
       }
     
@@ -260,33 +251,46 @@ namespace lris
   {
     __close();
     
-    __eventCtr = 0;
-    __eventNum = 0;
-    
     fb = new art::FileBlock(art::FileFormatVersion(1, "DPPD RawInput 2019"), name);
     
     //
-    __file.open( name.c_str(), std::ios::in | std::ios::binary | std::ios::ate);
-
-    if( !__file.is_open() )
+    if( !__recfile->open( name ) )
       {
 	throw art::Exception( art::errors::FileOpenError )
-	  << "Error opening binary file " << name << std::endl;
+	  << __recfile->message() << std::endl;
       }
-    
-    // get file size
-    __filesz = __file.tellg();
-  
-    // move to beginning
-    __file.seekg(0, std::ios::beg);
   
     // unpack event table
-    if( __unpack_evtable() == 0 )
+    if( !__recfile->readTable() )
       {
+	mf::LogError(__FUNCTION__)<<__recfile->message();
 	__close();
 	throw art::Exception( art::errors::FileReadError )
 	  << "File " << name << " does not have any events"<< std::endl;
       }
+    if( !__recfile->message().empty() )
+      mf::LogError(__FUNCTION__)<<__recfile->message();
+    mf::LogInfo(__FUNCTION__)<<"Number of events in this file "<<__recfile->size();
+
+    // map the file to take the events directly from memory
+    if( !__recfile->map( __eventList.empty() ) )
+      {
+	std::string msg = __recfile->message();
+	__close();
+	throw art::Exception( art::errors::FileOpenError )
+	  << msg << std::endl;
+      }
+
+    // records to read; the event number is taken from the header of the first fragment
+    __recfile->select( __skipEvents, __eventList, evinfoSz,
+		       [this]( const BYTE *hdr, uint32_t &evnum ) {
+			 eveinfo_t ei;
+			 if( __unpack_eve_info( hdr, ei ) == 0 ) return false;
+			 evnum = ei.evnum;
+			 return true;
+		       } );
+    if( __skipEvents > 0 || !__eventList.empty() )
+      mf::LogInfo(__FUNCTION__)<<"Selected "<<__recfile->nselected()<<" of "<<__recfile->size()<<" events";
 
     __currentSubRunID = art::SubRunID();
     __file_seqno      = __get_file_seqno( name );
@@ -300,28 +304,22 @@ namespace lris
 				      art::SubRunPrincipal* &outSR,
 				      art::EventPrincipal* &outE )
   {
-    mf::LogInfo(__FUNCTION__)<<"Processing "<<__eventCtr<<" event record";
-    if( __eventCtr == __eventNum ) 
+    mf::LogInfo(__FUNCTION__)<<"Processing "<<__recfile->nread()<<" event record";
+
+    // take the next selected event from the memory map, the read-ahead
+    // buffer or the file; the one after it is fetched while this one is unpacked
+    const BYTE *evbytes;
+    size_t      evnb;
+    if( !__recfile->next( evbytes, evnb ) )
       {
 	//ok we finished
-	mf::LogDebug(__FUNCTION__)<<"Finished reading "<<__eventNum<<" events";
+	mf::LogDebug(__FUNCTION__)<<"Finished reading "<<__recfile->nselected()<<" events";
 	return false;
       }
     
-    // move to the next file position
-    if( __events[ __eventCtr ] != __file.tellg() )
-      __file.seekg( __events[ __eventCtr ], std::ios::beg );
-    size_t bsz = __evsz[ __eventCtr ];
-    
-    std::vector<BYTE> buf;
-    __readChunk( buf, bsz );
-    
-    // increment our event counter
-    __eventCtr++;
-    
     DaqEvent event;
     //bool ok = 
-    __unpackEvent( buf, event );
+    __unpackEvent( evbytes, evnb, event );
     // not sure what art wants me to do here if this was not ok ???
     
     art::RunNumber_t rn     = event.runnum;
@@ -379,13 +377,7 @@ namespace lris
 	raw::ChannelID_t ch = i; //daqch; 
 	// raw digit 
 	if( __keepch[i] ){
-	  unsigned invped = __invped[i];
-	  if( invped > 0 ){
-	    for( auto &e : event.crodata[daqch] ){
-	      float v = (float)invped - e;
-	      e = (short)(v);
-	    }
-	  }
+	  // the baseline inversion was done when the data were unpacked
 	  cro_data->push_back( raw::RawDigit(ch, __nsacro, 
 					     std::move( event.crodata[daqch] ), 
 					     event.compression) );
@@ -444,107 +436,7 @@ namespace lris
   ///
   void PDDPRawInputDriver::__close()
   {
-    if(__file.is_open())
-      __file.close();  
-  
-    __filesz = 0;
-  }
-
-  //
-  // read a chunk of bytes from file
-  void PDDPRawInputDriver::__readChunk( std::vector<BYTE> &bytes, size_t sz )
-  {
-    bytes.resize( sz );
-    __file.read( &bytes[0], sz );
-    if( !__file )
-      {
-	ssize_t nb = __file.gcount();
-	//mf::LogWarning(__FUNCTION__)
-	//<<"Could not read "<<sz<" bytes "<<" only "<<nb<<" were available"<<endl;
-	bytes.resize( nb );
-	// reset stream state from errors
-	__file.clear();
-      }
-  }
-
-  //
-  // unpack the header with event table
-  unsigned PDDPRawInputDriver::__unpack_evtable()
-  {
-    unsigned rval = 0;
-    //__eventNum    = 0; 
-  
-    std::vector<BYTE> buf;
-    size_t msz = 2*sizeof(uint32_t);
-    __readChunk( buf, msz);
-    if( buf.size() != msz )
-      {
-	mf::LogError(__FUNCTION__)<<"Could not read number of events";
-	return 0;
-      }
-  
-    
-    // number of events in the file
-    __eventNum = ConvertToValue<uint32_t>(&buf[4]);
-    rval += buf.size();
-    
-    // file 
-    if( __eventNum == 0 )
-      {
-	mf::LogError(__FUNCTION__)<<"File does not contain any events";
-	return 0;
-      }
-
-    mf::LogInfo(__FUNCTION__)<<"Number of events in this file "<<__eventNum;
-    
-    size_t evtsz = __eventNum * 4 * sizeof(uint32_t);
-    if(  evtsz + rval >= __filesz )
-      {
-	mf::LogError(__FUNCTION__)<<"Cannot find event table";
-	return 0;
-      }
-
-    // read next chunk with event table info
-    __readChunk( buf, evtsz );
-    rval += buf.size();
-  
-    // unpack sizes of events in sequence
-    // we are only interested in the size here
-    __evsz.clear();
-    for( unsigned i=0;i<buf.size();i+=16 )
-      {
-	unsigned o = 0;
-	//uint32_t sn = ConvertToValue<uint32_t>(&buf[i+o]);
-	
-	o = 4;
-	uint32_t sz = ConvertToValue<uint32_t>(&buf[i+o]);
-	__evsz.push_back( sz );
-      }
-
-    // generate table of positions of events in a file
-    __events.clear();
-  
-    // first event is at the current position
-    __events.push_back( __file.tellg() );
-    for(size_t i=0; i < __evsz.size()-1; i++)
-      {
-	__file.seekg( __evsz[i], std::ios::cur );
-	if( !__file )
-	  {
-	    mf::LogError(__FUNCTION__)<<"Event table does not match file size";
-	    __file.clear();
-	    __evsz.resize( __events.size() );
-	    __eventNum = __events.size();
-	    break;
-	  }
-	__events.push_back( __file.tellg() );
-      }
-  
-    //for( auto e : __events ) std::cout<<e<<"\n";
-    //for( auto e : __evsz ) std::cout<<e<<"\n";
-  
-    // return the number of bytes unpacked
-    return rval;
+    __recfile->close();
   }
 
   //
@@ -605,22 +497,32 @@ namespace lris
   
   //
   //
-  bool PDDPRawInputDriver::__unpackEvent( std::vector<BYTE> &buf, DaqEvent &event )
+  bool PDDPRawInputDriver::__unpackEvent( const BYTE *buf, size_t nb, DaqEvent &event )
   {
     // fragments from each L1 builder
     std::vector<fragment_t> frags;
   
-    unsigned idx = 0;
+    size_t idx = 0;
     for(;;)
       {
 	fragment_t afrag;
-	if( idx >= buf.size() ) break;
-	unsigned rval = __unpack_eve_info( &buf[idx], afrag.ei );
+	if( idx >= nb ) break;
+	if( idx + evinfoSz > nb )
+	  {
+	    mf::LogError(__FUNCTION__)<<"Truncated event fragment header";
+	    break;
+	  }
+	unsigned rval = __unpack_eve_info( buf + idx, afrag.ei );
 	if( rval == 0 ) return false;
 	idx += rval;
 	// set point to the binary data
-	afrag.bytes = &buf[idx];
+	afrag.bytes = buf + idx;
 	size_t dsz = afrag.ei.evszcro + afrag.ei.evszlro;
+	if( idx + dsz > nb )
+	  {
+	    mf::LogError(__FUNCTION__)<<"Event fragment data exceed the event size";
+	    break;
+	  }
 	idx += dsz;
 	idx += 1; // "Bruno byte"
       
@@ -646,28 +548,31 @@ namespace lris
       }
   
     //mf::LogDebug(__FUNCTION__)<<"number of fragments "<<frags.size()<<"\n";
-    // 
-    std::mutex iomutex;
-    std::vector<std::thread> threads(frags.size() - 1);
+    if( frags.empty() ) return false;
+
+    // unpack CRO data of all fragments with the worker threads
     unsigned nsa    = __nsacro;
-    //unsigned invped = __invped;
-    for (unsigned i = 1; i<frags.size(); ++i) 
+    // first channel of each fragment in the event for the baseline inversion
+    std::vector<size_t> choffset( frags.size(), 0 );
+    size_t nch = 0;
+    for( size_t i = 0; i < frags.size(); ++i )
       {
-	auto afrag = frags.begin() + i;
-	threads[i-1] = std::thread([&iomutex, i, nsa, afrag] {
-	    {
-	      std::lock_guard<std::mutex> iolock(iomutex);
-	      // make it look like we're using i so clang doesn't complain.  This had been commented out
-	      //msg_info << "Unpack thread #" << i << " is running\n";
-	      if (i==100000) std::cout << "Unpack thread #" << i << " is running\n";
-	    }
-	    //unpackLROData( f0->bytes, f0->ei.evszlro, ... );
-	    unpackCroData( afrag->bytes + afrag->ei.evszlro, afrag->ei.evszcro, 
-			   GETDCFLAG(afrag->ei.runflags), nsa, afrag->crodata);
-	  });
+	choffset[i] = nch;
+	if( !GETDCFLAG(frags[i].ei.runflags) )
+	  nch += lris::adc12::nchannels( frags[i].ei.evszcro, nsa );
       }
+    const std::vector<uint16_t> &invped = __invped;
+    __pool->run( frags.size(), [&frags, &choffset, &invped, nsa]( size_t i ) {
+	auto afrag = frags.begin() + i;
+	size_t off  = choffset[i];
+	size_t nped = off < invped.size() ? invped.size() - off : 0;
+	const uint16_t *ped = nped > 0 ? invped.data() + off : nullptr;
+	//unpackLROData( afrag->bytes, afrag->ei.evszlro, ... );
+	unpackCroData( afrag->bytes + afrag->ei.evszlro, afrag->ei.evszcro, 
+		       GETDCFLAG(afrag->ei.runflags), nsa, afrag->crodata, ped, nped );
+      });
   
-    // unpack first fragment in the main thread
+    // event info from the first fragment
     auto f0 = frags.begin();
     event.good      = EVDQFLAG( f0->ei.evflag );
     event.runnum    = f0->ei.runnum;
@@ -680,9 +585,7 @@ namespace lris
     event.trignum   = f0->ei.ti.num;
     event.trigstamp = f0->ei.ti.ts;
   
-    //unpackLROData( f0->bytes, f0->ei.evszlro, ... );
-    unpackCroData( f0->bytes + f0->ei.evszlro, f0->ei.evszcro, GETDCFLAG(f0->ei.runflags),
-		   nsa, event.crodata );
+    event.crodata   = std::move( f0->crodata );
     
     event.compression = raw::kNone;
     // the compression should be set for all L1 event builders, 
@@ -690,9 +593,6 @@ namespace lris
     if( GETDCFLAG(f0->ei.runflags) ) 
       event.compression = raw::kHuffman;
   
-    // wait for other threads to complete
-    for (auto& t : threads) t.join();
-  
     // merge with other fragments
     for (auto it = frags.begin() + 1; it != frags.end(); ++it )
       {
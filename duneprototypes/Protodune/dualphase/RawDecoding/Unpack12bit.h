@@ -0,0 +1,202 @@
+/*
+    Unpacker for the 12-bit ADC data of the dual-phase style readout
+    (PDDP CRO data, VD coldbox TDE data)
+
+    The uncompressed data are channel-major: nsa samples of the first
+    channel, then the next channel, and so on. Samples are packed in pairs
+    into 3 bytes, most significant bits first:
+
+      byte 0 : a[11:4]
+      byte 1 : a[3:0] b[11:8]
+      byte 2 : b[7:0]
+
+    unpackChannels() writes each channel straight into its own vector.
+    The baseline inversion used for the inverted signal polarity
+    (adc -> invped - adc) can be applied on the fly.
+
+    Three kernels are provided: a portable scalar one, an SSSE3 one
+    (12 bytes -> 8 samples) and an AVX2 one (24 bytes -> 16 samples). The
+    vector kernels use function-level target attributes so the library
+    does not have to be built with -mavx2; the best kernel supported by the
+    running CPU is selected at first use. All kernels give the same result.
+
+ */
+#ifndef __UNPACK12BIT_H__
+#define __UNPACK12BIT_H__
+
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+
+#if defined(__x86_64__) && defined(__GNUC__)
+#define UNPACK12BIT_X86 1
+#include <immintrin.h>
+#endif
+
+namespace lris
+{
+  namespace adc12
+  {
+    enum class Kernel { Auto, Scalar, SSSE3, AVX2 };
+
+    // unpack npair sample pairs from in (3 bytes each) into out[0 .. 2*npair)
+    // if invped > 0 the stored value is invped - adc
+    typedef void (*PairKernel)( const uint8_t *in, size_t npair, int16_t *out, uint16_t invped );
+
+    inline void unpackPairsScalar( const uint8_t *in, size_t npair, int16_t *out, uint16_t invped )
+    {
+      for( size_t i = 0; i < npair; ++i, in += 3 )
+	{
+	  uint16_t a = ( (in[0] << 4) | (in[1] >> 4) ) & 0xfff;
+	  uint16_t b = ( ((in[1] & 0xf) << 8) | in[2] ) & 0xfff;
+	  if( invped > 0 )
+	    {
+	      a = invped - a;
+	      b = invped - b;
+	    }
+	  *out++ = (int16_t)a;
+	  *out++ = (int16_t)b;
+	}
+    }
+
+#ifdef UNPACK12BIT_X86
+
+    // Each 16-bit lane receives the two bytes holding its sample in
+    // big-endian order: even lanes need a shift right by 4, odd lanes
+    // a mask of the upper 4 bits.
+    __attribute__((target("ssse3")))
+    inline __m128i unpack8SSSE3( __m128i v, __m128i ped, bool inv )
+    {
+      const __m128i shuf  = _mm_setr_epi8( 1,0, 2,1, 4,3, 5,4, 7,6, 8,7, 10,9, 11,10 );
+      const __m128i meven = _mm_setr_epi16( -1, 0, -1, 0, -1, 0, -1, 0 );
+      const __m128i modd  = _mm_setr_epi16( 0, 0xfff, 0, 0xfff, 0, 0xfff, 0, 0xfff );
+      v = _mm_shuffle_epi8( v, shuf );
+      v = _mm_or_si128( _mm_and_si128( _mm_srli_epi16( v, 4 ), meven ),
+			_mm_and_si128( v, modd ) );
+      return inv ? _mm_sub_epi16( ped, v ) : v;
+    }
+
+    // 4 pairs per step; each load reads 16 bytes for the 12 used
+    __attribute__((target("ssse3")))
+    inline void unpackPairsSSSE3( const uint8_t *in, size_t npair, int16_t *out, uint16_t invped )
+    {
+      const __m128i ped = _mm_set1_epi16( invped );
+      const bool    inv = invped > 0;
+      size_t i = 0;
+      for( ; i + 6 <= npair; i += 4, in += 12, out += 8 )
+	{
+	  __m128i v = _mm_loadu_si128( reinterpret_cast<const __m128i*>(in) );
+	  _mm_storeu_si128( reinterpret_cast<__m128i*>(out), unpack8SSSE3( v, ped, inv ) );
+	}
+      unpackPairsScalar( in, npair - i, out, invped );
+    }
+
+    // 8 pairs per step: 24 bytes are split over the two 128-bit lanes
+    __attribute__((target("avx2")))
+    inline void unpackPairsAVX2( const uint8_t *in, size_t npair, int16_t *out, uint16_t invped )
+    {
+      const __m256i shuf  = _mm256_setr_epi8( 1,0, 2,1, 4,3, 5,4, 7,6, 8,7, 10,9, 11,10,
+					      1,0, 2,1, 4,3, 5,4, 7,6, 8,7, 10,9, 11,10 );
+      const __m256i meven = _mm256_set1_epi32( 0x0000ffff );
+      const __m256i modd  = _mm256_set1_epi32( 0x0fff0000 );
+      const __m256i ped   = _mm256_set1_epi16( invped );
+      const bool    inv   = invped > 0;
+      size_t i = 0;
+      // the upper load reads 4 bytes past the 24 used
+      for( ; i + 10 <= npair; i += 8, in += 24, out += 16 )
+	{
+	  __m256i v = _mm256_castsi128_si256( _mm_loadu_si128( reinterpret_cast<const __m128i*>(in) ) );
+	  v = _mm256_inserti128_si256( v, _mm_loadu_si128( reinterpret_cast<const __m128i*>(in + 12) ), 1 );
+	  v = _mm256_shuffle_epi8( v, shuf );
+	  v = _mm256_or_si256( _mm256_and_si256( _mm256_srli_epi16( v, 4 ), meven ),
+			       _mm256_and_si256( v, modd ) );
+	  if( inv ) v = _mm256_sub_epi16( ped, v );
+	  _mm256_storeu_si256( reinterpret_cast<__m256i*>(out), v );
+	}
+      unpackPairsSSSE3( in, npair - i, out, invped );
+    }
+
+#endif
+
+    // kernel for the requested implementation; Auto (and any kernel not
+    // supported by this CPU) resolves to the best available one
+    inline PairKernel pairKernel( Kernel ker = Kernel::Auto )
+    {
+#ifdef UNPACK12BIT_X86
+      static const bool haveAVX2  = __builtin_cpu_supports("avx2");
+      static const bool haveSSSE3 = __builtin_cpu_supports("ssse3");
+      if( ker == Kernel::Scalar ) return unpackPairsScalar;
+      if( ker == Kernel::SSSE3 && haveSSSE3 ) return unpackPairsSSSE3;
+      if( haveAVX2 && ker != Kernel::SSSE3 ) return unpackPairsAVX2;
+      if( haveSSSE3 ) return unpackPairsSSSE3;
+#endif
+      (void) ker;
+      return unpackPairsScalar;
+    }
+
+    // number of channels made from nb bytes: a partly filled last channel
+    // counts, and there is always at least one
+    inline size_t nchannels( size_t nb, unsigned nsa )
+    {
+      if( nsa == 0 ) return 0;
+      size_t nsamp = 2 * ( nb / 3 );
+      return nsamp <= nsa ? 1 : ( nsamp + nsa - 1 ) / nsa;
+    }
+
+    // unpack samples [s0, s0 + n) of the packed stream into out
+    inline void unpackSamples( const uint8_t *in, size_t s0, size_t n, int16_t *out,
+			       uint16_t invped, PairKernel kernel )
+    {
+      if( n == 0 ) return;
+      int16_t pair[2];
+      const uint8_t *p = in + 3 * ( s0 / 2 );
+      // odd start: second sample of a pair
+      if( s0 % 2 )
+	{
+	  unpackPairsScalar( p, 1, pair, invped );
+	  *out++ = pair[1];
+	  p += 3;
+	  --n;
+	}
+      kernel( p, n / 2, out, invped );
+      // odd end: first sample of a pair
+      if( n % 2 )
+	{
+	  unpackPairsScalar( p + 3 * ( n / 2 ), 1, pair, invped );
+	  out[n - 1] = pair[0];
+	}
+    }
+
+    // Append nchannels(nb, nsa) vectors of nsa samples to data. The samples
+    // missing from the last channel are 0 before the inversion.
+    // invped[ich] (for ich < ninvped) is the baseline for the inversion of
+    // the ich-th new channel, 0 for none.
+    template<class ADCVector>
+    void unpackChannels( const void *buf, size_t nb, unsigned nsa,
+			 std::vector<ADCVector> &data,
+			 const uint16_t *invped = nullptr, size_t ninvped = 0,
+			 Kernel ker = Kernel::Auto )
+    {
+      const uint8_t *in  = static_cast<const uint8_t*>( buf );
+      PairKernel kernel  = pairKernel( ker );
+      size_t nsamp       = 2 * ( nb / 3 );
+      size_t nch         = nchannels( nb, nsa );
+      data.reserve( data.size() + nch );
+      for( size_t ich = 0; ich < nch; ++ich )
+	{
+	  data.emplace_back( nsa );
+	  size_t s0 = ich * nsa;
+	  size_t n  = nsamp > s0 ? nsamp - s0 : 0;
+	  if( n > nsa ) n = nsa;
+	  uint16_t ped = ( invped && ich < ninvped ) ? invped[ich] : 0;
+	  int16_t *out = reinterpret_cast<int16_t*>( data.back().data() );
+	  unpackSamples( in, s0, n, out, ped, kernel );
+	  // the padding is inverted as well
+	  if( ped > 0 )
+	    for( size_t i = n; i < nsa; ++i ) out[i] = (int16_t)ped;
+	}
+    }
+  }
+}
+
+#endif
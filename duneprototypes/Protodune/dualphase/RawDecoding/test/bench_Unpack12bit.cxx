@@ -0,0 +1,118 @@
+// bench_Unpack12bit.cxx
+//
+// Measure the throughput of the 12-bit ADC unpacker kernels against the
+// original byte-by-byte loop for a block of channels. Rates are in GB/s of
+// packed input. The full unpack includes allocating the channel vectors.
+//
+// Usage: bench_Unpack12bit [NCH [NSAMPLE [NREP]]]
+
+#include <string>
+#include <iostream>
+#include <random>
+#include <vector>
+#include <chrono>
+#include "duneprototypes/Protodune/dualphase/RawDecoding/Unpack12bit.h"
+
+using std::string;
+using std::cout;
+using std::endl;
+using std::vector;
+using Clock = std::chrono::steady_clock;
+using lris::adc12::Kernel;
+using ADCVector = vector<short>;
+
+//**********************************************************************
+
+namespace {
+
+// The loop from unpackCroData.
+void unpackLegacy(const char* buf, size_t nb, unsigned nsa, vector<ADCVector>& data) {
+  data.push_back(ADCVector(nsa));
+  size_t sz = 0;
+  const char* start = buf;
+  const char* stop  = start + nb;
+  while ( start != stop ) {
+    char v1 = *start++;
+    char v2 = *start++;
+    char v3 = *start++;
+    uint16_t tmp1 = ((v1 << 4) + ((v2 >> 4) & 0xf)) & 0xfff;
+    uint16_t tmp2 = (((v2 & 0xf) << 8 ) + (v3 & 0xff)) & 0xfff;
+    if ( sz == nsa ) { data.push_back(ADCVector(nsa)); sz = 0; }
+    data.back()[sz++] = (short)tmp1;
+    if ( sz == nsa ) { data.push_back(ADCVector(nsa)); sz = 0; }
+    data.back()[sz++] = (short)tmp2;
+  }
+}
+
+}  // end unnamed namespace
+
+//**********************************************************************
+
+int main(int argc, char* argv[]) {
+  const string myname = "bench_Unpack12bit: ";
+  if ( argc > 1 && string(argv[1]) == "-h" ) {
+    cout << "Usage: " << argv[0] << " [NCH [NSAMPLE [NREP]]]" << endl;
+    return 0;
+  }
+  size_t nch = argc > 1 ? std::stoi(argv[1]) : 640;
+  unsigned int nsa = argc > 2 ? std::stoi(argv[2]) : 10000;
+  unsigned int nrep = argc > 3 ? std::stoi(argv[3]) : 20;
+
+  std::mt19937 gen(12345);
+  vector<char> buf(3*((nch*nsa + 1)/2));
+  for ( char& c : buf ) c = char(gen());
+  double gb = nrep*buf.size()/1.0e9;
+  cout << myname << nch << " channels x " << nsa << " samples: "
+       << buf.size()/1.0e6 << " MB packed" << endl;
+
+  vector<ADCVector> ref;
+  Clock::time_point t0 = Clock::now();
+  for ( unsigned int irep=0; irep<nrep; ++irep ) {
+    ref.clear();
+    unpackLegacy(buf.data(), buf.size(), nsa, ref);
+  }
+  double tref = std::chrono::duration<double>(Clock::now() - t0).count();
+  cout << myname << "Legacy loop: " << gb/tref << " GB/s" << endl;
+
+  // Kernels alone, into a buffer that is already allocated.
+  vector<int16_t> flat(2*(buf.size()/3));
+  for ( Kernel ker : {Kernel::Scalar, Kernel::SSSE3, Kernel::AVX2} ) {
+    string kname = ker == Kernel::Scalar ? "Scalar" : ker == Kernel::SSSE3 ? "SSSE3 " : "AVX2  ";
+    lris::adc12::PairKernel kernel = lris::adc12::pairKernel(ker);
+    if ( ker != Kernel::Scalar && kernel == lris::adc12::pairKernel(Kernel::Scalar) ) continue;
+    Clock::time_point t1 = Clock::now();
+    for ( unsigned int irep=0; irep<nrep; ++irep ) {
+      kernel(reinterpret_cast<const uint8_t*>(buf.data()), buf.size()/3, flat.data(), 0);
+    }
+    double t = std::chrono::duration<double>(Clock::now() - t1).count();
+    cout << myname << kname << " kernel only:  " << gb/t << " GB/s" << endl;
+  }
+
+  // Full unpack into new channel vectors as done for each event.
+  vector<uint16_t> invped(nch, 4096);
+  for ( bool inv : {false, true} ) {
+    for ( Kernel ker : {Kernel::Scalar, Kernel::SSSE3, Kernel::AVX2} ) {
+      string kname = ker == Kernel::Scalar ? "Scalar" : ker == Kernel::SSSE3 ? "SSSE3 " : "AVX2  ";
+      if ( lris::adc12::pairKernel(ker) != lris::adc12::pairKernel(Kernel::Scalar) ||
+           ker == Kernel::Scalar ) {
+        vector<ADCVector> data;
+        Clock::time_point t1 = Clock::now();
+        for ( unsigned int irep=0; irep<nrep; ++irep ) {
+          data.clear();
+          lris::adc12::unpackChannels(buf.data(), buf.size(), nsa, data,
+                                      inv ? invped.data() : nullptr, invped.size(), ker);
+        }
+        double t = std::chrono::duration<double>(Clock::now() - t1).count();
+        if ( !inv && data != ref ) {
+          cout << myname << "ERROR: " << kname << " result differs from the legacy loop." << endl;
+          return 1;
+        }
+        cout << myname << kname << (inv ? " + inversion:  " : ":              ") << gb/t << " GB/s"
+             << " (x" << tref/t << ")" << endl;
+      }
+    }
+  }
+  return 0;
+}
+
+//**********************************************************************
@@ -0,0 +1,290 @@
+// test_DaqReadEngine.cxx
+//
+// Tests for the unpack thread pool, the event read-ahead, the memory
+// map and the record file used by the dual-phase raw input sources.
+
+#include <string>
+#include <iostream>
+#include <fstream>
+#include <vector>
+#include <atomic>
+#include <stdexcept>
+#include <cstdio>
+#include <cstring>
+#include "duneprototypes/Protodune/dualphase/RawDecoding/DaqReadEngine.h"
+
+#undef NDEBUG
+#include <cassert>
+
+using std::string;
+using std::cout;
+using std::endl;
+using std::vector;
+using lris::UnpackPool;
+using lris::EventReadAhead;
+
+//**********************************************************************
+
+int test_DaqReadEngine(unsigned int nevt) {
+  const string myname = "test_DaqReadEngine: ";
+#ifdef NDEBUG
+  cout << myname << "NDEBUG must be off." << endl;
+  abort();
+#endif
+  string line = "-----------------------------";
+
+  cout << myname << line << endl;
+  cout << myname << "Checking the thread pool." << endl;
+  for ( unsigned int nthr : {1, 2, 4, 7} ) {
+    UnpackPool pool(nthr);
+    assert( pool.size() == nthr );
+    for ( size_t ntask : {0, 1, 3, 8, 50} ) {
+      for ( int irep=0; irep<20; ++irep ) {
+        vector<std::atomic<int>> calls(ntask);
+        for ( auto& c : calls ) c = 0;
+        pool.run(ntask, [&calls](size_t i) { ++calls[i]; });
+        for ( auto& c : calls ) assert( c == 1 );
+      }
+    }
+    // Exceptions are passed to the caller and the pool stays usable.
+    bool caught = false;
+    try {
+      pool.run(10, [](size_t i) { if ( i == 3 ) throw std::runtime_error("task 3"); });
+    } catch ( const std::runtime_error& ) {
+      caught = true;
+    }
+    assert( caught );
+    std::atomic<int> ncall(0);
+    pool.run(10, [&ncall](size_t) { ++ncall; });
+    assert( ncall == 10 );
+  }
+
+  cout << myname << line << endl;
+  cout << myname << "Writing a file with " << nevt << " records." << endl;
+  string fname = "test_DaqReadEngine.dat";
+  vector<std::streampos> pos;
+  vector<size_t> sizes;
+  {
+    std::ofstream fout(fname, std::ios::binary);
+    for ( unsigned int ievt=0; ievt<nevt; ++ievt ) {
+      pos.push_back(fout.tellp());
+      size_t sz = 1000 + 137*ievt;
+      sizes.push_back(sz);
+      for ( size_t ibyt=0; ibyt<sz; ++ibyt ) fout.put(char((ievt + ibyt) & 0xff));
+    }
+  }
+  auto check = [&](const vector<char>& buf, unsigned int ievt) {
+    if ( buf.size() != sizes[ievt] ) return false;
+    for ( size_t ibyt=0; ibyt<buf.size(); ++ibyt ) {
+      if ( buf[ibyt] != char((ievt + ibyt) & 0xff) ) return false;
+    }
+    return true;
+  };
+
+  cout << myname << line << endl;
+  cout << myname << "Checking sequential read-ahead." << endl;
+  {
+    std::ifstream fin(fname, std::ios::binary);
+    EventReadAhead reader;
+    vector<char> buf;
+    assert( ! reader.take(0, buf) );
+    fin.seekg(pos[0]);
+    lris::readDaqChunk(fin, buf, sizes[0]);
+    assert( check(buf, 0) );
+    for ( unsigned int ievt=1; ievt<nevt; ++ievt ) {
+      reader.prefetch(fin, ievt, pos[ievt], sizes[ievt]);
+      assert( reader.take(ievt, buf) );
+      assert( check(buf, ievt) );
+      // Each record is only delivered once.
+      assert( ! reader.take(ievt, buf) );
+    }
+  }
+
+  cout << myname << line << endl;
+  cout << myname << "Checking out-of-order requests and truncated records." << endl;
+  {
+    std::ifstream fin(fname, std::ios::binary);
+    EventReadAhead reader;
+    vector<char> buf;
+    reader.prefetch(fin, 1, pos[1], sizes[1]);
+    assert( ! reader.take(2, buf) );
+    reader.prefetch(fin, 2, pos[2], sizes[2]);
+    reader.cancel();
+    assert( ! reader.take(2, buf) );
+    unsigned int ilast = nevt - 1;
+    reader.prefetch(fin, ilast, pos[ilast], sizes[ilast] + 100);
+    assert( reader.take(ilast, buf) );
+    assert( check(buf, ilast) );
+    // The stream is usable after a short read.
+    reader.prefetch(fin, 0, pos[0], sizes[0]);
+    assert( reader.take(0, buf) );
+    assert( check(buf, 0) );
+    // Destroy with a read in flight.
+    reader.prefetch(fin, 1, pos[1], sizes[1]);
+  }
+
+  cout << myname << line << endl;
+  cout << myname << "Checking the memory map." << endl;
+  {
+    lris::MappedDaqFile map;
+    assert( ! map.is_open() );
+    assert( ! map.open("test_DaqReadEngine_nofile.dat") );
+    assert( map.open(fname) );
+    assert( map.size() == size_t(pos.back()) + sizes.back() );
+    // Random access in reverse order.
+    for ( unsigned int ievt=nevt; ievt-->0; ) {
+      size_t sz = sizes[ievt];
+      const char* pdat = map.view(pos[ievt], sz);
+      map.willneed(pos[ievt], sz);
+      assert( check(vector<char>(pdat, pdat + sz), ievt) );
+    }
+    // Views are clamped to the file.
+    unsigned int ilast = nevt - 1;
+    size_t sz = sizes[ilast] + 100;
+    map.view(pos[ilast], sz);
+    assert( sz == sizes[ilast] );
+    sz = 10;
+    map.view(map.size() + 5, sz);
+    assert( sz == 0 );
+    map.close();
+    assert( ! map.is_open() );
+    assert( map.open(fname, false) );
+  }
+  std::remove(fname.c_str());
+
+  cout << myname << line << endl;
+  cout << myname << "Writing a raw file with an event table." << endl;
+  // Record i holds event number 1000 + 3*i in its first word.
+  string rname = "test_DaqReadEngine_raw.dat";
+  auto evnum = [](const char* hdr, uint32_t& num) { std::memcpy(&num, hdr, sizeof(num)); return num != 0; };
+  {
+    std::ofstream fout(rname, std::ios::binary);
+    auto putWord = [&fout](uint32_t word) { fout.write(reinterpret_cast<const char*>(&word), sizeof(word)); };
+    putWord(0);
+    putWord(nevt);
+    for ( unsigned int ievt=0; ievt<nevt; ++ievt ) {
+      putWord(ievt);
+      putWord(sizes[ievt]);
+      putWord(0);
+      putWord(0);
+    }
+    for ( unsigned int ievt=0; ievt<nevt; ++ievt ) {
+      vector<char> rec(sizes[ievt]);
+      for ( size_t ibyt=0; ibyt<rec.size(); ++ibyt ) rec[ibyt] = char((ievt + ibyt) & 0xff);
+      uint32_t num = 1000 + 3*ievt;
+      std::memcpy(rec.data(), &num, sizeof(num));
+      fout.write(rec.data(), rec.size());
+    }
+  }
+  auto checkRecord = [&](const char* pdat, size_t nb, unsigned int ievt) {
+    if ( nb != sizes[ievt] ) return false;
+    uint32_t num;
+    std::memcpy(&num, pdat, sizeof(num));
+    if ( num != 1000 + 3*ievt ) return false;
+    for ( size_t ibyt=sizeof(num); ibyt<nb; ++ibyt ) {
+      if ( pdat[ibyt] != char((ievt + ibyt) & 0xff) ) return false;
+    }
+    return true;
+  };
+
+  for ( int mode=0; mode<3; ++mode ) {
+    bool readahead = mode == 1;
+    bool mmap = mode == 2;
+    cout << myname << line << endl;
+    cout << myname << "Checking the record file with" << (readahead ? "" : "out") << " read-ahead and "
+         << (mmap ? "with" : "without") << " memory map." << endl;
+    lris::DaqRecordFile recfile(readahead, mmap);
+    assert( ! recfile.open("test_DaqReadEngine_nofile.dat") );
+    assert( ! recfile.message().empty() );
+    assert( recfile.open(rname) );
+    assert( recfile.readTable() );
+    assert( recfile.message().empty() );
+    assert( recfile.size() == nevt );
+    assert( recfile.map(true) );
+    // All records in order.
+    assert( recfile.select(0, {}, 4, evnum) == nevt );
+    const char* pdat = nullptr;
+    size_t nb = 0;
+    for ( unsigned int ievt=0; ievt<nevt; ++ievt ) {
+      assert( recfile.nread() == ievt );
+      assert( recfile.next(pdat, nb) );
+      assert( checkRecord(pdat, nb, ievt) );
+    }
+    assert( ! recfile.next(pdat, nb) );
+    // Skipped records, an event list and a limit.
+    vector<uint32_t> evlist;
+    for ( unsigned int ievt=0; ievt<nevt; ievt+=4 ) evlist.push_back(1000 + 3*ievt);
+    evlist.push_back(999);
+    std::sort(evlist.begin(), evlist.end());
+    size_t nsel = recfile.select(5, evlist, 4, evnum);
+    size_t nexp = 0;
+    for ( unsigned int ievt=8; ievt<nevt; ievt+=4 ) {
+      assert( recfile.next(pdat, nb) );
+      assert( checkRecord(pdat, nb, ievt) );
+      ++nexp;
+    }
+    assert( nsel == nexp );
+    assert( ! recfile.next(pdat, nb) );
+    assert( recfile.select(1, {}, 4, evnum, 3) == 3 );
+    for ( unsigned int ievt=1; ievt<4; ++ievt ) {
+      assert( recfile.next(pdat, nb) );
+      assert( checkRecord(pdat, nb, ievt) );
+    }
+    assert( ! recfile.next(pdat, nb) );
+    // Close with a prefetch in flight and reopen.
+    recfile.select(0, {}, 4, evnum);
+    assert( recfile.next(pdat, nb) );
+    recfile.close();
+    assert( recfile.size() == 0 && ! recfile.next(pdat, nb) );
+    assert( recfile.open(rname) && recfile.readTable() && recfile.map(false) );
+    assert( recfile.select(nevt - 1, {}, 4, evnum) == 1 );
+    assert( recfile.next(pdat, nb) && checkRecord(pdat, nb, nevt - 1) );
+  }
+
+  cout << myname << line << endl;
+  cout << myname << "Checking files without events." << endl;
+  {
+    std::ofstream fout(rname, std::ios::binary | std::ios::trunc);
+    uint32_t words[2] = {0, 0};
+    fout.write(reinterpret_cast<const char*>(words), sizeof(words));
+  }
+  {
+    lris::DaqRecordFile recfile(true, false);
+    assert( recfile.open(rname) );
+    assert( ! recfile.readTable() );
+    assert( recfile.message() == "File does not contain any events" );
+  }
+  {
+    std::ofstream fout(rname, std::ios::binary | std::ios::trunc);
+    uint32_t words[2] = {0, 10};
+    fout.write(reinterpret_cast<const char*>(words), sizeof(words));
+  }
+  {
+    lris::DaqRecordFile recfile(false, true);
+    assert( recfile.open(rname) );
+    assert( ! recfile.readTable() );
+    assert( recfile.message() == "Cannot find event table" );
+  }
+  std::remove(rname.c_str());
+
+  cout << myname << line << endl;
+  cout << myname << "Done." << endl;
+  return 0;
+}
+
+//**********************************************************************
+
+int main(int argc, char* argv[]) {
+  unsigned int nevt = 50;
+  if ( argc > 1 ) {
+    string sarg(argv[1]);
+    if ( sarg == "-h" ) {
+      cout << "Usage: " << argv[0] << " [NEVT]" << endl;
+      return 0;
+    }
+    nevt = std::stoi(sarg);
+  }
+  return test_DaqReadEngine(nevt);
+}
+
+//**********************************************************************
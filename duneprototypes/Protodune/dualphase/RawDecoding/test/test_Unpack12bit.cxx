@@ -0,0 +1,137 @@
+// test_Unpack12bit.cxx
+//
+// Check the 12-bit ADC unpacker against the original byte-by-byte loop
+// of the PDDP and TDE raw input sources.
+
+#include <string>
+#include <iostream>
+#include <random>
+#include <vector>
+#include "duneprototypes/Protodune/dualphase/RawDecoding/Unpack12bit.h"
+
+#undef NDEBUG
+#include <cassert>
+
+using std::string;
+using std::cout;
+using std::endl;
+using std::vector;
+using lris::adc12::Kernel;
+using ADCVector = vector<short>;
+
+//**********************************************************************
+
+namespace {
+
+// The loop from unpackCroData followed by the baseline inversion done
+// in readNext.
+void unpackReference(const char* buf, size_t nb, unsigned nsa,
+                     vector<ADCVector>& data, const vector<uint16_t>& invped) {
+  data.push_back(ADCVector(nsa));
+  size_t sz = 0;
+  const char* start = buf;
+  const char* stop  = start + 3*(nb/3);
+  while ( start != stop ) {
+    char v1 = *start++;
+    char v2 = *start++;
+    char v3 = *start++;
+    uint16_t tmp1 = ((v1 << 4) + ((v2 >> 4) & 0xf)) & 0xfff;
+    uint16_t tmp2 = (((v2 & 0xf) << 8 ) + (v3 & 0xff)) & 0xfff;
+    if ( sz == nsa ) { data.push_back(ADCVector(nsa)); sz = 0; }
+    data.back()[sz++] = (short)tmp1;
+    if ( sz == nsa ) { data.push_back(ADCVector(nsa)); sz = 0; }
+    data.back()[sz++] = (short)tmp2;
+  }
+  for ( size_t ich=0; ich<data.size() && ich<invped.size(); ++ich ) {
+    if ( invped[ich] == 0 ) continue;
+    for ( auto& e : data[ich] ) {
+      float v = (float)invped[ich] - e;
+      e = (short)(v);
+    }
+  }
+}
+
+}  // end unnamed namespace
+
+//**********************************************************************
+
+int test_Unpack12bit(unsigned int ncase) {
+  const string myname = "test_Unpack12bit: ";
+#ifdef NDEBUG
+  cout << myname << "NDEBUG must be off." << endl;
+  abort();
+#endif
+  string line = "-----------------------------";
+  std::mt19937 gen(20240612);
+
+  cout << myname << line << endl;
+  cout << myname << "Checking a known sequence." << endl;
+  {
+    // 0xabc 0x123 0xfff 0x000
+    vector<char> buf = {char(0xab), char(0xc1), char(0x23), char(0xff), char(0xf0), char(0x00)};
+    for ( Kernel ker : {Kernel::Scalar, Kernel::SSSE3, Kernel::AVX2} ) {
+      vector<ADCVector> data;
+      lris::adc12::unpackChannels(buf.data(), buf.size(), 2, data, nullptr, 0, ker);
+      assert( data.size() == 2 );
+      assert( data[0][0] == 0xabc && data[0][1] == 0x123 );
+      assert( data[1][0] == 0xfff && data[1][1] == 0x000 );
+      uint16_t ped[2] = {4096, 0};
+      data.clear();
+      lris::adc12::unpackChannels(buf.data(), buf.size(), 2, data, ped, 2, ker);
+      assert( data[0][0] == 4096 - 0xabc && data[0][1] == 4096 - 0x123 );
+      assert( data[1][0] == 0xfff && data[1][1] == 0x000 );
+    }
+  }
+
+  cout << myname << line << endl;
+  cout << myname << "Checking " << ncase << " random blocks against the reference." << endl;
+  for ( unsigned int icas=0; icas<ncase; ++icas ) {
+    unsigned int nsa = 1 + gen() % 200;
+    if ( icas % 10 == 0 ) nsa = 10000;
+    size_t nb = gen() % (3*nsa*4);
+    if ( icas % 3 ) nb -= nb % 3;
+    vector<char> buf(nb);
+    for ( char& c : buf ) c = char(gen());
+    size_t nch = lris::adc12::nchannels(nb, nsa);
+    vector<uint16_t> invped(nch);
+    if ( icas % 2 ) {
+      for ( uint16_t& p : invped ) p = (gen() % 3) ? 4096 : 0;
+    }
+    vector<ADCVector> ref;
+    unpackReference(buf.data(), nb, nsa, ref, invped);
+    assert( ref.size() == nch );
+    for ( Kernel ker : {Kernel::Scalar, Kernel::SSSE3, Kernel::AVX2, Kernel::Auto} ) {
+      // Channels are appended to what is there.
+      vector<ADCVector> data(1, ADCVector(3, 7));
+      lris::adc12::unpackChannels(buf.data(), nb, nsa, data, invped.data(), invped.size(), ker);
+      bool ok = data.size() == nch + 1 && data[0] == ADCVector(3, 7);
+      for ( size_t ich=0; ok && ich<nch; ++ich ) ok = data[ich+1] == ref[ich];
+      if ( ! ok ) {
+        cout << myname << "Mismatch for case " << icas << ": nsa=" << nsa << " nb=" << nb
+             << " kernel=" << int(ker) << endl;
+        assert( false );
+      }
+    }
+  }
+
+  cout << myname << line << endl;
+  cout << myname << "Done." << endl;
+  return 0;
+}
+
+//**********************************************************************
+
+int main(int argc, char* argv[]) {
+  unsigned int ncase = 1000;
+  if ( argc > 1 ) {
+    string sarg(argv[1]);
+    if ( sarg == "-h" ) {
+      cout << "Usage: " << argv[0] << " [NCASE]" << endl;
+      return 0;
+    }
+    ncase = std::stoi(sarg);
+  }
+  return test_Unpack12bit(ncase);
+}
+
+//**********************************************************************
@@ -0,0 +1,319 @@
+///////////////////////////////////////////////////////////////////////////////////////////////////
+// File:        ChannelMapCache.h
+//
+// Binary cache for the whitespace-separated text channel map files
+// (PD2HDChannelMap_*.txt, DAPHNE_*ChannelMap*.txt, vdcbce_chanmap_*.txt).
+//
+// The text files are tables with one channel per line.  Parsing them with a
+// stringstream per line is the dominant cost of building a channel map at job
+// start.  A cache file holds the same table already tokenized:
+//
+//   Header        magic, format version, table shape, source file stamp,
+//                 checksums
+//   int32_t       cells[nrows*ncols]   row-major; string columns hold an index
+//                                      into the string table
+//   uint32_t      stroffsets[nstrings+1]
+//   char          strings[strsize]     interned strings, not null-terminated
+//
+// The cache is mapped read-only with mmap and used in place.  It is rejected
+// (and the caller falls back to the text file) if the magic, version, shape or
+// file size do not match, or if the text file being replaced is not the one
+// the cache was made from.  The latter is decided from the size and
+// modification time of the text file; only if the size matches but the time
+// does not (e.g. the file was copied without keeping its time stamp) is the
+// text read and compared with the checksum recorded in the cache.
+//
+// The payload checksum is not checked when a job opens the cache.  It is
+// checked by MappedTable::verify, which makeChannelMapCache runs on every
+// cache it writes and on existing caches with its -c option.
+//
+// The cache for map file X is X.bin in the same directory.  Caches are made
+// with the makeChannelMapCache executable, which is run on every map file at
+// build time.
+///////////////////////////////////////////////////////////////////////////////////////////////////
+
+#ifndef ChannelMapCache_H
+#define ChannelMapCache_H
+
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <map>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace dune {
+namespace chanmapcache {
+
+  constexpr char kMagic[8] = {'D','U','N','E','C','M','A','P'};
+  constexpr uint32_t kVersion = 2;
+
+  struct Header {
+    char magic[8];
+    uint32_t version;
+    uint32_t ncols;
+    uint32_t nrows;
+    uint32_t strColMask;        // bit i set if column i holds strings
+    uint32_t nstrings;
+    uint32_t strsize;
+    uint64_t sourceSize;        // size of the text file the cache was made from
+    int64_t sourceMtime;        // modification time of that text file [ns]
+    uint64_t sourceChecksum;    // checksum of that text file
+    uint64_t payloadChecksum;   // checksum of everything after the header
+  };
+
+  // 64-bit FNV-1a
+  inline uint64_t checksum(const void* data, size_t size, uint64_t hash = 14695981039346656037ull) {
+    const unsigned char* p = static_cast<const unsigned char*>(data);
+    for (size_t i = 0; i < size; ++i) {
+      hash ^= p[i];
+      hash *= 1099511628211ull;
+    }
+    return hash;
+  }
+
+  inline std::string cacheFileName(const std::string& textname) { return textname + ".bin"; }
+
+  inline int64_t mtimeNs(const struct stat& st) {
+    return int64_t(st.st_mtim.tv_sec)*1000000000 + st.st_mtim.tv_nsec;
+  }
+
+  inline bool readFile(const std::string& fname, std::string& contents) {
+    std::ifstream in(fname, std::ios::in | std::ios::binary);
+    if (!in) return false;
+    std::ostringstream ss;
+    ss << in.rdbuf();
+    contents = ss.str();
+    return true;
+  }
+
+  // Read just the header of a cache file, e.g. to find its table layout.
+  inline bool readHeader(const std::string& cachename, Header& hdr) {
+    std::ifstream in(cachename, std::ios::in | std::ios::binary);
+    return in && in.read(reinterpret_cast<char*>(&hdr), sizeof(hdr)) &&
+           std::memcmp(hdr.magic, kMagic, sizeof(kMagic)) == 0;
+  }
+
+  // Read-only view of a cache file mapped into memory.
+
+  class MappedTable {
+
+  public:
+
+    MappedTable() = default;
+    MappedTable(const MappedTable&) = delete;
+    MappedTable& operator=(const MappedTable&) = delete;
+    ~MappedTable() { close(); }
+
+    // Map cachename and validate it.  The table must have ncols columns with
+    // string columns given by strColMask.  If textname is not empty, the cache
+    // must have been made from a file with the same contents.  The payload
+    // checksum is not checked; see verify.
+    // Returns false, with the reason in err, if the cache cannot be used.
+    bool open(const std::string& cachename, const std::string& textname,
+              uint32_t ncols, uint32_t strColMask, std::string& err) {
+      close();
+      int fd = ::open(cachename.c_str(), O_RDONLY);
+      if (fd < 0) { err = "cannot open " + cachename; return false; }
+      struct stat st;
+      if (fstat(fd, &st) != 0 || size_t(st.st_size) < sizeof(Header)) {
+        ::close(fd);
+        err = "cache file too small";
+        return false;
+      }
+      m_size = st.st_size;
+      void* addr = mmap(nullptr, m_size, PROT_READ, MAP_PRIVATE, fd, 0);
+      ::close(fd);
+      if (addr == MAP_FAILED) { m_size = 0; err = "mmap failed"; return false; }
+      m_base = static_cast<const char*>(addr);
+
+      const Header& hdr = header();
+      if (std::memcmp(hdr.magic, kMagic, sizeof(kMagic)) != 0) return fail("bad magic", err);
+      if (hdr.version != kVersion) return fail("unsupported cache version", err);
+      if (hdr.ncols != ncols || hdr.strColMask != strColMask) return fail("unexpected table layout", err);
+      size_t expected = sizeof(Header) + sizeof(int32_t)*size_t(hdr.nrows)*hdr.ncols
+                        + sizeof(uint32_t)*(size_t(hdr.nstrings) + 1) + hdr.strsize;
+      if (m_size != expected) return fail("cache file size mismatch", err);
+      struct stat tst;
+      if (!textname.empty() && stat(textname.c_str(), &tst) == 0) {
+        if (uint64_t(tst.st_size) != hdr.sourceSize) {
+          return fail("cache is stale with respect to " + textname, err);
+        }
+        std::string text;
+        if (mtimeNs(tst) != hdr.sourceMtime && readFile(textname, text) &&
+            checksum(text.data(), text.size()) != hdr.sourceChecksum) {
+          return fail("cache is stale with respect to " + textname, err);
+        }
+      }
+      m_cells = reinterpret_cast<const int32_t*>(m_base + sizeof(Header));
+      m_stroffs = reinterpret_cast<const uint32_t*>(m_cells + size_t(hdr.nrows)*hdr.ncols);
+      m_strings = reinterpret_cast<const char*>(m_stroffs + hdr.nstrings + 1);
+      for (uint32_t istr = 0; istr < hdr.nstrings; ++istr) {
+        if (m_stroffs[istr] > m_stroffs[istr+1] || m_stroffs[istr+1] > hdr.strsize) {
+          return fail("corrupt string table", err);
+        }
+      }
+      for (size_t icel = 0; icel < size_t(hdr.nrows)*hdr.ncols; ++icel) {
+        if (isString(icel % hdr.ncols) && uint32_t(m_cells[icel]) >= hdr.nstrings) {
+          return fail("corrupt string index", err);
+        }
+      }
+      return true;
+    }
+
+    // Check the payload checksum of an open cache.  This reads the whole file,
+    // so it is left to makeChannelMapCache rather than done on every open.
+    bool verify(std::string& err) const {
+      if (!isOpen()) { err = "cache is not open"; return false; }
+      if (checksum(m_base + sizeof(Header), m_size - sizeof(Header)) != header().payloadChecksum) {
+        err = "payload checksum mismatch";
+        return false;
+      }
+      return true;
+    }
+
+    void close() {
+      if (m_base != nullptr) munmap(const_cast<char*>(m_base), m_size);
+      m_base = nullptr;
+      m_size = 0;
+    }
+
+    bool isOpen() const { return m_base != nullptr; }
+    uint32_t nrows() const { return header().nrows; }
+    uint32_t ncols() const { return header().ncols; }
+    bool isString(uint32_t icol) const { return (header().strColMask >> icol) & 1; }
+
+    int32_t value(uint32_t irow, uint32_t icol) const { return m_cells[size_t(irow)*ncols() + icol]; }
+
+    std::string_view str(uint32_t irow, uint32_t icol) const {
+      uint32_t istr = value(irow, icol);
+      return std::string_view(m_strings + m_stroffs[istr], m_stroffs[istr+1] - m_stroffs[istr]);
+    }
+
+  private:
+
+    const Header& header() const { return *reinterpret_cast<const Header*>(m_base); }
+
+    bool fail(const std::string& msg, std::string& err) {
+      err = msg;
+      close();
+      return false;
+    }
+
+    const char* m_base = nullptr;
+    size_t m_size = 0;
+    const int32_t* m_cells = nullptr;
+    const uint32_t* m_stroffs = nullptr;
+    const char* m_strings = nullptr;
+
+  };
+
+  // Tokenize a text map and write its cache.  A column is stored as strings if
+  // any of its entries is not an integer.  Blank lines are skipped; every other
+  // line must have the same number of fields.
+  // Returns false, with the reason in err, on failure.
+  inline bool writeCache(const std::string& textname, const std::string& cachename, std::string& err) {
+    std::string text;
+    struct stat tst;
+    if (stat(textname.c_str(), &tst) != 0 || !readFile(textname, text)) {
+      err = "cannot read " + textname;
+      return false;
+    }
+
+    std::vector<std::vector<std::string>> rows;
+    std::istringstream in(text);
+    std::string line;
+    while (std::getline(in, line)) {
+      std::istringstream ls(line);
+      std::vector<std::string> fields;
+      std::string field;
+      while (ls >> field) fields.push_back(field);
+      if (fields.empty()) continue;
+      if (!rows.empty() && fields.size() != rows.front().size()) {
+        err = "inconsistent number of fields in " + textname;
+        return false;
+      }
+      rows.push_back(fields);
+    }
+    if (rows.empty()) { err = "no channels in " + textname; return false; }
+    uint32_t ncols = rows.front().size();
+    if (ncols > 32) { err = "too many columns in " + textname; return false; }
+
+    auto isInt = [](const std::string& s, int32_t& val) {
+      try {
+        size_t pos = 0;
+        long long v = std::stoll(s, &pos);
+        if (pos != s.size() || v < INT32_MIN || v > INT32_MAX) return false;
+        val = v;
+        return true;
+      } catch (...) {
+        return false;
+      }
+    };
+
+    Header hdr;
+    std::memcpy(hdr.magic, kMagic, sizeof(kMagic));
+    hdr.version = kVersion;
+    hdr.ncols = ncols;
+    hdr.nrows = rows.size();
+    hdr.strColMask = 0;
+    int32_t val;
+    for (const auto& row : rows) {
+      for (uint32_t icol = 0; icol < ncols; ++icol) {
+        if (!isInt(row[icol], val)) hdr.strColMask |= (1u << icol);
+      }
+    }
+
+    std::vector<int32_t> cells;
+    cells.reserve(size_t(hdr.nrows)*ncols);
+    std::map<std::string, uint32_t> strIndex;
+    std::vector<std::string> strs;
+    for (const auto& row : rows) {
+      for (uint32_t icol = 0; icol < ncols; ++icol) {
+        if ((hdr.strColMask >> icol) & 1) {
+          auto ins = strIndex.emplace(row[icol], strs.size());
+          if (ins.second) strs.push_back(row[icol]);
+          cells.push_back(ins.first->second);
+        } else {
+          isInt(row[icol], val);
+          cells.push_back(val);
+        }
+      }
+    }
+    std::vector<uint32_t> stroffs(1, 0);
+    std::string blob;
+    for (const auto& s : strs) {
+      blob += s;
+      stroffs.push_back(blob.size());
+    }
+    hdr.nstrings = strs.size();
+    hdr.strsize = blob.size();
+    hdr.sourceSize = text.size();
+    hdr.sourceMtime = mtimeNs(tst);
+    hdr.sourceChecksum = checksum(text.data(), text.size());
+
+    std::string payload;
+    payload.append(reinterpret_cast<const char*>(cells.data()), cells.size()*sizeof(int32_t));
+    payload.append(reinterpret_cast<const char*>(stroffs.data()), stroffs.size()*sizeof(uint32_t));
+    payload.append(blob);
+    hdr.payloadChecksum = checksum(payload.data(), payload.size());
+
+    std::ofstream out(cachename, std::ios::out | std::ios::binary | std::ios::trunc);
+    if (!out) { err = "cannot write " + cachename; return false; }
+    out.write(reinterpret_cast<const char*>(&hdr), sizeof(hdr));
+    out.write(payload.data(), payload.size());
+    if (!out) { err = "error writing " + cachename; return false; }
+    return true;
+  }
+
+}  // namespace chanmapcache
+}  // namespace dune
+
+#endif
@@ -1,10 +1,16 @@
 #include "DAPHNEChannelMap.h"
+#include "ChannelMapCache.h"
 #include <iostream>
 #include <fstream>
 #include <sstream>
 
+#include <sys/stat.h>
+
 
 void dune::DAPHNEChannelMap::ReadMapFromFile(std::string &fullname) {
+  fLoadedFromCache = ReadMapFromCache(chanmapcache::cacheFileName(fullname), fullname);
+  if (fLoadedFromCache) return;
+
   std::ifstream inFile(fullname, std::ios::in);
   std::string line;
 
@@ -28,6 +34,29 @@ void dune::DAPHNEChannelMap::ReadMapFromFile(std::string &fullname) {
   inFile.close();
 }
 
+bool dune::DAPHNEChannelMap::ReadMapFromCache(const std::string &cachename, const std::string &textname) {
+  struct stat st;
+  if (stat(cachename.c_str(), &st) != 0) return false;  // no cache, silently use the text file
+
+  chanmapcache::MappedTable table;
+  std::string err;
+  if (!table.open(cachename, textname, 4, 0, err)) {
+    std::cout << "DAPHNEChannelMap: ignoring channel map cache " << cachename << ": " << err << std::endl;
+    return false;
+  }
+
+  for (uint32_t irow = 0; irow < table.nrows(); ++irow) {
+    unsigned int slot = table.value(irow, 0);
+    unsigned int link = table.value(irow, 1);
+    unsigned int daphne_channel = table.value(irow, 2);
+    unsigned int offline_channel = table.value(irow, 3);
+    if (fIgnoreLinks) link = 0;
+    check_offline_channel(offline_channel);
+    fMapToOfflineChannel[DaphneChanInfo({slot,link,daphne_channel})] = offline_channel;
+  }
+  return true;
+}
+
 unsigned int dune::DAPHNEChannelMap::GetOfflineChannel(
     unsigned int slot, unsigned int link, unsigned int daphne_channel) {
 
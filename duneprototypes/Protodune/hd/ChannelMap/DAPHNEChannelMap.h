@@ -44,6 +44,7 @@ public:
   DAPHNEChannelMap() {};  // constructor
   DAPHNEChannelMap(bool ignore_links=false) : fIgnoreLinks(ignore_links) {};  // constructor
   void ReadMapFromFile(std::string &fullname);
+  bool LoadedFromCache() const { return fLoadedFromCache; }  // true if the last map was read from its binary cache
   unsigned int GetOfflineChannel(unsigned int slot, unsigned int link,
                                  unsigned int frame_chan);
 
@@ -62,6 +63,11 @@ private:
     }
   };
   bool fIgnoreLinks;
+  bool fLoadedFromCache = false;
+
+  // Read the map from the binary cache made from textname.  Returns false if
+  // there is no usable cache.
+  bool ReadMapFromCache(const std::string &cachename, const std::string &textname);
 
 };
 #endif
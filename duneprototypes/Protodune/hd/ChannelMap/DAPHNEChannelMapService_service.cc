@@ -18,6 +18,8 @@ dune::DAPHNEChannelMapService::DAPHNEChannelMapService(fhicl::ParameterSet const
     std::cout << "DAPHNE Channel Map: Building DAPHNE channel map from file " << channelMapFile << std::endl;
 
   fChannelMap.ReadMapFromFile(fullname);
+  if (fChannelMap.LoadedFromCache())
+    std::cout << "DAPHNE Channel Map: used binary cache " << fullname << ".bin" << std::endl;
 }
 
 dune::DAPHNEChannelMapService::DAPHNEChannelMapService(fhicl::ParameterSet const& pset, art::ActivityRegistry&) : DAPHNEChannelMapService(pset) {}
@@ -8,65 +8,127 @@
 ///////////////////////////////////////////////////////////////////////////////////////////////////
 
 #include "PD2HDChannelMapSP.h"
+#include "ChannelMapCache.h"
 
+#include <algorithm>
 #include <iostream>
 #include <fstream>
 #include <sstream>
 
-// so far, nothing needs to be done in the constructor
+#include <sys/stat.h>
 
 dune::PD2HDChannelMapSP::PD2HDChannelMapSP()
 {
+  fBadInfo = {};
+  fBadInfo.valid = false;
 }
 
 void dune::PD2HDChannelMapSP::ReadMapFromFile(std::string &fullname)
 {
-  std::ifstream inFile(fullname, std::ios::in);
-  std::string line;
-
-  while (std::getline(inFile,line)) {
-    std::stringstream linestream(line);
-
-    HDChanInfo_t chanInfo;
-    linestream 
-      >> chanInfo.offlchan 
-      >> chanInfo.crate 
-      >> chanInfo.APAName
-      >> chanInfo.wib 
-      >> chanInfo.link 
-      >> chanInfo.femb_on_link 
-      >> chanInfo.cebchan 
-      >> chanInfo.plane 
-      >> chanInfo.chan_in_plane 
-      >> chanInfo.femb 
-      >> chanInfo.asic 
-      >> chanInfo.asicchan
-      >> chanInfo.wibframechan; 
+  fChanInfos.clear();
 
-    chanInfo.valid = true;
+  // use the binary cache made from this file if there is a valid one
 
-    // fill maps.
+  fLoadedFromCache = ReadMapFromCache(chanmapcache::cacheFileName(fullname), fullname);
+  if (!fLoadedFromCache) {
 
-    check_offline_channel(chanInfo.offlchan);
+    std::ifstream inFile(fullname, std::ios::in);
+    std::string line;
+
+    while (std::getline(inFile,line)) {
+      if (line.find_first_not_of(" \t\r") == std::string::npos) continue;
+      std::stringstream linestream(line);
 
-    DetToChanInfo[chanInfo.crate][chanInfo.wib][chanInfo.link][chanInfo.wibframechan] = chanInfo;
-    OfflToChanInfo[chanInfo.offlchan] = chanInfo;
+      HDChanInfo_t chanInfo;
+      linestream 
+        >> chanInfo.offlchan 
+        >> chanInfo.crate 
+        >> chanInfo.APAName
+        >> chanInfo.wib 
+        >> chanInfo.link 
+        >> chanInfo.femb_on_link 
+        >> chanInfo.cebchan 
+        >> chanInfo.plane 
+        >> chanInfo.chan_in_plane 
+        >> chanInfo.femb 
+        >> chanInfo.asic 
+        >> chanInfo.asicchan
+        >> chanInfo.wibframechan; 
 
+      chanInfo.valid = true;
+
+      check_offline_channel(chanInfo.offlchan);
+
+      fChanInfos.push_back(chanInfo);
+    }
+    inFile.close();
   }
-  inFile.close();
 
+  BuildIndices();
 }
 
-dune::PD2HDChannelMapSP::HDChanInfo_t dune::PD2HDChannelMapSP::GetChanInfoFromWIBElements(
-    unsigned int crate,
-    unsigned int slot,
-    unsigned int link,
-    unsigned int wibframechan ) const {
+bool dune::PD2HDChannelMapSP::ReadMapFromCache(const std::string &cachename, const std::string &textname)
+{
+  struct stat st;
+  if (stat(cachename.c_str(), &st) != 0) return false;  // no cache, silently use the text file
+
+  chanmapcache::MappedTable table;
+  std::string err;
+  if (!table.open(cachename, textname, 13, 1u << 2, err)) {
+    std::cout << "PD2HDChannelMapSP: ignoring channel map cache " << cachename << ": " << err << std::endl;
+    return false;
+  }
 
-  unsigned int wib = slot + 1;
+  std::vector<HDChanInfo_t> chanInfos(table.nrows());
+  for (uint32_t irow = 0; irow < table.nrows(); ++irow) {
+    HDChanInfo_t &chanInfo = chanInfos[irow];
+    chanInfo.offlchan      = table.value(irow, 0);
+    chanInfo.crate         = table.value(irow, 1);
+    chanInfo.APAName       = table.str(irow, 2);
+    chanInfo.wib           = table.value(irow, 3);
+    chanInfo.link          = table.value(irow, 4);
+    chanInfo.femb_on_link  = table.value(irow, 5);
+    chanInfo.cebchan       = table.value(irow, 6);
+    chanInfo.plane         = table.value(irow, 7);
+    chanInfo.chan_in_plane = table.value(irow, 8);
+    chanInfo.femb          = table.value(irow, 9);
+    chanInfo.asic          = table.value(irow, 10);
+    chanInfo.asicchan      = table.value(irow, 11);
+    chanInfo.wibframechan  = table.value(irow, 12);
+    chanInfo.valid = true;
+    check_offline_channel(chanInfo.offlchan);
+  }
+  fChanInfos.swap(chanInfos);
+  return true;
+}
+
+void dune::PD2HDChannelMapSP::BuildIndices()
+{
+  // size the dense hardware index from the ranges seen
+
+  fNCrates = fNWibs = fNLinks = fNWibFrameChans = 0;
+  for (const auto &ci : fChanInfos) {
+    fNCrates = std::max(fNCrates, ci.crate + 1);
+    fNWibs = std::max(fNWibs, ci.wib + 1);
+    fNLinks = std::max(fNLinks, ci.link + 1);
+    fNWibFrameChans = std::max(fNWibFrameChans, ci.wibframechan + 1);
+  }
+
+  // fill the indices in file order so that, as with the nested maps used
+  // before, a later line for the same channel replaces an earlier one
+
+  fDetIndex.assign(size_t(fNCrates)*fNWibs*fNLinks*fNWibFrameChans, -1);
+  fOfflIndex.assign(fNChans, -1);
+  fCrateKnown.assign(fNCrates, false);
+  for (size_t i = 0; i < fChanInfos.size(); ++i) {
+    const HDChanInfo_t &ci = fChanInfos[i];
+    fDetIndex[detIndexAddress(ci.crate, ci.wib, ci.link, ci.wibframechan)] = i;
+    fOfflIndex[ci.offlchan] = i;
+    fCrateKnown[ci.crate] = true;
+  }
+}
 
-  HDChanInfo_t badInfo = {};
-  badInfo.valid = false;
+int dune::PD2HDChannelMapSP::resolveCrate(unsigned int crate) const {
 
 // a hack -- ununderstood crates are mapped to crate 2
 // for use in the Coldbox
@@ -74,37 +136,57 @@ dune::PD2HDChannelMapSP::HDChanInfo_t dune::PD2HDChannelMapSP::GetChanInfoFromWI
 // data with two ununderstood crates, or an ununderstood crate and crate 2,
 // will have duplicate channels.
 
-  auto fm1 = DetToChanInfo.find(crate);
-  if (fm1 == DetToChanInfo.end()) 
-    {
-      unsigned int substituteCrate = 2;  
-      fm1 = DetToChanInfo.find(substituteCrate);
-      if (fm1 == DetToChanInfo.end()) return badInfo;
-    }
-  auto& m1 = fm1->second;
+  if (crate < fNCrates && fCrateKnown[crate]) return crate;
+  unsigned int substituteCrate = 2;  
+  if (substituteCrate < fNCrates && fCrateKnown[substituteCrate]) return substituteCrate;
+  return -1;
+}
+
+int dune::PD2HDChannelMapSP::GetIndexFromWIBElements(
+    unsigned int crate,
+    unsigned int slot,
+    unsigned int link,
+    unsigned int wibframechan ) const {
 
-  auto fm2 = m1.find(wib);
-  if (fm2 == m1.end()) return badInfo;
-  auto& m2 = fm2->second;
+  unsigned int wib = slot + 1;
+  if (wib >= fNWibs || link >= fNLinks || wibframechan >= fNWibFrameChans) return -1;
+  int rcrate = resolveCrate(crate);
+  if (rcrate < 0) return -1;
+  return fDetIndex[detIndexAddress(rcrate, wib, link, wibframechan)];
+}
 
-  auto fm3 = m2.find(link);
-  if (fm3 == m2.end()) return badInfo;
-  auto& m3 = fm3->second;
+void dune::PD2HDChannelMapSP::GetIndicesFromWIBElements(
+    unsigned int crate,
+    unsigned int slot,
+    unsigned int link,
+    unsigned int firstwibframechan,
+    unsigned int nchan,
+    int *indices) const {
 
-  auto fm4 = m3.find(wibframechan);
-  if (fm4 == m3.end()) return badInfo;
-  return fm4->second;
+  std::fill(indices, indices + nchan, -1);
+  unsigned int wib = slot + 1;
+  if (wib >= fNWibs || link >= fNLinks) return;
+  int rcrate = resolveCrate(crate);
+  if (rcrate < 0) return;
+  const int *row = fDetIndex.data() + detIndexAddress(rcrate, wib, link, 0);
+  for (unsigned int i = 0; i < nchan; ++i) {
+    unsigned int wibframechan = firstwibframechan + i;
+    if (wibframechan < fNWibFrameChans) indices[i] = row[wibframechan];
+  }
+}
+
+dune::PD2HDChannelMapSP::HDChanInfo_t dune::PD2HDChannelMapSP::GetChanInfoFromWIBElements(
+    unsigned int crate,
+    unsigned int slot,
+    unsigned int link,
+    unsigned int wibframechan ) const {
+
+  return GetChanInfoRefFromWIBElements(crate, slot, link, wibframechan);
 }
 
 
 dune::PD2HDChannelMapSP::HDChanInfo_t dune::PD2HDChannelMapSP::GetChanInfoFromOfflChan(unsigned int offlineChannel) const {
-  auto ci = OfflToChanInfo.find(offlineChannel);
-  if (ci == OfflToChanInfo.end()) 
-    {
-      HDChanInfo_t badInfo = {};
-      badInfo.valid = false;
-      return badInfo;
-    }
-  return ci->second;
+  if (offlineChannel >= fOfflIndex.size()) return fBadInfo;
+  return GetChanInfoByIndex(fOfflIndex[offlineChannel]);
 
 }
@@ -48,6 +48,10 @@ public:
 
   void ReadMapFromFile(std::string &fullname);
 
+  // true if the last ReadMapFromFile used the binary cache of the text file (see ChannelMapCache.h)
+
+  bool LoadedFromCache() const { return fLoadedFromCache; }
+
   // TPC channel map accessors
 
   // Map instrumentation numbers (crate:slot:link:FEMB:plane) to offline channel number.  FEMB is 0 or 1 and indexes the FEMB in the WIB frame.
@@ -61,23 +65,83 @@ public:
 
   HDChanInfo_t GetChanInfoFromOfflChan(unsigned int offlchan) const;
 
+  // Constant-time lookups that avoid copying the channel info.
+  // The index is a position in the channel table, or -1 for an unknown channel.
+  // The returned references stay valid until the map is read again.
+
+  int GetIndexFromWIBElements(
+   unsigned int crate,
+   unsigned int slot,
+   unsigned int link,
+   unsigned int wibframechan) const;
+
+  const HDChanInfo_t& GetChanInfoByIndex(int index) const
+  {
+    return (index < 0) ? fBadInfo : fChanInfos[index];
+  };
+
+  const HDChanInfo_t& GetChanInfoRefFromWIBElements(
+   unsigned int crate,
+   unsigned int slot,
+   unsigned int link,
+   unsigned int wibframechan) const
+  {
+    return GetChanInfoByIndex(GetIndexFromWIBElements(crate, slot, link, wibframechan));
+  };
+
+  // Batch lookup of nchan consecutive WIB frame channels starting at firstwibframechan,
+  // e.g. the 64 channels of one WIBEth stream.  Fills indices[0..nchan-1] with
+  // channel table indices (-1 where there is no channel).
+
+  void GetIndicesFromWIBElements(
+   unsigned int crate,
+   unsigned int slot,
+   unsigned int link,
+   unsigned int firstwibframechan,
+   unsigned int nchan,
+   int *indices) const;
+
   unsigned int GetNChannels() {return fNChans;};
 
 private:
 
   const unsigned int fNChans = 2560*4;
 
-  // map of crate, slot, link, femb_on_link, plane, chan to channel info struct
+  // channel info for every channel in the map, in map file order
+
+  std::vector<HDChanInfo_t> fChanInfos;
+  HDChanInfo_t fBadInfo;
+
+  // dense table of indices into fChanInfos, -1 if there is no channel,
+  // addressed by crate, wib, link and wibframechan
+
+  std::vector<int> fDetIndex;
+  unsigned int fNCrates = 0;
+  unsigned int fNWibs = 0;
+  unsigned int fNLinks = 0;
+  unsigned int fNWibFrameChans = 0;
+  std::vector<bool> fCrateKnown;
+
+  // index into fChanInfos by offline channel number, -1 if absent
+
+  std::vector<int> fOfflIndex;
+
+  size_t detIndexAddress(unsigned int crate, unsigned int wib,
+                         unsigned int link, unsigned int wibframechan) const
+  {
+    return ((size_t(crate)*fNWibs + wib)*fNLinks + link)*fNWibFrameChans + wibframechan;
+  };
+
+  bool fLoadedFromCache = false;
 
-  std::unordered_map<unsigned int,   // crate
-    std::unordered_map<unsigned int, // wib
-    std::unordered_map<unsigned int, // link
-    std::unordered_map<unsigned int, // wibframechan
-    HDChanInfo_t > > > > DetToChanInfo;
+  // fill fChanInfos from a binary cache; false if there is no usable cache
+  bool ReadMapFromCache(const std::string &cachename, const std::string &textname);
 
-  // map of chan info indexed by offline channel number
+  // build the lookup indices from fChanInfos
+  void BuildIndices();
 
-  std::unordered_map<unsigned int, HDChanInfo_t> OfflToChanInfo;
+  // return the crate used for lookups, or -1 if neither it nor the substitute is known
+  int resolveCrate(unsigned int crate) const;
 
   //-----------------------------------------------
 
@@ -34,6 +34,28 @@ public:
    unsigned int wibframechan) const;
 
   dune::PD2HDChannelMapSP::HDChanInfo_t GetChanInfoFromOfflChan(unsigned int offlchan) const;
+
+  // Copy-free lookups; see PD2HDChannelMapSP.
+
+  int GetIndexFromWIBElements(
+   unsigned int crate,
+   unsigned int slot,
+   unsigned int link,
+   unsigned int wibframechan) const
+  { return fHDChanMap.GetIndexFromWIBElements(crate, slot, link, wibframechan); }
+
+  void GetIndicesFromWIBElements(
+   unsigned int crate,
+   unsigned int slot,
+   unsigned int link,
+   unsigned int firstwibframechan,
+   unsigned int nchan,
+   int *indices) const
+  { fHDChanMap.GetIndicesFromWIBElements(crate, slot, link, firstwibframechan, nchan, indices); }
+
+  const dune::PD2HDChannelMapSP::HDChanInfo_t& GetChanInfoByIndex(int index) const
+  { return fHDChanMap.GetChanInfoByIndex(index); }
+
   unsigned int GetNChannels() {return fHDChanMap.GetNChannels();};
 
 private:
@@ -26,6 +26,8 @@ dune::PD2HDChannelMapService::PD2HDChannelMapService(fhicl::ParameterSet const&
     std::cout << "PD2HD Channel Map: Building TPC wiremap from file " << channelMapFile << std::endl;
 
   fHDChanMap.ReadMapFromFile(fullname);
+  if (fHDChanMap.LoadedFromCache())
+    std::cout << "PD2HD Channel Map: used binary cache " << fullname << ".bin" << std::endl;
 }
 
 dune::PD2HDChannelMapService::PD2HDChannelMapService(fhicl::ParameterSet const& pset, art::ActivityRegistry&) : PD2HDChannelMapService(pset) {
@@ -0,0 +1,59 @@
+// makeChannelMapCache.cxx
+//
+// Write the binary cache for a text channel map file (see ChannelMapCache.h).
+//
+// Usage: makeChannelMapCache [-c] MAPFILE.txt [CACHEFILE]
+//
+// The cache is written to MAPFILE.txt.bin unless CACHEFILE is given, and is
+// then read back and its payload checksum verified.  With -c an existing
+// cache is checked against MAPFILE.txt instead of being written.  The channel
+// map services look for the cache next to the text file they are configured
+// with and fall back to the text file if it is missing or stale.  They do not
+// verify the payload checksum.
+
+#include "ChannelMapCache.h"
+
+#include <iostream>
+#include <string>
+
+using std::string;
+using std::cout;
+using std::cerr;
+using std::endl;
+
+//**********************************************************************
+
+int main(int argc, char** argv) {
+  const string myname = "makeChannelMapCache: ";
+  int iarg = 1;
+  bool checkOnly = argc > 1 && string(argv[1]) == "-c";
+  if ( checkOnly ) ++iarg;
+  if ( argc - iarg < 1 || argc - iarg > 2 || string(argv[iarg]) == "-h" ) {
+    cout << "Usage: " << argv[0] << " [-c] MAPFILE.txt [CACHEFILE]" << endl;
+    cout << "  Writes the binary cache for a text channel map file." << endl;
+    cout << "  The default cache name is MAPFILE.txt.bin" << endl;
+    cout << "  With -c, checks an existing cache instead." << endl;
+    return argc - iarg == 1 ? 0 : 1;
+  }
+  string textname = argv[iarg];
+  string cachename = argc - iarg > 1 ? argv[iarg+1] : dune::chanmapcache::cacheFileName(textname);
+  string err;
+  if ( ! checkOnly && ! dune::chanmapcache::writeCache(textname, cachename, err) ) {
+    cerr << myname << "ERROR: " << err << endl;
+    return 2;
+  }
+  // Check the cache can be read back and its contents are intact.
+  dune::chanmapcache::Header hdr;
+  dune::chanmapcache::MappedTable table;
+  if ( ! dune::chanmapcache::readHeader(cachename, hdr) ) {
+    cerr << myname << "ERROR: " << cachename << " is not a channel map cache" << endl;
+    return 3;
+  }
+  if ( ! table.open(cachename, textname, hdr.ncols, hdr.strColMask, err) || ! table.verify(err) ) {
+    cerr << myname << "ERROR: " << (checkOnly ? "" : "written ") << "cache is not valid: " << err << endl;
+    return 3;
+  }
+  cout << myname << (checkOnly ? "Checked " : "Wrote ") << cachename << " with " << table.nrows()
+       << " rows of " << table.ncols() << " columns" << endl;
+  return 0;
+}
@@ -0,0 +1,71 @@
+// bench_ChannelMapStartup.cxx
+//
+// Time building a PD2HD channel map from its text file and from its binary
+// cache.
+//
+// Usage: bench_ChannelMapStartup MAPFILE.txt [NREP]
+
+#include <string>
+#include <iostream>
+#include <chrono>
+#include <cstdio>
+#include "duneprototypes/Protodune/hd/ChannelMap/ChannelMapCache.h"
+#include "duneprototypes/Protodune/hd/ChannelMap/PD2HDChannelMapSP.h"
+
+using std::string;
+using std::cout;
+using std::endl;
+using Clock = std::chrono::steady_clock;
+namespace cmc = dune::chanmapcache;
+
+//**********************************************************************
+
+namespace {
+
+// Return the mean time in ms to read the map.
+double timeRead(string fname, unsigned int nrep, bool expectCache) {
+  double sum = 0.0;
+  for ( unsigned int irep=0; irep<nrep; ++irep ) {
+    Clock::time_point t0 = Clock::now();
+    dune::PD2HDChannelMapSP cmap;
+    cmap.ReadMapFromFile(fname);
+    sum += std::chrono::duration<double, std::milli>(Clock::now() - t0).count();
+    if ( cmap.LoadedFromCache() != expectCache ) {
+      cout << "Unexpected map source for " << fname << endl;
+      return -1.0;
+    }
+  }
+  return sum/nrep;
+}
+
+}  // end unnamed namespace
+
+//**********************************************************************
+
+int main(int argc, char* argv[]) {
+  const string myname = "bench_ChannelMapStartup: ";
+  if ( argc < 2 || string(argv[1]) == "-h" ) {
+    cout << "Usage: " << argv[0] << " MAPFILE.txt [NREP]" << endl;
+    return 0;
+  }
+  string fname = argv[1];
+  unsigned int nrep = argc > 2 ? std::stoi(argv[2]) : 20;
+  string cname = cmc::cacheFileName(fname);
+  string err;
+
+  std::remove(cname.c_str());
+  double ttxt = timeRead(fname, nrep, false);
+  if ( ! cmc::writeCache(fname, cname, err) ) {
+    cout << myname << "ERROR: " << err << endl;
+    return 1;
+  }
+  double tbin = timeRead(fname, nrep, true);
+  std::remove(cname.c_str());
+
+  cout << myname << "Text:  " << ttxt << " ms" << endl;
+  cout << myname << "Cache: " << tbin << " ms" << endl;
+  if ( tbin > 0.0 ) cout << myname << "Speedup: " << ttxt/tbin << endl;
+  return 0;
+}
+
+//**********************************************************************
@@ -0,0 +1,222 @@
+// test_ChannelMapCache.cxx
+//
+// Check that channel maps read from a binary cache are identical to those
+// read from the text file, that stale caches are rejected and that corrupt
+// caches fail verification.
+
+#include <string>
+#include <iostream>
+#include <fstream>
+#include <vector>
+#include <cstdio>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include "duneprototypes/Protodune/hd/ChannelMap/ChannelMapCache.h"
+#include "duneprototypes/Protodune/hd/ChannelMap/PD2HDChannelMapSP.h"
+#include "duneprototypes/Protodune/hd/ChannelMap/DAPHNEChannelMap.h"
+
+#undef NDEBUG
+#include <cassert>
+
+using std::string;
+using std::cout;
+using std::endl;
+using dune::PD2HDChannelMapSP;
+using dune::DAPHNEChannelMap;
+namespace cmc = dune::chanmapcache;
+
+//**********************************************************************
+
+namespace {
+
+bool sameInfo(const PD2HDChannelMapSP::HDChanInfo_t& a, const PD2HDChannelMapSP::HDChanInfo_t& b) {
+  if ( a.valid != b.valid ) return false;
+  if ( ! a.valid ) return true;
+  return a.offlchan == b.offlchan && a.crate == b.crate && a.APAName == b.APAName &&
+         a.wib == b.wib && a.link == b.link && a.femb_on_link == b.femb_on_link &&
+         a.cebchan == b.cebchan && a.plane == b.plane && a.chan_in_plane == b.chan_in_plane &&
+         a.femb == b.femb && a.asic == b.asic && a.asicchan == b.asicchan &&
+         a.wibframechan == b.wibframechan;
+}
+
+void copyFile(const string& src, const string& dst) {
+  std::ifstream in(src, std::ios::binary);
+  std::ofstream out(dst, std::ios::binary | std::ios::trunc);
+  out << in.rdbuf();
+}
+
+// Set the modification time of a file to sec seconds after the epoch.
+void setMtime(const string& fname, time_t sec) {
+  struct timespec times[2];
+  times[0].tv_sec = times[1].tv_sec = sec;
+  times[0].tv_nsec = times[1].tv_nsec = 0;
+  assert( utimensat(AT_FDCWD, fname.c_str(), times, 0) == 0 );
+}
+
+}  // end unnamed namespace
+
+//**********************************************************************
+
+int test_ChannelMapCache(string pdhdFile, string daphneFile) {
+  const string myname = "test_ChannelMapCache: ";
+#ifdef NDEBUG
+  cout << myname << "NDEBUG must be off." << endl;
+  abort();
+#endif
+  string line = "-----------------------------";
+  string err;
+
+  // Work on copies so that no cache left over from elsewhere is picked up.
+  string textName = "test_ChannelMapCache_pdhd.txt";
+  string cacheName = cmc::cacheFileName(textName);
+  copyFile(pdhdFile, textName);
+  std::remove(cacheName.c_str());
+
+  cout << myname << line << endl;
+  cout << myname << "Reading PD2HD map from text." << endl;
+  PD2HDChannelMapSP textMap;
+  textMap.ReadMapFromFile(textName);
+  assert( ! textMap.LoadedFromCache() );
+
+  cout << myname << line << endl;
+  cout << myname << "Writing and reading the cache." << endl;
+  assert( cmc::writeCache(textName, cacheName, err) );
+  PD2HDChannelMapSP cacheMap;
+  cacheMap.ReadMapFromFile(textName);
+  assert( cacheMap.LoadedFromCache() );
+
+  cout << myname << line << endl;
+  cout << myname << "Comparing lookups." << endl;
+  unsigned int nbad = 0;
+  unsigned int nvalid = 0;
+  for ( unsigned int ocha=0; ocha<textMap.GetNChannels() + 10; ++ocha ) {
+    PD2HDChannelMapSP::HDChanInfo_t a = textMap.GetChanInfoFromOfflChan(ocha);
+    if ( ! sameInfo(a, cacheMap.GetChanInfoFromOfflChan(ocha)) ) ++nbad;
+    if ( a.valid ) ++nvalid;
+  }
+  for ( unsigned int crate=0; crate<6; ++crate ) {
+    for ( unsigned int slot=0; slot<6; ++slot ) {
+      for ( unsigned int link=0; link<3; ++link ) {
+        for ( unsigned int wchan=0; wchan<260; ++wchan ) {
+          if ( ! sameInfo(textMap.GetChanInfoFromWIBElements(crate, slot, link, wchan),
+                          cacheMap.GetChanInfoFromWIBElements(crate, slot, link, wchan)) ) ++nbad;
+        }
+      }
+    }
+  }
+  cout << myname << "Valid channels: " << nvalid << endl;
+  cout << myname << "Mismatches: " << nbad << endl;
+  assert( nvalid > 0 );
+  assert( nbad == 0 );
+
+  cout << myname << line << endl;
+  cout << myname << "Checking a touched but unchanged text file keeps the cache." << endl;
+  setMtime(textName, 1000000000);
+  PD2HDChannelMapSP touchedMap;
+  touchedMap.ReadMapFromFile(textName);
+  assert( touchedMap.LoadedFromCache() );
+
+  cout << myname << line << endl;
+  cout << myname << "Checking a stale cache of the same size is rejected." << endl;
+  {
+    std::fstream io(textName, std::ios::in | std::ios::out | std::ios::binary);
+    char ch = 0;
+    io.get(ch);
+    assert( ch >= '0' && ch <= '8' );
+    io.seekp(0);
+    io.put(ch + 1);
+  }
+  setMtime(textName, 1000000001);
+  PD2HDChannelMapSP sameSizeMap;
+  sameSizeMap.ReadMapFromFile(textName);
+  assert( ! sameSizeMap.LoadedFromCache() );
+  copyFile(pdhdFile, textName);
+
+  cout << myname << line << endl;
+  cout << myname << "Checking a stale cache is rejected." << endl;
+  {
+    std::ofstream out(textName, std::ios::app);
+    out << "\n";
+  }
+  PD2HDChannelMapSP staleMap;
+  staleMap.ReadMapFromFile(textName);
+  assert( ! staleMap.LoadedFromCache() );
+  assert( sameInfo(staleMap.GetChanInfoFromOfflChan(0), textMap.GetChanInfoFromOfflChan(0)) );
+
+  cout << myname << line << endl;
+  cout << myname << "Checking a corrupt cache fails verification." << endl;
+  assert( cmc::writeCache(textName, cacheName, err) );
+  cmc::MappedTable table;
+  assert( table.open(cacheName, textName, 13, 1u << 2, err) );
+  assert( table.verify(err) );
+  table.close();
+  {
+    std::fstream io(cacheName, std::ios::in | std::ios::out | std::ios::binary);
+    io.seekp(sizeof(cmc::Header) + 5);
+    io.put('\x7f');
+  }
+  assert( table.open(cacheName, textName, 13, 1u << 2, err) );
+  assert( ! table.verify(err) );
+  cout << myname << "Reason: " << err << endl;
+  table.close();
+
+  cout << myname << line << endl;
+  cout << myname << "Checking a truncated cache is rejected." << endl;
+  assert( truncate(cacheName.c_str(), sizeof(cmc::Header) + 8) == 0 );
+  PD2HDChannelMapSP truncMap;
+  truncMap.ReadMapFromFile(textName);
+  assert( ! truncMap.LoadedFromCache() );
+  assert( ! table.open(cacheName, textName, 13, 1u << 2, err) );
+  cout << myname << "Reason: " << err << endl;
+  std::remove(cacheName.c_str());
+  std::remove(textName.c_str());
+
+  cout << myname << line << endl;
+  cout << myname << "Checking the DAPHNE map." << endl;
+  textName = "test_ChannelMapCache_daphne.txt";
+  cacheName = cmc::cacheFileName(textName);
+  copyFile(daphneFile, textName);
+  std::remove(cacheName.c_str());
+  DAPHNEChannelMap daphneText(false);
+  daphneText.ReadMapFromFile(textName);
+  assert( ! daphneText.LoadedFromCache() );
+  assert( cmc::writeCache(textName, cacheName, err) );
+  DAPHNEChannelMap daphneCache(false);
+  daphneCache.ReadMapFromFile(textName);
+  assert( daphneCache.LoadedFromCache() );
+  assert( table.open(cacheName, textName, 4, 0, err) );
+  assert( table.verify(err) );
+  for ( unsigned int irow=0; irow<table.nrows(); ++irow ) {
+    unsigned int slot = table.value(irow, 0);
+    unsigned int link = table.value(irow, 1);
+    unsigned int dchan = table.value(irow, 2);
+    assert( daphneText.GetOfflineChannel(slot, link, dchan) == daphneCache.GetOfflineChannel(slot, link, dchan) );
+  }
+  cout << myname << "Checked " << table.nrows() << " DAPHNE channels." << endl;
+  table.close();
+  std::remove(cacheName.c_str());
+  std::remove(textName.c_str());
+
+  cout << myname << line << endl;
+  cout << myname << "Done." << endl;
+  return 0;
+}
+
+//**********************************************************************
+
+int main(int argc, char* argv[]) {
+  string pdhdFile = "PD2HDChannelMap_v5.txt";
+  string daphneFile = "DAPHNE_test5_ChannelMap_v1.txt";
+  if ( argc > 1 ) {
+    string sarg(argv[1]);
+    if ( sarg == "-h" ) {
+      cout << "Usage: " << argv[0] << " [PD2HDMAP [DAPHNEMAP]]" << endl;
+      return 0;
+    }
+    pdhdFile = sarg;
+  }
+  if ( argc > 2 ) daphneFile = argv[2];
+  return test_ChannelMapCache(pdhdFile, daphneFile);
+}
+
+//**********************************************************************
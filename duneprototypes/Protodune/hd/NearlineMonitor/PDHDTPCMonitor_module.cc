@@ -25,6 +25,8 @@
 #include "messagefacility/MessageLogger/MessageLogger.h"
 #include "fhiclcpp/ParameterSet.h"
 #include "duneprototypes/Protodune/hd/ChannelMap/PD2HDChannelMapService.h"
+#include "duneprototypes/Protodune/singlephase/NearlineMonitor/MonitorFFT.h"
+#include "tbb/parallel_for.h"
 
 // ROOT includes.
 #include "TH1.h"
@@ -53,6 +55,7 @@ namespace tpc_monitor{
     void beginRun(const art::Run& run);
     void reconfigure(fhicl::ParameterSet const& pset);
     void analyze(const art::Event& evt); 
+    void endJob();
     
   private:
     // Parameters in .fcl file
@@ -68,6 +71,9 @@ namespace tpc_monitor{
     int fHitThreshInd;
     int fHitDeadtimeColl;
     int fHitDeadtimeInd;
+    int fFFTBatchSize;
+    int fFFTSnapshotInterval;
+    bool fParallelAPAs;
     
     // sampling rate
     float fSampleRate;
@@ -101,9 +107,57 @@ namespace tpc_monitor{
     
     TH1F *fNTicksTPC;
     TH1F *fRMSNTicksTPC;
+
+    // FFTs: waveforms are transformed in batches of fFFTBatchSize channels and the
+    // spectra are summed in arrays, which are added to the FFT histograms above every
+    // fFFTSnapshotInterval events (0 for only at the end of the job)
+    struct FFTChannel {
+      unsigned int apa;
+      unsigned int plane;
+      int planechan;
+      int femb;
+    };
+    int fNEventsSinceSnapshot = 0;
+
+    // The digits of an event are split by APA. The channel map is read and the digits
+    // are sorted into the APA shards serially. Each shard is then unpacked by its own
+    // task, run with tbb::parallel_for (on art's scheduler) if fParallelAPAs is set.
+    // A task writes only to its shard and to the results for its own digits, so no
+    // locks are needed. When all are done the per-channel results are filled into the
+    // histograms in digit order and the shard sums are added to them.
+    struct DigitInfo {
+      const raw::RawDigit* digit;
+      unsigned int apa;
+      unsigned int plane;
+      int planechan;
+      int femb;
+      int xBin;
+      int yBin;
+    };
+    struct APAShard {
+      std::vector<size_t> digits;   // indices in fDigitInfo
+      std::vector<short> uncompressed;
+      std::vector<short> uncompPed;
+      std::map<int, Hist1Sum<double>>  chanADCSum;          // by plane
+      MonitorFFT fft;
+      std::vector<double> fftWaveforms;
+      std::vector<double> fftSpectra;
+      std::vector<FFTChannel> fftChannels;
+      size_t fftNSamples = 0;
+      std::map<int, ProfileSum>       chanFFTProfileSum;   // by plane
+      std::map<int, Hist2Sum<float>>  chanFFTSum;          // by plane
+      std::map<int, Hist2Sum<float>>  persistentFFTSum;    // by plane
+      std::map<int, ProfileSum>       fembFFTSum;          // by FEMB
+    };
+    std::vector<APAShard> fShards;      // index is crate - 1
+    std::vector<DigitInfo> fDigitInfo;
+    std::vector<int> fDigitNHits;
     
     // define functions
-    void calculateFFT(TH1D* hist_waveform, TH1D* graph_frequency);
+    int processDigit(APAShard& shard, const DigitInfo& info);
+    void addFFTChannel(APAShard& shard, const std::vector<short>& waveform, const FFTChannel& chaninfo);
+    void transformFFTBatch(APAShard& shard);
+    void snapshotFFT();
     int FEMBchanToHistogramMap(int FEMBchan, int coord);
 
   }; // PDHDTPCMonitor
@@ -125,6 +179,9 @@ namespace tpc_monitor{
     fHitDeadtimeInd  = p.get<int>("HitDeadtimeInd",100);
     fCollPed         = p.get<int>("CollPed",800);
     fIndPed          = p.get<int>("IndPed",8200);
+    fFFTBatchSize    = p.get<int>("FFTBatchSize",64);
+    fFFTSnapshotInterval = p.get<int>("FFTSnapshotInterval",0);
+    fParallelAPAs    = p.get<bool>("ParallelAPAs",true);
     
     fSampleRate = 1.953125;
     // width of frequencyBin in kHz
@@ -151,8 +208,10 @@ namespace tpc_monitor{
     std::vector<TString> planelabel = { "U", "V", "X1", "X2" };
     std::vector<int> planechancount = { 800, 800, 480, 480 };
     
+    fShards.resize(4);
     for (int iapa=0; iapa<4; ++iapa)
       {
+	APAShard& shard = fShards[iapa];
 	for (int iplane=0; iplane<4; ++iplane)
 	  {
 	    TString hnamebase = apalabel.at(iapa) + "_" + planelabel.at(iplane) + "_";
@@ -171,14 +230,19 @@ namespace tpc_monitor{
 		xhigh = fIndPed + 299.5;
 	      }
 	    fChanADC[iapa][iplane] = tfs->make<TH1D>(hnamebase+"ADC",hnamebase+"ADC;ADC;Entries",600,xlow,xhigh);
+	    shard.chanADCSum[iplane] = Hist1Sum<double>(fChanADC[iapa][iplane]);
 	    fPersistentFFT[iapa][iplane] = tfs->make<TH2F>(hnamebase+"PersistentFFT",hnamebase+"Persistent FFT;Frequency [kHz];Amplitude [dB]",fNTicks/2,0,fNTicks/2*fBinWidth,150,-100.0,50.0);
 	    fChanFFTProfile[iapa][iplane] = tfs->make<TProfile>(hnamebase+"FFTProfile",hnamebase+"FFT;Frequency [kHz];Amplitude [dB]",fNTicks/2,0,fNTicks/2*fBinWidth);
+	    shard.chanFFTSum[iplane] = Hist2Sum<float>(fChanFFT[iapa][iplane]);
+	    shard.persistentFFTSum[iplane] = Hist2Sum<float>(fPersistentFFT[iapa][iplane]);
+	    shard.chanFFTProfileSum[iplane] = ProfileSum(fChanFFTProfile[iapa][iplane]);
 	  }
 	for (int ifemb=1; ifemb<21; ++ifemb)
 	  {
 	    TString hname = apalabel.at(iapa) + "_FEMB";
 	    hname += ifemb;
 	    fFEMBFFT[iapa][ifemb] = tfs->make<TProfile>(hname+"FFTProfile",hname+"FFT;Frequency [kHz];Amplitude [dB]",fNTicks/2,0,fNTicks/2*fBinWidth);
+	    shard.fembFFTSum[ifemb] = ProfileSum(fFEMBFFT[iapa][ifemb]);
 	  }
       }
 
@@ -255,9 +319,12 @@ namespace tpc_monitor{
 	//std::cout << "RDStatus:  Status Word " << rdstatus.GetStatWord() << std::endl; 
       }
 
-    // Loop over all RawDigits
+    // Sort the RawDigits into the APA shards, with what they need from the channel map
 
     std::vector<float> nticksvec;
+    fDigitInfo.clear();
+    fDigitInfo.reserve(RawDigits.size());
+    for (auto& shard : fShards) shard.digits.clear();
     
     for(auto const & dptr : RawDigits) {
       const raw::RawDigit & digit = *dptr;
@@ -278,64 +345,14 @@ namespace tpc_monitor{
       int nSamples = digit.Samples();
       fNTicksTPC->Fill(nSamples);
       nticksvec.push_back(nSamples);
-      
-      int pedestal = (int)digit.GetPedestal();
-      //int pedestal = 0;  
-
-      std::vector<short> uncompressed(nSamples);
-      // with pedestal	  
-      raw::Uncompress(digit.ADCs(), uncompressed, pedestal, digit.Compression());
-
-      // subtract pedestals
-      std::vector<short> uncompPed(nSamples);
-
-      auto adchistopointer = fChanADC[apa][plane];
-      for (int i=0; i<nSamples; i++) 
-	{ 
-	  auto adc=uncompressed.at(i);
-	  uncompPed.at(i) = adc - pedestal;
-	  adchistopointer->Fill(adc);
-        }
-
-      // number of ADC uncompressed without pedestal
-      size_t nADC_uncompPed=uncompPed.size();	 
-      
-      // wavefrom histogram   
-      TH1D* histwav=new TH1D(Form("wav%d",(int)chan),Form("wav%d",(int)chan),nSamples,0,nSamples); 
-      for(int k=0;k<(int)nADC_uncompPed;k++) {
-	histwav->SetBinContent(k+1, uncompPed.at(k));
-      }
-	    
-      // Do FFT for single waveforms
-      TH1D* histfft=new TH1D(Form("fft%d",(int)chan),Form("fft%d",(int)chan),nSamples,0,nSamples*fBinWidth); 
-      calculateFFT(histwav, histfft);
-
-      auto fftptr = fChanFFT[apa][plane];
-      auto fftprofileptr = fChanFFTProfile[apa][plane];
-      auto fftpersistentptr = fPersistentFFT[apa][plane];
-      auto fftfembptr = fFEMBFFT[apa][chanInfo.femb];
-      
-      for(int k=0;k<(int)nADC_uncompPed/2;k++) {
-	double bc = histfft->GetBinContent(k+1);
-	if (bc > -1E6 && bc < 1E6)
-	  {
-	    fftptr->Fill(planechan,(k+0.5)*fBinWidth, bc);
-	    fftprofileptr->Fill((k+0.5)*fBinWidth, bc);
-	    fftpersistentptr->Fill((k+0.5)*fBinWidth, bc);
-	    fftfembptr->Fill((k+0.5)*fBinWidth, bc);
-	  }
-      }
 
-      // Mean and RMS
-      float mean = digit.GetPedestal();
-      float rms = digit.GetSigma();
-      fChanMean[apa][plane]->Fill(planechan,mean);
-      fMeanHist[apa][plane]->Fill(mean);
-      fChanRMS[apa][plane]->Fill(planechan,rms);
-      fRMSHist[apa][plane]->Fill(rms);
+      if (apa >= fShards.size())
+	{
+	  MF_LOG_WARNING("PDHDTPCMonitor") << "Skipping channel " << chan << " in crate " << chanInfo.crate;
+	  continue;
+	}
       
-      // fill the summary plots
-
+      // location in the summary plots
       int FEMBchan = chanInfo.cebchan;
       int iFEMB = chanInfo.femb - 1;
       //Get the location of any FEMBchan in the histogram
@@ -343,62 +360,157 @@ namespace tpc_monitor{
       int xBin = ((FEMBchanToHistogramMap(FEMBchan,0))+(iFEMB*4)+xEdgeAPA[apa]); // (fembchan location on histogram) + shift from mobo + shift from apa
       int yBin = ((FEMBchanToHistogramMap(FEMBchan,1))+yEdgeAPA[(apa%2)]); //(fembchan location on histogram) + shift from apa 
 
-      fAllChanMean->Fill(xBin,yBin,mean); //histogram the mean
-      fAllChanRMS->Fill(xBin,yBin,rms); //histogram the rms
-      
-      histwav->Delete(); 
-      histfft->Delete();                                                                                                                    
-
-      int nhits = 0;
-      int lasthittick = -10000;
-      int thresh = fHitThreshColl;
-      if (plane < 2) thresh = fHitThreshInd;
-      int ndeadlimit = fHitDeadtimeColl;
-      if (plane < 2) ndeadlimit = fHitDeadtimeInd;
-      for (int itick=0; itick< (int) uncompPed.size(); ++itick)
-	{
-	  if (TMath::Abs(uncompPed.at(itick)) > thresh && itick > lasthittick + ndeadlimit)
-	    {
-	      ++nhits;
-	      lasthittick = itick;
-	    }
-	}
-      fChanHitOccupancy[apa][plane]->Fill(planechan,nhits);
-      
+      // FFT plans are made here as making one is not thread safe
+      fShards[apa].fft.prepare(nSamples);
+      fShards[apa].digits.push_back(fDigitInfo.size());
+      fDigitInfo.push_back({&digit, apa, plane, planechan, (int)chanInfo.femb, xBin, yBin});
     } // RawDigits
 
+    // Unpack the digits of each APA: ADC distributions, FFTs and hit counts
+
+    fDigitNHits.resize(fDigitInfo.size());
+    auto processShard = [&](size_t iapa)
+      {
+	APAShard& shard = fShards[iapa];
+	for (size_t idig : shard.digits) fDigitNHits[idig] = processDigit(shard, fDigitInfo[idig]);
+	transformFFTBatch(shard);
+      };
+    if (fParallelAPAs) tbb::parallel_for(size_t(0), fShards.size(), processShard);
+    else for (size_t iapa=0; iapa<fShards.size(); ++iapa) processShard(iapa);
+
+    // Fill the per-channel histograms
+
+    for (size_t idig=0; idig<fDigitInfo.size(); ++idig) {
+      const DigitInfo& info = fDigitInfo[idig];
+      unsigned int apa = info.apa;
+      unsigned int plane = info.plane;
+
+      // Mean and RMS
+      float mean = info.digit->GetPedestal();
+      float rms = info.digit->GetSigma();
+      fChanMean[apa][plane]->Fill(info.planechan,mean);
+      fMeanHist[apa][plane]->Fill(mean);
+      fChanRMS[apa][plane]->Fill(info.planechan,rms);
+      fRMSHist[apa][plane]->Fill(rms);
+      
+      // fill the summary plots
+      fAllChanMean->Fill(info.xBin,info.yBin,mean); //histogram the mean
+      fAllChanRMS->Fill(info.xBin,info.yBin,rms); //histogram the rms
+
+      fChanHitOccupancy[apa][plane]->Fill(info.planechan,fDigitNHits[idig]);
+    }
+    for (size_t iapa=0; iapa<fShards.size(); ++iapa)
+      for (auto& sum : fShards[iapa].chanADCSum) sum.second.flush(fChanADC[iapa][sum.first]);
+
     auto ntrms = TMath::RMS(nticksvec.size(),nticksvec.data());
     fRMSNTicksTPC->Fill(ntrms);
+
+    if (fFFTSnapshotInterval > 0 && ++fNEventsSinceSnapshot >= fFFTSnapshotInterval) snapshotFFT();
     
     return;
   }
+
+  //-----------------------------------------------------------------------
+
+  void PDHDTPCMonitor::endJob() {
+    snapshotFFT();
+  }
   
   //-----------------------------------------------------------------------  
-  //calculate FFT
-  void PDHDTPCMonitor::calculateFFT(TH1D* hist_waveform, TH1D* hist_frequency) {
-  
-    int n_bins = hist_waveform->GetNbinsX();
-    TH1* hist_transform = 0;
+  // unpack one digit of an APA shard into the shard sums and return the number of
+  // hits.  Runs in the shard's task, so it writes to nothing else.
+  int PDHDTPCMonitor::processDigit(APAShard& shard, const DigitInfo& info) {
+    const raw::RawDigit & digit = *info.digit;
+    int nSamples = digit.Samples();
+    int pedestal = (int)digit.GetPedestal();
+    //int pedestal = 0;  
+
+    // with pedestal	  
+    shard.uncompressed.assign(nSamples, 0);
+    raw::Uncompress(digit.ADCs(), shard.uncompressed, pedestal, digit.Compression());
+
+    // subtract pedestals
+    shard.uncompPed.resize(nSamples);
+    auto& adcsum = shard.chanADCSum[info.plane];
+    for (int i=0; i<nSamples; i++) 
+      { 
+	auto adc=shard.uncompressed[i];
+	shard.uncompPed[i] = adc - pedestal;
+	adcsum.fill(adc);
+      }
 
-    // Create hist_transform from the input hist_waveform
-    hist_transform = hist_waveform->FFT(hist_transform, "MAG");
-    hist_transform -> Scale (1.0 / float(n_bins));
-    int nFFT=hist_transform->GetNbinsX();
-  
-    double frequency;
-    double amplitude;
-    double amplitudeLog;
-  
-    // Loop on the hist_transform to fill the hist_transform_frequency                                                                                        
-    for (int k = 0; k < nFFT/2; k++){
+    // FFT of the waveform, done with the rest of its batch
+    addFFTChannel(shard, shard.uncompPed, {info.apa, info.plane, info.planechan, info.femb});
+
+    int nhits = 0;
+    int lasthittick = -10000;
+    int thresh = fHitThreshColl;
+    if (info.plane < 2) thresh = fHitThreshInd;
+    int ndeadlimit = fHitDeadtimeColl;
+    if (info.plane < 2) ndeadlimit = fHitDeadtimeInd;
+    for (int itick=0; itick<nSamples; ++itick)
+      {
+	if (TMath::Abs(shard.uncompPed[itick]) > thresh && itick > lasthittick + ndeadlimit)
+	  {
+	    ++nhits;
+	    lasthittick = itick;
+	  }
+      }
+    return nhits;
+  }
 
-      frequency =  (k+0.5)*fBinWidth; // kHz
-      amplitude = hist_transform->GetBinContent(k+1); 
-      amplitudeLog = 20*log10(amplitude); // dB
-      hist_frequency->Fill(frequency, amplitudeLog);
+  //-----------------------------------------------------------------------  
+  // queue a waveform for the FFT, transforming the batch when it is full
+  void PDHDTPCMonitor::addFFTChannel(APAShard& shard, const std::vector<short>& waveform, const FFTChannel& chaninfo) {
+    if (waveform.size() != shard.fftNSamples) {
+      transformFFTBatch(shard);
+      shard.fftNSamples = waveform.size();
     }
+    shard.fftWaveforms.insert(shard.fftWaveforms.end(), waveform.begin(), waveform.end());
+    shard.fftChannels.push_back(chaninfo);
+    if ((int)shard.fftChannels.size() >= fFFTBatchSize) transformFFTBatch(shard);
+  }
 
-    hist_transform->Delete();  
+  //-----------------------------------------------------------------------  
+  // FFT of the queued waveforms, summed into the shard's FFT sums
+  void PDHDTPCMonitor::transformFFTBatch(APAShard& shard) {
+    if (shard.fftChannels.empty()) return;
+    shard.fft.spectra(shard.fftWaveforms.data(), shard.fftChannels.size(), shard.fftNSamples, shard.fftSpectra);
+    int nfreq = shard.fftNSamples/2;
+    for (size_t ich=0; ich<shard.fftChannels.size(); ++ich) {
+      const FFTChannel& ci = shard.fftChannels[ich];
+      const double* spectrum = shard.fftSpectra.data() + ich*nfreq;
+      auto& fftsum = shard.chanFFTSum[ci.plane];
+      auto& fftprofilesum = shard.chanFFTProfileSum[ci.plane];
+      auto& fftpersistentsum = shard.persistentFFTSum[ci.plane];
+      auto& fftfembsum = shard.fembFFTSum[ci.femb];
+      for (int k=0; k<nfreq; k++) {
+	double bc = spectrum[k];
+	if (bc > -1E6 && bc < 1E6)
+	  {
+	    fftsum.fill(ci.planechan,(k+0.5)*fBinWidth, bc);
+	    fftprofilesum.fill((k+0.5)*fBinWidth, bc);
+	    fftpersistentsum.fill((k+0.5)*fBinWidth, bc);
+	    fftfembsum.fill((k+0.5)*fBinWidth, bc);
+	  }
+      }
+    }
+    shard.fftWaveforms.clear();
+    shard.fftChannels.clear();
+  }
+
+  //-----------------------------------------------------------------------  
+  // add the summed spectra to the FFT histograms
+  void PDHDTPCMonitor::snapshotFFT() {
+    for (size_t iapa=0; iapa<fShards.size(); ++iapa) {
+      APAShard& shard = fShards[iapa];
+      transformFFTBatch(shard);
+      for (auto& sum : shard.chanFFTSum) sum.second.flush(fChanFFT[iapa][sum.first]);
+      for (auto& sum : shard.chanFFTProfileSum) sum.second.flush(fChanFFTProfile[iapa][sum.first]);
+      for (auto& sum : shard.persistentFFTSum) sum.second.flush(fPersistentFFT[iapa][sum.first]);
+      for (auto& sum : shard.fembFFTSum) sum.second.flush(fFEMBFFT[iapa][sum.first]);
+    }
+    fNEventsSinceSnapshot = 0;
   }
 
   //----------------------------------------------------------------------
@@ -9,6 +9,12 @@
 
 #include "DAPHNEUtils.h"
 
+#include <algorithm>
+#include <array>
+#include <map>
+#include <tuple>
+#include <vector>
+
 namespace daphne {
 using dunedaq::daqdataformats::SourceID;
 using dunedaq::daqdataformats::FragmentType;
@@ -24,6 +30,10 @@ class DAPHNEInterface1 : public DAPHNEInterfaceBase {
   static const size_t FrameSize = sizeof(DAPHNEFrame);
   static const size_t StreamFrameSize = sizeof(DAPHNEStreamFrame);
 
+  utils::StreamAssembler fStreamAssembler;
+  //Offline channel for (slot, link, DAPHNE channel) of streaming frames
+  std::map<std::tuple<int, int, int>, int> fStreamChannels;
+
   template <class T>
   size_t GetNFrames(size_t frag_size, size_t frag_header_size) {
     return (frag_size - FragmentHeaderSize)/sizeof(T);
@@ -77,50 +87,87 @@ class DAPHNEInterface1 : public DAPHNEInterfaceBase {
     }
   }
 
+  //Offline channels of the 4 channels of a streaming frame, -1 for those
+  //not in the channel map. Lookups are cached, as every frame of a stream
+  //repeats the same channels.
+  std::array<int, 4> GetStreamChannels(const DAPHNEStreamFrame * frame) {
+    int b_link = frame->daq_header.link_id;
+    int b_slot = frame->daq_header.slot_id;
+    std::array<int, 4> frame_channels = {
+      static_cast<int>(frame->header.channel_0),
+      static_cast<int>(frame->header.channel_1),
+      static_cast<int>(frame->header.channel_2),
+      static_cast<int>(frame->header.channel_3)};
+    std::array<int, 4> offline_channels;
+    for (size_t i = 0; i < frame_channels.size(); ++i) {
+      auto key = std::make_tuple(b_slot, b_link, frame_channels[i]);
+      auto ichan = fStreamChannels.find(key);
+      if (ichan == fStreamChannels.end()) {
+        int offline_channel = -1;
+        try {
+          offline_channel = fChannelMap->GetOfflineChannel(
+            b_slot, b_link, frame_channels[i]);
+        }
+        catch (const std::range_error & err) {
+          std::cout << "WARNING: Could not find offline channel for " <<
+                       b_slot << " " << b_link << " " << frame_channels[i] << std::endl;
+        }
+        ichan = fStreamChannels.emplace(key, offline_channel).first;
+      }
+      offline_channels[i] = ichan->second;
+    }
+    return offline_channels;
+  }
+
+  //First pass over a streaming fragment: count the samples of each channel
+  //so that its waveform is allocated once when the fragment is unpacked
+  void CountStreamFrames(std::unique_ptr<Fragment> & frag) {
+    auto n_frames = GetNFrames<DAPHNEStreamFrame>(frag->get_size(),
+                                                  FragmentHeaderSize);
+    for (size_t i = 0; i < n_frames; ++i) {
+      auto frame
+          = reinterpret_cast<DAPHNEStreamFrame*>(
+              static_cast<uint8_t*>(frag->get_data()) + i*StreamFrameSize);
+      for (int chan : GetStreamChannels(frame)) {
+        fStreamAssembler.Count(chan, frame->s_adcs_per_channel);
+      }
+    }
+  }
+
   void ProcessStreamFrame(
       DAPHNEStreamFrame * frame,
       std::unordered_map<unsigned int, std::vector<raw::OpDetWaveform>> & wf_map,
       utils::DAPHNETree * daphne_tree) {
-    art::ServiceHandle<dune::DAPHNEChannelMapService> channel_map;
-    auto b_link = frame->daq_header.link_id;
     auto b_slot = frame->daq_header.slot_id;
   
-  
     //Each streaming frame comes with data from 4 channels
     std::array<size_t, 4> frame_channels = {
       frame->header.channel_0,
       frame->header.channel_1,
       frame->header.channel_2,
       frame->header.channel_3};
+    auto offline_channels = GetStreamChannels(frame);
+
+    //Unpack the whole frame at once
+    const size_t n_adcs = frame->s_adcs_per_channel;
+    std::array<raw::ADC_Count_t,
+               DAPHNEStreamFrame::s_channels_per_frame*DAPHNEStreamFrame::s_adcs_per_channel> adcs;
+    utils::UnpackStreamFrame(*frame, adcs.data());
+
     // Loop over channels
     for (size_t i = 0; i < frame->s_channels_per_frame; ++i) {
-      auto offline_channel = -1;
-  
-      try {
-        offline_channel = channel_map->GetOfflineChannel(
-          b_slot, b_link, frame_channels[i]);
-      }
-      catch (const std::range_error & err) {
-        std::cout << "WARNING: Could not find offline channel for " <<
-                     b_slot << " " << b_link << " " << frame_channels[i] << std::endl;
-      }
+      auto offline_channel = offline_channels[i];
+      const raw::ADC_Count_t * chan_adcs = adcs.data() + i*n_adcs;
   
       //Make output
-      auto & waveform = daphne::utils::MakeWaveform(
+      auto & waveform = fStreamAssembler.MakeWaveform(
             offline_channel,
-            frame->s_adcs_per_channel,
             frame->get_timestamp(),
-            wf_map,
-            true);
-  
-      // Loop over ADC values in the frame for channel i 
-      for (size_t j = 0; j < static_cast<size_t>(frame->s_adcs_per_channel); ++j) {
-        waveform.push_back(frame->get_adc(j, i));
-        if (daphne_tree != nullptr)
-          daphne_tree->fADCValue[j] = frame->get_adc(j, i);
-      }
+            wf_map);
+      fStreamAssembler.Append(waveform, chan_adcs, n_adcs);
   
       if (daphne_tree != nullptr) {
+        std::copy(chan_adcs, chan_adcs + n_adcs, daphne_tree->fADCValue);
         daphne_tree->fSlot = b_slot;
         daphne_tree->fDaphneChannel = frame_channels[i];
         daphne_tree->fOfflineChannel = offline_channel;
@@ -229,10 +276,16 @@ class DAPHNEInterface1 : public DAPHNEInterfaceBase {
         // Too small to even have a header
         if (!CheckFragSize(frag)) continue;
 
-        //Process it
+        //Count the samples of a streaming fragment before unpacking it, so
+        //that each of its waveforms is allocated once. A channel is read out
+        //on one link, so all its samples are in this fragment.
+        if (frag->get_fragment_type() != FragmentType::kDAPHNE) {
+          CountStreamFrames(frag);
+        }
         UnpackFragment(frag, wf_map, daphne_tree);
       }
     }
+    fStreamAssembler.Clear();
   };
 
 };
@@ -1,6 +1,8 @@
 #include "DAPHNEUtils.h"
 #include "detdataformats/DetID.hpp"
 
+#include <algorithm>
+
 namespace daphne::utils {
 
 DAPHNETree::DAPHNETree() : fTree(nullptr) {}
@@ -61,12 +63,36 @@ raw::OpDetWaveform & MakeWaveform(
 
 
   auto & waveform = wf_map.at(offline_chan).back();
-  //Reserve more adcs at once for efficiency
-  waveform.reserve(waveform.size() + n_adcs);
+  //Reserve more adcs at once for efficiency. Streams grow geometrically:
+  //an exact reserve per frame would copy the waveform every time.
+  if (waveform.capacity() < waveform.size() + n_adcs) {
+    waveform.reserve(is_stream ?
+        std::max(waveform.size() + n_adcs, 2*waveform.capacity()) :
+        waveform.size() + n_adcs);
+  }
   return waveform;
 
 }
 
+raw::OpDetWaveform & StreamAssembler::MakeWaveform(
+  unsigned int offline_chan,
+  raw::TimeStamp_t timestamp,
+  std::unordered_map<unsigned int, std::vector<raw::OpDetWaveform>> & wf_map) {
+
+  auto & waveforms = wf_map[offline_chan];
+  if (waveforms.empty()) {
+    waveforms.emplace_back(timestamp, offline_chan);
+  }
+
+  auto & waveform = waveforms.back();
+  auto ipend = fPending.find(offline_chan);
+  if (ipend != fPending.end()) {
+    waveform.reserve(waveform.size() + ipend->second);
+    fPending.erase(ipend);
+  }
+  return waveform;
+}
+
 bool CheckSubdet(size_t geo_id, std::string subdet_label) {
   dunedaq::detdataformats::DetID::Subdetector det_idenum
       = static_cast<dunedaq::detdataformats::DetID::Subdetector>(
@@ -12,6 +12,9 @@
 
 #include "TTree.h"
 
+#include <unordered_map>
+#include <vector>
+
 namespace daphne {
 
   using WaveformVector = std::vector<raw::OpDetWaveform>;
@@ -40,6 +43,51 @@ namespace utils {
     std::unordered_map<unsigned int, WaveformVector> & wf_map,
     bool is_stream = false);
     bool CheckSubdet(size_t geo_id, std::string subdet_label);
+
+  //Unpacks all ADCs of a streaming frame, channel after channel:
+  //adcs[i*s_adcs_per_channel + j] == frame.get_adc(j, i)
+  template <class StreamFrame>
+  void UnpackStreamFrame(const StreamFrame & frame, raw::ADC_Count_t * adcs) {
+    const size_t n_adcs = frame.s_adcs_per_channel;
+    for (size_t i = 0; i < static_cast<size_t>(frame.s_channels_per_frame); ++i) {
+      for (size_t j = 0; j < n_adcs; ++j) {
+        adcs[i*n_adcs + j] = frame.get_adc(j, i);
+      }
+    }
+  }
+
+  //Assembles the waveforms of streaming channels.
+  //MakeWaveform with is_stream reserves frame by frame, which for a long
+  //stream reallocates and copies the waveform for every frame. Here the
+  //frames of a stream fragment are counted before it is unpacked, and each
+  //waveform is allocated once, when its channel is first filled.
+  class StreamAssembler {
+   public:
+    //Count n_adcs samples to come for offline_chan
+    void Count(unsigned int offline_chan, size_t n_adcs) {
+      fPending[offline_chan] += n_adcs;
+    }
+
+    //Same as MakeWaveform with is_stream, but reserves room for all the
+    //counted samples the first time the channel is seen
+    raw::OpDetWaveform & MakeWaveform(
+      unsigned int offline_chan,
+      raw::TimeStamp_t timestamp,
+      std::unordered_map<unsigned int, WaveformVector> & wf_map);
+
+    //Append the n_adcs samples in adcs to the waveform
+    void Append(raw::OpDetWaveform & waveform,
+                const raw::ADC_Count_t * adcs, size_t n_adcs) {
+      waveform.insert(waveform.end(), adcs, adcs + n_adcs);
+    }
+
+    //Forget the counts, e.g. at the end of the event
+    void Clear() { fPending.clear(); }
+
+   private:
+    //Samples counted and not yet reserved, per channel
+    std::unordered_map<unsigned int, size_t> fPending;
+  };
 }
 }
 
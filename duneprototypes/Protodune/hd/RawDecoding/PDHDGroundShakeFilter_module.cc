@@ -1,6 +1,9 @@
 #include <iostream>
 #include <utility>
 #include <set>
+#include <map>
+#include <algorithm>
+#include <memory>
 
 #include "art/Framework/Core/EDAnalyzer.h" 
 #include "art/Framework/Core/EDFilter.h" 
@@ -13,14 +16,22 @@
 #include "duneprototypes/Protodune/hd/ChannelMap/PD2HDChannelMapService.h"
 
 #include <bitset>
-#include "TH1F.h"
-#include "TH2F.h"
 
 
 namespace pdhd {
 
 using RawDigitVector = std::vector<raw::RawDigit>;
 
+// Flags events with ground shake noise: a coherent shift of the baseline on
+// many channels at once.  The pedestal-subtracted ADC values are summed over
+// channels for each tick, and an event is rejected if max - min of that sum
+// exceeds the threshold.
+//
+// The sum is made over all channels (GroupBy: "All", the original behavior)
+// or separately for each APA ("APA") or each APA and plane ("Plane"), in which
+// case the event is rejected if any group is over its threshold.  The per-tick
+// sums may be saved as std::vector<float> products, one per group.
+
 class PDHDGroundShakeFilter : public art::EDFilter {
  public:
   explicit PDHDGroundShakeFilter(fhicl::ParameterSet const & pset);
@@ -28,63 +39,162 @@ class PDHDGroundShakeFilter : public art::EDFilter {
   virtual bool filter(art::Event& e);
 
  private:
+  unsigned int fLogLevel;
   std::string fRawDigitLabel;
+  std::string fGroupBy;
+  double fThreshold;
+  std::vector<double> fPlaneThresholds;  // U, V, X thresholds for GroupBy: "Plane"
+  bool fSavePerTickSum;
+
+  // group of each offline channel, -1 if not used (not used for GroupBy: "All")
+  std::vector<int> fChanGroup;
+  std::vector<std::string> fGroupNames;
+  std::vector<double> fGroupThresholds;
 
+  // per-event work areas, kept to avoid reallocating them
+  std::vector<int> fDigitIndex;
+  std::vector<double> fSums;
 
 };
 
+//**********************************************************************
+
+namespace {
+
+// Add the pedestal-subtracted samples of one channel to the per-tick sums.
+// Each value is rounded to float, as it was when the sum was made by filling
+// and projecting a TH2F, and accumulated in double in channel order, so the
+// sums are identical to those of the histogram implementation.
+void addChannel(const short* adcs, size_t nticks, float pedestal, double* sums) {
+  for (size_t itck = 0; itck < nticks; ++itck) {
+    sums[itck] += float(adcs[itck] - pedestal);
+  }
+}
+
+}  // end unnamed namespace
+
+//**********************************************************************
+
 PDHDGroundShakeFilter::PDHDGroundShakeFilter::PDHDGroundShakeFilter(fhicl::ParameterSet const & pset):
   EDFilter(pset),
-  fRawDigitLabel(pset.get<std::string>("RawDigitLabel")){}
+  fLogLevel(pset.get<unsigned int>("LogLevel", 0)),
+  fRawDigitLabel(pset.get<std::string>("RawDigitLabel")),
+  fGroupBy(pset.get<std::string>("GroupBy", "All")),
+  fThreshold(pset.get<double>("Threshold", 1e7)),
+  fPlaneThresholds(pset.get<std::vector<double>>("PlaneThresholds", {})),
+  fSavePerTickSum(pset.get<bool>("SavePerTickSum", false)) {
+
+  if (fGroupBy == "All") {
+    fGroupNames.push_back("all");
+    fGroupThresholds.push_back(fThreshold);
+  }
+  else if (fGroupBy == "APA" || fGroupBy == "Plane") {
+    bool byPlane = (fGroupBy == "Plane");
+    if (byPlane && !fPlaneThresholds.empty() && fPlaneThresholds.size() != 3) {
+      throw cet::exception("PDHDGroundShakeFilter") << "PlaneThresholds must have 3 entries (U, V, X)\n";
+    }
+    std::vector<unsigned int> apas = pset.get<std::vector<unsigned int>>("APAs", {});
+    std::vector<unsigned int> planes = pset.get<std::vector<unsigned int>>("Planes", {});
+
+    // The APA number is the crate number in the channel map.
+    art::ServiceHandle<dune::PD2HDChannelMapService> channelMap;
+    unsigned int nchan = channelMap->GetNChannels();
+    fChanGroup.assign(nchan, -1);
+    std::map<std::pair<unsigned int, unsigned int>, int> groupIndex;
+    for (unsigned int ichan = 0; ichan < nchan; ++ichan) {
+      auto info = channelMap->GetChanInfoFromOfflChan(ichan);
+      if (!info.valid) continue;
+      if (!apas.empty() && std::find(apas.begin(), apas.end(), info.crate) == apas.end()) continue;
+      if (!planes.empty() && std::find(planes.begin(), planes.end(), info.plane) == planes.end()) continue;
+      std::pair<unsigned int, unsigned int> key(info.crate, byPlane ? info.plane : 0);
+      auto ins = groupIndex.emplace(key, 0);
+      if (ins.second) {
+        ins.first->second = fGroupNames.size();
+        std::string name = "apa" + std::to_string(info.crate);
+        if (byPlane) name += "plane" + std::to_string(info.plane);
+        fGroupNames.push_back(name);
+        double thresh = fThreshold;
+        if (byPlane && info.plane < fPlaneThresholds.size()) thresh = fPlaneThresholds[info.plane];
+        fGroupThresholds.push_back(thresh);
+      }
+      fChanGroup[ichan] = ins.first->second;
+    }
+    if (fGroupNames.empty()) {
+      throw cet::exception("PDHDGroundShakeFilter") << "No channels selected by APAs and Planes\n";
+    }
+  }
+  else {
+    throw cet::exception("PDHDGroundShakeFilter") << "Invalid GroupBy: " << fGroupBy
+                                                  << ". Use All, APA or Plane.\n";
+  }
 
+  if (fSavePerTickSum) {
+    for (const std::string& name : fGroupNames) produces<std::vector<float>>(name);
+  }
+}
 
-bool PDHDGroundShakeFilter::filter(art::Event & evt) {
 
+bool PDHDGroundShakeFilter::filter(art::Event & evt) {
 
-  // auto const &rawdigits = *evt.getValidHandle<vector<raw::RawDigit>>(rawdigits_tag);
-  auto &rawdigits = *evt.getValidHandle<RawDigitVector>(fRawDigitLabel);
+  auto const &rawdigits = *evt.getValidHandle<RawDigitVector>(fRawDigitLabel);
   if (rawdigits.empty())
         {
             std::cout << "WARNING: no RawDigit found." << std::endl;
             return false;
         }  
 
-  const int nticks = rawdigits[0].Samples();
-  const int nchans = rawdigits.size();
-  // int Event_ = evt.id().event();
-  // std::cout<<"evt = "<<m_Event<<std::endl;
-  // std::cout<<"nticks = "<<nticks<<std::endl;
-  // std::cout<<"nchans = "<<nchans<<std::endl;
-  TH2F *h_orig = new TH2F("h_orig", "RawDigits", nchans, -0.5, nchans - 0.5, nticks, 0, nticks);
-
-  for (auto rd : rawdigits){
-            int channel = rd.Channel();
-            // int nSamples = rd.Samples();
-            for (int j = 0; j < nticks; j++)
-            {
-                h_orig->SetBinContent(channel + 1, j + 1, rd.ADC(j) - rd.GetPedestal());
-            }
-  } // end of rawdigits
-
-  // Project all channels to 1D.
-  TH1F *hhh = new TH1F("hhh","hhh",nticks,0,nticks);
-  for(int j=0;j<nticks;j++){
-      TH1F *h1 = (TH1F *)h_orig->ProjectionX("proj_x", j+1, j+1);
-      h1->SetDirectory(0);
-      int val = h1->Integral();
-      hhh->SetBinContent(j+1,val);
-      delete h1;
+  const size_t nticks = rawdigits[0].Samples();
+  const size_t ngroups = fGroupNames.size();
+
+  // Channels outside the range [0, nchan) are ignored.  For GroupBy: "All"
+  // nchan is the number of raw digits.  If a channel appears more than once
+  // only its last raw digit is used.
+
+  bool all = fChanGroup.empty();
+  size_t nchan = all ? rawdigits.size() : fChanGroup.size();
+  fDigitIndex.assign(nchan, -1);
+  for (size_t idig = 0; idig < rawdigits.size(); ++idig) {
+    raw::ChannelID_t chan = rawdigits[idig].Channel();
+    if (chan < nchan) fDigitIndex[chan] = idig;
   }
-  double diff = hhh->GetMaximum()-hhh->GetMinimum();
-  //cout<<"diff = "<<hhh->GetMaximum()-hhh->GetMinimum()<<endl;
-  delete hhh;
-  delete h_orig;
-  if(diff>1e7){
-        std::cout<<"found! Groud shake noise at Evt "<<evt.id().event()<<std::endl;
-        return false;
+
+  fSums.assign(ngroups*nticks, 0.0);
+  for (size_t ichan = 0; ichan < nchan; ++ichan) {
+    int idig = fDigitIndex[ichan];
+    if (idig < 0) continue;
+    int igrp = all ? 0 : fChanGroup[ichan];
+    if (igrp < 0) continue;
+    const raw::RawDigit& rd = rawdigits[idig];
+    const raw::RawDigit::ADCvector_t& adcs = rd.ADCs();
+    addChannel(adcs.data(), std::min(nticks, adcs.size()), rd.GetPedestal(), &fSums[igrp*nticks]);
+  }
+
+  // The per-tick sums are truncated to int and then stored as float before
+  // max - min is taken, as was done in the histogram implementation.
+
+  bool pass = true;
+  for (size_t igrp = 0; igrp < ngroups; ++igrp) {
+    std::vector<float> tickSums(nticks);
+    for (size_t itck = 0; itck < nticks; ++itck) tickSums[itck] = int(fSums[igrp*nticks + itck]);
+    double diff = 0.0;
+    if (nticks > 0) {
+      auto mm = std::minmax_element(tickSums.begin(), tickSums.end());
+      diff = double(*mm.second) - double(*mm.first);
+    }
+    if (fLogLevel > 0) {
+      std::cout << "PDHDGroundShakeFilter: " << fGroupNames[igrp] << " max - min = " << diff << std::endl;
+    }
+    if (diff > fGroupThresholds[igrp]) {
+      std::cout<<"found! Groud shake noise at Evt "<<evt.id().event();
+      if (!all) std::cout << " in " << fGroupNames[igrp];
+      std::cout << std::endl;
+      pass = false;
+    }
+    if (fSavePerTickSum) {
+      evt.put(std::make_unique<std::vector<float>>(std::move(tickSums)), fGroupNames[igrp]);
+    }
   }
-  // std::cout<<"Groud shake noise filter applied"<<std::endl;
-  return true;
+  return pass;
 }
 
 
@@ -49,14 +49,22 @@ public:
 
 private:
   std::string fInputLabel, fOutputLabel;
+  // If not empty, also put a time stamp under this instance whose flags hold
+  // the DAQ trigger type of the record, so that the trigger filters can select
+  // events before the TPC data are decoded.  These are not the timing-system
+  // codes (12 beam, 13 CRT) of the main product, which keeps zero flags.
+  std::string fTriggerTypeLabel;
 };
 }
 
 pdhd::PDHDTimingRawDecoder::PDHDTimingRawDecoder(fhicl::ParameterSet const& p)
   : EDProducer{p},
     fInputLabel(p.get<std::string>("InputLabel", "daq")),
-    fOutputLabel(p.get<std::string>("OutputLabel")) {
+    fOutputLabel(p.get<std::string>("OutputLabel")),
+    fTriggerTypeLabel(p.get<std::string>("TriggerTypeLabel", "")) {
   produces<std::vector<raw::RDTimeStamp>> (fOutputLabel);
+  if (!fTriggerTypeLabel.empty())
+    produces<std::vector<raw::RDTimeStamp>> (fTriggerTypeLabel);
 }
 
 void pdhd::PDHDTimingRawDecoder::produce(art::Event& event) {
@@ -83,6 +91,15 @@ void pdhd::PDHDTimingRawDecoder::produce(art::Event& event) {
   //Put it in the art event
   event.put(std::make_unique<std::vector<raw::RDTimeStamp>>(
       std::move(timestamps)), fOutputLabel);
+
+  if (!fTriggerTypeLabel.empty()) {
+    std::vector<raw::RDTimeStamp> trigtypes = {
+        raw::RDTimeStamp(trh_ptr->get_trigger_timestamp(),
+                         trh_ptr->get_trigger_type())
+    };
+    event.put(std::make_unique<std::vector<raw::RDTimeStamp>>(
+        std::move(trigtypes)), fTriggerTypeLabel);
+  }
 }
 
 DEFINE_ART_MODULE(pdhd::PDHDTimingRawDecoder)
@@ -0,0 +1,195 @@
+// WIBEthUnpack.h
+//
+// Bulk unpacker for the 14-bit ADC payload of a WIBEth frame.
+//
+// WIBEthFrame::get_adc(ichan, isample) extracts one value at a time from the
+// packed payload.  The functions here unpack the whole 64 channel x 64 sample
+// payload of a frame in one go into a channel-major tile:
+//
+//   tile[ichan*kSamples + isample] == frame->get_adc(ichan, isample)
+//
+// The payload is 64 rows (one per sample) of 14 little-endian 64-bit words,
+// i.e. 112 bytes per row holding 64 consecutive 14-bit values.  Four values
+// fill exactly 7 bytes, so a row is unpacked in groups of 4 channels.
+//
+// Three kernels are provided: a portable scalar one, an SSE4.2 one and an
+// AVX2 one.  The vector kernels are compiled with function-level target
+// attributes so that the library itself does not have to be built with
+// -mavx2; the best kernel supported by the running CPU is selected at first
+// use.  All kernels are bit-exact with WIBEthFrame::get_adc.
+
+#ifndef WIBEthUnpack_H
+#define WIBEthUnpack_H
+
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+#if defined(__x86_64__) && defined(__GNUC__)
+#define WIBETHUNPACK_X86 1
+#include <immintrin.h>
+#endif
+
+namespace pdhd {
+namespace rawdecoding {
+namespace wibeth {
+
+  constexpr unsigned int kChannels = 64;
+  constexpr unsigned int kSamples = 64;
+  constexpr unsigned int kBitsPerAdc = 14;
+  constexpr unsigned int kBytesPerRow = kChannels*kBitsPerAdc/8;   // 112
+  constexpr unsigned int kPayloadBytes = kSamples*kBytesPerRow;     // 7168
+  constexpr uint16_t kAdcMask = 0x3FFF;
+
+  // Vector kernels read up to this many bytes past the end of a row.
+  constexpr unsigned int kRowOverread = 16;
+
+  enum class Kernel { Auto, Scalar, SSE42, AVX2 };
+
+  //**********************************************************************
+
+  // Unpack one row of 64 values into out[0..63] (sample-major).
+  inline void unpackRowScalar(const uint8_t* row, uint16_t* out) {
+    for (unsigned int igrp = 0; igrp < kChannels/4; ++igrp) {
+      const uint8_t* p = row + 7*igrp;
+      uint64_t w = 0;
+      for (unsigned int ibyt = 0; ibyt < 7; ++ibyt) w |= uint64_t(p[ibyt]) << (8*ibyt);
+      out[4*igrp + 0] = w & kAdcMask;
+      out[4*igrp + 1] = (w >> 14) & kAdcMask;
+      out[4*igrp + 2] = (w >> 28) & kAdcMask;
+      out[4*igrp + 3] = (w >> 42) & kAdcMask;
+    }
+  }
+
+#ifdef WIBETHUNPACK_X86
+
+  // SSE4.2 row kernel.  Each 32-bit lane receives the 4 bytes that hold one
+  // channel; the per-lane bit offsets (0, 6, 4, 2) are equalised with a
+  // multiply by (64, 1, 4, 16) followed by a uniform shift right by 6.
+  __attribute__((target("sse4.2")))
+  inline void unpackRowSSE42(const uint8_t* row, uint16_t* out) {
+    const __m128i shuf = _mm_setr_epi8(0,1,2,3, 1,2,3,4, 3,4,5,6, 5,6,7,8);
+    const __m128i mult = _mm_setr_epi32(64, 1, 4, 16);
+    const __m128i mask = _mm_set1_epi32(kAdcMask);
+    for (unsigned int igrp = 0; igrp < kChannels/4; igrp += 2) {
+      __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(row + 7*igrp));
+      __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(row + 7*igrp + 7));
+      a = _mm_and_si128(_mm_srli_epi32(_mm_mullo_epi32(_mm_shuffle_epi8(a, shuf), mult), 6), mask);
+      b = _mm_and_si128(_mm_srli_epi32(_mm_mullo_epi32(_mm_shuffle_epi8(b, shuf), mult), 6), mask);
+      _mm_storeu_si128(reinterpret_cast<__m128i*>(out + 4*igrp), _mm_packus_epi32(a, b));
+    }
+  }
+
+  // AVX2 row kernel.  Same byte shuffle as the SSE kernel, applied to two
+  // 7-byte groups per 256-bit register, with a variable shift per lane.
+  __attribute__((target("avx2")))
+  inline void unpackRowAVX2(const uint8_t* row, uint16_t* out) {
+    const __m256i shuf = _mm256_setr_epi8(0,1,2,3, 1,2,3,4, 3,4,5,6, 5,6,7,8,
+                                          0,1,2,3, 1,2,3,4, 3,4,5,6, 5,6,7,8);
+    const __m256i shift = _mm256_setr_epi32(0, 6, 4, 2, 0, 6, 4, 2);
+    const __m256i mask = _mm256_set1_epi32(kAdcMask);
+    for (unsigned int igrp = 0; igrp < kChannels/4; igrp += 4) {
+      // a holds channels 4*igrp + 0..7, b holds 4*igrp + 8..15
+      const uint8_t* p = row + 7*igrp;
+      __m256i a = _mm256_castsi128_si256(_mm_loadu_si128(reinterpret_cast<const __m128i*>(p)));
+      __m256i b = _mm256_castsi128_si256(_mm_loadu_si128(reinterpret_cast<const __m128i*>(p + 14)));
+      a = _mm256_inserti128_si256(a, _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + 7)), 1);
+      b = _mm256_inserti128_si256(b, _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + 21)), 1);
+      a = _mm256_and_si256(_mm256_srlv_epi32(_mm256_shuffle_epi8(a, shuf), shift), mask);
+      b = _mm256_and_si256(_mm256_srlv_epi32(_mm256_shuffle_epi8(b, shuf), shift), mask);
+      __m256i p16 = _mm256_permute4x64_epi64(_mm256_packus_epi32(a, b), 0xD8);
+      _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + 4*igrp), p16);
+    }
+  }
+
+  // Transpose an 8x8 block of 16-bit values (SSE2, always available on x86-64).
+  inline void transpose8x8(const uint16_t* src, unsigned int sstride,
+                           uint16_t* dst, unsigned int dstride) {
+    __m128i r[8];
+    for (unsigned int i = 0; i < 8; ++i) r[i] = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i*sstride));
+    __m128i a0 = _mm_unpacklo_epi16(r[0], r[1]), a1 = _mm_unpackhi_epi16(r[0], r[1]);
+    __m128i a2 = _mm_unpacklo_epi16(r[2], r[3]), a3 = _mm_unpackhi_epi16(r[2], r[3]);
+    __m128i a4 = _mm_unpacklo_epi16(r[4], r[5]), a5 = _mm_unpackhi_epi16(r[4], r[5]);
+    __m128i a6 = _mm_unpacklo_epi16(r[6], r[7]), a7 = _mm_unpackhi_epi16(r[6], r[7]);
+    __m128i b0 = _mm_unpacklo_epi32(a0, a2), b1 = _mm_unpackhi_epi32(a0, a2);
+    __m128i b2 = _mm_unpacklo_epi32(a1, a3), b3 = _mm_unpackhi_epi32(a1, a3);
+    __m128i b4 = _mm_unpacklo_epi32(a4, a6), b5 = _mm_unpackhi_epi32(a4, a6);
+    __m128i b6 = _mm_unpacklo_epi32(a5, a7), b7 = _mm_unpackhi_epi32(a5, a7);
+    r[0] = _mm_unpacklo_epi64(b0, b4); r[1] = _mm_unpackhi_epi64(b0, b4);
+    r[2] = _mm_unpacklo_epi64(b1, b5); r[3] = _mm_unpackhi_epi64(b1, b5);
+    r[4] = _mm_unpacklo_epi64(b2, b6); r[5] = _mm_unpackhi_epi64(b2, b6);
+    r[6] = _mm_unpacklo_epi64(b3, b7); r[7] = _mm_unpackhi_epi64(b3, b7);
+    for (unsigned int i = 0; i < 8; ++i) _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i*dstride), r[i]);
+  }
+
+#endif
+
+  //**********************************************************************
+
+  using RowKernel = void (*)(const uint8_t*, uint16_t*);
+
+  // Return the row kernel for the requested implementation.  Auto (and any
+  // kernel not supported by this CPU) resolves to the best available one.
+  inline RowKernel rowKernel(Kernel ker =Kernel::Auto) {
+#ifdef WIBETHUNPACK_X86
+    static const bool haveAVX2 = __builtin_cpu_supports("avx2");
+    static const bool haveSSE42 = __builtin_cpu_supports("sse4.2");
+    if (ker == Kernel::Scalar) return unpackRowScalar;
+    if (ker == Kernel::SSE42 && haveSSE42) return unpackRowSSE42;
+    if (haveAVX2 && ker != Kernel::SSE42) return unpackRowAVX2;
+    if (haveSSE42) return unpackRowSSE42;
+#endif
+    (void) ker;
+    return unpackRowScalar;
+  }
+
+  // Unpack the full payload of one frame into a channel-major tile.
+  // payload points to the first ADC word (e.g. &frame->adc_words[0][0]) and
+  // must hold kPayloadBytes bytes; no byte beyond that is read.
+  inline void unpackFrame(const void* payload, uint16_t* tile, Kernel ker =Kernel::Auto) {
+    const uint8_t* pay = static_cast<const uint8_t*>(payload);
+    RowKernel unpackRow = rowKernel(ker);
+    alignas(32) uint16_t rows[kSamples*kChannels];   // sample-major
+    for (unsigned int isam = 0; isam + 1 < kSamples; ++isam) {
+      unpackRow(pay + isam*kBytesPerRow, rows + isam*kChannels);
+    }
+    // The vector kernels read past the end of the row so the last one is
+    // staged in a padded buffer rather than reading beyond the payload.
+    uint8_t last[kBytesPerRow + kRowOverread] = {0};
+    std::memcpy(last, pay + (kSamples - 1)*kBytesPerRow, kBytesPerRow);
+    unpackRow(last, rows + (kSamples - 1)*kChannels);
+#ifdef WIBETHUNPACK_X86
+    for (unsigned int isam = 0; isam < kSamples; isam += 8) {
+      for (unsigned int icha = 0; icha < kChannels; icha += 8) {
+        transpose8x8(rows + isam*kChannels + icha, kChannels, tile + icha*kSamples + isam, kSamples);
+      }
+    }
+#else
+    for (unsigned int isam = 0; isam < kSamples; ++isam) {
+      for (unsigned int icha = 0; icha < kChannels; ++icha) {
+        tile[icha*kSamples + isam] = rows[isam*kChannels + icha];
+      }
+    }
+#endif
+  }
+
+  // Append samples [firstSample, lastSample) of every channel in a tile to
+  // the corresponding per-channel vector.  The range is clipped to the frame.
+  template<class ADCVector>
+  void appendTile(const uint16_t* tile, int firstSample, int lastSample,
+                  std::vector<ADCVector>& adcs) {
+    if (firstSample < 0) firstSample = 0;
+    if (lastSample > int(kSamples)) lastSample = kSamples;
+    if (lastSample <= firstSample) return;
+    unsigned int ncha = adcs.size() < kChannels ? adcs.size() : kChannels;
+    for (unsigned int icha = 0; icha < ncha; ++icha) {
+      const uint16_t* src = tile + icha*kSamples;
+      adcs[icha].insert(adcs[icha].end(), src + firstSample, src + lastSample);
+    }
+  }
+
+}  // namespace wibeth
+}  // namespace rawdecoding
+}  // namespace pdhd
+
+#endif
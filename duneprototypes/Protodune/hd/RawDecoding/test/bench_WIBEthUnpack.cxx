@@ -0,0 +1,71 @@
+// bench_WIBEthUnpack.cxx
+//
+// Throughput of WIBEthFrame::get_adc compared with the bulk WIBEth unpackers.
+// Usage: bench_WIBEthUnpack [NFRAME] [NREP]
+
+#include <string>
+#include <iostream>
+#include <iomanip>
+#include <random>
+#include <vector>
+#include <chrono>
+#include "detdataformats/wibeth/WIBEthFrame.hpp"
+#include "duneprototypes/Protodune/hd/RawDecoding/WIBEthUnpack.h"
+
+using std::string;
+using std::cout;
+using std::endl;
+using dunedaq::fddetdataformats::WIBEthFrame;
+namespace wibeth = pdhd::rawdecoding::wibeth;
+using Clock = std::chrono::steady_clock;
+
+int main(int argc, char* argv[]) {
+  const string myname = "bench_WIBEthUnpack: ";
+  unsigned int nframe = argc > 1 ? std::stoi(argv[1]) : 1000;
+  unsigned int nrep = argc > 2 ? std::stoi(argv[2]) : 20;
+
+  std::mt19937_64 gen(1);
+  std::vector<WIBEthFrame> frames(nframe);
+  for ( WIBEthFrame& frame : frames ) {
+    uint64_t* pw = &frame.adc_words[0][0];
+    for ( unsigned int iwrd=0; iwrd<wibeth::kPayloadBytes/8; ++iwrd ) pw[iwrd] = gen();
+  }
+  const double mbytes = 1.e-6*nframe*nrep*wibeth::kPayloadBytes;
+  std::vector<std::vector<short>> adcs(64);
+  for ( auto& adc : adcs ) adc.reserve(64*nframe);
+  long sum = 0;
+
+  auto report = [&](string name, Clock::time_point t0) {
+    double sec = std::chrono::duration<double>(Clock::now() - t0).count();
+    cout << myname << std::setw(10) << name << ": " << std::setw(9) << std::fixed << std::setprecision(1)
+         << mbytes/sec << " MB/s" << endl;
+  };
+
+  auto t0 = Clock::now();
+  for ( unsigned int irep=0; irep<nrep; ++irep ) {
+    for ( auto& adc : adcs ) adc.clear();
+    for ( const WIBEthFrame& frame : frames ) {
+      for ( int icha=0; icha<64; ++icha ) {
+        for ( int isam=0; isam<64; ++isam ) adcs[icha].push_back(frame.get_adc(icha, isam));
+      }
+    }
+    sum += adcs[63].back();
+  }
+  report("get_adc", t0);
+
+  std::vector<uint16_t> tile(wibeth::kChannels*wibeth::kSamples);
+  for ( wibeth::Kernel ker : { wibeth::Kernel::Scalar, wibeth::Kernel::SSE42, wibeth::Kernel::AVX2 } ) {
+    t0 = Clock::now();
+    for ( unsigned int irep=0; irep<nrep; ++irep ) {
+      for ( auto& adc : adcs ) adc.clear();
+      for ( const WIBEthFrame& frame : frames ) {
+        wibeth::unpackFrame(&frame.adc_words[0][0], tile.data(), ker);
+        wibeth::appendTile(tile.data(), 0, 64, adcs);
+      }
+      sum += adcs[63].back();
+    }
+    report(ker == wibeth::Kernel::Scalar ? "scalar" : ker == wibeth::Kernel::SSE42 ? "sse4.2" : "avx2", t0);
+  }
+  cout << myname << "Checksum: " << sum << endl;
+  return 0;
+}
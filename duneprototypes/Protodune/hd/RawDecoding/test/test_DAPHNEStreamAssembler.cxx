@@ -0,0 +1,123 @@
+// test_DAPHNEStreamAssembler.cxx
+//
+// Check that the DAPHNE stream assembler builds the same waveforms as
+// appending frame by frame with MakeWaveform, with one allocation for each.
+
+#include <string>
+#include <iostream>
+#include <random>
+#include <algorithm>
+#include <array>
+#include <vector>
+#include <cstring>
+#include <unordered_map>
+#include "duneprototypes/Protodune/hd/RawDecoding/DAPHNEUtils.h"
+
+#undef NDEBUG
+#include <cassert>
+
+using std::string;
+using std::cout;
+using std::endl;
+using std::vector;
+using StreamFrame = dunedaq::fddetdataformats::Daphnestreamframe2;
+using WaveformMap = std::unordered_map<unsigned int, daphne::WaveformVector>;
+namespace utils = daphne::utils;
+
+//**********************************************************************
+
+int test_DAPHNEStreamAssembler(unsigned int nframe =500) {
+  const string myname = "test_DAPHNEStreamAssembler: ";
+#ifdef NDEBUG
+  cout << myname << "NDEBUG must be off." << endl;
+  abort();
+#endif
+  string line = "-----------------------------";
+
+  // Random frames, each for 4 of 10 channels. One channel is the unmapped -1.
+  std::mt19937 gen(20231018);
+  vector<StreamFrame> frames(nframe);
+  vector<std::array<int, 4>> chans(nframe);
+  const std::array<int, 10> offline = {-1, 100, 101, 102, 103, 200, 201, 202, 203, 300};
+  for ( unsigned int ifrm=0; ifrm<nframe; ++ifrm ) {
+    uint8_t* pb = reinterpret_cast<uint8_t*>(&frames[ifrm]);
+    for ( size_t ibyt=0; ibyt<sizeof(StreamFrame); ++ibyt ) pb[ibyt] = gen() & 0xff;
+    for ( int& chan : chans[ifrm] ) chan = offline[gen() % offline.size()];
+  }
+  const size_t nadc = StreamFrame::s_adcs_per_channel;
+
+  cout << myname << line << endl;
+  cout << myname << "Checking frame unpacking." << endl;
+  vector<raw::ADC_Count_t> adcs(StreamFrame::s_channels_per_frame*nadc);
+  for ( const StreamFrame& frame : frames ) {
+    utils::UnpackStreamFrame(frame, adcs.data());
+    for ( size_t icha=0; icha<StreamFrame::s_channels_per_frame; ++icha ) {
+      for ( size_t iadc=0; iadc<nadc; ++iadc ) assert( adcs[icha*nadc + iadc] == frame.get_adc(iadc, icha) );
+    }
+  }
+
+  cout << myname << line << endl;
+  cout << myname << "Checking assembly of " << nframe << " frames." << endl;
+  WaveformMap expmap;
+  // A self-triggered waveform on one channel: the stream is appended to it.
+  utils::MakeWaveform(300, 3, 7, expmap).push_back(42);
+  expmap.at(300).back().push_back(43);
+  WaveformMap wfmap = expmap;
+  for ( unsigned int ifrm=0; ifrm<nframe; ++ifrm ) {
+    utils::UnpackStreamFrame(frames[ifrm], adcs.data());
+    for ( size_t icha=0; icha<4; ++icha ) {
+      auto& wf = utils::MakeWaveform(chans[ifrm][icha], nadc, 1000 + ifrm, expmap, true);
+      for ( size_t iadc=0; iadc<nadc; ++iadc ) wf.push_back(adcs[icha*nadc + iadc]);
+    }
+  }
+  utils::StreamAssembler assembler;
+  for ( unsigned int ifrm=0; ifrm<nframe; ++ifrm ) {
+    for ( int chan : chans[ifrm] ) assembler.Count(chan, nadc);
+  }
+  for ( unsigned int ifrm=0; ifrm<nframe; ++ifrm ) {
+    utils::UnpackStreamFrame(frames[ifrm], adcs.data());
+    for ( size_t icha=0; icha<4; ++icha ) {
+      auto& wf = assembler.MakeWaveform(chans[ifrm][icha], 1000 + ifrm, wfmap);
+      size_t capacity = wf.capacity();
+      assembler.Append(wf, adcs.data() + icha*nadc, nadc);
+      assert( wf.capacity() == capacity );
+    }
+  }
+  assembler.Clear();
+  assert( wfmap.size() == expmap.size() );
+  for ( const auto& ent : expmap ) {
+    const daphne::WaveformVector& wfs = wfmap.at(ent.first);
+    assert( wfs.size() == ent.second.size() );
+    for ( size_t iwf=0; iwf<wfs.size(); ++iwf ) {
+      const raw::OpDetWaveform& wf = wfs[iwf];
+      const raw::OpDetWaveform& expwf = ent.second[iwf];
+      assert( wf.ChannelNumber() == expwf.ChannelNumber() );
+      assert( wf.TimeStamp() == expwf.TimeStamp() );
+      assert( wf.size() == expwf.size() );
+      assert( wf.capacity() == wf.size() );
+      assert( std::equal(wf.begin(), wf.end(), expwf.begin()) );
+    }
+    cout << myname << "  Channel " << int(ent.first) << ": " << wfs.back().size() << " samples" << endl;
+  }
+
+  cout << myname << line << endl;
+  cout << myname << "Done." << endl;
+  return 0;
+}
+
+//**********************************************************************
+
+int main(int argc, char* argv[]) {
+  unsigned int nframe = 500;
+  if ( argc > 1 ) {
+    string sarg(argv[1]);
+    if ( sarg == "-h" ) {
+      cout << "Usage: " << argv[0] << " [NFRAME]" << endl;
+      return 0;
+    }
+    nframe = std::stoi(sarg);
+  }
+  return test_DAPHNEStreamAssembler(nframe);
+}
+
+//**********************************************************************
@@ -0,0 +1,94 @@
+// test_WIBEthUnpack.cxx
+//
+// Check that the bulk WIBEth unpackers are bit-exact with WIBEthFrame::get_adc.
+
+#include <string>
+#include <iostream>
+#include <random>
+#include <vector>
+#include <cstring>
+#include "detdataformats/wibeth/WIBEthFrame.hpp"
+#include "duneprototypes/Protodune/hd/RawDecoding/WIBEthUnpack.h"
+
+#undef NDEBUG
+#include <cassert>
+
+using std::string;
+using std::cout;
+using std::endl;
+using dunedaq::fddetdataformats::WIBEthFrame;
+namespace wibeth = pdhd::rawdecoding::wibeth;
+
+//**********************************************************************
+
+int test_WIBEthUnpack(unsigned int nframe =200) {
+  const string myname = "test_WIBEthUnpack: ";
+#ifdef NDEBUG
+  cout << myname << "NDEBUG must be off." << endl;
+  abort();
+#endif
+  string line = "-----------------------------";
+
+  std::mt19937_64 gen(12345);
+  std::vector<WIBEthFrame> frames(nframe);
+  for ( WIBEthFrame& frame : frames ) {
+    uint64_t* pw = &frame.adc_words[0][0];
+    for ( unsigned int iwrd=0; iwrd<wibeth::kPayloadBytes/8; ++iwrd ) pw[iwrd] = gen();
+  }
+  // Frames with all bits set or cleared catch masking errors.
+  std::memset(&frames[0].adc_words[0][0], 0xff, wibeth::kPayloadBytes);
+  std::memset(&frames[1].adc_words[0][0], 0x00, wibeth::kPayloadBytes);
+
+  for ( wibeth::Kernel ker : { wibeth::Kernel::Scalar, wibeth::Kernel::SSE42,
+                               wibeth::Kernel::AVX2, wibeth::Kernel::Auto } ) {
+    cout << myname << line << endl;
+    cout << myname << "Checking kernel " << int(ker) << endl;
+    std::vector<uint16_t> tile(wibeth::kChannels*wibeth::kSamples);
+    unsigned int nbad = 0;
+    for ( const WIBEthFrame& frame : frames ) {
+      wibeth::unpackFrame(&frame.adc_words[0][0], tile.data(), ker);
+      for ( int icha=0; icha<64; ++icha ) {
+        for ( int isam=0; isam<64; ++isam ) {
+          if ( tile[icha*64 + isam] != frame.get_adc(icha, isam) ) ++nbad;
+        }
+      }
+    }
+    cout << myname << "Mismatches: " << nbad << endl;
+    assert( nbad == 0 );
+  }
+
+  cout << myname << line << endl;
+  cout << myname << "Checking partial append." << endl;
+  std::vector<uint16_t> tile(wibeth::kChannels*wibeth::kSamples);
+  wibeth::unpackFrame(&frames[2].adc_words[0][0], tile.data());
+  std::vector<std::vector<short>> adcs(64);
+  wibeth::appendTile(tile.data(), 5, 40, adcs);
+  wibeth::appendTile(tile.data(), 30, 20, adcs);
+  wibeth::appendTile(tile.data(), 60, 80, adcs);
+  for ( int icha=0; icha<64; ++icha ) {
+    assert( adcs[icha].size() == 39 );
+    for ( int isam=5; isam<40; ++isam ) assert( adcs[icha][isam-5] == frames[2].get_adc(icha, isam) );
+    for ( int isam=60; isam<64; ++isam ) assert( adcs[icha][isam-25] == frames[2].get_adc(icha, isam) );
+  }
+
+  cout << myname << line << endl;
+  cout << myname << "Done." << endl;
+  return 0;
+}
+
+//**********************************************************************
+
+int main(int argc, char* argv[]) {
+  unsigned int nframe = 200;
+  if ( argc > 1 ) {
+    string sarg(argv[1]);
+    if ( sarg == "-h" ) {
+      cout << "Usage: " << argv[0] << " [NFRAME]" << endl;
+      return 0;
+    }
+    nframe = std::stoi(sarg);
+  }
+  return test_WIBEthUnpack(nframe);
+}
+
+//**********************************************************************
@@ -27,11 +27,16 @@
 #include "duneprototypes/Protodune/singlephase/CTB/data/pdspctb.h"
 #include "lardataobj/RawData/RDTimeStamp.h"
 #include "dunecore/DuneObj/ProtoDUNETimeStamp.h"
+#include "duneprototypes/Protodune/singlephase/BeamReco/BeamSnapshot.h"
+#include "duneprototypes/Protodune/singlephase/BeamReco/BeamTriggerIndex.h"
+#include "duneprototypes/Protodune/singlephase/BeamReco/BeamTOFMatcher.h"
 #include <bitset>
 #include <iomanip>
 #include <utility>
 #include <algorithm>
 #include <limits>
+#include <map>
+#include <tuple>
 
 #include "TTree.h"
 #include "TH2F.h"
@@ -72,6 +77,7 @@ public:
 
   // Selected optional functions.
   void beginJob() override;
+  void endJob() override;
 
   uint64_t joinHighLow(double,double);
 
@@ -106,6 +112,9 @@ public:
 
   void getS11Info(uint64_t);
 
+  void FillFolderCaches(uint64_t);
+  void IndexTriggers();
+
   std::vector<double> FetchAndReport(
       long long, std::string,
       std::unique_ptr<ifbeam_ns::BeamFolder>&);
@@ -198,6 +207,8 @@ private:
   double fXCETFetchShift;
   int fIFBeamDebug;
   double  fTimeWindow;
+  std::string fSnapshotFile;
+  std::string fSnapshotOutput;
   uint64_t fFixedTime;
   std::vector< std::string > fDevices;
 
@@ -298,7 +309,22 @@ private:
 
   std::unique_ptr<ifbeam_ns::BeamFolder> bfp;
   std::unique_ptr<ifbeam_ns::BeamFolder> bfp_xcet;
-  art::ServiceHandle<ifbeam_ns::IFBeam> ifb;
+
+  //Local store used instead of the database (SnapshotFile)
+  std::unique_ptr<proto::BeamSnapshotFolder> sfp;
+  std::unique_ptr<proto::BeamSnapshotFolder> sfp_xcet;
+
+  //Records everything fetched from the database (SnapshotOutput)
+  std::unique_ptr<proto::BeamSnapshotWriter> fSnapshotWriter;
+
+  //Per-spill memory: values already fetched in this spill
+  //and the triggers of the spill sorted in time
+  std::map< std::tuple<const void*, std::string, long long>, std::vector<double> > fSpillFetches;
+  proto::BeamTriggerIndex fTriggerIndex;
+  proto::BeamTriggerIndex fS11Index;
+  long long fS11IndexTime = -1;
+  size_t fNFetchHits = 0, fNFetchMisses = 0;
+  size_t fNSpillFetches = 0, fNSpillReuses = 0;
 
   art::Handle< std::vector<raw::RDTimeStamp> > RDTimeStampHandle;
 
@@ -326,6 +352,8 @@ proto::BeamEvent::BeamEvent(fhicl::ParameterSet const & p)
     fXCETFetchShift(p.get<double>("XCETFetchShift")),
     fIFBeamDebug(p.get<int>("IFBeamDebug")),
     fTimeWindow(p.get<double>("TimeWindow")),
+    fSnapshotFile(p.get<std::string>("SnapshotFile", "")),
+    fSnapshotOutput(p.get<std::string>("SnapshotOutput", "")),
     fFixedTime(p.get<uint64_t>("FixedTime")),
     fDevices(p.get<std::vector<std::string>>("Devices")),    
     //For Tracking/////
@@ -444,7 +472,27 @@ std::vector<double> proto::BeamEvent::FetchAndReport(long long time, std::string
     MF_LOG_INFO("BeamEvent") << "At Time: " << time << "\n";    
   }
 
-  theResult = the_folder->GetNamedVector(time, name);
+  //Several events of a spill ask for the same values
+  auto key = std::make_tuple( (const void*)&the_folder, name, time );
+  auto cached = fSpillFetches.find(key);
+  if( cached != fSpillFetches.end() ){
+    ++fNFetchHits;
+    if( fPrintDebug )
+      MF_LOG_INFO("BeamEvent") << "Already fetched in this spill\n";
+    return cached->second;
+  }
+
+  if( sfp ){
+    //Reading from the local store: bfp_xcet requests go to its xcet folder
+    theResult = ( &the_folder == &bfp_xcet ? sfp_xcet : sfp )->GetNamedVector(time, name);
+  }
+  else{
+    double actual_time = 0.;
+    theResult = the_folder->GetNamedVector(time, name, &actual_time);
+    if( fSnapshotWriter ) fSnapshotWriter->add(name, actual_time, theResult);
+  }
+  ++fNFetchMisses;
+  fSpillFetches[key] = theResult;
 
   if( fPrintDebug )
     MF_LOG_INFO("BeamEvent") << "Successfully fetched " << time << "\n";
@@ -564,25 +612,31 @@ void proto::BeamEvent::MatchS11ToGen(){
   if( fPrintDebug )
     MF_LOG_INFO("BeamEvent") << "Matching S11 To Gen" << "\n";
 
-  for(size_t iT = 0; iT < beamspill->GetNT0(); ++iT){
-    double GenTrigSec  = beamspill->GetT0(iT).first;
-    double GenTrigNano = beamspill->GetT0(iT).second;
+  if( fTriggerIndex.size() != beamspill->GetNT0() ) IndexTriggers();
+
+  //Only the triggers near the S11 time are tested
+  double s11Time = s11Sec + 1.e-9*s11Nano;
+  size_t iT = fTriggerIndex.firstMatch( s11Time + fS11DiffLower, s11Time + fS11DiffUpper, [&](size_t iTrig){
+    double GenTrigSec  = beamspill->GetT0(iTrig).first;
+    double GenTrigNano = beamspill->GetT0(iTrig).second;
 
     double diff = GenTrigSec - s11Sec;
     diff += 1.e-9*(GenTrigNano - s11Nano);
 
-    if( fS11DiffLower < diff && diff < fS11DiffUpper ){
+    return ( fS11DiffLower < diff && diff < fS11DiffUpper );
+  } );
 
-      if( fPrintDebug ){
-        MF_LOG_INFO("BeamEvent") << "Found matching S11 and GenTrig!" << "\n";
-        MF_LOG_INFO("BeamEvent") << "diff: " << diff << "\n";
-      }
+  if( iT != proto::BeamTriggerIndex::npos ){
 
-      beamspill->SetActiveTrigger( iT ); 
-      beamevt->SetActiveTrigger( iT );
-      beamevt->SetT0( beamspill->GetT0( iT ) );
-      return;
+    if( fPrintDebug ){
+      MF_LOG_INFO("BeamEvent") << "Found matching S11 and GenTrig!" << "\n";
+      MF_LOG_INFO("BeamEvent") << "diff: " << beamspill->GetT0(iT).first - s11Sec + 1.e-9*(beamspill->GetT0(iT).second - s11Nano) << "\n";
     }
+
+    beamspill->SetActiveTrigger( iT ); 
+    beamevt->SetActiveTrigger( iT );
+    beamevt->SetT0( beamspill->GetT0( iT ) );
+    return;
   }
 
   if( fPrintDebug )
@@ -596,20 +650,25 @@ void proto::BeamEvent::MatchBeamToTPC(){
 
   if( fPrintDebug )
     MF_LOG_INFO("BeamEvent") << "Matching in time between Beamline and TPC!!!" << "\n"; 
-  for(size_t iT = 0; iT < beamspill->GetNT0(); ++iT){
-    
-    double GenTrigSec  = beamspill->GetT0(iT).first;
-    double GenTrigNano = beamspill->GetT0(iT).second;
 
-    //Separates seconds portion of the ticks 
-    //From the nanoseconds
-    long long RDTSTickSec = (RDTSTime * 2) / (int)(TMath::Power(10,8));
-    RDTSTickSec = RDTSTickSec * (int)(TMath::Power(10,8)) / 2;
-    long long RDTSTickNano = RDTSTime - RDTSTickSec;
+  if( fTriggerIndex.size() != beamspill->GetNT0() ) IndexTriggers();
 
-    //Units are 20 nanoseconds ticks
-    double RDTSTimeSec  = 20.e-9 * RDTSTickSec;
-    double RDTSTimeNano = 20.    * RDTSTickNano;
+  //Separates seconds portion of the ticks 
+  //From the nanoseconds
+  long long RDTSTickSec = (RDTSTime * 2) / (int)(TMath::Power(10,8));
+  RDTSTickSec = RDTSTickSec * (int)(TMath::Power(10,8)) / 2;
+  long long RDTSTickNano = RDTSTime - RDTSTickSec;
+
+  //Units are 20 nanoseconds ticks
+  double RDTSTimeSec  = 20.e-9 * RDTSTickSec;
+  double RDTSTimeNano = 20.    * RDTSTickNano;
+
+  //Only the triggers near the calibrated RDTS time are tested
+  double expected = RDTSTimeSec + 1.e-9*RDTSTimeNano - SpillOffset - fTimingCalibration;
+  size_t iT = fTriggerIndex.firstMatch( expected - fCalibrationTolerance, expected + fCalibrationTolerance, [&](size_t iTrig){
+    
+    double GenTrigSec  = beamspill->GetT0(iTrig).first;
+    double GenTrigNano = beamspill->GetT0(iTrig).second;
 
     double diffSec = RDTSTimeSec - GenTrigSec - SpillOffset;
     double diffNano = 1.e-09*(RDTSTimeNano - GenTrigNano);
@@ -621,26 +680,36 @@ void proto::BeamEvent::MatchBeamToTPC(){
 
     double diff = diffSec + diffNano; 
   
-    if( ( fTimingCalibration - fCalibrationTolerance < diff ) && (fTimingCalibration + fCalibrationTolerance > diff) ){
+    return ( ( fTimingCalibration - fCalibrationTolerance < diff ) && (fTimingCalibration + fCalibrationTolerance > diff) );
+  } );
 
-      beamspill->SetActiveTrigger( iT ); 
-      beamevt->SetActiveTrigger( iT );
-      beamevt->SetT0( beamspill->GetT0( iT ) );
+  if( iT != proto::BeamTriggerIndex::npos ){
 
-      if( fPrintDebug ){
-        MF_LOG_INFO("BeamEvent") << "FOUND MATCHING TIME!!!" << "\n";
-        MF_LOG_INFO("BeamEvent") << "diff: " << diff << "\n";
-        MF_LOG_INFO("BeamEvent") << "Set event T0: " << beamevt->GetT0Sec() << " " << beamevt->GetT0Nano() << "\n";
-      }
+    beamspill->SetActiveTrigger( iT ); 
+    beamevt->SetActiveTrigger( iT );
+    beamevt->SetT0( beamspill->GetT0( iT ) );
 
-      return;
+    if( fPrintDebug ){
+      MF_LOG_INFO("BeamEvent") << "FOUND MATCHING TIME!!!" << "\n";
+      MF_LOG_INFO("BeamEvent") << "Set event T0: " << beamevt->GetT0Sec() << " " << beamevt->GetT0Nano() << "\n";
     }
+
+    return;
   }
 
   MF_LOG_INFO("BeamEvent") << "Could not find matching time " << "\n";
   beamspill->SetUnmatched();
 }
 
+void proto::BeamEvent::IndexTriggers(){
+  std::vector<double> triggerTimes;
+  triggerTimes.reserve( beamspill->GetNT0() );
+  for(size_t iT = 0; iT < beamspill->GetNT0(); ++iT){
+    triggerTimes.push_back( beamspill->GetT0(iT).first + 1.e-9*beamspill->GetT0(iT).second );
+  }
+  fTriggerIndex.build( triggerTimes );
+}
+
 void proto::BeamEvent::SetBeamEvent(){
 
   if( !beamspill->CheckIsMatched() ){
@@ -789,113 +858,13 @@ void proto::BeamEvent::produce(art::Event & e){
       if( fPrintDebug )
         MF_LOG_INFO("BeamEvent") << "New spill or forced new fetch. Getting new beamspill info" << "\n";
 
-      //Testing: printing out cache start and end 
-      cache_start = bfp->GetCacheStartTime();
-      cache_end   = bfp->GetCacheEndTime();
+      //Forget what was fetched for the previous spill
+      fSpillFetches.clear();
+      fS11IndexTime = -1;
+      ++fNSpillFetches;
 
-      if( fPrintDebug ){
-        MF_LOG_INFO("BeamEvent") << "cache_start: " << cache_start << "\n";
-        MF_LOG_INFO("BeamEvent") << "cache_end: "   << cache_end << "\n";
-        MF_LOG_INFO("BeamEvent") << "fetch_time: "  << fetch_time << "\n";
-      }
-     
-      cache_start = bfp_xcet->GetCacheStartTime();
-      cache_end   = bfp_xcet->GetCacheEndTime();
-
-      if( fPrintDebug ){
-        MF_LOG_INFO("BeamEvent") << "xcet cache_start: " << cache_start << "\n";
-        MF_LOG_INFO("BeamEvent") << "xcet cache_end: "   << cache_end << "\n";
-        MF_LOG_INFO("BeamEvent") << "xcet fetch_time: "  << fetch_time << "\n";
-      }
-
-      //Not the first event
-      if(cache_start > 0 && cache_end > 0){
-
-        //So try filling the cache first with the 'possible' end of spill time
-        //then the lower spill time.
-        //
-        //This is done so that the cache essentially reshuffles where it starts and ends
-        //
-        //All the checking is done internal to the FillCache method
-        //
-        //Note: I'm using a loose definition of the start and end of spills
-        //      It's really just the maximum and minimum possible vales of those times
-        //      since it's not possible to know for certain in any given event. 
-        //      (The info does exist in the raw decoder info, but it's not always 
-        //       present, so I'm just opting for this)
-        try{        
-          bfp->FillCache( fetch_time + fFillCacheUp );
-
-          if( fPrintDebug ){
-            cache_start = bfp->GetCacheStartTime();
-            cache_end   = bfp->GetCacheEndTime();
-            MF_LOG_INFO("BeamEvent") << "interim cache_start: " << cache_start << "\n";
-            MF_LOG_INFO("BeamEvent") << "interim cache_end: "   << cache_end << "\n";
-          }
-
-          bfp->FillCache( fetch_time - fFillCacheDown );
-          if( fPrintDebug ){
-            cache_start = bfp->GetCacheStartTime();
-            cache_end   = bfp->GetCacheEndTime();
-            MF_LOG_INFO("BeamEvent") << "new cache_start: " << cache_start << "\n";
-            MF_LOG_INFO("BeamEvent") << "new cache_end: "   << cache_end << "\n";
-          }
-
-          bfp_xcet->FillCache( fetch_time + fFillCacheUp );
-          if( fPrintDebug ){
-            cache_start = bfp_xcet->GetCacheStartTime();
-            cache_end   = bfp_xcet->GetCacheEndTime();
-            MF_LOG_INFO("BeamEvent") << "interim xcet cache_start: " << cache_start << "\n";
-            MF_LOG_INFO("BeamEvent") << "interim xcet cache_end: "   << cache_end << "\n";
-          }
-
-          bfp_xcet->FillCache( fetch_time - fFillCacheDown );
-          if( fPrintDebug ){
-            cache_start = bfp_xcet->GetCacheStartTime();
-            cache_end   = bfp_xcet->GetCacheEndTime();
-            MF_LOG_INFO("BeamEvent") << "new xcet cache_start: " << cache_start << "\n";
-            MF_LOG_INFO("BeamEvent") << "new xcet cache_end: "   << cache_end << "\n";
-          }
-        }
-        catch( std::exception const& e){
-          MF_LOG_WARNING("BeamEvent") << "Could not fill cache\n"; 
-          MF_LOG_ERROR("BeamEvent") << e.what() << "\n";
-        }
-      }      
-      else{
-        //First event, let's get the start of spill info 
-
-        if( fPrintDebug )
-          MF_LOG_INFO("BeamEvent") << "First Event: Priming cache\n";
-
-        try{        
-          bfp->FillCache( fetch_time - fFillCacheDown );
-        }
-        catch( std::exception const& e){
-          MF_LOG_WARNING("BeamEvent") << "Could not fill cache\n"; 
-          MF_LOG_ERROR("BeamEvent") << e.what() << "\n";
-        }
-        try{
-          bfp_xcet->FillCache( fetch_time - fFillCacheDown );
-        }
-        catch( std::exception const& e){
-          MF_LOG_WARNING("BeamEvent") << "Could not fill xcet cache\n"; 
-          MF_LOG_ERROR("BeamEvent") << e.what() << "\n";
-        }
-
-        if( fPrintDebug ){
-          cache_start = bfp->GetCacheStartTime();
-          cache_end   = bfp->GetCacheEndTime();
-          MF_LOG_INFO("BeamEvent") << "new cache_start: " << cache_start << "\n";
-          MF_LOG_INFO("BeamEvent") << "new cache_end: "   << cache_end << "\n";
-
-          cache_start = bfp_xcet->GetCacheStartTime();
-          cache_end   = bfp_xcet->GetCacheEndTime();
-          MF_LOG_INFO("BeamEvent") << "new xcet cache_start: " << cache_start << "\n";
-          MF_LOG_INFO("BeamEvent") << "new xcet cache_end: "   << cache_end << "\n";
-        }
-
-      }
+      //The local store needs no cache
+      if( !sfp ) FillFolderCaches(fetch_time);
 
       // Parse the Time of Flight Counter data for the list
       // of times that we are using
@@ -935,12 +904,16 @@ void proto::BeamEvent::produce(art::Event & e){
       PrevStart = SpillStart;
       PrevRDTSTimeSec = RDTSTimeSec;
 
+      //Sort the triggers in time once for all the events of the spill
+      IndexTriggers();
+
     }
     else{
       if( fPrintDebug )
         MF_LOG_INFO("BeamEvent") << "Same spill. Reusing beamspill info" << "\n";
 
       *beamspill = prev_beamspill;
+      ++fNSpillReuses;
     }
 
     if( fPrintDebug ){
@@ -1134,7 +1107,20 @@ void proto::BeamEvent::getS11Info(uint64_t time){
   double RDTSTimeNano = 20.    * RDTSTickNano;
 
 
-  for(int i = 0; i < s11Count; ++i){
+  //Index the S11 signals once per fetch, relative to the first one
+  double tref = ( s11Count > 0 ? secondsS11[1] - fOffsetTAI : 0. );
+  if( fS11IndexTime != (long long)time || fS11Index.size() != (size_t)std::max(s11Count, 0) ){
+    std::vector< double > keys;
+    for(int i = 0; i < s11Count; ++i){
+      keys.push_back( (secondsS11[2*i + 1] - fOffsetTAI) - tref + 1.e-9*(8.*coarseS11[i] + fracS11[i]/512.) );
+    }
+    fS11Index.build( keys );
+    fS11IndexTime = time;
+  }
+
+  //First signal in readout order in the window around the RDTS time
+  double RDTSKey = RDTSTimeSec - tref + 1.e-9*RDTSTimeNano;
+  size_t iS11 = fS11Index.firstMatch( RDTSKey + fRDTSToS11Lower, RDTSKey + fRDTSToS11Upper, [&](size_t i){
     double nano = 8.*coarseS11[i] + fracS11[i]/512.;
 
     double diffSec = secondsS11[2*i + 1] - RDTSTimeSec - fOffsetTAI;
@@ -1146,15 +1132,17 @@ void proto::BeamEvent::getS11Info(uint64_t time){
     }
 
     double diff = diffSec + 1.e-9*diffNano;
-    if( fRDTSToS11Lower < diff && diff < fRDTSToS11Upper ){
+    return ( fRDTSToS11Lower < diff && diff < fRDTSToS11Upper );
+  } );
 
-      if( fPrintDebug )
-        MF_LOG_INFO("BeamEvent") << "FOUND Match between S11 and RDTS" << "\n";  
+  if( iS11 != proto::BeamTriggerIndex::npos ){
 
-      s11Nano = nano;
-      s11Sec  = secondsS11[2*i + 1] - fOffsetTAI;
-      return;
-    }
+    if( fPrintDebug )
+      MF_LOG_INFO("BeamEvent") << "FOUND Match between S11 and RDTS" << "\n";  
+
+    s11Nano = 8.*coarseS11[iS11] + fracS11[iS11]/512.;
+    s11Sec  = secondsS11[2*iS11 + 1] - fOffsetTAI;
+    return;
   }
 
   MF_LOG_WARNING("BeamEvent") << "Could not match RDTS to S11\n";
@@ -1313,12 +1301,13 @@ void proto::BeamEvent::parseXTOF(uint64_t time){
       if (fXTOF2ACoarse == 0.0 && fXTOF2AFrac == 0.0 && fXTOF2ASec == 0.0) break;
       unorderedTOF2ATime.push_back(std::make_pair(fXTOF2ASec, (fXTOF2ACoarse*8. + fXTOF2AFrac/512.)) );
 
-      if(diff2A.size()) diff2A.clear();
-      for(size_t j = 0; j < timestampCountGeneralTrigger[0]; ++j){
-        diff2A.push_back( 1.e9*(unorderedTOF2ATime.back().first - unorderedGenTrigTime[j].first) + (unorderedTOF2ATime.back().second - unorderedGenTrigTime[j].second) );
+      if(fDebugTOFs){
+        diff2A.clear();
+        for(size_t j = 0; j < unorderedGenTrigTime.size(); ++j){
+          diff2A.push_back( 1.e9*(unorderedTOF2ATime.back().first - unorderedGenTrigTime[j].first) + (unorderedTOF2ATime.back().second - unorderedGenTrigTime[j].second) );
+        }
+        fXTOF2ATree->Fill();
       }
-      
-      if(fDebugTOFs)fXTOF2ATree->Fill();
 
     }  
 
@@ -1336,19 +1325,28 @@ void proto::BeamEvent::parseXTOF(uint64_t time){
 
       unorderedTOF2BTime.push_back(std::make_pair(fXTOF2BSec, (fXTOF2BCoarse*8. + fXTOF2BFrac/512.) ));
 
-      if(diff2B.size()) diff2B.clear();
-
-      for(size_t j = 0; j < timestampCountGeneralTrigger[0]; ++j){
-        diff2B.push_back( 1.e9*(unorderedTOF2BTime.back().first - unorderedGenTrigTime[j].first) + (unorderedTOF2BTime.back().second - unorderedGenTrigTime[j].second) );
+      if(fDebugTOFs){
+        diff2B.clear();
+        for(size_t j = 0; j < unorderedGenTrigTime.size(); ++j){
+          diff2B.push_back( 1.e9*(unorderedTOF2BTime.back().first - unorderedGenTrigTime[j].first) + (unorderedTOF2BTime.back().second - unorderedGenTrigTime[j].second) );
+        }
+        fXTOF2BTree->Fill();
       }
-
-      if(fDebugTOFs)fXTOF2BTree->Fill();
     }
   }
 
   if( fPrintDebug )
     MF_LOG_INFO("BeamEvent") << "NGenTrigs: " << timestampCountGeneralTrigger[0] << " NTOF2s: " << unorderedTOF2ATime.size() + unorderedTOF2BTime.size() << "\n";
 
+  //Index the TOF hits once for all the general triggers
+  proto::BeamTOFMatcher tofMatcher(fDownstreamToGenTrig, fUpstreamToDownstream);
+  if( gotTOFs ){
+    double tref = ( unorderedGenTrigTime.size() ? unorderedGenTrigTime[0].first : 0. );
+    tofMatcher.setHits( unorderedTOF1ATime, unorderedTOF1BTime, unorderedTOF2ATime, unorderedTOF2BTime, tref );
+  }
+  std::vector< proto::BeamTOFMatcher::Match > tofMatches;
+  const std::string tofChanNames[4] = { "1A to 2A", "1B to 2A", "1A to 2B", "1B to 2B" };
+
   for(size_t iT = 0; iT < unorderedGenTrigTime.size(); ++iT){
     
     bool found_TOF = false;
@@ -1370,126 +1368,22 @@ void proto::BeamEvent::parseXTOF(uint64_t time){
       if( fPrintDebug )
         MF_LOG_INFO("BeamEvent") << "Gen: " << the_gen_sec << " " << the_gen_ns << "\n";
 
-      //First check 2A
-      for(size_t ip2A = 0; ip2A < unorderedTOF2ATime.size(); ++ip2A){
-        double TOF2A_sec = unorderedTOF2ATime[ip2A].first;
-        double TOF2A_ns  = unorderedTOF2ATime[ip2A].second;         
-        double delta_2A = 1.e9*(the_gen_sec - TOF2A_sec) + the_gen_ns - TOF2A_ns;
-
-        if( delta_2A < 0. ) break;
-        else if( delta_2A > fDownstreamToGenTrig ) continue;
+      //Downstream hits (2A, then 2B) at most fDownstreamToGenTrig before the trigger,
+      //each with the upstream hits (1A, then 1B) less than fUpstreamToDownstream before it
+      tofMatcher.match( unorderedGenTrigTime[iT], tofMatches );
 
-        //if here, 0. < delta < 50ns
+      for( const auto & tofMatch : tofMatches ){
         if( fPrintDebug )
-          MF_LOG_INFO("BeamEvent") << "Found match 2A to Gen" << "\n";
+          MF_LOG_INFO("BeamEvent") << "Found match " << tofChanNames[tofMatch.chan] << " " << tofMatch.tof << "\n";
 
-        //So check 1A and 1B
-        for(size_t ip1A = 0; ip1A < unorderedTOF1ATime.size(); ++ip1A){
-          double TOF1A_sec = unorderedTOF1ATime[ip1A].first;
-          double TOF1A_ns  = unorderedTOF1ATime[ip1A].second;         
-          double delta = 1.e9*( TOF2A_sec - TOF1A_sec ) + TOF2A_ns - TOF1A_ns;
-
-          if( delta < 0. ) break;
-          else if( delta > 0. && delta < fUpstreamToDownstream){
-            if( fPrintDebug )
-              MF_LOG_INFO("BeamEvent") << "Found match 1A to 2A " << delta << "\n";
-
-            found_TOF = true;
-            channel = k1A2A;
-
-            possibleTOF.push_back( delta ); 
-            possibleTOFChan.push_back( channel );
-
-            UpstreamTriggers.push_back( ip1A );
-            DownstreamTriggers.push_back( ip2A );
-          }
-          else continue; 
-        }
-        for(size_t ip1B = 0; ip1B < unorderedTOF1BTime.size(); ++ip1B){
-          double TOF1B_sec = unorderedTOF1BTime[ip1B].first;
-          double TOF1B_ns  = unorderedTOF1BTime[ip1B].second;         
-          double delta = 1.e9*( TOF2A_sec - TOF1B_sec ) + TOF2A_ns - TOF1B_ns;
+        found_TOF = true;
+        channel = tofMatch.chan;
 
-          if( delta < 0. ) break;
-          else if( delta > 0. && delta < fUpstreamToDownstream){
+        possibleTOF.push_back( tofMatch.tof ); 
+        possibleTOFChan.push_back( channel );
 
-            if( fPrintDebug )
-              MF_LOG_INFO("BeamEvent") << "Found match 1B to 2A " << delta << "\n";
-
-            found_TOF = true;
-            channel = k1B2A;
-
-            possibleTOF.push_back( delta ); 
-            possibleTOFChan.push_back( channel );
-
-            UpstreamTriggers.push_back( ip1B );
-            DownstreamTriggers.push_back( ip2A );
-          }
-          else continue; 
-        }
-      }
-
-      //Then check 2B 
-      for(size_t ip2B = 0; ip2B < unorderedTOF2BTime.size(); ++ip2B){
-        double TOF2B_sec = unorderedTOF2BTime[ip2B].first;
-        double TOF2B_ns  = unorderedTOF2BTime[ip2B].second;         
-        double delta_2B = 1.e9*(the_gen_sec - TOF2B_sec) + the_gen_ns - TOF2B_ns;
-
-
-        if( delta_2B < 0. ) break;
-        else if( delta_2B > fDownstreamToGenTrig ) continue;
-
-        //if here, 0. < delta < 50ns
-        if( fPrintDebug )
-          MF_LOG_INFO("BeamEvent") << "Found match 2B to Gen" << "\n";
-
-        //So check 1A and 1B
-        for(size_t ip1A = 0; ip1A < unorderedTOF1ATime.size(); ++ip1A){
-          double TOF1A_sec = unorderedTOF1ATime[ip1A].first;
-          double TOF1A_ns  = unorderedTOF1ATime[ip1A].second;         
-          double delta = 1.e9*( TOF2B_sec - TOF1A_sec ) + TOF2B_ns - TOF1A_ns;
-
-
-          if( delta < 0. ) break;
-          else if( delta > 0. && delta < fUpstreamToDownstream){
-                              
-            if( fPrintDebug )
-              MF_LOG_INFO("BeamEvent") << "Found match 1A to 2B " << delta << "\n";
-             
-            found_TOF = true;
-            channel = k1A2B;
-
-            possibleTOF.push_back( delta ); 
-            possibleTOFChan.push_back( channel );
-
-            UpstreamTriggers.push_back( ip1A );
-            DownstreamTriggers.push_back( ip2B );
-          }
-          else continue; 
-        }
-        for(size_t ip1B = 0; ip1B < unorderedTOF1BTime.size(); ++ip1B){
-          double TOF1B_sec = unorderedTOF1BTime[ip1B].first;
-          double TOF1B_ns  = unorderedTOF1BTime[ip1B].second;         
-          double delta = 1.e9*( TOF2B_sec - TOF1B_sec ) + TOF2B_ns - TOF1B_ns;
-
-          
-          if( delta < 0. ) break;
-          else if( delta > 0. && delta < fUpstreamToDownstream){
-
-            if( fPrintDebug )
-              MF_LOG_INFO("BeamEvent") << "Found match 1B to 2B " << delta << "\n";
-
-            found_TOF = true;
-            channel = k1B2B;
-
-            possibleTOF.push_back( delta ); 
-            possibleTOFChan.push_back( channel );
-
-            UpstreamTriggers.push_back( ip1B );
-            DownstreamTriggers.push_back( ip2B );
-          }
-          else continue;
-        }
+        UpstreamTriggers.push_back( tofMatch.upstream );
+        DownstreamTriggers.push_back( tofMatch.downstream );
       }
 
       if( fPrintDebug )
@@ -1600,9 +1494,27 @@ void proto::BeamEvent::parseXCETDB(uint64_t time){
 
 
 
+  //Index the XCET hits in time, relative to the first general trigger
+  double tref = ( beamspill->GetNT0() ? beamspill->GetT0Sec(0) : 0. );
+  proto::BeamTriggerIndex XCET1_index, XCET2_index;
+  std::vector< double > keys;
+  if( fetched_XCET1 ){
+    for( size_t ic1 = 0; ic1 < XCET1_seconds.size(); ++ic1 )
+      keys.push_back( (XCET1_seconds[ic1] - fOffsetTAI) - tref + 1.e-9*(8.*XCET1_coarse[ic1] + XCET1_frac[ic1] / 512.) );
+    XCET1_index.build( keys );
+  }
+  keys.clear();
+  if( fetched_XCET2 ){
+    for( size_t ic2 = 0; ic2 < XCET2_seconds.size(); ++ic2 )
+      keys.push_back( (XCET2_seconds[ic2] - fOffsetTAI) - tref + 1.e-9*(8.*XCET2_coarse[ic2] + XCET2_frac[ic2] / 512.) );
+    XCET2_index.build( keys );
+  }
+
   //Go through the general triggers and try to match. If one can't be found, then just add a 0
   for( size_t i = 0; i < beamspill->GetNT0(); ++i ){
 
+    double genKey = beamspill->GetT0Sec(i) - tref + 1.e-9*beamspill->GetT0Nano(i);
+
     if( fXCETDebug ) std::cout << "GenTrig: " << i << " " << beamspill->GetT0Sec(i) << " " << beamspill->GetT0Nano(i) << std::endl;
     
     beam::CKov status_1;
@@ -1614,18 +1526,23 @@ void proto::BeamEvent::parseXCETDB(uint64_t time){
 
       status_1.trigger = 0;
 
-      for( size_t ic1 = 0; ic1 < XCET1_seconds.size(); ++ic1 ){
-        double delta = 1.e9 * ( beamspill->GetT0Sec(i) - (XCET1_seconds[ic1] - fOffsetTAI) );
-        delta += ( beamspill->GetT0Nano(i) - (8.*XCET1_coarse[ic1] + XCET1_frac[ic1] / 512.) );
+      //First hit in readout order within 500 ns of the trigger
+      size_t ic1 = XCET1_index.firstMatch( genKey - 500.e-9, genKey + 500.e-9, [&](size_t ic){
+        double delta = 1.e9 * ( beamspill->GetT0Sec(i) - (XCET1_seconds[ic] - fOffsetTAI) );
+        delta += ( beamspill->GetT0Nano(i) - (8.*XCET1_coarse[ic] + XCET1_frac[ic] / 512.) );
 
         if( fXCETDebug ) std::cout << "XCET1 delta: " << delta << std::endl;
 
-        if( fabs(delta) < 500. ){
-          if( fXCETDebug ) std::cout << "Found matching XCET1 trigger " << XCET1_seconds[ic1] - fOffsetTAI << " " << (8.*XCET1_coarse[ic1] + XCET1_frac[ic1] / 512.) << " " << delta << std::endl;
-          status_1.trigger = 1;
-          status_1.timeStamp = delta;
-          break;
-        }     
+        return ( fabs(delta) < 500. );
+      } );
+
+      if( ic1 != proto::BeamTriggerIndex::npos ){
+        double delta = 1.e9 * ( beamspill->GetT0Sec(i) - (XCET1_seconds[ic1] - fOffsetTAI) );
+        delta += ( beamspill->GetT0Nano(i) - (8.*XCET1_coarse[ic1] + XCET1_frac[ic1] / 512.) );
+
+        if( fXCETDebug ) std::cout << "Found matching XCET1 trigger " << XCET1_seconds[ic1] - fOffsetTAI << " " << (8.*XCET1_coarse[ic1] + XCET1_frac[ic1] / 512.) << " " << delta << std::endl;
+        status_1.trigger = 1;
+        status_1.timeStamp = delta;
       }
     }
     beamspill->AddCKov0( status_1 );
@@ -1639,19 +1556,23 @@ void proto::BeamEvent::parseXCETDB(uint64_t time){
 
       status_2.trigger = 0;
 
-      for( size_t ic2 = 0; ic2 < XCET2_seconds.size(); ++ic2 ){
+      //First hit in readout order within 500 ns of the trigger
+      size_t ic2 = XCET2_index.firstMatch( genKey - 500.e-9, genKey + 500.e-9, [&](size_t ic){
+        double delta = 1.e9 * ( beamspill->GetT0Sec(i) - (XCET2_seconds[ic] - fOffsetTAI) );
+        delta += ( beamspill->GetT0Nano(i) - (8.*XCET2_coarse[ic] + XCET2_frac[ic] / 512.) );
+
+        if( fXCETDebug ) std::cout << "XCET2 delta: " << delta << std::endl;
+
+        return ( fabs(delta) < 500. );
+      } );
 
+      if( ic2 != proto::BeamTriggerIndex::npos ){
         double delta = 1.e9 * ( beamspill->GetT0Sec(i) - (XCET2_seconds[ic2] - fOffsetTAI) );
         delta += ( beamspill->GetT0Nano(i) - (8.*XCET2_coarse[ic2] + XCET2_frac[ic2] / 512.) );
 
-        if( fXCETDebug ) std::cout << "XCET2 delta: " << delta << std::endl;
-
-        if( fabs(delta) < 500. ){
-          if( fXCETDebug ) std::cout << "Found matching XCET2 trigger " << XCET2_seconds[ic2] - fOffsetTAI << " " << (8.*XCET2_coarse[ic2] + XCET2_frac[ic2] / 512.) << " " << delta << std::endl;
-          status_2.trigger = 1;
-          status_2.timeStamp = delta;
-          break;
-        }     
+        if( fXCETDebug ) std::cout << "Found matching XCET2 trigger " << XCET2_seconds[ic2] - fOffsetTAI << " " << (8.*XCET2_coarse[ic2] + XCET2_frac[ic2] / 512.) << " " << delta << std::endl;
+        status_2.trigger = 1;
+        status_2.timeStamp = delta;
       }
     }
     beamspill->AddCKov1( status_2 );
@@ -1812,6 +1733,120 @@ void proto::BeamEvent::parseXBPF(uint64_t time){
 ////////////////////////
 
 
+void proto::BeamEvent::FillFolderCaches(uint64_t fetch_time){
+
+  //Testing: printing out cache start and end 
+  cache_start = bfp->GetCacheStartTime();
+  cache_end   = bfp->GetCacheEndTime();
+
+  if( fPrintDebug ){
+    MF_LOG_INFO("BeamEvent") << "cache_start: " << cache_start << "\n";
+    MF_LOG_INFO("BeamEvent") << "cache_end: "   << cache_end << "\n";
+    MF_LOG_INFO("BeamEvent") << "fetch_time: "  << fetch_time << "\n";
+  }
+ 
+  cache_start = bfp_xcet->GetCacheStartTime();
+  cache_end   = bfp_xcet->GetCacheEndTime();
+
+  if( fPrintDebug ){
+    MF_LOG_INFO("BeamEvent") << "xcet cache_start: " << cache_start << "\n";
+    MF_LOG_INFO("BeamEvent") << "xcet cache_end: "   << cache_end << "\n";
+    MF_LOG_INFO("BeamEvent") << "xcet fetch_time: "  << fetch_time << "\n";
+  }
+
+  //Not the first event
+  if(cache_start > 0 && cache_end > 0){
+
+    //So try filling the cache first with the 'possible' end of spill time
+    //then the lower spill time.
+    //
+    //This is done so that the cache essentially reshuffles where it starts and ends
+    //
+    //All the checking is done internal to the FillCache method
+    //
+    //Note: I'm using a loose definition of the start and end of spills
+    //      It's really just the maximum and minimum possible vales of those times
+    //      since it's not possible to know for certain in any given event. 
+    //      (The info does exist in the raw decoder info, but it's not always 
+    //       present, so I'm just opting for this)
+    try{        
+      bfp->FillCache( fetch_time + fFillCacheUp );
+
+      if( fPrintDebug ){
+        cache_start = bfp->GetCacheStartTime();
+        cache_end   = bfp->GetCacheEndTime();
+        MF_LOG_INFO("BeamEvent") << "interim cache_start: " << cache_start << "\n";
+        MF_LOG_INFO("BeamEvent") << "interim cache_end: "   << cache_end << "\n";
+      }
+
+      bfp->FillCache( fetch_time - fFillCacheDown );
+      if( fPrintDebug ){
+        cache_start = bfp->GetCacheStartTime();
+        cache_end   = bfp->GetCacheEndTime();
+        MF_LOG_INFO("BeamEvent") << "new cache_start: " << cache_start << "\n";
+        MF_LOG_INFO("BeamEvent") << "new cache_end: "   << cache_end << "\n";
+      }
+
+      bfp_xcet->FillCache( fetch_time + fFillCacheUp );
+      if( fPrintDebug ){
+        cache_start = bfp_xcet->GetCacheStartTime();
+        cache_end   = bfp_xcet->GetCacheEndTime();
+        MF_LOG_INFO("BeamEvent") << "interim xcet cache_start: " << cache_start << "\n";
+        MF_LOG_INFO("BeamEvent") << "interim xcet cache_end: "   << cache_end << "\n";
+      }
+
+      bfp_xcet->FillCache( fetch_time - fFillCacheDown );
+      if( fPrintDebug ){
+        cache_start = bfp_xcet->GetCacheStartTime();
+        cache_end   = bfp_xcet->GetCacheEndTime();
+        MF_LOG_INFO("BeamEvent") << "new xcet cache_start: " << cache_start << "\n";
+        MF_LOG_INFO("BeamEvent") << "new xcet cache_end: "   << cache_end << "\n";
+      }
+    }
+    catch( std::exception const& e){
+      MF_LOG_WARNING("BeamEvent") << "Could not fill cache\n"; 
+      MF_LOG_ERROR("BeamEvent") << e.what() << "\n";
+    }
+  }      
+  else{
+    //First event, let's get the start of spill info 
+
+    if( fPrintDebug )
+      MF_LOG_INFO("BeamEvent") << "First Event: Priming cache\n";
+
+    try{        
+      bfp->FillCache( fetch_time - fFillCacheDown );
+    }
+    catch( std::exception const& e){
+      MF_LOG_WARNING("BeamEvent") << "Could not fill cache\n"; 
+      MF_LOG_ERROR("BeamEvent") << e.what() << "\n";
+    }
+    try{
+      bfp_xcet->FillCache( fetch_time - fFillCacheDown );
+    }
+    catch( std::exception const& e){
+      MF_LOG_WARNING("BeamEvent") << "Could not fill xcet cache\n"; 
+      MF_LOG_ERROR("BeamEvent") << e.what() << "\n";
+    }
+
+    if( fPrintDebug ){
+      cache_start = bfp->GetCacheStartTime();
+      cache_end   = bfp->GetCacheEndTime();
+      MF_LOG_INFO("BeamEvent") << "new cache_start: " << cache_start << "\n";
+      MF_LOG_INFO("BeamEvent") << "new cache_end: "   << cache_end << "\n";
+
+      cache_start = bfp_xcet->GetCacheStartTime();
+      cache_end   = bfp_xcet->GetCacheEndTime();
+      MF_LOG_INFO("BeamEvent") << "new xcet cache_start: " << cache_start << "\n";
+      MF_LOG_INFO("BeamEvent") << "new xcet cache_end: "   << cache_end << "\n";
+    }
+
+  }
+}
+// END BeamEvent::FillFolderCaches
+////////////////////////
+
+
 void proto::BeamEvent::beginJob()
 {
   art::ServiceHandle<art::TFileService> tfs;
@@ -1886,37 +1921,66 @@ void proto::BeamEvent::beginJob()
     fXTOF2BTree->Branch("diff2B", &diff2B);
   }
 
-  //Tells IFBeam to print out debug statements
-  ifbeam_ns::BeamFolder::_debug = fIFBeamDebug;
-
-  bfp = ifb->getBeamFolder(fBundleName,fURLStr,fTimeWindow);
-  if( fPrintDebug ){ 
-    MF_LOG_INFO("BeamEvent") << "%%%%%%%%%% Got beam folder %%%%%%%%%%\n"; 
-    MF_LOG_INFO("BeamEvent") << "%%%%%%%%%% Setting TimeWindow: " << fTimeWindow << " %%%%%%%%%%\n";
+  if( fSnapshotFile != "" ){
+    //Read the beamline info from a local store instead of the database
+    auto store = std::make_shared<const proto::BeamSnapshotStore>(fSnapshotFile);
+    MF_LOG_INFO("BeamEvent") << "Reading beamline info from " << fSnapshotFile
+                             << " (" << store->names().size() << " devices)\n";
+    sfp = std::make_unique<proto::BeamSnapshotFolder>(store);
+    sfp->set_epsilon( fBFEpsilon );
+    sfp_xcet = std::make_unique<proto::BeamSnapshotFolder>(store);
+    sfp_xcet->set_epsilon( fXCETEpsilon );
   }
+  else{
+    //Tells IFBeam to print out debug statements
+    ifbeam_ns::BeamFolder::_debug = fIFBeamDebug;
+
+    art::ServiceHandle<ifbeam_ns::IFBeam> ifb;
+    bfp = ifb->getBeamFolder(fBundleName,fURLStr,fTimeWindow);
+    if( fPrintDebug ){ 
+      MF_LOG_INFO("BeamEvent") << "%%%%%%%%%% Got beam folder %%%%%%%%%%\n"; 
+      MF_LOG_INFO("BeamEvent") << "%%%%%%%%%% Setting TimeWindow: " << fTimeWindow << " %%%%%%%%%%\n";
+    }
 
-  bfp->set_epsilon( fBFEpsilon );
+    bfp->set_epsilon( fBFEpsilon );
 
-  if( fPrintDebug )
-    MF_LOG_INFO("BeamEvent") << "%%%%%%%%%% Set beam epislon " << fBFEpsilon << " %%%%%%%%%%\n";
+    if( fPrintDebug )
+      MF_LOG_INFO("BeamEvent") << "%%%%%%%%%% Set beam epislon " << fBFEpsilon << " %%%%%%%%%%\n";
 
-  bfp_xcet = ifb->getBeamFolder(fXCETBundleName,fURLStr,fTimeWindow);
+    bfp_xcet = ifb->getBeamFolder(fXCETBundleName,fURLStr,fTimeWindow);
 
-  if( fPrintDebug ){ 
-    MF_LOG_INFO("BeamEvent") << "%%%%%%%%%% Got beam folder %%%%%%%%%%\n"; 
-    MF_LOG_INFO("BeamEvent") << "%%%%%%%%%% Setting TimeWindow: " << fTimeWindow << " %%%%%%%%%%\n";
-  }
+    if( fPrintDebug ){ 
+      MF_LOG_INFO("BeamEvent") << "%%%%%%%%%% Got beam folder %%%%%%%%%%\n"; 
+      MF_LOG_INFO("BeamEvent") << "%%%%%%%%%% Setting TimeWindow: " << fTimeWindow << " %%%%%%%%%%\n";
+    }
  
-  bfp_xcet->set_epsilon( fXCETEpsilon );
+    bfp_xcet->set_epsilon( fXCETEpsilon );
 
-  if( fPrintDebug ) 
-    MF_LOG_INFO("BeamEvent") << "%%%%%%%%%% Set beam epislon " << fBFEpsilon << " %%%%%%%%%%\n";
+    if( fPrintDebug ) 
+      MF_LOG_INFO("BeamEvent") << "%%%%%%%%%% Set beam epislon " << fBFEpsilon << " %%%%%%%%%%\n";
 
+    if( fSnapshotOutput != "" )
+      fSnapshotWriter = std::make_unique<proto::BeamSnapshotWriter>(fSnapshotOutput);
+  }
 
   //Rotate the basis vectors of the FBMs
   BeamMonitorBasisVectors();
 }
 
+void proto::BeamEvent::endJob()
+{
+  MF_LOG_INFO("BeamEvent") << "Spills fetched: " << fNSpillFetches
+                           << ", events reusing their spill: " << fNSpillReuses << "\n"
+                           << "Beamline values fetched: " << fNFetchMisses
+                           << ", reused within a spill: " << fNFetchHits << "\n";
+
+  if( fSnapshotWriter ){
+    MF_LOG_INFO("BeamEvent") << "Wrote " << fSnapshotWriter->recordCount()
+                             << " beamline records to " << fSnapshotOutput << "\n";
+    fSnapshotWriter->close();
+  }
+}
+
 uint64_t proto::BeamEvent::joinHighLow(double high, double low){
 
   uint64_t low64 = (uint64_t)low;
@@ -0,0 +1,234 @@
+// BeamSnapshot.cxx
+
+#include "BeamSnapshot.h"
+#include <algorithm>
+#include <cstring>
+#include <sstream>
+#include <stdexcept>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+using std::string;
+using std::vector;
+using std::runtime_error;
+
+namespace {
+
+const char magic[8] = {'P', 'D', 'B', 'I', 'S', 'N', 'A', 'P'};
+const uint32_t version = 1;
+const size_t headerSize = 16;
+const size_t trailerSize = 16;
+
+size_t padded(size_t n) { return (n + 7) & ~size_t(7); }
+
+template<class T>
+void put(std::ofstream& out, const T& val) {
+  out.write(reinterpret_cast<const char*>(&val), sizeof(T));
+}
+
+// Sequential reader of the index with bounds checks.
+class Cursor {
+public:
+  Cursor(const char* beg, const char* end, const string& fname) : m_pos(beg), m_end(end), m_fname(fname) { }
+  const char* take(size_t n) {
+    if ( size_t(m_end - m_pos) < n ) throw runtime_error("BeamSnapshotStore: truncated index in " + m_fname);
+    const char* pos = m_pos;
+    m_pos += n;
+    return pos;
+  }
+  template<class T>
+  T get() {
+    T val;
+    std::memcpy(&val, take(sizeof(T)), sizeof(T));
+    return val;
+  }
+private:
+  const char* m_pos;
+  const char* m_end;
+  const string& m_fname;
+};
+
+}  // end unnamed namespace
+
+namespace proto {
+
+//**********************************************************************
+
+BeamSnapshotWriter::BeamSnapshotWriter(const string& fname)
+: m_fname(fname), m_file(fname, std::ios::binary | std::ios::trunc) {
+  if ( ! m_file ) throw runtime_error("BeamSnapshotWriter: unable to open " + fname);
+  m_file.write(magic, sizeof(magic));
+  put(m_file, version);
+  put(m_file, uint32_t(0));
+}
+
+//**********************************************************************
+
+BeamSnapshotWriter::~BeamSnapshotWriter() {
+  try {
+    close();
+  } catch ( ... ) { }
+}
+
+//**********************************************************************
+
+void BeamSnapshotWriter::add(const string& name, double time, const vector<double>& values) {
+  if ( ! m_file.is_open() ) throw runtime_error("BeamSnapshotWriter: " + m_fname + " is closed");
+  auto& recs = m_index[name];
+  if ( recs.count(time) ) return;
+  m_file.write(reinterpret_cast<const char*>(values.data()), values.size()*sizeof(double));
+  recs[time] = {m_nval, values.size()};
+  m_nval += values.size();
+  ++m_nrec;
+}
+
+//**********************************************************************
+
+void BeamSnapshotWriter::close() {
+  if ( ! m_file.is_open() ) return;
+  const uint64_t indexOffset = headerSize + m_nval*sizeof(double);
+  put(m_file, uint64_t(m_index.size()));
+  for ( const auto& var : m_index ) {
+    const string& name = var.first;
+    put(m_file, uint64_t(name.size()));
+    m_file.write(name.data(), name.size());
+    const char zeros[8] = {0};
+    m_file.write(zeros, padded(name.size()) - name.size());
+    put(m_file, uint64_t(var.second.size()));
+    for ( const auto& rec : var.second ) {
+      put(m_file, rec.first);
+      put(m_file, rec.second.first);
+      put(m_file, rec.second.count);
+    }
+  }
+  put(m_file, indexOffset);
+  m_file.write(magic, sizeof(magic));
+  m_file.close();
+  if ( m_file.fail() ) throw runtime_error("BeamSnapshotWriter: error writing " + m_fname);
+}
+
+//**********************************************************************
+
+BeamSnapshotStore::BeamSnapshotStore(const string& fname) {
+  int fd = ::open(fname.c_str(), O_RDONLY);
+  if ( fd < 0 ) throw runtime_error("BeamSnapshotStore: unable to open " + fname);
+  struct stat st;
+  if ( ::fstat(fd, &st) != 0 || size_t(st.st_size) < headerSize + trailerSize + sizeof(uint64_t) ) {
+    ::close(fd);
+    throw runtime_error("BeamSnapshotStore: " + fname + " is too short to be a store");
+  }
+  m_size = st.st_size;
+  void* map = ::mmap(nullptr, m_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  ::close(fd);
+  if ( map == MAP_FAILED ) throw runtime_error("BeamSnapshotStore: unable to map " + fname);
+  m_map = static_cast<const char*>(map);
+
+  try {
+    uint32_t fileVersion;
+    std::memcpy(&fileVersion, m_map + sizeof(magic), sizeof(fileVersion));
+    const char* trailer = m_map + m_size - trailerSize;
+    if ( std::memcmp(m_map, magic, sizeof(magic)) != 0 || std::memcmp(trailer + 8, magic, sizeof(magic)) != 0 ) {
+      throw runtime_error("BeamSnapshotStore: " + fname + " is not a complete store");
+    }
+    if ( fileVersion != version ) {
+      std::ostringstream ssmsg;
+      ssmsg << "BeamSnapshotStore: " << fname << " has unsupported version " << fileVersion;
+      throw runtime_error(ssmsg.str());
+    }
+    uint64_t indexOffset;
+    std::memcpy(&indexOffset, trailer, sizeof(indexOffset));
+    if ( indexOffset < headerSize || indexOffset > m_size - trailerSize || (indexOffset - headerSize) % sizeof(double) ) {
+      throw runtime_error("BeamSnapshotStore: bad index offset in " + fname);
+    }
+    const double* values = reinterpret_cast<const double*>(m_map + headerSize);
+    const uint64_t nval = (indexOffset - headerSize)/sizeof(double);
+    Cursor cur(m_map + indexOffset, trailer, fname);
+    uint64_t nvar = cur.get<uint64_t>();
+    bool first = true;
+    for ( uint64_t ivar=0; ivar<nvar; ++ivar ) {
+      uint64_t nchar = cur.get<uint64_t>();
+      string name(cur.take(padded(nchar)), nchar);
+      uint64_t nrec = cur.get<uint64_t>();
+      vector<Record>& recs = m_vars[name];
+      recs.reserve(nrec);
+      for ( uint64_t irec=0; irec<nrec; ++irec ) {
+        double time = cur.get<double>();
+        uint64_t ifirst = cur.get<uint64_t>();
+        uint64_t count = cur.get<uint64_t>();
+        if ( ifirst > nval || count > nval - ifirst ) {
+          throw runtime_error("BeamSnapshotStore: record of " + name + " outside the values in " + fname);
+        }
+        recs.push_back({time, values + ifirst, count});
+        if ( first || time < m_start ) m_start = time;
+        if ( first || time > m_end ) m_end = time;
+        first = false;
+      }
+    }
+  } catch ( ... ) {
+    ::munmap(const_cast<char*>(m_map), m_size);
+    throw;
+  }
+  ::madvise(const_cast<char*>(m_map), m_size, MADV_RANDOM);
+}
+
+//**********************************************************************
+
+BeamSnapshotStore::~BeamSnapshotStore() {
+  if ( m_map != nullptr ) ::munmap(const_cast<char*>(m_map), m_size);
+}
+
+//**********************************************************************
+
+vector<string> BeamSnapshotStore::names() const {
+  vector<string> out;
+  for ( const auto& var : m_vars ) out.push_back(var.first);
+  return out;
+}
+
+//**********************************************************************
+
+const vector<BeamSnapshotStore::Record>& BeamSnapshotStore::records(const string& name) const {
+  static const vector<Record> none;
+  auto ivar = m_vars.find(name);
+  return ivar == m_vars.end() ? none : ivar->second;
+}
+
+//**********************************************************************
+
+const BeamSnapshotStore::Record*
+BeamSnapshotStore::find(const string& name, double when, double eps) const {
+  const vector<Record>& recs = records(name);
+  auto irec = std::lower_bound(recs.begin(), recs.end(), when - eps,
+                               [](const Record& rec, double time) { return rec.time < time; });
+  if ( irec == recs.end() || irec->time > when + eps ) return nullptr;
+  return &*irec;
+}
+
+//**********************************************************************
+
+BeamSnapshotFolder::BeamSnapshotFolder(std::shared_ptr<const BeamSnapshotStore> store)
+: m_store(store) {
+  if ( ! m_store ) throw runtime_error("BeamSnapshotFolder: no store");
+}
+
+//**********************************************************************
+
+vector<double> BeamSnapshotFolder::
+GetNamedVector(double when, const string& variable_name, double* actual_time) const {
+  const BeamSnapshotStore::Record* prec = m_store->find(variable_name, when, m_eps);
+  if ( prec == nullptr ) {
+    std::ostringstream ssmsg;
+    ssmsg << "BeamSnapshotFolder: no record of " << variable_name << " within " << m_eps
+          << " s of " << std::fixed << when;
+    throw runtime_error(ssmsg.str());
+  }
+  if ( actual_time != nullptr ) *actual_time = prec->time;
+  return vector<double>(prec->values, prec->values + prec->count);
+}
+
+//**********************************************************************
+
+}  // end namespace proto
@@ -0,0 +1,149 @@
+// BeamSnapshot.h
+//
+// Local store of the beam instrumentation readings used by BeamEvent, so
+// that the beam reconstruction can be rerun without the IFBeam database.
+//
+// BeamSnapshotWriter records each vector read from the database under its
+// variable name (e.g. "dip/acc/NORTH/NP04/BI/XBTF/S11:coarse[]") and the
+// time of the record. Close() writes the store file.
+//
+// BeamSnapshotStore maps a store file read-only. For each variable it holds
+// the records sorted by time, with the values left in the map.
+//
+// BeamSnapshotFolder provides the part of the ifbeam_ns::BeamFolder
+// interface used by BeamEvent on top of a store. A lookup returns the
+// earliest record within epsilon of the requested time, as BeamFolder does.
+// The store holds a subset of the database records that includes every
+// record returned while it was written. The same queries with the same
+// epsilon therefore return the same values.
+//
+// File layout (native byte order, 8-byte aligned):
+//   header:  "PDBISNAP", uint32 version, uint32 0
+//   values:  the doubles of every record, one block per record
+//   index:   uint64 nvar, then for each variable
+//              uint64 name length, name padded to 8 bytes,
+//              uint64 nrec, nrec x {double time, uint64 first, uint64 count}
+//   trailer: uint64 index offset, "PDBISNAP"
+
+#ifndef BeamSnapshot_H
+#define BeamSnapshot_H
+
+#include <cstdint>
+#include <cstddef>
+#include <fstream>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace proto {
+
+class BeamSnapshotWriter {
+
+public:
+
+  // Open fname for writing. Throws std::runtime_error on failure.
+  explicit BeamSnapshotWriter(const std::string& fname);
+
+  // Close() is called if it was not called before.
+  ~BeamSnapshotWriter();
+
+  BeamSnapshotWriter(const BeamSnapshotWriter&) = delete;
+  BeamSnapshotWriter& operator=(const BeamSnapshotWriter&) = delete;
+
+  // Record the values of variable name at time. A record that is already
+  // in the store (same name and time) is not written again.
+  void add(const std::string& name, double time, const std::vector<double>& values);
+
+  // Write the index and close the file.
+  void close();
+
+  size_t recordCount() const { return m_nrec; }
+
+private:
+
+  struct Record {
+    uint64_t first;
+    uint64_t count;
+  };
+
+  std::string m_fname;
+  std::ofstream m_file;
+  uint64_t m_nval = 0;
+  size_t m_nrec = 0;
+  std::map<std::string, std::map<double, Record>> m_index;
+
+};
+
+class BeamSnapshotStore {
+
+public:
+
+  // Map fname. Throws std::runtime_error if it is not a complete store.
+  explicit BeamSnapshotStore(const std::string& fname);
+
+  ~BeamSnapshotStore();
+
+  BeamSnapshotStore(const BeamSnapshotStore&) = delete;
+  BeamSnapshotStore& operator=(const BeamSnapshotStore&) = delete;
+
+  // A record: the values are valid as long as the store.
+  struct Record {
+    double time;
+    const double* values;
+    size_t count;
+  };
+
+  bool has(const std::string& name) const { return m_vars.count(name); }
+  std::vector<std::string> names() const;
+
+  // Records of a variable sorted by time (empty for an unknown variable).
+  const std::vector<Record>& records(const std::string& name) const;
+
+  // Earliest record of name with time in [when - eps, when + eps],
+  // nullptr if there is none.
+  const Record* find(const std::string& name, double when, double eps) const;
+
+  // Earliest and latest record times, 0 for an empty store.
+  double startTime() const { return m_start; }
+  double endTime() const { return m_end; }
+
+private:
+
+  const char* m_map = nullptr;
+  size_t m_size = 0;
+  std::map<std::string, std::vector<Record>> m_vars;
+  double m_start = 0.0;
+  double m_end = 0.0;
+
+};
+
+class BeamSnapshotFolder {
+
+public:
+
+  explicit BeamSnapshotFolder(std::shared_ptr<const BeamSnapshotStore> store);
+
+  void set_epsilon(double eps) { m_eps = eps; }
+
+  // Values of variable_name at time when. Throws std::runtime_error if the
+  // store has no record within epsilon, where BeamFolder would throw for a
+  // value missing from the database.
+  std::vector<double> GetNamedVector(double when, const std::string& variable_name,
+                                     double* actual_time = nullptr) const;
+
+  // The whole store is available, so there is no cache to fill.
+  void FillCache(double) { }
+  uint64_t GetCacheStartTime() const { return m_store->startTime(); }
+  uint64_t GetCacheEndTime() const { return m_store->endTime(); }
+
+private:
+
+  std::shared_ptr<const BeamSnapshotStore> m_store;
+  double m_eps = 0.0;
+
+};
+
+}  // end namespace proto
+
+#endif
@@ -0,0 +1,77 @@
+// BeamTOFMatcher.cxx
+
+#include "BeamTOFMatcher.h"
+
+using std::vector;
+
+namespace proto {
+
+//**********************************************************************
+
+BeamTOFMatcher::BeamTOFMatcher(double downstreamToGenTrig, double upstreamToDownstream)
+: m_downstreamToGenTrig(downstreamToGenTrig),
+  m_upstreamToDownstream(upstreamToDownstream) { }
+
+//**********************************************************************
+
+void BeamTOFMatcher::setHits(const TimeVector& tof1A, const TimeVector& tof1B,
+                             const TimeVector& tof2A, const TimeVector& tof2B, double tref) {
+  m_tref = tref;
+  m_hits[0] = &tof1A;
+  m_hits[1] = &tof1B;
+  m_hits[2] = &tof2A;
+  m_hits[3] = &tof2B;
+  for ( int icnt=0; icnt<4; ++icnt ) index(*m_hits[icnt], m_index[icnt]);
+}
+
+//**********************************************************************
+
+void BeamTOFMatcher::index(const TimeVector& hits, BeamTriggerIndex& idx) const {
+  vector<double> keys;
+  keys.reserve(hits.size());
+  for ( const Time& hit : hits ) keys.push_back(key(hit));
+  idx.build(keys);
+}
+
+//**********************************************************************
+
+void BeamTOFMatcher::match(const Time& genTrig, vector<Match>& matches) const {
+  matches.clear();
+  if ( m_hits[0] == nullptr ) return;
+  const double genKey = key(genTrig);
+  for ( int downChan=0; downChan<2; ++downChan ) {
+    const TimeVector& down = *m_hits[2 + downChan];
+    const BeamTriggerIndex& idx = m_index[2 + downChan];
+    // Scan stops at the first downstream hit after the trigger.
+    size_t end = idx.scanEnd(genKey, [&](size_t idown) { return delta(genTrig, down[idown]) < 0.; });
+    // And keeps those not more than the window before it.
+    idx.matchesBefore(end, genKey - 1.e-9*m_downstreamToGenTrig, genKey,
+                      [&](size_t idown) { return !(delta(genTrig, down[idown]) > m_downstreamToGenTrig); },
+                      m_down);
+    for ( size_t idown : m_down ) matchUpstream(down[idown], idown, downChan, matches);
+  }
+}
+
+//**********************************************************************
+
+void BeamTOFMatcher::matchUpstream(const Time& down, size_t idown, int downChan, vector<Match>& matches) const {
+  const double downKey = key(down);
+  for ( int upChan=0; upChan<2; ++upChan ) {
+    const TimeVector& up = *m_hits[upChan];
+    const BeamTriggerIndex& idx = m_index[upChan];
+    size_t end = idx.scanEnd(downKey, [&](size_t iup) { return delta(down, up[iup]) < 0.; });
+    idx.matchesBefore(end, downKey - 1.e-9*m_upstreamToDownstream, downKey,
+                      [&](size_t iup) {
+                        double dt = delta(down, up[iup]);
+                        return dt > 0. && dt < m_upstreamToDownstream;
+                      },
+                      m_up);
+    for ( size_t iup : m_up ) {
+      matches.push_back({delta(down, up[iup]), upChan + 2*downChan, iup, idown});
+    }
+  }
+}
+
+//**********************************************************************
+
+}  // end namespace proto
@@ -0,0 +1,78 @@
+// BeamTOFMatcher.h
+//
+// Matching of the XTOF hits to a general trigger for BeamEvent.
+//
+// A downstream hit (2A or 2B) matches a general trigger at most
+// DownstreamToGenTrig ns before it. An upstream hit (1A or 1B) matches a
+// downstream hit less than UpstreamToDownstream ns before it. Each of these
+// scans a hit list in readout order and stops at the first hit later than
+// the reference time. The lists are indexed once per spill with
+// BeamTriggerIndex, and each general trigger costs a few binary searches.
+// The matches and their order are those of the nested loops this replaces.
+
+#ifndef BeamTOFMatcher_H
+#define BeamTOFMatcher_H
+
+#include "duneprototypes/Protodune/singlephase/BeamReco/BeamTriggerIndex.h"
+#include <cstddef>
+#include <utility>
+#include <vector>
+
+namespace proto {
+
+class BeamTOFMatcher {
+
+public:
+
+  // Hit time: seconds and nanoseconds.
+  using Time = std::pair<double, double>;
+  using TimeVector = std::vector<Time>;
+
+  // An upstream/downstream pair. chan is 0 for 1A2A, 1 for 1B2A, 2 for
+  // 1A2B and 3 for 1B2B.
+  struct Match {
+    double tof;
+    int chan;
+    size_t upstream;
+    size_t downstream;
+  };
+
+  // Ctor from the windows in ns.
+  BeamTOFMatcher(double downstreamToGenTrig, double upstreamToDownstream);
+
+  // Set the hits of each counter, in readout order. tref is any time near
+  // the spill, in seconds, to keep the indexed times precise.
+  void setHits(const TimeVector& tof1A, const TimeVector& tof1B,
+               const TimeVector& tof2A, const TimeVector& tof2B, double tref);
+
+  // All pairs for a general trigger: first those with a 2A hit, then with a
+  // 2B hit, each by increasing downstream hit, then 1A before 1B, then by
+  // increasing upstream hit.
+  void match(const Time& genTrig, std::vector<Match>& matches) const;
+
+private:
+
+  // Time in ns from b to a, computed as in the original loops.
+  static double delta(const Time& a, const Time& b) {
+    return 1.e9*(a.first - b.first) + a.second - b.second;
+  }
+
+  double key(const Time& t) const { return t.first - m_tref + 1.e-9*t.second; }
+
+  void index(const TimeVector& hits, BeamTriggerIndex& idx) const;
+
+  void matchUpstream(const Time& down, size_t idown, int downChan, std::vector<Match>& matches) const;
+
+  double m_downstreamToGenTrig;
+  double m_upstreamToDownstream;
+  double m_tref = 0.0;
+  const TimeVector* m_hits[4] = {nullptr, nullptr, nullptr, nullptr};  // 1A, 1B, 2A, 2B
+  BeamTriggerIndex m_index[4];
+  mutable std::vector<size_t> m_down;
+  mutable std::vector<size_t> m_up;
+
+};
+
+}  // end namespace proto
+
+#endif
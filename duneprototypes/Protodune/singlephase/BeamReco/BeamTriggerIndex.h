@@ -0,0 +1,95 @@
+// BeamTriggerIndex.h
+//
+// Time-sorted index of beamline triggers or hits (general triggers, TOF,
+// XCET or S11 hits).
+//
+// BeamEvent matches triggers by scanning lists in readout order with exact
+// tests on the (seconds, nanoseconds) times. The index is built from
+// approximate times in seconds, which the caller may take relative to a
+// nearby reference to keep them precise. A binary search then gives the few
+// entries near a time window, and the caller's exact test is applied to
+// those only. Candidate ranges are widened by slack() so that rounding in
+// the approximate times cannot drop an entry the exact test would accept.
+// The results are the same as those of the scans over all entries.
+
+#ifndef BeamTriggerIndex_H
+#define BeamTriggerIndex_H
+
+#include <algorithm>
+#include <cstddef>
+#include <utility>
+#include <vector>
+
+namespace proto {
+
+class BeamTriggerIndex {
+
+public:
+
+  static constexpr size_t npos = size_t(-1);
+
+  // Seconds added to each side of the window: far above the rounding of
+  // times near 1e9 s, far below the spacing of beam triggers.
+  static constexpr double slack() { return 1.e-5; }
+
+  // Index entries with the given times, in readout order.
+  void build(const std::vector<double>& times) {
+    m_entries.clear();
+    m_entries.reserve(times.size());
+    m_runningMax.clear();
+    m_runningMax.reserve(times.size());
+    for ( size_t itrg=0; itrg<times.size(); ++itrg ) {
+      m_entries.emplace_back(times[itrg], itrg);
+      m_runningMax.push_back(itrg == 0 ? times[itrg] : std::max(m_runningMax.back(), times[itrg]));
+    }
+    std::sort(m_entries.begin(), m_entries.end());
+  }
+
+  size_t size() const { return m_entries.size(); }
+
+  // Lowest index with time within [tmin - slack, tmax + slack]
+  // for which pass(index) is true, npos if there is none.
+  template<class PASS>
+  size_t firstMatch(double tmin, double tmax, PASS&& pass) const {
+    auto ient = std::lower_bound(m_entries.begin(), m_entries.end(), std::make_pair(tmin - slack(), size_t(0)));
+    size_t best = npos;
+    for ( ; ient != m_entries.end() && ient->first <= tmax + slack(); ++ient ) {
+      if ( ient->second < best && pass(ient->second) ) best = ient->second;
+    }
+    return best;
+  }
+
+  // Where a scan in readout order that stops at the first entry later than
+  // tref stops: the first index for which stop(index) is true, or size().
+  // stop(index) must be the exact test that the entry is later than tref.
+  template<class STOP>
+  size_t scanEnd(double tref, STOP&& stop) const {
+    size_t itrg = std::upper_bound(m_runningMax.begin(), m_runningMax.end(), tref - slack()) - m_runningMax.begin();
+    for ( ; itrg < m_runningMax.size(); ++itrg ) {
+      if ( stop(itrg) ) return itrg;
+    }
+    return m_runningMax.size();
+  }
+
+  // Indices below end with time within [tmin - slack, tmax + slack] for
+  // which pass(index) is true, in increasing order.
+  template<class PASS>
+  void matchesBefore(size_t end, double tmin, double tmax, PASS&& pass, std::vector<size_t>& out) const {
+    out.clear();
+    auto ient = std::lower_bound(m_entries.begin(), m_entries.end(), std::make_pair(tmin - slack(), size_t(0)));
+    for ( ; ient != m_entries.end() && ient->first <= tmax + slack(); ++ient ) {
+      if ( ient->second < end && pass(ient->second) ) out.push_back(ient->second);
+    }
+    std::sort(out.begin(), out.end());
+  }
+
+private:
+
+  std::vector<std::pair<double, size_t>> m_entries;
+  std::vector<double> m_runningMax;  // Latest time up to each index
+
+};
+
+}  // end namespace proto
+
+#endif
@@ -0,0 +1,165 @@
+// test_BeamSnapshot.cxx
+//
+// Test the beam instrumentation snapshot store: write a store, read it back
+// and check the lookups against a brute-force search of what was written.
+
+#include <string>
+#include <iostream>
+#include <fstream>
+#include <random>
+#include <memory>
+#include <stdexcept>
+#include <vector>
+#include <map>
+#include <cmath>
+#include <cstdio>
+#include <algorithm>
+#include <iterator>
+#include "duneprototypes/Protodune/singlephase/BeamReco/BeamSnapshot.h"
+
+#undef NDEBUG
+#include <cassert>
+
+using std::string;
+using std::cout;
+using std::endl;
+using std::vector;
+using proto::BeamSnapshotWriter;
+using proto::BeamSnapshotStore;
+using proto::BeamSnapshotFolder;
+
+//**********************************************************************
+
+int test_BeamSnapshot(unsigned int nrec) {
+  const string myname = "test_BeamSnapshot: ";
+#ifdef NDEBUG
+  cout << myname << "NDEBUG must be off." << endl;
+  abort();
+#endif
+  string line = "-----------------------------";
+  const string fname = "test_BeamSnapshot.dat";
+  std::mt19937 gen(20180927);
+
+  cout << myname << line << endl;
+  cout << myname << "Writing " << nrec << " records." << endl;
+  vector<string> names = {"dip/acc/NORTH/NP04/BI/XBTF/S11:coarse[]",
+                          "dip/acc/NORTH/NP04/BI/XBPF/XBPF022697:eventsData[]",
+                          "timber/XBH4/XTDC/022/713:SECONDS"};
+  std::map<string, std::map<double, vector<double>>> ref;
+  {
+    BeamSnapshotWriter writer(fname);
+    for ( unsigned int irec=0; irec<nrec; ++irec ) {
+      const string& name = names[gen() % names.size()];
+      double time = 1.5e9 + 0.5*(gen() % 2000);
+      vector<double> vals(gen() % 50);
+      for ( double& val : vals ) val = int(gen() % 100000) - 50000.5;
+      writer.add(name, time, vals);
+      // The first record at a time is kept.
+      if ( ref[name].count(time) == 0 ) ref[name][time] = vals;
+    }
+    size_t nref = 0;
+    for ( const auto& var : ref ) nref += var.second.size();
+    assert( writer.recordCount() == nref );
+  }
+
+  cout << myname << line << endl;
+  cout << myname << "Reading the store." << endl;
+  auto store = std::make_shared<const BeamSnapshotStore>(fname);
+  assert( store->names().size() == ref.size() );
+  double tmin = 1e20;
+  double tmax = -1e20;
+  for ( const auto& var : ref ) {
+    const auto& recs = store->records(var.first);
+    assert( recs.size() == var.second.size() );
+    size_t irec = 0;
+    for ( const auto& rec : var.second ) {
+      assert( recs[irec].time == rec.first );
+      assert( vector<double>(recs[irec].values, recs[irec].values + recs[irec].count) == rec.second );
+      tmin = std::min(tmin, rec.first);
+      tmax = std::max(tmax, rec.first);
+      ++irec;
+    }
+  }
+  assert( store->startTime() == tmin );
+  assert( store->endTime() == tmax );
+  assert( ! store->has("nosuchdevice") );
+  assert( store->records("nosuchdevice").empty() );
+
+  cout << myname << line << endl;
+  cout << myname << "Checking the folder lookups." << endl;
+  BeamSnapshotFolder folder(store);
+  for ( double eps : {0.0, 0.25, 6.0} ) {
+    folder.set_epsilon(eps);
+    for ( unsigned int itry=0; itry<1000; ++itry ) {
+      const string& name = names[gen() % names.size()];
+      double when = 1.5e9 - 10.0 + 0.25*(gen() % 4100);
+      const vector<double>* pexp = nullptr;
+      double texp = 0.0;
+      for ( const auto& rec : ref[name] ) {
+        if ( std::fabs(rec.first - when) <= eps ) {
+          pexp = &rec.second;
+          texp = rec.first;
+          break;
+        }
+      }
+      bool caught = false;
+      double actual = 0.0;
+      vector<double> vals;
+      try {
+        vals = folder.GetNamedVector(when, name, &actual);
+      } catch ( const std::runtime_error& ) {
+        caught = true;
+      }
+      assert( caught == (pexp == nullptr) );
+      if ( pexp != nullptr ) {
+        assert( vals == *pexp );
+        assert( actual == texp );
+      }
+    }
+  }
+  bool caught = false;
+  try {
+    folder.GetNamedVector(tmin, "nosuchdevice");
+  } catch ( const std::runtime_error& ) {
+    caught = true;
+  }
+  assert( caught );
+
+  cout << myname << line << endl;
+  cout << myname << "Checking that a truncated store is rejected." << endl;
+  {
+    std::ifstream fin(fname, std::ios::binary);
+    string bytes((std::istreambuf_iterator<char>(fin)), std::istreambuf_iterator<char>());
+    std::ofstream fout(fname, std::ios::binary | std::ios::trunc);
+    fout.write(bytes.data(), bytes.size() - 3);
+  }
+  caught = false;
+  try {
+    BeamSnapshotStore bad(fname);
+  } catch ( const std::runtime_error& ) {
+    caught = true;
+  }
+  assert( caught );
+  std::remove(fname.c_str());
+
+  cout << myname << line << endl;
+  cout << myname << "Done." << endl;
+  return 0;
+}
+
+//**********************************************************************
+
+int main(int argc, char* argv[]) {
+  unsigned int nrec = 5000;
+  if ( argc > 1 ) {
+    string sarg(argv[1]);
+    if ( sarg == "-h" ) {
+      cout << "Usage: " << argv[0] << " [NREC]" << endl;
+      return 0;
+    }
+    nrec = std::stoi(sarg);
+  }
+  return test_BeamSnapshot(nrec);
+}
+
+//**********************************************************************
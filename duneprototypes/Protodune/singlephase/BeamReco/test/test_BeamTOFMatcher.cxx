@@ -0,0 +1,162 @@
+// test_BeamTOFMatcher.cxx
+//
+// Check that BeamTOFMatcher gives the same TOF pairs, in the same order, as
+// the nested scans over the XTOF hits that BeamEvent used before.
+// The spills are synthetic, with hit times in the DIP form (seconds,
+// 8*coarse + frac/512 ns). Some have hits out of order or repeated.
+
+#include <algorithm>
+#include <string>
+#include <iostream>
+#include <random>
+#include <utility>
+#include <vector>
+#include "duneprototypes/Protodune/singlephase/BeamReco/BeamTOFMatcher.h"
+
+#undef NDEBUG
+#include <cassert>
+
+using std::string;
+using std::cout;
+using std::endl;
+using std::vector;
+using proto::BeamTOFMatcher;
+using Time = BeamTOFMatcher::Time;
+using TimeVector = BeamTOFMatcher::TimeVector;
+using Match = BeamTOFMatcher::Match;
+
+namespace {
+
+// The loops of BeamEvent::parseXTOF for one general trigger.
+void legacyMatch(const Time& gen, const TimeVector* hits[4], double downToGen, double upToDown,
+                 vector<Match>& matches) {
+  matches.clear();
+  for ( int downChan=0; downChan<2; ++downChan ) {
+    const TimeVector& down = *hits[2 + downChan];
+    for ( size_t idown=0; idown<down.size(); ++idown ) {
+      double delta_down = 1.e9*(gen.first - down[idown].first) + gen.second - down[idown].second;
+      if ( delta_down < 0. ) break;
+      else if ( delta_down > downToGen ) continue;
+      for ( int upChan=0; upChan<2; ++upChan ) {
+        const TimeVector& up = *hits[upChan];
+        for ( size_t iup=0; iup<up.size(); ++iup ) {
+          double delta = 1.e9*(down[idown].first - up[iup].first) + down[idown].second - up[iup].second;
+          if ( delta < 0. ) break;
+          else if ( delta > 0. && delta < upToDown ) {
+            matches.push_back({delta, upChan + 2*downChan, iup, idown});
+          }
+        }
+      }
+    }
+  }
+}
+
+// DIP time of t seconds.
+Time dipTime(double t, std::mt19937& gen) {
+  double sec = int(t);
+  double nano = 1.e9*(t - sec);
+  double coarse = int(nano/8.);
+  double frac = (gen() % 4 == 0) ? 0. : double(gen() % 4096);
+  return {sec, 8.*coarse + frac/512.};
+}
+
+}  // end unnamed namespace
+
+//**********************************************************************
+
+int test_BeamTOFMatcher(unsigned int nspill) {
+  const string myname = "test_BeamTOFMatcher: ";
+#ifdef NDEBUG
+  cout << myname << "NDEBUG must be off." << endl;
+  abort();
+#endif
+  string line = "-----------------------------";
+  std::mt19937 gen(20181011);
+  std::uniform_real_distribution<double> unif(0.0, 1.0);
+
+  // Values as in BeamEvent.fcl
+  const double downToGen = 50.;
+  const double upToDown = 500.;
+
+  cout << myname << line << endl;
+  cout << myname << "Matching in " << nspill << " spills." << endl;
+  size_t ntrig = 0;
+  size_t nmatch = 0;
+  vector<Match> exp;
+  vector<Match> got;
+  for ( unsigned int ispill=0; ispill<nspill; ++ispill ) {
+    double spillSec = 1540000000.0 + 60.0*ispill;
+    // Particles: 1A or 1B, then 2A or 2B some 100 to 400 ns later, and a
+    // general trigger up to 60 ns after that. Some counters miss hits and
+    // there is random noise in each.
+    TimeVector gens, tofs[4];
+    size_t npart = gen() % 300;
+    for ( size_t ipart=0; ipart<npart; ++ipart ) {
+      double t = spillSec + 4.8*unif(gen);
+      double tdown = t + 1.e-9*(100. + 300.*unif(gen));
+      double tgen = tdown + 1.e-9*60.*unif(gen);
+      if ( gen() % 10 ) tofs[gen() % 2].push_back(dipTime(t, gen));
+      if ( gen() % 10 ) tofs[2 + gen() % 2].push_back(dipTime(tdown, gen));
+      gens.push_back(dipTime(tgen, gen));
+    }
+    for ( int icnt=0; icnt<4; ++icnt ) {
+      size_t nnoise = gen() % 30;
+      for ( size_t inoi=0; inoi<nnoise; ++inoi ) tofs[icnt].push_back(dipTime(spillSec + 4.8*unif(gen), gen));
+    }
+    // Readout order: sorted in most spills, some hits swapped or repeated
+    // in the others.
+    auto byTime = [](const Time& lhs, const Time& rhs) {
+      return lhs.first < rhs.first || (lhs.first == rhs.first && lhs.second < rhs.second);
+    };
+    std::sort(gens.begin(), gens.end(), byTime);
+    for ( int icnt=0; icnt<4; ++icnt ) {
+      TimeVector& hits = tofs[icnt];
+      std::sort(hits.begin(), hits.end(), byTime);
+      if ( ispill % 3 == 0 && hits.size() > 1 ) {
+        for ( size_t iswp=0; iswp<5; ++iswp ) std::swap(hits[gen() % hits.size()], hits[gen() % hits.size()]);
+        hits.insert(hits.begin() + gen() % hits.size(), hits[gen() % hits.size()]);
+      }
+    }
+
+    BeamTOFMatcher matcher(downToGen, upToDown);
+    double tref = gens.size() ? gens[0].first : 0.;
+    matcher.setHits(tofs[0], tofs[1], tofs[2], tofs[3], tref);
+    const TimeVector* hits[4] = {&tofs[0], &tofs[1], &tofs[2], &tofs[3]};
+    for ( const Time& genTrig : gens ) {
+      ++ntrig;
+      legacyMatch(genTrig, hits, downToGen, upToDown, exp);
+      matcher.match(genTrig, got);
+      assert( got.size() == exp.size() );
+      for ( size_t imat=0; imat<exp.size(); ++imat ) {
+        assert( got[imat].tof == exp[imat].tof );
+        assert( got[imat].chan == exp[imat].chan );
+        assert( got[imat].upstream == exp[imat].upstream );
+        assert( got[imat].downstream == exp[imat].downstream );
+      }
+      if ( exp.size() ) ++nmatch;
+    }
+  }
+  cout << myname << "Found TOFs for " << nmatch << " of " << ntrig << " general triggers." << endl;
+  assert( nmatch > 0 );
+
+  cout << myname << line << endl;
+  cout << myname << "Done." << endl;
+  return 0;
+}
+
+//**********************************************************************
+
+int main(int argc, char* argv[]) {
+  unsigned int nspill = 200;
+  if ( argc > 1 ) {
+    string sarg(argv[1]);
+    if ( sarg == "-h" ) {
+      cout << "Usage: " << argv[0] << " [NSPILL]" << endl;
+      return 0;
+    }
+    nspill = std::stoi(sarg);
+  }
+  return test_BeamTOFMatcher(nspill);
+}
+
+//**********************************************************************
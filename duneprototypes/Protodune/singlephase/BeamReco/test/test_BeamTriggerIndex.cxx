@@ -0,0 +1,142 @@
+// test_BeamTriggerIndex.cxx
+//
+// Check that the time-sorted trigger index finds the same trigger as the
+// scans over all triggers of a spill used by BeamEvent.
+
+#include <string>
+#include <iostream>
+#include <random>
+#include <utility>
+#include <vector>
+#include "duneprototypes/Protodune/singlephase/BeamReco/BeamTriggerIndex.h"
+
+#undef NDEBUG
+#include <cassert>
+
+using std::string;
+using std::cout;
+using std::endl;
+using std::vector;
+using std::pair;
+using proto::BeamTriggerIndex;
+
+//**********************************************************************
+
+int test_BeamTriggerIndex(unsigned int nspill) {
+  const string myname = "test_BeamTriggerIndex: ";
+#ifdef NDEBUG
+  cout << myname << "NDEBUG must be off." << endl;
+  abort();
+#endif
+  string line = "-----------------------------";
+  std::mt19937 gen(20181010);
+  std::uniform_real_distribution<double> unif(0.0, 1.0);
+
+  // Values as in BeamEvent.fcl
+  const double calib = -0.095151040;
+  const double calibTol = 1.e-6;
+  const double s11Lower = -.75e-6;
+  const double s11Upper = -.55e-6;
+
+  cout << myname << line << endl;
+  cout << myname << "Matching in " << nspill << " spills." << endl;
+  size_t nmatch = 0;
+  size_t ntry = 0;
+  for ( unsigned int ispill=0; ispill<nspill; ++ispill ) {
+    // Triggers over a 5 s spill, some of them at the same time.
+    double spillSec = 1540000000.0 + 60.0*ispill;
+    size_t ntrg = gen() % 400;
+    vector<pair<double, double>> t0s;
+    for ( size_t itrg=0; itrg<ntrg; ++itrg ) {
+      if ( itrg > 0 && gen() % 20 == 0 ) {
+        t0s.push_back(t0s[gen() % itrg]);
+      } else {
+        double t = 5.0*unif(gen);
+        double sec = spillSec + int(t);
+        double nano = 1.e9*(t - int(t));
+        t0s.push_back({sec, nano});
+      }
+    }
+    vector<double> times;
+    for ( const auto& t0 : t0s ) times.push_back(t0.first + 1.e-9*t0.second);
+    BeamTriggerIndex index;
+    index.build(times);
+    assert( index.size() == ntrg );
+
+    for ( unsigned int itry=0; itry<200; ++itry ) {
+      ++ntry;
+      // TPC trigger: near a beam trigger for most tries.
+      double spillOffset = 10.0 + unif(gen);
+      double rdtsSec, rdtsNano;
+      if ( ntrg > 0 && itry % 4 != 0 ) {
+        const auto& t0 = t0s[gen() % ntrg];
+        double t = t0.first + 1.e-9*t0.second + spillOffset + calib + 3.e-6*(unif(gen) - 0.5);
+        rdtsSec = int(t);
+        rdtsNano = 1.e9*(t - int(t));
+      } else {
+        rdtsSec = spillSec + 10 + gen() % 5;
+        rdtsNano = 1.e9*unif(gen);
+      }
+
+      // MatchBeamToTPC
+      auto passTPC = [&](size_t iT) {
+        double diffSec = rdtsSec - t0s[iT].first - spillOffset;
+        double diffNano = 1.e-09*(rdtsNano - t0s[iT].second);
+        double diff = diffSec + diffNano;
+        return calib - calibTol < diff && calib + calibTol > diff;
+      };
+      size_t expTPC = BeamTriggerIndex::npos;
+      for ( size_t iT=0; iT<ntrg; ++iT ) {
+        if ( passTPC(iT) ) { expTPC = iT; break; }
+      }
+      double expected = rdtsSec + 1.e-9*rdtsNano - spillOffset - calib;
+      size_t gotTPC = index.firstMatch(expected - calibTol, expected + calibTol, passTPC);
+      assert( gotTPC == expTPC );
+      if ( gotTPC != BeamTriggerIndex::npos ) ++nmatch;
+
+      // MatchS11ToGen
+      double s11Sec = -1.0;
+      double s11Nano = -1.0;
+      if ( ntrg > 0 && itry % 3 != 0 ) {
+        const auto& t0 = t0s[gen() % ntrg];
+        double t = t0.first + 1.e-9*t0.second - 0.65e-6 + 0.4e-6*(unif(gen) - 0.5);
+        s11Sec = int(t);
+        s11Nano = 1.e9*(t - int(t));
+      }
+      auto passS11 = [&](size_t iT) {
+        double diff = t0s[iT].first - s11Sec;
+        diff += 1.e-9*(t0s[iT].second - s11Nano);
+        return s11Lower < diff && diff < s11Upper;
+      };
+      size_t expS11 = BeamTriggerIndex::npos;
+      for ( size_t iT=0; iT<ntrg; ++iT ) {
+        if ( passS11(iT) ) { expS11 = iT; break; }
+      }
+      double s11Time = s11Sec + 1.e-9*s11Nano;
+      size_t gotS11 = index.firstMatch(s11Time + s11Lower, s11Time + s11Upper, passS11);
+      assert( gotS11 == expS11 );
+    }
+  }
+  cout << myname << "Matched " << nmatch << " of " << ntry << " TPC triggers." << endl;
+
+  cout << myname << line << endl;
+  cout << myname << "Done." << endl;
+  return 0;
+}
+
+//**********************************************************************
+
+int main(int argc, char* argv[]) {
+  unsigned int nspill = 200;
+  if ( argc > 1 ) {
+    string sarg(argv[1]);
+    if ( sarg == "-h" ) {
+      cout << "Usage: " << argv[0] << " [NSPILL]" << endl;
+      return 0;
+    }
+    nspill = std::stoi(sarg);
+  }
+  return test_BeamTriggerIndex(nspill);
+}
+
+//**********************************************************************
@@ -54,6 +54,8 @@
 
 //Local includes
 #include "duneprototypes/Protodune/singlephase/CRT/data/CRTTrigger.h"
+#include "duneprototypes/Protodune/singlephase/CRT/alg/match/CRTHitSweep.h"
+#include "duneprototypes/Protodune/singlephase/CRT/alg/match/CRTMatchCache.h"
 
 //ROOT includes
 #include "TH1.h"
@@ -69,6 +71,7 @@
 #include <numeric> //std::accumulate was moved from <algorithm> to <numeric> in c++14
 #include <iostream>
 #include <cmath>
+#include <map>
 using namespace std;   // Namespaces established to make life easier
 using namespace ROOT::Math;
 namespace CRT {
@@ -91,6 +94,7 @@ public:
   
   bool moduleMatcher(int module1, int module2);
   void produce(art::Event & event) override;
+  void beginJob() override;
   std::string fTrackModuleLabel = "pandoraTrack";
 
   int nEvents = 0;
@@ -192,6 +196,24 @@ public:
 
   std::vector < tempHits > tempHits_F;
   std::vector < tempHits > tempHits_B;
+
+  void make2DHits(const std::vector < tempHits > & hits, std::vector < recoHits > & out);
+  CRT::StripTable fStripTable; // (module, channel) -> strip centre, filled in beginJob
+  CRT::HitSweep fHitSweep;
+  std::vector < CRT::StripHit > stripHits;
+  std::vector < CRT::Hit2D > hits2D;
+
+  typedef struct // Track moved to a CRT time
+  {
+    double startX, startY, startZ;
+    double endX, endY, endZ;
+  }
+  shiftedTrack;
+
+  double driftOffset(detinfo::DetectorPropertiesData const & detProp, geo::WireID const & wire, double crtTime);
+  std::map < geo::PlaneID, CRT::TimeMemo < double > > driftOffsets; // Per event, by readout plane
+  CRT::TimeMemo < shiftedTrack > trackShifts; // Per track
+  CRT::TimeIndex hitTimes_F, hitTimes_B;
   std::vector < tracksPair > tracksPair_F;
   std::vector < tracksPair > tracksPair_B;
 };
@@ -221,6 +243,44 @@ bool CRT::SingleCRTMatchingProducer::moduleMatcher(int module1, int module2) {
 
 }
 
+void CRT::SingleCRTMatchingProducer::make2DHits(const std::vector < tempHits > & hits, std::vector < recoHits > & out) {
+  // Pair hits on matching X and Y modules within the module-to-module timing cut
+  stripHits.clear();
+  for (const auto & hit: hits) stripHits.push_back({size_t(hit.module), size_t(hit.channel), double(hit.triggerTime)});
+  fHitSweep.Build2DHits(stripHits, fStripTable, fModuletoModuleTimingCut,
+                        [this](int module1, int module2) { return moduleMatcher(module1, module2); }, hits2D);
+  for (const auto & hit2D: hits2D) {
+    const auto & hitX = hits[hit2D.x];
+    const auto & hitY = hits[hit2D.y];
+    recoHits rHits;
+    rHits.hitPositionX = hit2D.posX; // Strip centre, +1.25 cm if the next strip was hit too (CRT_Res=2.5 cm)
+    rHits.hitPositionY = hit2D.posY;
+    rHits.hitPositionZ = hit2D.posZ;
+    rHits.adcX=hitX.adc;
+    rHits.adcY=hitY.adc;
+    rHits.moduleX=hitX.module;
+    rHits.moduleY=hitY.module;
+    rHits.trigNumberX=hitX.triggerNumber;
+    rHits.trigNumberY=hitY.triggerNumber;
+    rHits.stripX=hitX.channel;
+    rHits.stripY=hitY.channel;
+    rHits.timeAvg = hit2D.time;
+    out.push_back(rHits);
+  }
+}
+
+double CRT::SingleCRTMatchingProducer::driftOffset(detinfo::DetectorPropertiesData const & detProp, geo::WireID const & wire, double crtTime) {
+  // X shift of a track at the CRT time, computed once per event for each CRT time and readout plane
+  return driftOffsets[wire.planeID()].Get(crtTime, [&](double time) {
+    int RDOffset=0;
+    if (!fMCCSwitch) RDOffset=111;
+    double ticksOffset=0;
+    if (!fMCCSwitch) ticksOffset = (time+RDOffset)/25.f+detProp.GetXTicksOffset(wire.Plane, wire.TPC, wire.Cryostat);
+    else ticksOffset = (time/500.f)+detProp.GetXTicksOffset(wire.Plane, wire.TPC, wire.Cryostat);
+    return detProp.ConvertTicksToX(ticksOffset, wire.Plane, wire.TPC, wire.Cryostat);
+  });
+}
+
 
 //Turn sim::AuxDetSimChannels into CRT::Hits. 
 void CRT::SingleCRTMatchingProducer::produce(art::Event & event)
@@ -324,10 +384,7 @@ void CRT::SingleCRTMatchingProducer::produce(art::Event & event)
 	 //cout<<trigger.Channel()<<','<<hit.Channel()<<','<<hit.ADC()<<endl;
         nHits++;
 
-        const auto & trigGeo = geom -> AuxDet(trigger.Channel()); // Get geo  
-        const auto & csens = trigGeo.SensitiveVolume(hit.Channel());
-        const auto center = csens.GetCenter();
-        if (center.Z() < 100) tempHits_F.push_back(tHits); // Sort F/B from Z
+        if (fStripTable.At(trigger.Channel(), hit.Channel()).z < 100) tempHits_F.push_back(tHits); // Sort F/B from Z
         else tempHits_B.push_back(tHits);
         hitID++;
       }
@@ -338,108 +395,9 @@ void CRT::SingleCRTMatchingProducer::produce(art::Event & event)
   //cout << "Hits compiled for event: " << nEvents << endl;
   //cout << "Number of Hits above Threshold:  " << hitID << endl;
 
-  for (unsigned int f = 0; f < tempHits_F.size(); f++) {
-    for (unsigned int f_test = 0; f_test < tempHits_F.size(); f_test++) {
-       if (fabs(tempHits_F[f_test].triggerTime-tempHits_F[f].triggerTime)>fModuletoModuleTimingCut) continue;
-      const auto & trigGeo = geom -> AuxDet(tempHits_F[f].module);
-      const auto & trigGeo2 = geom -> AuxDet(tempHits_F[f_test].module);
-
-      const auto & hit1Geo = trigGeo.SensitiveVolume(tempHits_F[f].channelGeo);
-      const auto hit1Center = hit1Geo.GetCenter();
-      // Create 2D hits from geo of the Y and X modules
-       const auto & hit2Geo = trigGeo2.SensitiveVolume(tempHits_F[f_test].channelGeo);
-      const auto hit2Center = hit2Geo.GetCenter();
-      bool moduleMatched;
-      moduleMatched=moduleMatcher(tempHits_F[f_test].module, tempHits_F[f].module);
-
-      if (moduleMatched) {
-        // Get the center of the hits (CRT_Res=2.5 cm)
-        double hitX = hit1Center.X();
-	for (unsigned int a = 0; a < tempHits_F.size(); a++)
-	{
-	if(tempHits_F[a].module==tempHits_F[f].module && (tempHits_F[a].channelGeo-1)==tempHits_F[f].channelGeo) hitX=hit1Center.X()+1.25;
-	}
-	double hitYPrelim=hit2Center.Y();
-	for (unsigned int a = 0; a < tempHits_F.size(); a++)
-	{
-	if(tempHits_F[a].module==tempHits_F[f_test].module && (tempHits_F[a].channelGeo-1)==tempHits_F[f_test].channelGeo) hitYPrelim=hit2Center.Y()+1.25;
-	}
-	
-
-	
-	double hitY=hitYPrelim;
-        double hitZ = (hit1Center.Z() + hit2Center.Z()) / 2.f;
-
-        recoHits rHits;
-        rHits.adcX=tempHits_F[f].adc;
-	rHits.adcY=tempHits_F[f_test].adc;
-        rHits.hitPositionX = hitX;
-        rHits.hitPositionY = hitY;
-        rHits.hitPositionZ = hitZ;
-	rHits.moduleX=tempHits_F[f].module;
-        rHits.moduleY=tempHits_F[f_test].module;
-        rHits.trigNumberX=tempHits_F[f].triggerNumber;
-	rHits.trigNumberY=tempHits_F[f_test].triggerNumber;
-	rHits.stripX=tempHits_F[f].channel;
-	rHits.stripY=tempHits_F[f_test].channel;
-	rHits.timeAvg = (tempHits_F[f_test].triggerTime+tempHits_F[f].triggerTime)/2.0;
-       primaryHits_F.push_back(rHits); // Add array
-    }
-    }
-  }
-  for (unsigned int f = 0; f < tempHits_B.size(); f++) {
-    for (unsigned int f_test = 0; f_test < tempHits_B.size(); f_test++) { // Same as above but for back CRT
-       if (fabs(tempHits_B[f_test].triggerTime-tempHits_B[f].triggerTime)>fModuletoModuleTimingCut) continue;
-
-      const auto & trigGeo = geom -> AuxDet(tempHits_B[f].module);
-      const auto & trigGeo2 = geom -> AuxDet(tempHits_B[f_test].module);
-      const auto & hit1Geo = trigGeo.SensitiveVolume(tempHits_B[f].channelGeo);
-      const auto hit1Center = hit1Geo.GetCenter();
-
-      const auto & hit2Geo = trigGeo2.SensitiveVolume(tempHits_B[f_test].channelGeo);
-      const auto hit2Center = hit2Geo.GetCenter();
-      bool moduleMatched;
-      moduleMatched=moduleMatcher(tempHits_B[f_test].module, tempHits_B[f].module);
-
-
-      if (moduleMatched) {
-        double hitX = hit1Center.X();
-	
-	
-	for (unsigned int a = 0; a < tempHits_B.size(); a++)
-	{
-	if(tempHits_B[a].module==tempHits_B[f].module && (tempHits_B[a].channelGeo-1)==tempHits_B[f].channelGeo) hitX=hit1Center.X()+1.25;
-	}
-	
-        double hitYPrelim = hit2Center.Y();
-	
-	for (unsigned int a = 0; a < tempHits_B.size(); a++)
-	{
-	if(tempHits_B[a].module==tempHits_B[f_test].module && (tempHits_B[a].channel-1)==tempHits_B[f_test].channel) hitYPrelim=hit2Center.Y()+1.25;
-	}
-	double hitY=hitYPrelim;
-
-	
-        double hitZ = (hit1Center.Z() + hit2Center.Z()) / 2.f;
-
-        recoHits rHits;
-        rHits.adcX=tempHits_B[f].adc;
-	rHits.adcY=tempHits_B[f_test].adc;
-        rHits.hitPositionX = hitX;
-        rHits.hitPositionY = hitY;
-        rHits.hitPositionZ = hitZ;
-        rHits.moduleX=tempHits_B[f].module;
-        rHits.moduleY=tempHits_B[f_test].module;
-	rHits.stripX=tempHits_B[f].channel;
-	rHits.trigNumberX=tempHits_B[f].triggerNumber;
-	rHits.trigNumberY=tempHits_B[f_test].triggerNumber;
-	rHits.stripY=tempHits_B[f_test].channel;
-	rHits.timeAvg = (tempHits_B[f_test].triggerTime+tempHits_B[f].triggerTime)/2.0;
-	 primaryHits_B.push_back(rHits); 
-
-	 }
-    }
-  }
+  // Create 2D hits from the X and Y modules of each side
+  make2DHits(tempHits_F, primaryHits_F);
+  make2DHits(tempHits_B, primaryHits_B);
 
      auto const t0CandPtr = art::PtrMaker<anab::T0>(event);
      auto const crtPtr = art::PtrMaker<anab::CosmicTag>(event);	
@@ -465,6 +423,13 @@ event.put(std::move(T0col)); event.put(std::move(CRTTrack)); event.put(std::move
   int tempId = 0;
 
   auto const detProp = art::ServiceHandle<detinfo::DetectorPropertiesService const>()->DataFor(event);
+  driftOffsets.clear();
+  std::vector < double > times;
+  for (const auto & hit: primaryHits_F) times.push_back(hit.timeAvg);
+  hitTimes_F.Build(times);
+  times.clear();
+  for (const auto & hit: primaryHits_B) times.push_back(hit.timeAvg);
+  hitTimes_B.Build(times);
    
   for (int iRecoTrack = 0; iRecoTrack < nTracksReco; ++iRecoTrack) {
     if (primaryHits_F.size()+primaryHits_B.size()<1) break;
@@ -508,6 +473,33 @@ event.put(std::move(T0col)); event.put(std::move(CRTTrack)); event.put(std::move
     firstHit=lastHit;
     lastHit=0;
     }
+    // CRT times allowed by the Pandora T0 of the track
+    const double pandoraT0 = t0s.empty() ? 0. : t0s.at(0)->Time();
+    const double timeScale = event.isRealData() ? 20.f : 1.;
+    auto tooEarly = [&](double timeAvg) { return pandoraT0-timeAvg*timeScale > 100000; };
+    auto tooLate = [&](double timeAvg) { return timeAvg*timeScale-pandoraT0 > 100000; };
+
+    // Track with the given X positions, corrected for space charge
+    auto correctTrack = [&](double startX, double endX, bool applySCE) {
+      shiftedTrack track{startX, trackStartPositionY_noSCE, trackStartPositionZ_noSCE,
+                         endX, trackEndPositionY_noSCE, trackEndPositionZ_noSCE};
+      if (applySCE && fSCECorrection && SCE->EnableCalSpatialSCE()) {
+        auto const startTPC = geom->PositionToTPCID(geo::Point_t(track.startX, track.startY, track.startZ)).deepestIndex();
+        auto const endTPC = geom->PositionToTPCID(geo::Point_t(track.endX, track.endY, track.endZ)).deepestIndex();
+        if (endTPC<13 && startTPC<13) {
+          auto const & posOffsets_F = SCE->GetCalPosOffsets(geo::Point_t(track.startX, track.startY, track.startZ), startTPC);
+          track.startX -= posOffsets_F.X();
+          track.startY += posOffsets_F.Y();
+          track.startZ += posOffsets_F.Z();
+          auto const & posOffsets_B = SCE->GetCalPosOffsets(geo::Point_t(track.endX, track.endY, track.endZ), endTPC);
+          track.endX -= posOffsets_B.X();
+          track.endY += posOffsets_B.Y();
+          track.endZ += posOffsets_B.Z();
+        }
+      }
+      return track;
+    };
+
  if ((trackEndPositionZ_noSCE>90 && trackEndPositionZ_noSCE < 660 && trackStartPositionZ_noSCE <50 && trackStartPositionZ_noSCE<660) || (trackStartPositionZ_noSCE>90 && trackStartPositionZ_noSCE < 660 && trackEndPositionZ_noSCE <50 && trackEndPositionZ_noSCE<660)) {
 
       double min_delta = DBL_MAX;
@@ -518,53 +510,35 @@ event.put(std::move(T0col)); event.put(std::move(CRTTrack)); event.put(std::move
       int bestHitIndex_F=-1;
       double best_trackX1=DBL_MAX;
       double best_trackX2=DBL_MAX;
-      for (unsigned int iHit_F = 0; iHit_F < primaryHits_F.size(); iHit_F++) {
-   double xOffset=0;
-
-		double trackStartPositionX_notCorrected=trackStartPositionX_noSCE;
-		double trackEndPositionX_notCorrected=trackEndPositionX_noSCE;
-		if (!t0s.empty()){
-		if (event.isRealData() && fabs(t0s.at(0)->Time()-(primaryHits_F[iHit_F].timeAvg*20.f))>100000) continue;
-		if (!event.isRealData() && fabs(t0s.at(0)->Time()-primaryHits_F[iHit_F].timeAvg)>100000) continue;
-		}
-		if (t0s.empty()){
-		int RDOffset=0;
-		if (!fMCCSwitch) RDOffset=111;
-		double ticksOffset=0;
-		//cout<<(primaryHits_F[iHit_F].timeAvg+RDOffset)<<endl;
-                //cout<<detProp.GetXTicksOffset(allHits[firstHit]->WireID().Plane, allHits[firstHit]->WireID().TPC, allHits[firstHit]->WireID().Cryostat)<<endl;
-                if (!fMCCSwitch) ticksOffset = (primaryHits_F[iHit_F].timeAvg+RDOffset)/25.f+detProp.GetXTicksOffset(allHits[firstHit]->WireID().Plane, allHits[firstHit]->WireID().TPC, allHits[firstHit]->WireID().Cryostat);
-
-                else if (fMCCSwitch) ticksOffset = (primaryHits_F[iHit_F].timeAvg/500.f)+detProp.GetXTicksOffset(allHits[firstHit]->WireID().Plane, allHits[firstHit]->WireID().TPC, allHits[firstHit]->WireID().Cryostat);
-		
-               xOffset=detProp.ConvertTicksToX(ticksOffset,allHits[firstHit]->WireID().Plane, allHits[firstHit]->WireID().TPC, allHits[firstHit]->WireID().Cryostat);
-		//double xOffset=.08*ticksOffset
-		
-	 trackStartPositionX_noSCE=trackStartPositionX_notCorrected-xOffset;
-         trackEndPositionX_noSCE=trackEndPositionX_notCorrected-xOffset;
-	if (fabs(xOffset)>300 || ((trackStartPositionX_notCorrected<0 && trackStartPositionX_noSCE>0) || (trackEndPositionX_notCorrected<0 && trackEndPositionX_noSCE>0)) || ((trackStartPositionX_notCorrected>0 && trackStartPositionX_noSCE<0) || (trackEndPositionX_notCorrected>0 && trackEndPositionX_noSCE<0)) ) continue;
-	}
+      std::pair < size_t, size_t > hitRange(0, hitTimes_F.Size());
+      if (!t0s.empty()) hitRange = hitTimes_F.Range(tooEarly, tooLate);
+      trackShifts.Clear();
+      // Without a Pandora T0 the track is moved to the time of each candidate in turn,
+      // starting from where the previous candidate left it, so the candidates are
+      // visited in index order.
+      double shiftedStartX=trackStartPositionX_noSCE;
+      double shiftedEndX=trackEndPositionX_noSCE;
+      for (size_t iPos = hitRange.first; iPos < hitRange.second; iPos++) { // Candidates in time order with a Pandora T0
+        const unsigned int iHit_F = t0s.empty() ? iPos : hitTimes_F[iPos];
+        shiftedTrack shifted;
+        if (t0s.empty()) {
+          const double xOffset = driftOffset(detProp, allHits[firstHit]->WireID(), primaryHits_F[iHit_F].timeAvg);
+          const double trackStartPositionX_notCorrected=shiftedStartX;
+          const double trackEndPositionX_notCorrected=shiftedEndX;
+          shiftedStartX=trackStartPositionX_notCorrected-xOffset;
+          shiftedEndX=trackEndPositionX_notCorrected-xOffset;
+          if (fabs(xOffset)>300 || ((trackStartPositionX_notCorrected<0 && shiftedStartX>0) || (trackEndPositionX_notCorrected<0 && shiftedEndX>0)) || ((trackStartPositionX_notCorrected>0 && shiftedStartX<0) || (trackEndPositionX_notCorrected>0 && shiftedEndX<0)) ) continue;
+          shifted = correctTrack(shiftedStartX, shiftedEndX, true);
+        }
+        else shifted = trackShifts.Get(0., [&](double) { return correctTrack(shiftedStartX, shiftedEndX, true); });
 
-   double trackStartPositionX=trackStartPositionX_noSCE;
-   double trackStartPositionY=trackStartPositionY_noSCE;
-   double trackStartPositionZ=trackStartPositionZ_noSCE;
+   double trackStartPositionX=shifted.startX;
+   double trackStartPositionY=shifted.startY;
+   double trackStartPositionZ=shifted.startZ;
 
-   double trackEndPositionX=trackEndPositionX_noSCE;
-   double trackEndPositionY=trackEndPositionY_noSCE;
-   double trackEndPositionZ=trackEndPositionZ_noSCE;
-
-   if (fSCECorrection && SCE->EnableCalSpatialSCE()){
-if(geom->PositionToTPCID(geo::Point_t(trackEndPositionX, trackEndPositionY, trackEndPositionZ)).deepestIndex()<13 && geom->PositionToTPCID(geo::Point_t(trackStartPositionX, trackStartPositionY, trackStartPositionZ)).deepestIndex()<13){ 
-            auto const & posOffsets_F = SCE->GetCalPosOffsets(geo::Point_t(trackStartPositionX, trackStartPositionY, trackStartPositionZ), geom->PositionToTPCID(geo::Point_t(trackStartPositionX, trackStartPositionY, trackStartPositionZ)).deepestIndex());
-            trackStartPositionX -= posOffsets_F.X();
-            trackStartPositionY += posOffsets_F.Y();
-            trackStartPositionZ += posOffsets_F.Z();
-            auto const & posOffsets_B = SCE->GetCalPosOffsets(geo::Point_t(trackEndPositionX, trackEndPositionY, trackEndPositionZ), geom->PositionToTPCID(geo::Point_t(trackEndPositionX, trackEndPositionY, trackEndPositionZ)).deepestIndex());
-            trackEndPositionX -= posOffsets_B.X();
-            trackEndPositionY += posOffsets_B.Y();
-            trackEndPositionZ += posOffsets_B.Z();
-	}
-    }
+   double trackEndPositionX=shifted.endX;
+   double trackEndPositionY=shifted.endY;
+   double trackEndPositionZ=shifted.endZ;
 
         double X1 = primaryHits_F[iHit_F].hitPositionX;
 
@@ -606,7 +580,7 @@ if(geom->PositionToTPCID(geo::Point_t(trackEndPositionX, trackEndPositionY, trac
         double deltaY1 = (predictedHitPositionY1-Y1);
 
 
-   if (min_delta > std::abs(deltaX1) + std::abs(deltaY1) ){
+   if (min_delta > std::abs(deltaX1) + std::abs(deltaY1) || (min_delta == std::abs(deltaX1) + std::abs(deltaY1) && int(iHit_F) < bestHitIndex_F)){
 
 	   min_delta=std::abs(deltaX1)+std::abs(deltaY1);
 
@@ -676,40 +650,36 @@ if(geom->PositionToTPCID(geo::Point_t(trackEndPositionX, trackEndPositionY, trac
       int bestHitIndex_B=-1;
       double best_trackX1=DBL_MAX;
       double best_trackX2=DBL_MAX;
-      for (unsigned int iHit_B = 0; iHit_B < primaryHits_B.size(); iHit_B++) {
-double xOffset=0;
-    
+      std::pair < size_t, size_t > hitRange(0, hitTimes_B.Size());
+      if (!t0s.empty()) hitRange = hitTimes_B.Range(tooEarly, tooLate);
+      trackShifts.Clear();
+      // Without a Pandora T0 the track is moved to the time of each candidate in turn,
+      // starting from where the previous candidate left it, so the candidates are
+      // visited in index order.
+      double shiftedStartX=trackStartPositionX_noSCE;
+      double shiftedEndX=trackEndPositionX_noSCE;
+      for (size_t iPos = hitRange.first; iPos < hitRange.second; iPos++) { // Candidates in time order with a Pandora T0
+        const unsigned int iHit_B = t0s.empty() ? iPos : hitTimes_B[iPos];
+        shiftedTrack shifted;
+        if (t0s.empty()) {
+          const double xOffset = driftOffset(detProp, allHits[firstHit]->WireID(), primaryHits_B[iHit_B].timeAvg);
+          const double trackStartPositionX_notCorrected=shiftedStartX;
+          const double trackEndPositionX_notCorrected=shiftedEndX;
+          shiftedStartX=trackStartPositionX_notCorrected-xOffset;
+          shiftedEndX=trackEndPositionX_notCorrected-xOffset;
+          if (fabs(xOffset)>300 || ((trackStartPositionX_notCorrected<0 && shiftedStartX>0) || (trackEndPositionX_notCorrected<0 && shiftedEndX>0)) || ((trackStartPositionX_notCorrected>0 && shiftedStartX<0) || (trackEndPositionX_notCorrected>0 && shiftedEndX<0)) ) continue;
+          shifted = correctTrack(shiftedStartX, shiftedEndX, false);
+        }
+        else shifted = trackShifts.Get(0., [&](double) { return correctTrack(shiftedStartX, shiftedEndX, false); });
 
-		double trackStartPositionX_notCorrected=trackStartPositionX_noSCE;
-		double trackEndPositionX_notCorrected=trackEndPositionX_noSCE;
-		if (!t0s.empty()){
-		if (event.isRealData() && fabs(t0s.at(0)->Time()-(primaryHits_B[iHit_B].timeAvg*20.f))>100000) continue;
-		if (!event.isRealData() && fabs(t0s.at(0)->Time()-primaryHits_B[iHit_B].timeAvg)>100000) continue;
-	}
-		if (t0s.empty()){
-		int RDOffset=0;
-		if (!fMCCSwitch) RDOffset=111;
-		double ticksOffset=0;
-                if (!fMCCSwitch) ticksOffset = (primaryHits_B[iHit_B].timeAvg+RDOffset)/25.f+detProp.GetXTicksOffset(allHits[firstHit]->WireID().Plane, allHits[firstHit]->WireID().TPC, allHits[firstHit]->WireID().Cryostat);
-
-                else if (fMCCSwitch) ticksOffset = (primaryHits_B[iHit_B].timeAvg/500.f)+detProp.GetXTicksOffset(allHits[firstHit]->WireID().Plane, allHits[firstHit]->WireID().TPC, allHits[firstHit]->WireID().Cryostat);
-		
-               xOffset=detProp.ConvertTicksToX(ticksOffset,allHits[firstHit]->WireID().Plane, allHits[firstHit]->WireID().TPC, allHits[firstHit]->WireID().Cryostat);
-		//double xOffset=.08*ticksOffset
-		
-	 trackStartPositionX_noSCE=trackStartPositionX_notCorrected-xOffset;
-         trackEndPositionX_noSCE=trackEndPositionX_notCorrected-xOffset;
-
-	if (fabs(xOffset)>300 || ((trackStartPositionX_notCorrected<0 && trackStartPositionX_noSCE>0) || (trackEndPositionX_notCorrected<0 && trackEndPositionX_noSCE>0)) || ((trackStartPositionX_notCorrected>0 && trackStartPositionX_noSCE<0) || (trackEndPositionX_notCorrected>0 && trackEndPositionX_noSCE<0)) ) continue;
-	}
+   double trackStartPositionX=shifted.startX;
+   double trackStartPositionY=shifted.startY;
+   double trackStartPositionZ=shifted.startZ;
 
-   double trackStartPositionX=trackStartPositionX_noSCE;
-   double trackStartPositionY=trackStartPositionY_noSCE;
-   double trackStartPositionZ=trackStartPositionZ_noSCE;
+   double trackEndPositionX=shifted.endX;
+   double trackEndPositionY=shifted.endY;
+   double trackEndPositionZ=shifted.endZ;
 
-   double trackEndPositionX=trackEndPositionX_noSCE;
-   double trackEndPositionY=trackEndPositionY_noSCE;
-   double trackEndPositionZ=trackEndPositionZ_noSCE;
         double X1 = primaryHits_B[iHit_B].hitPositionX;
 
         double Y1 = primaryHits_B[iHit_B].hitPositionY;
@@ -749,7 +719,7 @@ double xOffset=0;
 
         double deltaY1 = (predictedHitPositionY1-Y1);
 
-      if (min_delta > std::abs(deltaX1) + std::abs(deltaY1) ){
+      if (min_delta > std::abs(deltaX1) + std::abs(deltaY1) || (min_delta == std::abs(deltaX1) + std::abs(deltaY1) && int(iHit_B) < bestHitIndex_B)){
 
 	   min_delta=std::abs(deltaX1)+std::abs(deltaY1);
 
@@ -900,4 +870,11 @@ event.put(std::move(T0col)); event.put(std::move(CRTTrack)); event.put(std::move
 
 
 
+// Setup CRT
+void CRT::SingleCRTMatchingProducer::beginJob() {
+  // Strip centres do not change during the job, so look them up once
+  art::ServiceHandle < geo::Geometry > geom;
+  CRT::FillStripTable(*geom, fStripTable);
+}
+
 DEFINE_ART_MODULE(CRT::SingleCRTMatchingProducer)
@@ -54,6 +54,7 @@
 
 //Local includes
 #include "duneprototypes/Protodune/singlephase/CRT/data/CRTTrigger.h"
+#include "duneprototypes/Protodune/singlephase/CRT/alg/match/CRTHitSweep.h"
 
 //ROOT includes
 #include "TH1.h"
@@ -230,6 +231,12 @@ int moduletoCTB(int module2, int module1);
 
   std::vector < tempHits > tempHits_F;
   std::vector < tempHits > tempHits_B;
+
+  void make2DHits(const std::vector < tempHits > & hits, std::vector < recoHits > & out);
+  CRT::StripTable fStripTable; // (module, channel) -> strip centre, filled in beginJob
+  CRT::HitSweep fHitSweep;
+  std::vector < CRT::StripHit > stripHits;
+  std::vector < CRT::Hit2D > hits2D;
   std::vector < tracksPair > tracksPair_F;
   std::vector < tracksPair > tracksPair_B;
 };
@@ -252,6 +259,32 @@ bool CRT::SingleCRTMatching::moduleMatcher(int module1, int module2) {
 
 }
 
+void CRT::SingleCRTMatching::make2DHits(const std::vector < tempHits > & hits, std::vector < recoHits > & out) {
+  // Pair hits on matching X and Y modules within the module-to-module timing cut
+  stripHits.clear();
+  for (const auto & hit: hits) stripHits.push_back({size_t(hit.module), size_t(hit.channel), double(hit.triggerTime)});
+  fHitSweep.Build2DHits(stripHits, fStripTable, fModuletoModuleTimingCut,
+                        [this](int module1, int module2) { return moduleMatcher(module1, module2); }, hits2D);
+  for (const auto & hit2D: hits2D) {
+    const auto & hitX = hits[hit2D.x];
+    const auto & hitY = hits[hit2D.y];
+    recoHits rHits;
+    rHits.hitPositionX = hit2D.posX; // Strip centre, +1.25 cm if the next strip was hit too (CRT_Res=2.5 cm)
+    rHits.hitPositionY = hit2D.posY;
+    rHits.hitPositionZ = hit2D.posZ;
+    rHits.geoX=hitX.module;
+    rHits.geoY=hitY.module;
+    rHits.stripX=hitX.channel;
+    rHits.stripY=hitY.channel;
+    rHits.adcX=hitX.adc;
+    rHits.adcY=hitY.adc;
+    rHits.trigNumberX=hitX.triggerNumber;
+    rHits.trigNumberY=hitY.triggerNumber;
+    rHits.timeAvg = hit2D.time;
+    out.push_back(rHits);
+  }
+}
+
 int CRT::SingleCRTMatching::moduletoCTB(int module2, int module1){
   if (module1 == 14 && module2 == 11 ) return 15;
   else if (module1 == 14 &&  module2 == 10) return 10;
@@ -388,10 +421,7 @@ void CRT::SingleCRTMatching::analyze(art::Event
 	 //cout<<trigger.Channel()<<','<<hit.Channel()<<','<<hit.ADC()<<endl;
         nHits++;
 	tHits.triggerNumber=trigID;
-        const auto & trigGeo = geom -> AuxDet(trigger.Channel()); // Get geo  
-        const auto & csens = trigGeo.SensitiveVolume(hit.Channel());
-        const auto center = csens.GetCenter();
-        if (center.Z() < 100) tempHits_F.push_back(tHits); // Sort F/B from Z
+        if (fStripTable.At(trigger.Channel(), hit.Channel()).z < 100) tempHits_F.push_back(tHits); // Sort F/B from Z
         else tempHits_B.push_back(tHits);
         hitID++;
       }
@@ -402,107 +432,9 @@ void CRT::SingleCRTMatching::analyze(art::Event
   cout << "Hits compiled for event: " << nEvents << endl;
   cout << "Number of Hits above Threshold:  " << hitID << endl;
 
-  for (unsigned int f = 0; f < tempHits_F.size(); f++) {
-    for (unsigned int f_test = 0; f_test < tempHits_F.size(); f_test++) {
-       if (fabs(tempHits_F[f_test].triggerTime-tempHits_F[f].triggerTime)>fModuletoModuleTimingCut) continue;
-      const auto & trigGeo = geom -> AuxDet(tempHits_F[f].module);
-      const auto & trigGeo2 = geom -> AuxDet(tempHits_F[f_test].module);
-
-      const auto & hit1Geo = trigGeo.SensitiveVolume(tempHits_F[f].channel);
-      const auto hit1Center = hit1Geo.GetCenter();
-      // Create 2D hits from geo of the Y and X modules
-       const auto & hit2Geo = trigGeo2.SensitiveVolume(tempHits_F[f_test].channel);
-      const auto hit2Center = hit2Geo.GetCenter();
-      bool moduleMatched;
-      moduleMatched=moduleMatcher(tempHits_F[f_test].module, tempHits_F[f].module);
-      if (moduleMatched) {
-        // Get the center of the hits (CRT_Res=2.5 cm)
-        double hitX = hit1Center.X();
-	for (unsigned int a = 0; a < tempHits_F.size(); a++)
-	{
-	if(tempHits_F[a].module==tempHits_F[f].module && (tempHits_F[a].channel-1)==tempHits_F[f].channel) hitX=hit1Center.X()+1.25;
-	}
-	double hitYPrelim=hit2Center.Y();
-	for (unsigned int a = 0; a < tempHits_F.size(); a++)
-	{
-	if(tempHits_F[a].module==tempHits_F[f_test].module && (tempHits_F[a].channel-1)==tempHits_F[f_test].channel) hitYPrelim=hit2Center.Y()+1.25;
-	}
-	
-
-	
-	double hitY=hitYPrelim;
-        double hitZ = (hit1Center.Z() + hit2Center.Z()) / 2.f;
-
-        recoHits rHits;
-        rHits.hitPositionX = hitX;
-        rHits.hitPositionY = hitY;
-        rHits.hitPositionZ = hitZ;
-	rHits.geoX=tempHits_F[f].module;
-	rHits.geoY=tempHits_F[f_test].module;
-	rHits.stripX=tempHits_F[f].channel;
-	rHits.stripY=tempHits_F[f_test].channel;
-
-	rHits.adcX=tempHits_F[f].adc;
-	rHits.adcY=tempHits_F[f_test].adc;
-	rHits.trigNumberX=tempHits_F[f].triggerNumber;
-	rHits.trigNumberY=tempHits_F[f_test].triggerNumber;
-	rHits.timeAvg = (tempHits_F[f_test].triggerTime+tempHits_F[f].triggerTime)/2.0;
-       primaryHits_F.push_back(rHits); // Add array
-    }
-    }
-  }
-  for (unsigned int f = 0; f < tempHits_B.size(); f++) {
-    for (unsigned int f_test = 0; f_test < tempHits_B.size(); f_test++) { // Same as above but for back CRT
-       if (fabs(tempHits_B[f_test].triggerTime-tempHits_B[f].triggerTime)>fModuletoModuleTimingCut) continue;
-
-      const auto & trigGeo = geom -> AuxDet(tempHits_B[f].module);
-      const auto & trigGeo2 = geom -> AuxDet(tempHits_B[f_test].module);
-      const auto & hit1Geo = trigGeo.SensitiveVolume(tempHits_B[f].channel);
-      const auto hit1Center = hit1Geo.GetCenter();
-
-      const auto & hit2Geo = trigGeo2.SensitiveVolume(tempHits_B[f_test].channel);
-      const auto hit2Center = hit2Geo.GetCenter();
-      bool moduleMatched;
-      moduleMatched=moduleMatcher(tempHits_B[f_test].module, tempHits_B[f].module);
-
-      if (moduleMatched) {
-        double hitX = hit1Center.X();
-	
-	
-	for (unsigned int a = 0; a < tempHits_B.size(); a++)
-	{
-	if(tempHits_B[a].module==tempHits_B[f].module && (tempHits_B[a].channel-1)==tempHits_B[f].channel) hitX=hit1Center.X()+1.25;
-	}
-	
-        double hitYPrelim = hit2Center.Y();
-	
-	for (unsigned int a = 0; a < tempHits_B.size(); a++)
-	{
-	if(tempHits_B[a].module==tempHits_B[f_test].module && (tempHits_B[a].channel-1)==tempHits_B[f_test].channel) hitYPrelim=hit2Center.Y()+1.25;
-	}
-	double hitY=hitYPrelim;
-
-	
-        double hitZ = (hit1Center.Z() + hit2Center.Z()) / 2.f;
-
-        recoHits rHits;
-        rHits.hitPositionX = hitX;
-        rHits.hitPositionY = hitY;
-        rHits.hitPositionZ = hitZ;
-	rHits.geoX=tempHits_B[f].module;
-	rHits.geoY=tempHits_B[f_test].module;
-	rHits.adcX=tempHits_B[f].adc;
-	rHits.adcY=tempHits_B[f_test].adc;
-	rHits.stripX=tempHits_B[f].channel;
-	rHits.stripY=tempHits_B[f_test].channel;
-	rHits.trigNumberX=tempHits_B[f].triggerNumber;
-	rHits.trigNumberY=tempHits_B[f_test].triggerNumber;
-	rHits.timeAvg = (tempHits_B[f_test].triggerTime+tempHits_B[f].triggerTime)/2.0;
-	 primaryHits_B.push_back(rHits); 
-
-	 }
-    }
-  }
+  // Create 2D hits from the X and Y modules of each side
+  make2DHits(tempHits_F, primaryHits_F);
+  make2DHits(tempHits_B, primaryHits_B);
   // Reconstruciton information
  art::Handle < vector < recob::Track > > trackListHandle;
   vector < art::Ptr < recob::Track > > trackList;
@@ -1257,6 +1189,9 @@ cout<<"Truth track and CRT reco:"<<track<<','<<matchedTrack<<','<<truthTrack<<',
 
 // Setup CRT 
 void CRT::SingleCRTMatching::beginJob() {
+  // Strip centres do not change during the job, so look them up once
+  art::ServiceHandle < geo::Geometry > geom;
+  CRT::FillStripTable(*geom, fStripTable);
 	art::ServiceHandle<art::TFileService> fileServiceHandle;
        fCRTTree = fileServiceHandle->make<TTree>("Displacement", "event by event info");
        fMCCTree= fileServiceHandle->make<TTree>("MCC", "event by event info");
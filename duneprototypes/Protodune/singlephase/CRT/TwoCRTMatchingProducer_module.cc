@@ -59,6 +59,8 @@
 
 //Local includes
 #include "duneprototypes/Protodune/singlephase/CRT/data/CRTTrigger.h"
+#include "duneprototypes/Protodune/singlephase/CRT/alg/match/CRTHitSweep.h"
+#include "duneprototypes/Protodune/singlephase/CRT/alg/match/CRTMatchCache.h"
 
 
 
@@ -76,6 +78,7 @@
 #include <numeric> //std::accumulate was moved from <algorithm> to <numeric> in c++14
 #include <iostream>
 #include <cmath>
+#include <map>
 using namespace std;   // Namespaces established to make life easier
 using namespace ROOT::Math;
 
@@ -98,6 +101,7 @@ public:
   // Required functions.
 
   void produce(art::Event & event) override;
+  void beginJob() override;
 
   int nEvents = 0;
   int nHitsPerEvent=0;
@@ -142,6 +146,25 @@ typedef struct // Structures for arrays to move hits from raw to reco to validat
   std::vector < tempHits > tempHits_F;
   std::vector < tempHits > tempHits_B;
 
+  void make2DHits(const std::vector < tempHits > & hits, std::vector < recoHits > & out);
+  CRT::StripTable fStripTable; // (module, channel) -> strip centre, filled in beginJob
+  CRT::HitSweep fHitSweep;
+  std::vector < CRT::StripHit > stripHits;
+  std::vector < CRT::Hit2D > hits2D;
+  std::vector < double > timesF, timesB;
+  std::vector < std::pair < size_t, size_t > > frontBackPairs; // Front/back 2D hits within the timing cut
+
+  typedef struct // Track moved to a CRT time
+  {
+    double startX, startY, startZ;
+    double endX, endY, endZ;
+  }
+  shiftedTrack;
+
+  double driftOffset(detinfo::DetectorPropertiesData const & detProp, geo::WireID const & wire, double crtTime);
+  std::map < geo::PlaneID, CRT::TimeMemo < double > > driftOffsets; // Per event, by readout plane
+  CRT::TimeMemo < shiftedTrack > trackShifts; // Per track
+
 
 
 };
@@ -169,6 +192,38 @@ bool CRT::TwoCRTMatchingProducer::moduleMatcher(int module1, int module2) {
 
 }
 
+void CRT::TwoCRTMatchingProducer::make2DHits(const std::vector < tempHits > & hits, std::vector < recoHits > & out) {
+  // Pair hits on matching X and Y modules within the module-to-module timing cut
+  stripHits.clear();
+  for (const auto & hit: hits) stripHits.push_back({size_t(hit.module), size_t(hit.channel), double(hit.triggerTime)});
+  fHitSweep.Build2DHits(stripHits, fStripTable, fModuletoModuleTimingCut,
+                        [this](int module1, int module2) { return moduleMatcher(module1, module2); }, hits2D);
+  for (const auto & hit2D: hits2D) {
+    const auto & hitX = hits[hit2D.x];
+    const auto & hitY = hits[hit2D.y];
+    recoHits rHits;
+    rHits.hitPositionX = hit2D.posX; // Strip centre, +1.25 cm if the next strip was hit too (CRT_Res=2.5 cm)
+    rHits.hitPositionY = hit2D.posY;
+    rHits.hitPositionZ = hit2D.posZ;
+    rHits.trigNumberX=hitX.triggerNumber;
+    rHits.trigNumberY=hitY.triggerNumber;
+    rHits.timeAvg = hit2D.time;
+    out.push_back(rHits);
+  }
+}
+
+double CRT::TwoCRTMatchingProducer::driftOffset(detinfo::DetectorPropertiesData const & detProp, geo::WireID const & wire, double crtTime) {
+  // X shift of a track at the CRT time, computed once per event for each CRT time and readout plane
+  return driftOffsets[wire.planeID()].Get(crtTime, [&](double time) {
+    int RDOffset=0;
+    if (!fMCCSwitch) RDOffset=111;
+    double ticksOffset=0;
+    if (!fMCCSwitch) ticksOffset = (time+RDOffset)/25.f+detProp.GetXTicksOffset(wire.Plane, wire.TPC, wire.Cryostat);
+    else ticksOffset = (time/500.f)+detProp.GetXTicksOffset(wire.Plane, wire.TPC, wire.Cryostat);
+    return detProp.ConvertTicksToX(ticksOffset, wire.Plane, wire.TPC, wire.Cryostat);
+  });
+}
+
 
 //Turn sim::AuxDetSimChannels into CRT::Hits. 
 void CRT::TwoCRTMatchingProducer::produce(art::Event & event)
@@ -255,10 +310,7 @@ void CRT::TwoCRTMatchingProducer::produce(art::Event & event)
 	 //cout<<trigger.Channel()<<','<<hit.Channel()<<','<<hit.ADC()<<endl;
         nHits++;
 	tHits.triggerNumber=trigID;
-        const auto & trigGeo = geom -> AuxDet(trigger.Channel()); // Get geo  
-        const auto & csens = trigGeo.SensitiveVolume(hit.Channel());
-        const auto center = csens.GetCenter();
-        if (center.Z() < 100) tempHits_F.push_back(tHits); // Sort F/B from Z
+        if (fStripTable.At(trigger.Channel(), hit.Channel()).z < 100) tempHits_F.push_back(tHits); // Sort F/B from Z
         else tempHits_B.push_back(tHits);
         hitID++;
       }
@@ -269,94 +321,17 @@ void CRT::TwoCRTMatchingProducer::produce(art::Event & event)
   //cout << "Hits compiled for event: " << nEvents << endl;
   //cout << "Number of Hits above Threshold:  " << hitID << endl;
 
-  for (unsigned int f = 0; f < tempHits_F.size(); f++) {
-    for (unsigned int f_test = 0; f_test < tempHits_F.size(); f_test++) {
-       if (fabs(tempHits_F[f_test].triggerTime-tempHits_F[f].triggerTime)>fModuletoModuleTimingCut) continue;
-      const auto & trigGeo = geom -> AuxDet(tempHits_F[f].module);
-      const auto & trigGeo2 = geom -> AuxDet(tempHits_F[f_test].module);
-
-      const auto & hit1Geo = trigGeo.SensitiveVolume(tempHits_F[f].channel);
-      const auto hit1Center = hit1Geo.GetCenter();
-      // Create 2D hits from geo of the Y and X modules
-       const auto & hit2Geo = trigGeo2.SensitiveVolume(tempHits_F[f_test].channel);
-      const auto hit2Center = hit2Geo.GetCenter();
-      bool moduleMatched;
-      moduleMatched=moduleMatcher(tempHits_F[f_test].module, tempHits_F[f].module);
-      if (moduleMatched) {
-        // Get the center of the hits (CRT_Res=2.5 cm)
-        double hitX = hit1Center.X();
-	for (unsigned int a = 0; a < tempHits_F.size(); a++)
-	{
-	if(tempHits_F[a].module==tempHits_F[f].module && (tempHits_F[a].channel-1)==tempHits_F[f].channel) hitX=hit1Center.X()+1.25;
-	}
-	double hitYPrelim=hit2Center.Y();
-	for (unsigned int a = 0; a < tempHits_F.size(); a++)
-	{
-	if(tempHits_F[a].module==tempHits_F[f_test].module && (tempHits_F[a].channel-1)==tempHits_F[f_test].channel) hitYPrelim=hit2Center.Y()+1.25;
-	}
-	
-
-	
-	double hitY=hitYPrelim;
-        double hitZ = (hit1Center.Z() + hit2Center.Z()) / 2.f;
-
-        recoHits rHits;
-        rHits.hitPositionX = hitX;
-        rHits.hitPositionY = hitY;
-        rHits.hitPositionZ = hitZ;
-	rHits.trigNumberX=tempHits_F[f].triggerNumber;
-	rHits.trigNumberY=tempHits_F[f_test].triggerNumber;
-	rHits.timeAvg = (tempHits_F[f_test].triggerTime+tempHits_F[f].triggerTime)/2.0;
-       primaryHits_F.push_back(rHits); // Add array
-    }
-    }
-  }
-  for (unsigned int f = 0; f < tempHits_B.size(); f++) {
-    for (unsigned int f_test = 0; f_test < tempHits_B.size(); f_test++) { // Same as above but for back CRT
-       if (fabs(tempHits_B[f_test].triggerTime-tempHits_B[f].triggerTime)>fModuletoModuleTimingCut) continue;
-
-      const auto & trigGeo = geom -> AuxDet(tempHits_B[f].module);
-      const auto & trigGeo2 = geom -> AuxDet(tempHits_B[f_test].module);
-      const auto & hit1Geo = trigGeo.SensitiveVolume(tempHits_B[f].channel);
-      const auto hit1Center = hit1Geo.GetCenter();
-
-      const auto & hit2Geo = trigGeo2.SensitiveVolume(tempHits_B[f_test].channel);
-      const auto hit2Center = hit2Geo.GetCenter();
-      bool moduleMatched;
-      moduleMatched=moduleMatcher(tempHits_B[f_test].module, tempHits_B[f].module);
-
-      if (moduleMatched) {
-        double hitX = hit1Center.X();
-	
-	
-	for (unsigned int a = 0; a < tempHits_B.size(); a++)
-	{
-	if(tempHits_B[a].module==tempHits_B[f].module && (tempHits_B[a].channel-1)==tempHits_B[f].channel) hitX=hit1Center.X()+1.25;
-	}
-	
-        double hitYPrelim = hit2Center.Y();
-	
-	for (unsigned int a = 0; a < tempHits_B.size(); a++)
-	{
-	if(tempHits_B[a].module==tempHits_B[f_test].module && (tempHits_B[a].channel-1)==tempHits_B[f_test].channel) hitYPrelim=hit2Center.Y()+1.25;
-	}
-	double hitY=hitYPrelim;
-
-	
-        double hitZ = (hit1Center.Z() + hit2Center.Z()) / 2.f;
-
-        recoHits rHits;
-        rHits.hitPositionX = hitX;
-        rHits.hitPositionY = hitY;
-        rHits.hitPositionZ = hitZ;
-	rHits.trigNumberX=tempHits_B[f].triggerNumber;
-	rHits.trigNumberY=tempHits_B[f_test].triggerNumber;
-	rHits.timeAvg = (tempHits_B[f_test].triggerTime+tempHits_B[f].triggerTime)/2.0;
-	 primaryHits_B.push_back(rHits); 
-
-	 }
-    }
-  }
+  // Create 2D hits from the X and Y modules of each side
+  make2DHits(tempHits_F, primaryHits_F);
+  make2DHits(tempHits_B, primaryHits_B);
+
+  // Front and back 2D hits close enough in time to make a CRT track
+  timesF.clear();
+  timesB.clear();
+  for (const auto & hit: primaryHits_F) timesF.push_back(hit.timeAvg);
+  for (const auto & hit: primaryHits_B) timesB.push_back(hit.timeAvg);
+  CRT::TimeWindowPairs(timesF, timesB, fFronttoBackTimingCut, frontBackPairs);
+  driftOffsets.clear();
   vector < art::Ptr < recob::Track > > trackList;
   auto trackListHandle = event.getHandle < vector < recob::Track > >(fTrackModuleLabel);
   vector<art::Ptr<recob::PFParticle> > pfplist;
@@ -437,8 +412,37 @@ void CRT::TwoCRTMatchingProducer::produce(art::Event & event)
       int best_trigXB=0;
       int best_trigYB=0;
 
-    for (unsigned int f = 0; f < primaryHits_F.size(); f++) {
-        for (unsigned int b = 0; b < primaryHits_B.size(); b++) {
+      // Track moved to a CRT time when there is no Pandora T0, and corrected for space charge.
+      // Many front/back pairs share a time, so this is done once per time.
+      trackShifts.Clear();
+      auto shiftTrack = [&](double t0) {
+        shiftedTrack track{trackStartPositionX_notCorrected, trackStartPositionY_noSCE, trackStartPositionZ_noSCE,
+                           trackEndPositionX_notCorrected, trackEndPositionY_noSCE, trackEndPositionZ_noSCE};
+        if (t0s.empty()) {
+          const double xOffset = driftOffset(detProp, allHits[firstHit]->WireID(), t0);
+          track.startX = trackStartPositionX_notCorrected-xOffset;
+          track.endX = trackEndPositionX_notCorrected-xOffset;
+        }
+        if (fSCECorrection && SCE->EnableCalSpatialSCE()) {
+          auto const startTPC = geom->PositionToTPCID(geo::Point_t(track.startX, track.startY, track.startZ)).deepestIndex();
+          auto const endTPC = geom->PositionToTPCID(geo::Point_t(track.endX, track.endY, track.endZ)).deepestIndex();
+          if (endTPC<13 && startTPC<13) {
+            auto const & posOffsets_F = SCE->GetCalPosOffsets(geo::Point_t(track.startX, track.startY, track.startZ), startTPC);
+            track.startX -= posOffsets_F.X();
+            track.startY += posOffsets_F.Y();
+            track.startZ += posOffsets_F.Z();
+            auto const & posOffsets_B = SCE->GetCalPosOffsets(geo::Point_t(track.endX, track.endY, track.endZ), endTPC);
+            track.endX -= posOffsets_B.X();
+            track.endY += posOffsets_B.Y();
+            track.endZ += posOffsets_B.Z();
+          }
+        }
+        return track;
+      };
+
+    for (const auto & frontBack: frontBackPairs) { // Pairs passing fFronttoBackTimingCut
+        const unsigned int f = frontBack.first;
+        const unsigned int b = frontBack.second;
 
       double X1 = primaryHits_F[f].hitPositionX;
       double Y1 = primaryHits_F[f].hitPositionY;
@@ -448,53 +452,17 @@ void CRT::TwoCRTMatchingProducer::produce(art::Event & event)
       double Z2= primaryHits_B[b].hitPositionZ;
      
 
-	        if (fabs(primaryHits_F[f].timeAvg-primaryHits_B[b].timeAvg)>fFronttoBackTimingCut) continue;
 		double t0=(primaryHits_F[f].timeAvg+primaryHits_B[b].timeAvg)/2.f;
   		int tempId = 0;
-		double xOffset=0;
-    
-
-		double trackStartPositionX_noSCE=trackStartPositionX_notCorrected;
-		double trackEndPositionX_noSCE=trackEndPositionX_notCorrected;
-		if (t0s.empty()){
-		int RDOffset=0;
-		if (!fMCCSwitch) RDOffset=111;
-		double ticksOffset=0;
-
-                if (!fMCCSwitch) ticksOffset = (t0+RDOffset)/25.f+detProp.GetXTicksOffset(allHits[firstHit]->WireID().Plane, allHits[firstHit]->WireID().TPC, allHits[firstHit]->WireID().Cryostat);
-
-                else if (fMCCSwitch) ticksOffset = (t0/500.f)+detProp.GetXTicksOffset(allHits[firstHit]->WireID().Plane, allHits[firstHit]->WireID().TPC, allHits[firstHit]->WireID().Cryostat);
-		
-               xOffset=detProp.ConvertTicksToX(ticksOffset,allHits[firstHit]->WireID().Plane, allHits[firstHit]->WireID().TPC, allHits[firstHit]->WireID().Cryostat);
-		//double xOffset=.08*ticksOffset
-		
-	 trackStartPositionX_noSCE=trackStartPositionX_notCorrected-xOffset;
-         trackEndPositionX_noSCE=trackEndPositionX_notCorrected-xOffset;
-	}
-
-   double trackStartPositionX=trackStartPositionX_noSCE;
-   double trackStartPositionY=trackStartPositionY_noSCE;
-   double trackStartPositionZ=trackStartPositionZ_noSCE;
-
-   double trackEndPositionX=trackEndPositionX_noSCE;
-   double trackEndPositionY=trackEndPositionY_noSCE;
-   double trackEndPositionZ=trackEndPositionZ_noSCE;
-   if (fSCECorrection && SCE->EnableCalSpatialSCE()){
-if(geom->PositionToTPCID(geo::Point_t(trackEndPositionX, trackEndPositionY, trackEndPositionZ)).deepestIndex()<13 && geom->PositionToTPCID(geo::Point_t(trackStartPositionX, trackStartPositionY, trackStartPositionZ)).deepestIndex()<13){ 
-            auto const & posOffsets_F = SCE->GetCalPosOffsets(geo::Point_t(trackStartPositionX, trackStartPositionY, trackStartPositionZ), geom->PositionToTPCID(geo::Point_t(trackStartPositionX, trackStartPositionY, trackStartPositionZ)).deepestIndex());
-            trackStartPositionX -= posOffsets_F.X();
-            trackStartPositionY += posOffsets_F.Y();
-            trackStartPositionZ += posOffsets_F.Z();
-            auto const & posOffsets_B = SCE->GetCalPosOffsets(geo::Point_t(trackEndPositionX, trackEndPositionY, trackEndPositionZ), geom->PositionToTPCID(geo::Point_t(trackEndPositionX, trackEndPositionY, trackEndPositionZ)).deepestIndex());
-            trackEndPositionX -= posOffsets_B.X();
-            trackEndPositionY += posOffsets_B.Y();
-            trackEndPositionZ += posOffsets_B.Z();
-	}
-    }
-
-
+        const auto & shifted = trackShifts.Get(t0s.empty() ? t0 : 0., shiftTrack);
 
+   double trackStartPositionX=shifted.startX;
+   double trackStartPositionY=shifted.startY;
+   double trackStartPositionZ=shifted.startZ;
 
+   double trackEndPositionX=shifted.endX;
+   double trackEndPositionY=shifted.endY;
+   double trackEndPositionZ=shifted.endZ;
 
 	// Make metrics for a CRT pair to compare later
 	TVector3 trackStart(trackStartPositionX, trackStartPositionY, trackStartPositionZ);
@@ -556,7 +524,6 @@ if(geom->PositionToTPCID(geo::Point_t(trackEndPositionX, trackEndPositionY, trac
 	    if (!fMCCSwitch) best_T=(111.f+best_T)*20.f;
 	    // Added 111 tick CRT-CTB offset
           }
-        }
       }
       if (std::abs(best_dotProductCos)>0.99 && std::abs(best_deltaXF)+std::abs(best_deltaXB)<40 && std::abs(best_deltaYF)+std::abs(best_deltaYB)<40 ) {
         //std::cout<<"Found match with TPC*CRT "<<best_dotProductCos<<std::endl;
@@ -589,4 +556,11 @@ if(geom->PositionToTPCID(geo::Point_t(trackEndPositionX, trackEndPositionY, trac
 
 
 
+// Setup CRT
+void CRT::TwoCRTMatchingProducer::beginJob() {
+  // Strip centres do not change during the job, so look them up once
+  art::ServiceHandle < geo::Geometry > geom;
+  CRT::FillStripTable(*geom, fStripTable);
+}
+
 DEFINE_ART_MODULE(CRT::TwoCRTMatchingProducer)
@@ -52,6 +52,7 @@
 
 //Local includes
 #include "duneprototypes/Protodune/singlephase/CRT/data/CRTTrigger.h"
+#include "duneprototypes/Protodune/singlephase/CRT/alg/match/CRTHitSweep.h"
 
 
 
@@ -268,6 +269,14 @@ class CRT::TwoCRTMatching: public art::EDAnalyzer {
 
   std::vector < tempHits > tempHits_F;
   std::vector < tempHits > tempHits_B;
+
+  void make2DHits(const std::vector < tempHits > & hits, std::vector < recoHits > & out);
+  CRT::StripTable fStripTable; // (module, channel) -> strip centre, filled in beginJob
+  CRT::HitSweep fHitSweep;
+  std::vector < CRT::StripHit > stripHits;
+  std::vector < CRT::Hit2D > hits2D;
+  std::vector < double > timesF, timesB;
+  std::vector < std::pair < size_t, size_t > > frontBackPairs; // Front/back 2D hits within the timing cut
   std::vector < tracksPair > allTracksPair;
 
 };
@@ -321,6 +330,32 @@ bool CRT::TwoCRTMatching::moduleMatcher(int module1, int module2) {
 
 }
 
+void CRT::TwoCRTMatching::make2DHits(const std::vector < tempHits > & hits, std::vector < recoHits > & out) {
+  // Pair hits on matching X and Y modules within the module-to-module timing cut
+  stripHits.clear();
+  for (const auto & hit: hits) stripHits.push_back({size_t(hit.module), size_t(hit.channel), double(hit.triggerTime)});
+  fHitSweep.Build2DHits(stripHits, fStripTable, fModuletoModuleTimingCut,
+                        [this](int module1, int module2) { return moduleMatcher(module1, module2); }, hits2D);
+  for (const auto & hit2D: hits2D) {
+    const auto & hitX = hits[hit2D.x];
+    const auto & hitY = hits[hit2D.y];
+    recoHits rHits;
+    rHits.hitPositionX = hit2D.posX; // Strip centre, +1.25 cm if the next strip was hit too (CRT_Res=2.5 cm)
+    rHits.hitPositionY = hit2D.posY;
+    rHits.hitPositionZ = hit2D.posZ;
+    rHits.geoX=hitX.module;
+    rHits.geoY=hitY.module;
+    rHits.adcX=hitX.adc;
+    rHits.adcY=hitY.adc;
+    rHits.stripX=hitX.channel;
+    rHits.stripY=hitY.channel;
+    rHits.trigNumberX=hitX.triggerNumber;
+    rHits.trigNumberY=hitY.triggerNumber;
+    rHits.timeAvg = hit2D.time;
+    out.push_back(rHits);
+  }
+}
+
 
 void CRT::TwoCRTMatching::createPNG(TH1D * histo) {
   //Save important histograms as PNG
@@ -435,10 +470,7 @@ void CRT::TwoCRTMatching::analyze(art::Event
 	 //cout<<trigger.Channel()<<','<<hit.Channel()<<','<<hit.ADC()<<endl;
         nHits++;
 	tHits.triggerNumber=trigID;
-        const auto & trigGeo = geom -> AuxDet(trigger.Channel()); // Get geo  
-        const auto & csens = trigGeo.SensitiveVolume(hit.Channel());
-        const auto center = csens.GetCenter();
-        if (center.Z() < 100) tempHits_F.push_back(tHits); // Sort F/B from Z
+        if (fStripTable.At(trigger.Channel(), hit.Channel()).z < 100) tempHits_F.push_back(tHits); // Sort F/B from Z
         else tempHits_B.push_back(tHits);
         hitID++;
       }
@@ -449,107 +481,16 @@ void CRT::TwoCRTMatching::analyze(art::Event
   cout << "Hits compiled for event: " << nEvents << endl;
   cout << "Number of Hits above Threshold:  " << hitID << endl;
 
-  for (unsigned int f = 0; f < tempHits_F.size(); f++) {
-    for (unsigned int f_test = 0; f_test < tempHits_F.size(); f_test++) {
-       if (fabs(tempHits_F[f_test].triggerTime-tempHits_F[f].triggerTime)>fModuletoModuleTimingCut) continue;
-      const auto & trigGeo = geom -> AuxDet(tempHits_F[f].module);
-      const auto & trigGeo2 = geom -> AuxDet(tempHits_F[f_test].module);
-
-      const auto & hit1Geo = trigGeo.SensitiveVolume(tempHits_F[f].channel);
-      const auto hit1Center = hit1Geo.GetCenter();
-      // Create 2D hits from geo of the Y and X modules
-       const auto & hit2Geo = trigGeo2.SensitiveVolume(tempHits_F[f_test].channel);
-      const auto hit2Center = hit2Geo.GetCenter();
-      bool moduleMatched;
-      moduleMatched=moduleMatcher(tempHits_F[f_test].module, tempHits_F[f].module);
-      if (moduleMatched) {
-        // Get the center of the hits (CRT_Res=2.5 cm)
-        double hitX = hit1Center.X();
-	for (unsigned int a = 0; a < tempHits_F.size(); a++)
-	{
-	if(tempHits_F[a].module==tempHits_F[f].module && (tempHits_F[a].channel-1)==tempHits_F[f].channel) hitX=hit1Center.X()+1.25;
-	}
-	double hitYPrelim=hit2Center.Y();
-	for (unsigned int a = 0; a < tempHits_F.size(); a++)
-	{
-	if(tempHits_F[a].module==tempHits_F[f_test].module && (tempHits_F[a].channel-1)==tempHits_F[f_test].channel) hitYPrelim=hit2Center.Y()+1.25;
-	}
-	
+  // Create 2D hits from the X and Y modules of each side
+  make2DHits(tempHits_F, primaryHits_F);
+  make2DHits(tempHits_B, primaryHits_B);
 
-	
-	double hitY=hitYPrelim;
-        double hitZ = (hit1Center.Z() + hit2Center.Z()) / 2.f;
-
-        recoHits rHits;
-        rHits.hitPositionX = hitX;
-        rHits.hitPositionY = hitY;
-        rHits.hitPositionZ = hitZ;
-	rHits.geoX=tempHits_F[f].module;
-	rHits.geoY=tempHits_F[f_test].module;
-	rHits.stripX=tempHits_F[f].channel;
-	rHits.stripY=tempHits_F[f_test].channel;
-
-	rHits.adcX=tempHits_F[f].adc;
-	rHits.adcY=tempHits_F[f_test].adc;
-	rHits.trigNumberX=tempHits_F[f].triggerNumber;
-	rHits.trigNumberY=tempHits_F[f_test].triggerNumber;
-	rHits.timeAvg = (tempHits_F[f_test].triggerTime+tempHits_F[f].triggerTime)/2.0;
-       primaryHits_F.push_back(rHits); // Add array
-    }
-    }
-  }
-  for (unsigned int f = 0; f < tempHits_B.size(); f++) {
-    for (unsigned int f_test = 0; f_test < tempHits_B.size(); f_test++) { // Same as above but for back CRT
-       if (fabs(tempHits_B[f_test].triggerTime-tempHits_B[f].triggerTime)>fModuletoModuleTimingCut) continue;
-
-      const auto & trigGeo = geom -> AuxDet(tempHits_B[f].module);
-      const auto & trigGeo2 = geom -> AuxDet(tempHits_B[f_test].module);
-      const auto & hit1Geo = trigGeo.SensitiveVolume(tempHits_B[f].channel);
-      const auto hit1Center = hit1Geo.GetCenter();
-
-      const auto & hit2Geo = trigGeo2.SensitiveVolume(tempHits_B[f_test].channel);
-      const auto hit2Center = hit2Geo.GetCenter();
-      bool moduleMatched;
-      moduleMatched=moduleMatcher(tempHits_B[f_test].module, tempHits_B[f].module);
-
-      if (moduleMatched) {
-        double hitX = hit1Center.X();
-	
-	
-	for (unsigned int a = 0; a < tempHits_B.size(); a++)
-	{
-	if(tempHits_B[a].module==tempHits_B[f].module && (tempHits_B[a].channel-1)==tempHits_B[f].channel) hitX=hit1Center.X()+1.25;
-	}
-	
-        double hitYPrelim = hit2Center.Y();
-	
-	for (unsigned int a = 0; a < tempHits_B.size(); a++)
-	{
-	if(tempHits_B[a].module==tempHits_B[f_test].module && (tempHits_B[a].channel-1)==tempHits_B[f_test].channel) hitYPrelim=hit2Center.Y()+1.25;
-	}
-	double hitY=hitYPrelim;
-
-	
-        double hitZ = (hit1Center.Z() + hit2Center.Z()) / 2.f;
-
-        recoHits rHits;
-        rHits.hitPositionX = hitX;
-        rHits.hitPositionY = hitY;
-        rHits.hitPositionZ = hitZ;
-	rHits.geoX=tempHits_B[f].module;
-	rHits.geoY=tempHits_B[f_test].module;
-	rHits.adcX=tempHits_B[f].adc;
-	rHits.adcY=tempHits_B[f_test].adc;
-	rHits.stripX=tempHits_B[f].channel;
-	rHits.stripY=tempHits_B[f_test].channel;
-	rHits.trigNumberX=tempHits_B[f].triggerNumber;
-	rHits.trigNumberY=tempHits_B[f_test].triggerNumber;
-	rHits.timeAvg = (tempHits_B[f_test].triggerTime+tempHits_B[f].triggerTime)/2.0;
-	 primaryHits_B.push_back(rHits); 
-
-	 }
-    }
-  }
+  // Front and back 2D hits close enough in time to make a CRT track
+  timesF.clear();
+  timesB.clear();
+  for (const auto & hit: primaryHits_F) timesF.push_back(hit.timeAvg);
+  for (const auto & hit: primaryHits_B) timesB.push_back(hit.timeAvg);
+  CRT::TimeWindowPairs(timesF, timesB, fFronttoBackTimingCut, frontBackPairs);
 
 	std::cout<<primaryHits_F.size()<<','<<primaryHits_B.size()<<std::endl;
   // Reconstruciton information
@@ -660,8 +601,9 @@ art::FindManyP<anab::T0> trk_t0_assn_v(PFPListHandle, event ,"pandora");
       int best_trigXB=0;
       int best_trigYB=0;
        */
-    for (unsigned int f = 0; f < primaryHits_F.size(); f++) {
-        for (unsigned int b = 0; b < primaryHits_B.size(); b++) {
+    for (const auto & frontBack: frontBackPairs) { // Pairs passing fFronttoBackTimingCut
+        const unsigned int f = frontBack.first;
+        const unsigned int b = frontBack.second;
 
       double X1 = primaryHits_F[f].hitPositionX;
       double Y1 = primaryHits_F[f].hitPositionY;
@@ -672,7 +614,6 @@ art::FindManyP<anab::T0> trk_t0_assn_v(PFPListHandle, event ,"pandora");
 
      
 
-	        if (fabs(primaryHits_F[f].timeAvg-primaryHits_B[b].timeAvg)>fFronttoBackTimingCut) continue;
 		
 		//std::cout<<"FOUND A COMBO"<<std::endl;
 		double t0=(primaryHits_F[f].timeAvg+primaryHits_B[b].timeAvg)/2.f;
@@ -789,7 +730,6 @@ if(geom->PositionToTPCID(geo::Point_t(trackEndPositionX, trackEndPositionY, trac
 	    if (!fMCCSwitch) best_T=(111.f+t0)*20.f;
 	    // Added 111 tick CRT-CTB offset
           }
-        }
       }
 	X_F=best_XF; Y_F=best_YF; Z_F=best_ZF; X_B=best_XB; Y_B=best_YB; Z_B=best_ZB; int  f=bestHitIndex_F; int b=bestHitIndex_B;
  double t0=best_T;
@@ -1033,6 +973,9 @@ if(geom->PositionToTPCID(geo::Point_t(trackEndPositionX, trackEndPositionY, trac
 
 // Setup CRT 
 void CRT::TwoCRTMatching::beginJob() {
+  // Strip centres do not change during the job, so look them up once
+  art::ServiceHandle < geo::Geometry > geom;
+  CRT::FillStripTable(*geom, fStripTable);
 	art::ServiceHandle<art::TFileService> fileServiceHandle;
        fCRTTree = fileServiceHandle->make<TTree>("Displacement", "track by track info");
         fMCCMuon= fileServiceHandle->make<TTree>("MCCTruths", "event by event info");
@@ -0,0 +1,109 @@
+//File: CRTHitSweep.cpp
+//Brief: Implementation of the strip-centre table, the per-event strip bitmap and the
+//       time-ordered pair search used to build and pair 2D CRT hits.
+
+#include "CRTHitSweep.h" //Header
+
+//c++ includes
+#include <algorithm> //For std::sort, std::fill
+#include <cmath> //For std::fabs
+#include <numeric> //For std::iota
+#include <stdexcept> //For std::out_of_range
+#include <string>
+
+namespace CRT
+{
+  void StripTable::Clear()
+  {
+    fCenters.clear();
+    fValid.clear();
+    fNChannels = 0;
+  }
+
+  void StripTable::Set(const size_t module, const size_t channel, const Center& center)
+  {
+    if(module >= fCenters.size())
+    {
+      fCenters.resize(module+1);
+      fValid.resize(module+1);
+    }
+    if(channel >= fCenters[module].size())
+    {
+      fCenters[module].resize(channel+1);
+      fValid[module].resize(channel+1, false);
+    }
+    fCenters[module][channel] = center;
+    fValid[module][channel] = true;
+    if(channel >= fNChannels) fNChannels = channel+1;
+  }
+
+  bool StripTable::Has(const size_t module, const size_t channel) const
+  {
+    return module < fValid.size() && channel < fValid[module].size() && fValid[module][channel];
+  }
+
+  const StripTable::Center& StripTable::At(const size_t module, const size_t channel) const
+  {
+    if(!Has(module, channel))
+    {
+      throw std::out_of_range("CRT::StripTable: no strip for module " + std::to_string(module)
+                              + " channel " + std::to_string(channel));
+    }
+    return fCenters[module][channel];
+  }
+
+  void StripMap::Reset(const size_t nModules, const size_t nChannels)
+  {
+    fNModules = nModules;
+    fWordsPerModule = (nChannels + 63) / 64;
+    fBits.resize(fNModules*fWordsPerModule);
+    std::fill(fBits.begin(), fBits.end(), 0);
+  }
+
+  void StripMap::Set(const size_t module, const size_t channel)
+  {
+    if(module >= fNModules || channel >= 64*fWordsPerModule) return;
+    fBits[module*fWordsPerModule + channel/64] |= uint64_t(1) << (channel % 64);
+  }
+
+  bool StripMap::Test(const size_t module, const size_t channel) const
+  {
+    if(module >= fNModules || channel >= 64*fWordsPerModule) return false;
+    return (fBits[module*fWordsPerModule + channel/64] >> (channel % 64)) & 1;
+  }
+
+  namespace
+  {
+    std::vector<size_t> timeOrder(const std::vector<double>& times)
+    {
+      std::vector<size_t> order(times.size());
+      std::iota(order.begin(), order.end(), 0);
+      std::sort(order.begin(), order.end(), [&times](const size_t lhs, const size_t rhs)
+                                            { return times[lhs] < times[rhs]; });
+      return order;
+    }
+  }
+
+  void TimeWindowPairs(const std::vector<double>& a, const std::vector<double>& b, const double window,
+                       std::vector<std::pair<size_t, size_t>>& pairs)
+  {
+    pairs.clear();
+    const auto orderA = timeOrder(a);
+    const auto orderB = timeOrder(b);
+
+    //[first, last) is the range of b within window of the current a.  Both ends only
+    //move forward as a increases.  The cut is written as in the original loops,
+    //|b - a| > window, so that borderline pairs are treated the same way.
+    size_t first = 0, last = 0;
+    for(const size_t i: orderA)
+    {
+      const double time = a[i];
+      while(first < orderB.size() && b[orderB[first]] < time && std::fabs(b[orderB[first]] - time) > window) ++first;
+      if(last < first) last = first;
+      while(last < orderB.size() && (b[orderB[last]] <= time || std::fabs(b[orderB[last]] - time) <= window)) ++last;
+      for(size_t k = first; k < last; ++k) pairs.emplace_back(i, orderB[k]);
+    }
+
+    std::sort(pairs.begin(), pairs.end());
+  }
+}
@@ -0,0 +1,162 @@
+//File: CRTHitSweep.h
+//Brief: Building blocks for making 2D CRT hits out of strip hits and for pairing
+//       front and back 2D hits.  Hits are visited in time order with a sliding
+//       window, so the cost scales with the number of hits plus the number of
+//       pairs that pass the timing cut instead of with every possible pair.
+//       Strip centres are looked up in a table that is filled once per job, and
+//       adjacent strips are found with a per-event bitmap of the strips hit in
+//       each module.
+//
+//       Nothing here depends on the offline framework.  FillStripTable() takes
+//       anything with the AuxDet interface of the LArSoft geometry.
+//
+//       Results are the same, and in the same order, as the nested loops over
+//       all hits used by the CRT matching modules before.
+
+#ifndef CRT_CRTHITSWEEP_H
+#define CRT_CRTHITSWEEP_H
+
+//c++ includes
+#include <cstddef> //For size_t
+#include <cstdint> //For uint64_t
+#include <utility> //For std::pair
+#include <vector>
+
+namespace CRT
+{
+  //Centre of each strip in the offline coordinate system, indexed by (module, channel).
+  class StripTable
+  {
+    public:
+      struct Center
+      {
+        double x;
+        double y;
+        double z;
+      };
+
+      void Clear();
+      void Set(const size_t module, const size_t channel, const Center& center);
+      bool Has(const size_t module, const size_t channel) const;
+
+      //Throws std::out_of_range for a strip that was never set
+      const Center& At(const size_t module, const size_t channel) const;
+
+      bool Empty() const { return fCenters.empty(); }
+      size_t NModules() const { return fCenters.size(); }
+      size_t NChannels() const { return fNChannels; } //Largest number of channels in any module
+
+    private:
+      std::vector<std::vector<Center>> fCenters;
+      std::vector<std::vector<bool>> fValid;
+      size_t fNChannels = 0;
+  };
+
+  //Fill table with the centre of every sensitive volume of every AuxDet in geom.
+  template <class GEOMETRY>
+  void FillStripTable(const GEOMETRY& geom, StripTable& table)
+  {
+    table.Clear();
+    for(size_t module = 0; module < geom.NAuxDets(); ++module)
+    {
+      const auto& trigGeo = geom.AuxDet(module);
+      for(size_t channel = 0; channel < trigGeo.NSensitiveVolume(); ++channel)
+      {
+        const auto center = trigGeo.SensitiveVolume(channel).GetCenter();
+        table.Set(module, channel, {center.X(), center.Y(), center.Z()});
+      }
+    }
+  }
+
+  //One bit per strip telling whether it was hit in the current event.
+  class StripMap
+  {
+    public:
+      //Clear all bits and size the map.  Memory is kept from event to event.
+      void Reset(const size_t nModules, const size_t nChannels);
+      void Set(const size_t module, const size_t channel);
+      bool Test(const size_t module, const size_t channel) const; //false outside the map
+
+    private:
+      std::vector<uint64_t> fBits;
+      size_t fNModules = 0;
+      size_t fWordsPerModule = 0;
+  };
+
+  //A strip above threshold
+  struct StripHit
+  {
+    size_t module;
+    size_t channel;
+    double time;
+  };
+
+  //Overlap of a strip hit in an X module with one in a Y module
+  struct Hit2D
+  {
+    size_t x; //Index of the hit giving the X position
+    size_t y; //Index of the hit giving the Y position
+    double posX;
+    double posY;
+    double posZ;
+    double time; //Average of the two hit times
+  };
+
+  //All pairs (i, j) with |b[j] - a[i]| <= window, ordered by i and then by j.
+  void TimeWindowPairs(const std::vector<double>& a, const std::vector<double>& b, const double window,
+                       std::vector<std::pair<size_t, size_t>>& pairs);
+
+  //Make 2D hits from the strip hits of one side of the CRT.  Two hits are combined when
+  //they are within window of each other and moduleMatch(Y module, X module) is true.
+  //Positions are the strip centres, shifted by half a strip (1.25 cm) when the next
+  //strip in the same module was hit too.
+  class HitSweep
+  {
+    public:
+      template <class MATCHER>
+      void Build2DHits(const std::vector<StripHit>& hits, const StripTable& table, const double window,
+                       MATCHER&& moduleMatch, std::vector<Hit2D>& out);
+
+    private:
+      std::vector<double> fTimes;
+      std::vector<std::pair<size_t, size_t>> fPairs;
+      StripMap fStrips;
+  };
+
+  template <class MATCHER>
+  void HitSweep::Build2DHits(const std::vector<StripHit>& hits, const StripTable& table, const double window,
+                             MATCHER&& moduleMatch, std::vector<Hit2D>& out)
+  {
+    out.clear();
+    fTimes.clear();
+    fStrips.Reset(table.NModules(), table.NChannels());
+    for(const auto& hit: hits)
+    {
+      fTimes.push_back(hit.time);
+      fStrips.Set(hit.module, hit.channel);
+    }
+
+    TimeWindowPairs(fTimes, fTimes, window, fPairs);
+    for(const auto& pair: fPairs)
+    {
+      const auto& hitX = hits[pair.first];
+      const auto& hitY = hits[pair.second];
+      if(!moduleMatch(hitY.module, hitX.module)) continue;
+
+      const auto& centerX = table.At(hitX.module, hitX.channel);
+      const auto& centerY = table.At(hitY.module, hitY.channel);
+      Hit2D hit2D;
+      hit2D.x = pair.first;
+      hit2D.y = pair.second;
+      hit2D.posX = centerX.x;
+      if(fStrips.Test(hitX.module, hitX.channel+1)) hit2D.posX += 1.25;
+      hit2D.posY = centerY.y;
+      if(fStrips.Test(hitY.module, hitY.channel+1)) hit2D.posY += 1.25;
+      hit2D.posZ = (centerX.z + centerY.z) / 2.;
+      hit2D.time = (hitY.time + hitX.time) / 2.;
+      out.push_back(hit2D);
+    }
+  }
+}
+
+#endif //CRT_CRTHITSWEEP_H
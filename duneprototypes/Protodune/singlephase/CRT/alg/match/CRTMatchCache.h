@@ -0,0 +1,86 @@
+//File: CRTMatchCache.h
+//Brief: Helpers for matching TPC tracks to CRT hits without redoing the same work
+//       for every (track, CRT hit) combination.
+//
+//       TimeMemo remembers a value computed from a CRT time.  The matching modules
+//       use it for the drift offset of each CRT time, shared by all tracks read out
+//       on the same TPC plane, and for the shifted and space-charge corrected track
+//       of each CRT time.  Many 2D hits share a time, so each of these is computed
+//       once per time instead of once per hit.
+//
+//       TimeIndex keeps CRT hits in time order so that the hits allowed by a time
+//       window can be found by binary search.
+//
+//       Like CRTHitSweep.h, nothing here depends on the offline framework.
+
+#ifndef CRT_CRTMATCHCACHE_H
+#define CRT_CRTMATCHCACHE_H
+
+//c++ includes
+#include <algorithm> //For std::sort, std::partition_point
+#include <cstddef> //For size_t
+#include <numeric> //For std::iota
+#include <unordered_map>
+#include <utility> //For std::pair
+#include <vector>
+
+namespace CRT
+{
+  //Values computed once per distinct time.  The time is used as an exact key, so the
+  //memoized value is exactly what compute(time) returns.
+  template <class VALUE>
+  class TimeMemo
+  {
+    public:
+      void Clear() { fValues.clear(); }
+      size_t Size() const { return fValues.size(); }
+
+      template <class FUNC>
+      const VALUE& Get(const double time, FUNC&& compute)
+      {
+        auto found = fValues.find(time);
+        if(found == fValues.end()) found = fValues.emplace(time, compute(time)).first;
+        return found->second;
+      }
+
+    private:
+      std::unordered_map<double, VALUE> fValues;
+  };
+
+  //CRT hit indices in time order.
+  class TimeIndex
+  {
+    public:
+      void Build(const std::vector<double>& times)
+      {
+        fTimes = times;
+        fOrder.resize(times.size());
+        std::iota(fOrder.begin(), fOrder.end(), 0);
+        std::stable_sort(fOrder.begin(), fOrder.end(), [this](const size_t lhs, const size_t rhs)
+                                                       { return fTimes[lhs] < fTimes[rhs]; });
+      }
+
+      size_t Size() const { return fOrder.size(); }
+      size_t operator[](const size_t pos) const { return fOrder[pos]; } //Hit index at position pos in time order
+
+      //Positions [first, last) in time order of the hits that are neither tooEarly(time)
+      //nor tooLate(time).  tooEarly must be true for a (possibly empty) set of the
+      //earliest hits and tooLate for a set of the latest ones, as for any cut on a
+      //quantity that increases with time.
+      template <class EARLY, class LATE>
+      std::pair<size_t, size_t> Range(EARLY&& tooEarly, LATE&& tooLate) const
+      {
+        const auto first = std::partition_point(fOrder.begin(), fOrder.end(),
+                                                [&](const size_t hit) { return tooEarly(fTimes[hit]); });
+        const auto last = std::partition_point(first, fOrder.end(),
+                                               [&](const size_t hit) { return !tooLate(fTimes[hit]); });
+        return std::make_pair(size_t(first - fOrder.begin()), size_t(last - fOrder.begin()));
+      }
+
+    private:
+      std::vector<double> fTimes;
+      std::vector<size_t> fOrder;
+  };
+}
+
+#endif //CRT_CRTMATCHCACHE_H
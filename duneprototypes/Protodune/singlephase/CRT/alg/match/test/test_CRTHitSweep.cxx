@@ -0,0 +1,248 @@
+// test_CRTHitSweep.cxx
+//
+// Check that the time-sorted CRT hit sweep gives the same 2D hits and
+// front/back pairs, in the same order, as the nested loops it replaces,
+// and check the time index and memo used for track matching.
+
+#include <string>
+#include <iostream>
+#include <random>
+#include <vector>
+#include <utility>
+#include <cmath>
+#include <stdexcept>
+#include "duneprototypes/Protodune/singlephase/CRT/alg/match/CRTHitSweep.h"
+#include "duneprototypes/Protodune/singlephase/CRT/alg/match/CRTMatchCache.h"
+
+#undef NDEBUG
+#include <cassert>
+
+using std::string;
+using std::cout;
+using std::endl;
+using std::vector;
+using CRT::StripHit;
+using CRT::Hit2D;
+
+//**********************************************************************
+
+namespace {
+
+// Minimal stand-in for the AuxDet part of the LArSoft geometry.
+struct Point {
+  double x, y, z;
+  double X() const { return x; }
+  double Y() const { return y; }
+  double Z() const { return z; }
+};
+
+struct Strip {
+  Point center;
+  Point GetCenter() const { return center; }
+};
+
+struct Module {
+  vector<Strip> strips;
+  size_t NSensitiveVolume() const { return strips.size(); }
+  const Strip& SensitiveVolume(size_t i) const { return strips.at(i); }
+};
+
+struct FakeGeometry {
+  vector<Module> modules;
+  size_t NAuxDets() const { return modules.size(); }
+  const Module& AuxDet(size_t i) const { return modules.at(i); }
+};
+
+// Odd modules give X, even modules give Y; module 2k matches 2k+1.
+bool moduleMatcher(int module1, int module2) {
+  return module1 % 2 == 0 && module2 == module1 + 1;
+}
+
+// The nested loops of the CRT matching modules.
+vector<Hit2D> nestedLoops(const vector<StripHit>& hits, const FakeGeometry& geo, int cut) {
+  vector<Hit2D> out;
+  for ( size_t f=0; f<hits.size(); ++f ) {
+    for ( size_t f_test=0; f_test<hits.size(); ++f_test ) {
+      if ( fabs(int(hits[f_test].time) - int(hits[f].time)) > cut ) continue;
+      const Point hit1Center = geo.AuxDet(hits[f].module).SensitiveVolume(hits[f].channel).GetCenter();
+      const Point hit2Center = geo.AuxDet(hits[f_test].module).SensitiveVolume(hits[f_test].channel).GetCenter();
+      if ( !moduleMatcher(hits[f_test].module, hits[f].module) ) continue;
+      double hitX = hit1Center.X();
+      for ( size_t a=0; a<hits.size(); ++a ) {
+        if ( hits[a].module == hits[f].module && hits[a].channel - 1 == hits[f].channel ) hitX = hit1Center.X() + 1.25;
+      }
+      double hitY = hit2Center.Y();
+      for ( size_t a=0; a<hits.size(); ++a ) {
+        if ( hits[a].module == hits[f_test].module && hits[a].channel - 1 == hits[f_test].channel ) hitY = hit2Center.Y() + 1.25;
+      }
+      Hit2D hit;
+      hit.x = f;
+      hit.y = f_test;
+      hit.posX = hitX;
+      hit.posY = hitY;
+      hit.posZ = (hit1Center.Z() + hit2Center.Z())/2.f;
+      hit.time = (int(hits[f_test].time) + int(hits[f].time))/2.0;
+      out.push_back(hit);
+    }
+  }
+  return out;
+}
+
+bool same(const Hit2D& lhs, const Hit2D& rhs) {
+  return lhs.x == rhs.x && lhs.y == rhs.y && lhs.posX == rhs.posX && lhs.posY == rhs.posY &&
+         lhs.posZ == rhs.posZ && lhs.time == rhs.time;
+}
+
+}  // end unnamed namespace
+
+//**********************************************************************
+
+int test_CRTHitSweep(unsigned int ncase) {
+  const string myname = "test_CRTHitSweep: ";
+#ifdef NDEBUG
+  cout << myname << "NDEBUG must be off." << endl;
+  abort();
+#endif
+  string line = "-----------------------------";
+  std::mt19937 gen(20181127);
+
+  cout << myname << line << endl;
+  cout << myname << "Filling the strip table." << endl;
+  FakeGeometry geo;
+  const size_t nmod = 8;
+  const size_t nchan = 64;
+  for ( size_t imod=0; imod<nmod; ++imod ) {
+    Module mod;
+    for ( size_t ichan=0; ichan<nchan; ++ichan ) {
+      mod.strips.push_back({{imod*100.0 + ichan*2.5, imod*50.0 - ichan*2.5, imod%4 < 2 ? 10.0*imod : 700.0 + imod}});
+    }
+    geo.modules.push_back(mod);
+  }
+  CRT::StripTable table;
+  CRT::FillStripTable(geo, table);
+  assert( table.NModules() == nmod );
+  assert( table.NChannels() == nchan );
+  assert( table.At(3, 17).x == geo.modules[3].strips[17].center.x );
+  assert( table.Has(7, 63) );
+  assert( ! table.Has(7, 64) );
+  assert( ! table.Has(8, 0) );
+  bool caught = false;
+  try {
+    table.At(8, 0);
+  } catch ( const std::out_of_range& ) {
+    caught = true;
+  }
+  assert( caught );
+
+  cout << myname << line << endl;
+  cout << myname << "Checking the strip map." << endl;
+  {
+    CRT::StripMap strips;
+    strips.Reset(3, 100);
+    strips.Set(0, 0);
+    strips.Set(2, 99);
+    strips.Set(1, 64);
+    strips.Set(5, 1);
+    assert( strips.Test(0, 0) && strips.Test(2, 99) && strips.Test(1, 64) );
+    assert( ! strips.Test(1, 0) && ! strips.Test(2, 100) && ! strips.Test(5, 1) );
+    strips.Reset(3, 100);
+    assert( ! strips.Test(0, 0) );
+  }
+
+  cout << myname << line << endl;
+  cout << myname << "Comparing " << ncase << " events with the nested loops." << endl;
+  CRT::HitSweep sweep;
+  vector<Hit2D> hits2D;
+  std::vector<std::pair<size_t, size_t>> pairs;
+  size_t n2D = 0;
+  for ( unsigned int icas=0; icas<ncase; ++icas ) {
+    size_t nhit = gen() % 200;
+    int cut = 1 + gen() % 10;
+    int trange = 1 + gen() % 1000;
+    vector<StripHit> hits;
+    for ( size_t ihit=0; ihit<nhit; ++ihit ) {
+      hits.push_back({gen() % nmod, gen() % nchan, double(int(gen() % trange) - trange/2)});
+    }
+    sweep.Build2DHits(hits, table, cut, moduleMatcher, hits2D);
+    vector<Hit2D> ref = nestedLoops(hits, geo, cut);
+    assert( hits2D.size() == ref.size() );
+    for ( size_t ihit=0; ihit<ref.size(); ++ihit ) assert( same(hits2D[ihit], ref[ihit]) );
+    n2D += ref.size();
+
+    // Front/back pairing of the 2D hits with themselves and with a shifted copy.
+    vector<double> timesF, timesB;
+    for ( const Hit2D& hit : ref ) {
+      timesF.push_back(hit.time);
+      timesB.push_back(hit.time + 0.5*int(gen() % 5));
+    }
+    timesB.resize(timesB.size()/2);
+    CRT::TimeWindowPairs(timesF, timesB, cut, pairs);
+    size_t ipair = 0;
+    for ( size_t f=0; f<timesF.size(); ++f ) {
+      for ( size_t b=0; b<timesB.size(); ++b ) {
+        if ( fabs(timesF[f] - timesB[b]) > cut ) continue;
+        assert( ipair < pairs.size() );
+        assert( pairs[ipair].first == f && pairs[ipair].second == b );
+        ++ipair;
+      }
+    }
+    assert( ipair == pairs.size() );
+  }
+  cout << myname << "Found " << n2D << " 2D hits." << endl;
+
+  cout << myname << line << endl;
+  cout << myname << "Checking the time index and memo." << endl;
+  for ( unsigned int icas=0; icas<ncase; ++icas ) {
+    vector<double> times;
+    size_t nhit = gen() % 100;
+    for ( size_t ihit=0; ihit<nhit; ++ihit ) times.push_back(int(gen() % 200) - 100);
+    CRT::TimeIndex index;
+    index.Build(times);
+    assert( index.Size() == nhit );
+    double tmin = int(gen() % 200) - 100;
+    double tmax = tmin + gen() % 50;
+    auto range = index.Range([tmin](double t) { return t < tmin; }, [tmax](double t) { return t > tmax; });
+    vector<bool> seen(nhit, false);
+    for ( size_t pos=range.first; pos<range.second; ++pos ) {
+      size_t ihit = index[pos];
+      assert( times[ihit] >= tmin && times[ihit] <= tmax );
+      if ( pos > range.first ) assert( times[index[pos-1]] < times[ihit] ||
+                                       (times[index[pos-1]] == times[ihit] && index[pos-1] < ihit) );
+      seen[ihit] = true;
+    }
+    for ( size_t ihit=0; ihit<nhit; ++ihit ) assert( seen[ihit] == (times[ihit] >= tmin && times[ihit] <= tmax) );
+  }
+  {
+    CRT::TimeMemo<double> memo;
+    unsigned int ncall = 0;
+    auto twice = [&ncall](double t) { ++ncall; return 2*t; };
+    assert( memo.Get(1.5, twice) == 3.0 );
+    assert( memo.Get(-2.0, twice) == -4.0 );
+    assert( memo.Get(1.5, twice) == 3.0 );
+    assert( ncall == 2 && memo.Size() == 2 );
+    memo.Clear();
+    assert( memo.Size() == 0 );
+    assert( memo.Get(1.5, twice) == 3.0 && ncall == 3 );
+  }
+
+  cout << myname << line << endl;
+  cout << myname << "Done." << endl;
+  return 0;
+}
+
+//**********************************************************************
+
+int main(int argc, char* argv[]) {
+  unsigned int ncase = 500;
+  if ( argc > 1 ) {
+    string sarg(argv[1]);
+    if ( sarg == "-h" ) {
+      cout << "Usage: " << argv[0] << " [NCASE]" << endl;
+      return 0;
+    }
+    ncase = std::stoi(sarg);
+  }
+  return test_CRTHitSweep(ncase);
+}
+
+//**********************************************************************
@@ -10,6 +10,9 @@
 //
 //    - All dates and times should be in unix time (UTC)
 //
+// - Only the timing decoder output is read, so the filter can be put ahead of the
+//   TPC decoding in the trigger path and rejected events are never unpacked.
+//
 ////////////////////////////////////////////////////////////////////////
 // ROOT
 #include "TMath.h"
@@ -27,22 +30,25 @@
 
 #include "lardataobj/RawData/RDTimeStamp.h"
 
+#include "TimeIntervalIndex.h"
+
 
 namespace ProtoDUNEUnstableHV{
 
-class UnstablePeriod {
+class UnstablePeriodCollection {
     public:
-        void setTimePair(std::pair<UInt_t,UInt_t> timePair){
-            checkInputValid(timePair.first, timePair.second);
-            beginTs = TTimeStamp(timePair.first);
-            endTs = TTimeStamp(timePair.second);
+        // Each period (begin, end) excludes its end points, as in the fcl ranges.
+        void setTimePairs(std::vector <std::pair<UInt_t,UInt_t >> timePairs){
+            for (const auto& timePair : timePairs){
+                checkInputValid(timePair.first, timePair.second);
+                periods.addOpen(timePair.first, timePair.second);
+            }
         }
-        bool containsTimeStamp(const TTimeStamp *ts){
-            return ts->GetSec() > beginTs.GetSec() && ts->GetSec() < endTs.GetSec();
+        bool containsTimeStamp(const TTimeStamp &ts){
+            return ts.GetSec() >= 0 && periods.contains(ts.GetSec());
         }
     private:
-        TTimeStamp beginTs;
-        TTimeStamp endTs;
+        protoana::TimeIntervalIndex periods;
         void checkInputValid(UInt_t begin, UInt_t end){
             if (begin<1000000000 || end < 1000000000 || begin>end){
                 throw std::runtime_error("Unstable period not valid!");
@@ -50,26 +56,6 @@ class UnstablePeriod {
         }
 };
 
-class UnstablePeriodCollection {
-    public:
-        void setTimePairs(std::vector <std::pair<UInt_t,UInt_t >> timePairs){
-            n_periods = timePairs.size();
-            subPeriods = new UnstablePeriod[n_periods];
-            for (int n=0; n<n_periods; n++){
-                subPeriods[n].setTimePair(timePairs.at(n));
-            }
-        }
-        bool containsTimeStamp(const TTimeStamp *ts){
-            for (int n=0; n<n_periods; n++){
-                if (subPeriods[n].containsTimeStamp(ts)) return true;
-            }
-            return false;
-        }
-    private:
-        UnstablePeriod *subPeriods;
-        int n_periods;
-};
-
 class DecoderHandler {
     public:
         double getTimeStamp() {
@@ -80,6 +66,9 @@ class DecoderHandler {
             throw std::runtime_error("Handle to RDTimeStamp vector is empty!");
             return -1;
         }
+        void setTag(art::InputTag const & tag) {
+            iTag = tag;
+        }
         void setHandle(art::Event & e) {
             handle = e.getHandle< std::vector<raw::RDTimeStamp> >(iTag);
             MF_LOG_INFO("BeamEvent") << "Handle valid? " << handle.isValid() << "\n";
@@ -100,15 +89,16 @@ class Filter : public art::EDFilter  {
         bool filter(art::Event& evt);
         void beginJob();
     private:
-        UnstablePeriodCollection *unstablePeriodCollection = new UnstablePeriodCollection;
-        DecoderHandler *decoderHandler = new DecoderHandler;
+        UnstablePeriodCollection unstablePeriodCollection;
+        DecoderHandler decoderHandler;
         bool _filter(art::Event& evt);
         bool fDebug;
         TH1D* fSelectedEvents;
         TH1D* fTotalEvents;
 };
 Filter::Filter(fhicl::ParameterSet const& p) : EDFilter(p) {
-    unstablePeriodCollection->setTimePairs(p.get<std::vector<std::pair<UInt_t,UInt_t>>>("TimeRanges"));
+    unstablePeriodCollection.setTimePairs(p.get<std::vector<std::pair<UInt_t,UInt_t>>>("TimeRanges"));
+    decoderHandler.setTag(p.get<art::InputTag>("TimingTag", art::InputTag("timingrawdecoder", "daq")));
     fDebug = p.get<int>("Debug");
 }
 void Filter::beginJob() {
@@ -118,9 +108,9 @@ void Filter::beginJob() {
 }
 bool Filter::_filter(art::Event &evt) {
     if (!evt.isRealData()) return true;
-    decoderHandler->setHandle(evt);
-    TTimeStamp *evtTTS = new TTimeStamp(decoderHandler->getTimeStamp());
-    return !unstablePeriodCollection->containsTimeStamp(evtTTS);
+    decoderHandler.setHandle(evt);
+    TTimeStamp evtTTS(decoderHandler.getTimeStamp());
+    return !unstablePeriodCollection.containsTimeStamp(evtTTS);
 }
 bool Filter::filter(art::Event &evt) {
     fTotalEvents->Fill(1);
@@ -0,0 +1,76 @@
+// TimeIntervalIndex.h
+//
+// Set of closed integer intervals [begin, end], e.g. unstable HV periods in
+// unix seconds or ranges of bad runs, answering whether a value lies in any
+// of them.
+//
+// The filters used to keep the periods in a list and test an event against
+// each in turn. Here the intervals are kept sorted, with overlapping and
+// adjacent ones merged as they are added, so that a lookup is one binary
+// search. For a fixed set of intervals queried with single values this
+// gives the same answers as an interval tree with less bookkeeping.
+//
+// Intervals are added at configuration time; contains() does not modify
+// the index and may be called from several threads.
+
+#ifndef TimeIntervalIndex_H
+#define TimeIntervalIndex_H
+
+#include <algorithm>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+namespace protoana {
+
+class TimeIntervalIndex {
+
+public:
+
+  using Interval = std::pair<uint64_t, uint64_t>;
+
+  // Add the closed interval [begin, end]. Nothing is added if begin > end.
+  void add(uint64_t begin, uint64_t end) {
+    if ( begin > end ) return;
+    // Intervals ending before begin - 1 or starting after end + 1 do not
+    // touch the new one; those in between are merged into it.
+    auto ifirst = std::partition_point(m_ivs.begin(), m_ivs.end(),
+                                       [begin](const Interval& iv) { return begin > 0 && iv.second < begin - 1; });
+    auto ilast = std::partition_point(ifirst, m_ivs.end(),
+                                      [end](const Interval& iv) { return !(iv.first > 0 && iv.first - 1 > end); });
+    if ( ifirst != ilast ) {
+      begin = std::min(begin, ifirst->first);
+      end = std::max(end, (ilast - 1)->second);
+      ifirst = m_ivs.erase(ifirst, ilast);
+    }
+    m_ivs.insert(ifirst, Interval(begin, end));
+  }
+
+  // Add the open interval (begin, end), i.e. [begin + 1, end - 1].
+  void addOpen(uint64_t begin, uint64_t end) {
+    if ( end > begin + 1 ) add(begin + 1, end - 1);
+  }
+
+  // Whether t lies in any interval.
+  bool contains(uint64_t t) const {
+    auto iiv = std::upper_bound(m_ivs.begin(), m_ivs.end(), t,
+                                [](uint64_t tval, const Interval& iv) { return tval < iv.first; });
+    if ( iiv == m_ivs.begin() ) return false;
+    return t <= (iiv - 1)->second;
+  }
+
+  // The merged intervals in increasing order.
+  const std::vector<Interval>& intervals() const { return m_ivs; }
+
+  size_t size() const { return m_ivs.size(); }
+  bool empty() const { return m_ivs.empty(); }
+
+private:
+
+  std::vector<Interval> m_ivs;
+
+};
+
+}  // end namespace protoana
+
+#endif
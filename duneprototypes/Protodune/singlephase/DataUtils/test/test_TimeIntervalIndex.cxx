@@ -0,0 +1,116 @@
+// test_TimeIntervalIndex.cxx
+//
+// Check that the sorted interval index gives the same answer as testing each
+// interval in turn, as the unstable HV filter used to.
+
+#include <string>
+#include <iostream>
+#include <random>
+#include <vector>
+#include <cstdint>
+#include <limits>
+#include "duneprototypes/Protodune/singlephase/DataUtils/TimeIntervalIndex.h"
+
+#undef NDEBUG
+#include <cassert>
+
+using std::string;
+using std::cout;
+using std::endl;
+using std::vector;
+using protoana::TimeIntervalIndex;
+using Interval = TimeIntervalIndex::Interval;
+
+namespace {
+
+// The old check: strictly inside any of the periods.
+bool inAnyOpen(const vector<Interval>& periods, uint64_t t) {
+  for ( const Interval& per : periods ) {
+    if ( t > per.first && t < per.second ) return true;
+  }
+  return false;
+}
+
+}  // end unnamed namespace
+
+//**********************************************************************
+
+int test_TimeIntervalIndex(unsigned int nper) {
+  const string myname = "test_TimeIntervalIndex: ";
+#ifdef NDEBUG
+  cout << myname << "NDEBUG must be off." << endl;
+  abort();
+#endif
+  string line = "-----------------------------";
+
+  cout << myname << line << endl;
+  cout << myname << "Checking merging." << endl;
+  TimeIntervalIndex idx;
+  assert( idx.empty() );
+  assert( ! idx.contains(0) );
+  idx.add(10, 20);
+  idx.add(30, 40);
+  idx.add(22, 25);
+  assert( idx.size() == 3 );
+  idx.add(21, 21);   // adjacent on both sides
+  assert( idx.size() == 2 );
+  assert( idx.intervals()[0] == Interval(10, 25) );
+  idx.add(5, 50);
+  assert( idx.size() == 1 );
+  assert( idx.intervals()[0] == Interval(5, 50) );
+  idx.add(7, 6);
+  idx.addOpen(60, 61);
+  assert( idx.size() == 1 );
+  assert( idx.contains(5) && idx.contains(50) );
+  assert( ! idx.contains(4) && ! idx.contains(51) );
+  const uint64_t tmax = std::numeric_limits<uint64_t>::max();
+  idx.add(tmax - 1, tmax);
+  idx.add(0, 0);
+  assert( idx.size() == 3 );
+  assert( idx.contains(0) && idx.contains(tmax) && ! idx.contains(tmax - 2) );
+
+  cout << myname << line << endl;
+  cout << myname << "Comparing " << nper << " random periods with a linear search." << endl;
+  std::mt19937_64 gen(1537315216);
+  const uint64_t t0 = 1537315216;
+  std::uniform_int_distribution<uint64_t> starts(t0, t0 + 100*nper);
+  std::uniform_int_distribution<uint64_t> lens(0, 200);
+  vector<Interval> periods;
+  TimeIntervalIndex hvidx;
+  for ( unsigned int iper=0; iper<nper; ++iper ) {
+    uint64_t beg = starts(gen);
+    periods.emplace_back(beg, beg + lens(gen));
+    hvidx.addOpen(periods.back().first, periods.back().second);
+  }
+  for ( size_t iiv=1; iiv<hvidx.size(); ++iiv ) {
+    assert( hvidx.intervals()[iiv].first > hvidx.intervals()[iiv-1].second + 1 );
+  }
+  unsigned int nin = 0;
+  for ( uint64_t t=t0 - 10; t<t0 + 100*nper + 300; ++t ) {
+    bool exp = inAnyOpen(periods, t);
+    assert( hvidx.contains(t) == exp );
+    if ( exp ) ++nin;
+  }
+  cout << myname << "Merged intervals: " << hvidx.size() << ", seconds inside: " << nin << endl;
+
+  cout << myname << line << endl;
+  cout << myname << "Done." << endl;
+  return 0;
+}
+
+//**********************************************************************
+
+int main(int argc, char* argv[]) {
+  unsigned int nper = 500;
+  if ( argc > 1 ) {
+    string sarg(argv[1]);
+    if ( sarg == "-h" ) {
+      cout << "Usage: " << argv[0] << " [NPERIOD]" << endl;
+      return 0;
+    }
+    nper = std::stoi(sarg);
+  }
+  return test_TimeIntervalIndex(nper);
+}
+
+//**********************************************************************
@@ -14,6 +14,7 @@
 #include "larcorealg/Geometry/PlaneGeo.h"
 #include "larcoreobj/SimpleTypesAndConstants/PhysicalConstants.h"
 #include "messagefacility/MessageLogger/MessageLogger.h"
+#include "cetlib/search_path.h"
 
 
 
@@ -54,7 +55,7 @@ namespace {
 namespace spdp{
   //--------------------------------------------------------------------
   DetectorPropertiesProtoDUNEsp::DetectorPropertiesProtoDUNEsp() :
-    fLP(0), fGeo(0)
+    fLP(0), fGeo(0), fRunConditions(std::make_unique<RunConditionsStore>())
   {
 
   }
@@ -96,12 +97,15 @@ namespace spdp{
 
     if(fUseRunDependentTemperature){ // updata the temperature based on run number for data
 
-      if ((run > 5903) & (run < 6930)){ //first runs after Nov 17 2019 and March 1 2019, where tempreture average was lower
-        fTemperature = 87.36;
+      // The store is used for runs it has a temperature for. The other runs use
+      // the periods of lower and higher average temperature after Nov 17 2018.
+      const RunConditions* conditions = fRunConditions->find(run);
+      if (conditions != nullptr && conditions->hasTemperature()){
+        fTemperature = conditions->temperature;
+        std::cout<<"Using temperature "<<fTemperature<<" K from run conditions store"<<std::endl;
       }
-      else if (run >= 6930)
-      {
-        fTemperature = 87.65;
+      else {
+        runTemperature(run, fTemperature);
       }
     }
 
@@ -109,21 +113,54 @@ namespace spdp{
     return true;
   }
 
+  const RunConditions& DetectorPropertiesProtoDUNEsp::ConditionsForRun(int run, std::string const& filename){
+
+    // UpdateHV and UpdateReadoutWindowSize ask for the same run in turn.
+    if(run == fConditions.run) return fConditions;
+
+    fConditions = RunConditions();
+    const RunConditions* conditions = fRunConditions->find(run);
+    if(conditions != nullptr){
+      fConditions = *conditions;
+      std::cout<<"Run "<<run<<" conditions retrieved from run conditions store"<<std::endl;
+    }
+    fConditions.run = run;
+
+    // Values the store does not have ("-" or no line for the run) are taken
+    // from the MetaData, as they were before there was a store.
+    bool needHV = fGetHVDriftfromMetaData && !fConditions.hasHV();
+    bool needWindow = fGetReadOutWindowSizefromMetaData && !fConditions.hasReadoutWindow();
+    if(needHV || needWindow){
+      art::ServiceHandle<ifdh_ns::IFDH> ifdh;
+      auto metadata=ifdh->getMetadata(filename);
+      RunConditions fromMetadata;
+      runConditionsFromMetadata(metadata, fromMetadata);
+      if(needHV) fConditions.hv = fromMetadata.hv;
+      if(needWindow) fConditions.readoutWindow = fromMetadata.readoutWindow;
+      // The MetaData describes the file, so keep it for the run only if it is
+      // for that run.
+      if(fromMetadata.run == run){
+        std::cout<<"Run number from metadata: "<<fromMetadata.run<<std::endl;
+        fRunConditions->insert(fConditions);
+      }
+      else if(fromMetadata.run >= 0){
+        mf::LogWarning("DetectorPropertiesProtoDUNEsp") << "MetaData of " << filename << " is for run "
+                                                        << fromMetadata.run << ", not " << run;
+      }
+    }
+    return fConditions;
+  }
+
   bool DetectorPropertiesProtoDUNEsp::UpdateReadoutWindowSize(detinfo::DetectorClocksData const& clockData,
-                                                              std::string filename){
+                                                              std::string filename, int run){
 
     bool retVal=false;
 
     if(fGetReadOutWindowSizefromMetaData){
-      art::ServiceHandle<ifdh_ns::IFDH> ifdh;
-      auto metadata=ifdh->getMetadata(filename);
+      const RunConditions& conditions = ConditionsForRun(run, filename);
       retVal = true;
-      std::string window_str="DUNE_data.readout_window: ";
-      if(metadata.find(window_str)!=std::string::npos){
-        int n1 = metadata.find(window_str);
-        n1 += window_str.length();
-        int n2 = metadata.find("\n", n1);
-        double window=std::stod(metadata.substr(n1, n2-n1)); //milliseconds
+      if(conditions.hasReadoutWindow()){
+        double window=conditions.readoutWindow; //milliseconds
         double ticks=window*1000/(clockData.TPCClock().TickPeriod()); //sampling rate 2Mhz
         fNumberTimeSamples=ticks;
         fReadOutWindowSize=ticks;
@@ -143,7 +180,7 @@ namespace spdp{
 
 
 
-  bool DetectorPropertiesProtoDUNEsp::UpdateHV(std::string filename)
+  bool DetectorPropertiesProtoDUNEsp::UpdateHV(std::string filename, int run)
   {
 
 
@@ -153,26 +190,10 @@ namespace spdp{
     if(fGetHVDriftfromMetaData){
       retVal = true;
 
-      art::ServiceHandle<ifdh_ns::IFDH> ifdh;
-      auto metadata=ifdh->getMetadata(filename);
-
-      int run = 0;
-      std::string run_str="Runs: ";
-      if(metadata.find(run_str)!=std::string::npos){
-        int n1 = metadata.find(run_str);
-        n1 += run_str.length();
-        int n2 = metadata.find(".", n1);
-        run = std::stoi(metadata.substr(n1, n2-n1));
-        std::cout<<"Run number from metadata: "<<run<<std::endl;
-      }
-
-      std::string hv_str="detector.hv_value: ";
-      if(metadata.find(hv_str)!=std::string::npos){
-        int n1 = metadata.find(hv_str);
-        n1 += hv_str.length();
-        int n2 = metadata.find("\n", n1);
+      const RunConditions& conditions = ConditionsForRun(run, filename);
 
-        fHV_cath=std::stod(metadata.substr(n1, n2-n1));
+      if(conditions.hasHV()){
+        fHV_cath=conditions.hv;
         std::cout<<"Using HV on cathode as: "<<fHV_cath<<"KV,  Value retreived from samweb MetaData"<<std::endl;
       }
       else{
@@ -181,32 +202,12 @@ namespace spdp{
         fHV_cath=180;
       }
 
-
-
-      double Gplane_bias=(-0.665); //
-      double Uplane_bias=(-0.370);
-      double Vplane_bias=0;
-      double Xplane_bias=(0.820);
-
-
-      //double Gplane_bias=(-0.665*(fHV_cath/180)); // this is scaling, wasnt actually done.
-      //double Uplane_bias=(-0.370*(fHV_cath/180));
-      //double Vplane_bias=0;
-      //double Xplane_bias=0.820*(fHV_cath/180);
-      fEfield={fHV_cath/360,std::fabs(Gplane_bias-Uplane_bias)/0.47625,std::fabs(Uplane_bias-Vplane_bias)/0.47625,std::fabs(Vplane_bias-Xplane_bias)/0.47625};
-      //fEfield[0]=fHV_cath/360;
-      //fEfield[1]=std::fabs(Gplane_bias-Uplane_bias)/0.475;
-      //fEfield[2]=std::fabs(Uplane_bias-Vplane_bias)/0.475;
-      //fEfield[3]=std::fabs(Vplane_bias-Xplane_bias)/0.475;
-      if (std::abs(fHV_cath-180) < 1e-6){
-        // Use the corrected E field from Flavio, Francesco and Stefania
-        // Ref: https://indico.fnal.gov/event/20939/contribution/1/material/slides/0.pdf
-        if (run < 6725){ //first run in Feb 8, 2019
-          fEfield[0] = 0.4867;
-        }
-        else{
-          fEfield[0] = 0.4995;
-        }
+      // The store may hold measured fields for the run.
+      if(conditions.efield.size() == 4){
+        fEfield=conditions.efield;
+      }
+      else{
+        fEfield=planeGapFields(fHV_cath, run);
       }
       std::cout<<"Calculated E field in 4 plane gaps as: "<<fEfield[0]<<","<<fEfield[1]<<","<<fEfield[2]<<","<<fEfield[3]<<std::endl;
     }//End GetHVDriftfrom MetaData if
@@ -233,6 +234,33 @@ namespace spdp{
     fGetHVDriftfromMetaData    = false;  // DLA 2021-11-11  Redmine 26419
     fGetReadOutWindowSizefromMetaData = config.fGetReadOutWindowSizefromMetaData();
     fUseRunDependentTemperature = config.fUseRunDependentTemperature();
+    std::string conditionsFile  = config.RunConditionsFile();
+    if(conditionsFile.empty()){
+      fRunConditions = std::make_unique<RunConditionsStore>(config.RunConditionsCacheSize());
+    }
+    else{
+      std::string conditionsPath;
+      cet::search_path sp("FW_SEARCH_PATH");
+      if(!sp.find_file(conditionsFile, conditionsPath)) conditionsPath = conditionsFile;
+      try{
+        fRunConditions = std::make_unique<RunConditionsStore>(conditionsPath, config.RunConditionsCacheSize());
+      }
+      catch(std::exception const& e){
+        throw cet::exception("DetectorPropertiesProtoDUNEsp") << e.what() << "\n";
+      }
+      mf::LogInfo("DetectorPropertiesProtoDUNEsp") << "Run conditions store " << conditionsPath
+                                                   << " has " << fRunConditions->fileRunCount() << " runs";
+    }
+    fConditions = RunConditions();
+    if(config.TabulateDriftVelocity()){
+      fDriftVelocityTable = std::make_unique<DriftVelocityTable>();
+      mf::LogInfo("DetectorPropertiesProtoDUNEsp") << "Drift velocity table has " << fDriftVelocityTable->size()
+                                                   << " nodes, largest relative error "
+                                                   << fDriftVelocityTable->maxRelError();
+    }
+    else{
+      fDriftVelocityTable.reset();
+    }
     fElectronlifetime           = config.Electronlifetime();
     fTemperature                = config.Temperature();
     fElectronsToADC             = config.ElectronsToADC();
@@ -418,56 +446,16 @@ namespace spdp{
     // Default temperature use internal value.
     if(temperature == 0.)
       temperature = Temperature();
+    // The table only covers the range without warnings.
+    if(fDriftVelocityTable && fDriftVelocityTable->covers(efield, temperature))
+      return (*fDriftVelocityTable)(efield, temperature);
     if(temperature < 87.0 || temperature > 94.0)
       mf::LogWarning("DetectorPropertiesStandard") << "DriftVelocity Warning! : Temperature value of "
                                                    << temperature
                                                    << " K is outside of range covered by drift velocity"
                                                    << " parameterization. Returned value may not be"
                                                    << " correct";
-    double tshift = -87.203+temperature;
-    double xFit = 0.0938163-0.0052563*tshift-0.0001470*tshift*tshift;
-    double uFit = 5.18406+0.01448*tshift-0.003497*tshift*tshift-0.000516*tshift*tshift*tshift;
-    double vd;
-    // Icarus Parameter Set, use as default
-    double  P1 = -0.04640; // K^-1
-    double  P2 = 0.01712;  // K^-1
-    double  P3 = 1.88125;   // (kV/cm)^-1
-    double  P4 =  0.99408;    // kV/cm
-    double  P5 =  0.01172;   // (kV/cm)^-P6
-    double  P6 =  4.20214;
-    double  T0 =  105.749;  // K
-    // Walkowiak Parameter Set
-    double    P1W = -0.01481; // K^-1
-    double  P2W = -0.0075;  // K^-1
-    double   P3W =  0.141;   // (kV/cm)^-1
-    double   P4W =  12.4;    // kV/cm
-    double   P5W =  1.627;   // (kV/cm)^-P6
-    double   P6W =  0.317;
-    double   T0W =  90.371;  // K
-    // From Craig Thorne . . . currently not documented
-    // smooth transition from linear at small fields to
-    //     icarus fit at most fields to Walkowiak at very high fields
-    if (efield < xFit) vd=efield*uFit;
-    else if (efield<0.619) {
-      vd = ((P1*(temperature-T0)+1)
-            *(P3*efield*std::log(1+P4/efield) + P5*std::pow(efield,P6))
-            +P2*(temperature-T0));
-    }
-    else if (efield<0.699) {
-      vd = 12.5*(efield-0.619)*((P1W*(temperature-T0W)+1)
-                                *(P3W*efield*std::log(1+P4W/efield) + P5W*std::pow(efield,P6W))
-                                +P2W*(temperature-T0W))+
-        12.5*(0.699-efield)*((P1*(temperature-T0)+1)
-                             *(P3*efield*std::log(1+P4/efield) + P5*std::pow(efield,P6))
-                             +P2*(temperature-T0));
-    }
-    else {
-      vd = ((P1W*(temperature-T0W)+1)
-            *(P3W*efield*std::log(1+P4W/efield) + P5W*std::pow(efield,P6W))
-            +P2W*(temperature-T0W));
-    }
-    vd /= 10.;
-    return vd; // in cm/us
+    return driftVelocityParam(efield, temperature); // in cm/us
   }
   //----------------------------------------------------------------------------------
   // The below function assumes that the user has applied the lifetime correction and
@@ -492,10 +480,13 @@ namespace spdp{
     double  K3t    = util::kRecombk;                     // in KV/cm*(g/cm^2)/MeV
     double  rho    = Density();                    // LAr density in g/cm^3
     double Wion    = 1000./util::kGeVToElectrons;        // 23.6 eV = 1e, Wion in MeV/e
-    K3t           /= rho;                                // KV/MeV
-    double dEdx    = dQdx/(A3t/Wion-K3t/E_field*dQdx);    //MeV/cm
-
-    return dEdx;
+    return BirksRecombination(A3t, K3t, Wion, rho, E_field).dEdx(dQdx);    //MeV/cm
+  }
+  void DetectorPropertiesProtoDUNEsp::BirksCorrection(double const* dQdx, double* dEdx, size_t n, double E_field) const
+  {
+    double  rho    = Density();                    // LAr density in g/cm^3
+    double Wion    = 1000./util::kGeVToElectrons;        // 23.6 eV = 1e, Wion in MeV/e
+    BirksRecombination(util::kRecombA, util::kRecombk, Wion, rho, E_field).dEdx(dQdx, dEdx, n);
   }
 
   //----------------------------------------------------------------------------------
@@ -510,12 +501,13 @@ namespace spdp{
     // correction at high values of dQ/dx.
     double  rho    = Density();                    // LAr density in g/cm^3
     double Wion    = 1000./util::kGeVToElectrons;        // 23.6 eV = 1e, Wion in MeV/e
-    double Beta    = util::kModBoxB / (rho * E_field);
-    double Alpha   = util::kModBoxA;
-    double dEdx = (exp(Beta * Wion * dQdx ) - Alpha) / Beta;
-
-    return dEdx;
-
+    return ModBoxRecombination(util::kModBoxA, util::kModBoxB, Wion, rho, E_field).dEdx(dQdx);
+  }
+  void DetectorPropertiesProtoDUNEsp::ModBoxCorrection(double const* dQdx, double* dEdx, size_t n, double E_field) const
+  {
+    double  rho    = Density();                    // LAr density in g/cm^3
+    double Wion    = 1000./util::kGeVToElectrons;        // 23.6 eV = 1e, Wion in MeV/e
+    ModBoxRecombination(util::kModBoxA, util::kModBoxB, Wion, rho, E_field).dEdx(dQdx, dEdx, n);
   }
 
   //--------------------------------------------------------------------
@@ -40,6 +40,7 @@
 #include "fhiclcpp/types/OptionalAtom.h"
 // C/C++ standard libraries
 #include <set>
+#include <memory>
 
 
 
@@ -48,6 +49,8 @@
 
 
 #include "duneprototypes/Protodune/singlephase/DetectorServices/Providers/DetectorPropertiesProtoDUNEsp.h"
+#include "duneprototypes/Protodune/singlephase/DetectorServices/Providers/RunConditions.h"
+#include "duneprototypes/Protodune/singlephase/DetectorServices/Providers/DriftRecombination.h"
 
 
 
@@ -88,6 +91,24 @@ namespace spdp{
           Comment("option to update temperature based on run number, used for Data")
         };
 
+        fhicl::Atom<std::string > RunConditionsFile{
+          Name("RunConditionsFile"),
+          Comment("run conditions store (see RunConditions.h) used before the MetaData, empty for none"),
+          ""
+        };
+
+        fhicl::Atom<unsigned int> RunConditionsCacheSize{
+          Name("RunConditionsCacheSize"),
+          Comment("number of runs whose conditions are kept in memory"),
+          64
+        };
+
+        fhicl::Atom<bool        > TabulateDriftVelocity{
+          Name("TabulateDriftVelocity"),
+          Comment("interpolate the drift velocity in a table built at configuration (see DriftRecombination.h)"),
+          false
+        };
+
         fhicl::Atom<double      > Electronlifetime         {
           Name("Electronlifetime"        ),
           Comment("electron lifetime in liquid argon [us]")
@@ -209,9 +230,9 @@ namespace spdp{
         fhicl::ParameterSet const& p,
         std::set<std::string> const& ignore_params = {}
         );
-      bool UpdateHV(std::string filename);
+      bool UpdateHV(std::string filename, int run);
       bool UpdateReadoutWindowSize(detinfo::DetectorClocksData const& clockData,
-                                   std::string filename);
+                                   std::string filename, int run);
       bool UpdateTemp(int run);
       detinfo::DetectorPropertiesData DataFor(const detinfo::DetectorClocksData& clockData) const override;
 
@@ -242,6 +263,14 @@ namespace spdp{
       virtual double BirksCorrection(double dQdX, double EField) const override;
       virtual double ModBoxCorrection(double dQdX) const override;
       virtual double ModBoxCorrection(double dQdX, double EField) const override;
+
+      /// Corrections of n dQ/dX values at one E-field: dEdX[i] is the
+      /// correction of dQdX[i], as the single-value versions give it.
+      void BirksCorrection(double const* dQdX, double* dEdX, size_t n, double EField) const;
+      void ModBoxCorrection(double const* dQdX, double* dEdX, size_t n, double EField) const;
+
+      /// Largest relative error of the drift velocity table, 0 if there is none.
+      double DriftVelocityTableError() const { return fDriftVelocityTable ? fDriftVelocityTable->maxRelError() : 0.0; }
       virtual double ElectronLifetime() const override { return fElectronlifetime; }   //< microseconds
 
 
@@ -318,6 +347,10 @@ namespace spdp{
 
       detinfo::DetectorPropertiesData CalculateXTicksParams(detinfo::DetectorClocksData const& clockData) const;
 
+      /// Run conditions for an art run: from the store where it has them, with
+      /// each value it lacks taken from the samweb MetaData of filename.
+      const RunConditions& ConditionsForRun(int run, std::string const& filename);
+
       // service providers we depend on;
       // in principle could be replaced by a single providerpacl_type.
       const detinfo::LArProperties* fLP;
@@ -328,6 +361,9 @@ namespace spdp{
       bool                        fGetHVDriftfromMetaData;
       bool                        fGetReadOutWindowSizefromMetaData;
       bool                        fUseRunDependentTemperature;
+      std::unique_ptr<RunConditionsStore> fRunConditions; ///< run conditions from the store or the MetaData
+      std::unique_ptr<DriftVelocityTable> fDriftVelocityTable; ///< drift velocity table, if requested
+      RunConditions               fConditions;      ///< conditions of the last run looked up
       double                         fHV_cath;   //  <KV
       std::vector<double>          fEfield;           ///< kV/cm (per inter-plane volume)
       double                         fElectronlifetime; ///< microseconds
@@ -0,0 +1,131 @@
+// DriftRecombination.cxx
+
+#include "DriftRecombination.h"
+#include <algorithm>
+
+namespace {
+
+// Upper end of the low-field branch [kV/cm].
+double lowFieldLimit(double temperature) {
+  double tshift = -87.203+temperature;
+  return 0.0938163-0.0052563*tshift-0.0001470*tshift*tshift;
+}
+
+// Drift velocity [mm/us] above the low-field branch.
+double highFieldVelocity(double efield, double temperature) {
+  double vd;
+  // Icarus Parameter Set, use as default
+  double  P1 = -0.04640; // K^-1
+  double  P2 = 0.01712;  // K^-1
+  double  P3 = 1.88125;   // (kV/cm)^-1
+  double  P4 =  0.99408;    // kV/cm
+  double  P5 =  0.01172;   // (kV/cm)^-P6
+  double  P6 =  4.20214;
+  double  T0 =  105.749;  // K
+  // Walkowiak Parameter Set
+  double    P1W = -0.01481; // K^-1
+  double  P2W = -0.0075;  // K^-1
+  double   P3W =  0.141;   // (kV/cm)^-1
+  double   P4W =  12.4;    // kV/cm
+  double   P5W =  1.627;   // (kV/cm)^-P6
+  double   P6W =  0.317;
+  double   T0W =  90.371;  // K
+  // From Craig Thorne . . . currently not documented
+  // smooth transition from linear at small fields to
+  //     icarus fit at most fields to Walkowiak at very high fields
+  if (efield<0.619) {
+    vd = ((P1*(temperature-T0)+1)
+          *(P3*efield*std::log(1+P4/efield) + P5*std::pow(efield,P6))
+          +P2*(temperature-T0));
+  }
+  else if (efield<0.699) {
+    vd = 12.5*(efield-0.619)*((P1W*(temperature-T0W)+1)
+                              *(P3W*efield*std::log(1+P4W/efield) + P5W*std::pow(efield,P6W))
+                              +P2W*(temperature-T0W))+
+      12.5*(0.699-efield)*((P1*(temperature-T0)+1)
+                           *(P3*efield*std::log(1+P4/efield) + P5*std::pow(efield,P6))
+                           +P2*(temperature-T0));
+  }
+  else {
+    vd = ((P1W*(temperature-T0W)+1)
+          *(P3W*efield*std::log(1+P4W/efield) + P5W*std::pow(efield,P6W))
+          +P2W*(temperature-T0W));
+  }
+  return vd;
+}
+
+}  // end unnamed namespace
+
+namespace spdp {
+
+//**********************************************************************
+
+double driftVelocityParam(double efield, double temperature) {
+  // Drift Velocity as a function of Electric Field and LAr Temperature
+  // from : W. Walkowiak, NIM A 449 (2000) 288-294
+  double tshift = -87.203+temperature;
+  double xFit = lowFieldLimit(temperature);
+  double uFit = 5.18406+0.01448*tshift-0.003497*tshift*tshift-0.000516*tshift*tshift*tshift;
+  double vd;
+  if (efield < xFit) vd=efield*uFit;
+  else vd = highFieldVelocity(efield, temperature);
+  vd /= 10.;
+  return vd; // in cm/us
+}
+
+//**********************************************************************
+
+DriftVelocityTable::DriftVelocityTable(double emax, double estep, double tmin, double tmax)
+: m_emax(emax), m_estep(estep), m_tmin(tmin), m_tmax(tmax),
+  m_first(std::floor(0.05/estep)) {
+  size_t last = std::max(size_t(std::ceil(emax/estep - 1.e-6)), m_first + 1);
+  size_t nnode = last + 1 - m_first;
+  m_vel.resize(nnode);
+  m_slope.resize(nnode);
+  for ( size_t inod=0; inod<nnode; ++inod ) {
+    double efield = (m_first + inod)*m_estep;
+    double vlo = highFieldVelocity(efield, m_tmin)/10.;
+    double vhi = highFieldVelocity(efield, m_tmax)/10.;
+    m_vel[inod] = vlo;
+    m_slope[inod] = (vhi - vlo)/(m_tmax - m_tmin);
+  }
+  const double temps[3] = {m_tmin, 0.5*(m_tmin + m_tmax), m_tmax};
+  for ( double temperature : temps ) {
+    for ( size_t inod=0; inod+1<nnode; ++inod ) {
+      double efield = (m_first + inod + 0.5)*m_estep;
+      if ( efield > m_emax || efield < lowFieldLimit(temperature) ) continue;
+      double exact = driftVelocityParam(efield, temperature);
+      double err = std::fabs((*this)(efield, temperature) - exact)/std::fabs(exact);
+      m_maxRelError = std::max(m_maxRelError, err);
+    }
+  }
+}
+
+//**********************************************************************
+
+double DriftVelocityTable::operator()(double efield, double temperature) const {
+  if ( efield < lowFieldLimit(temperature) ) return driftVelocityParam(efield, temperature);
+  double x = efield/m_estep - m_first;
+  if ( x < 0.0 ) return driftVelocityParam(efield, temperature);
+  size_t inod = std::min(size_t(x), m_vel.size() - 2);
+  double frac = x - inod;
+  double vel = m_vel[inod] + frac*(m_vel[inod+1] - m_vel[inod]);
+  double slope = m_slope[inod] + frac*(m_slope[inod+1] - m_slope[inod]);
+  return vel + (temperature - m_tmin)*slope;
+}
+
+//**********************************************************************
+
+void ModBoxRecombination::dEdx(const double* dQdx, double* out, size_t n) const {
+  for ( size_t i=0; i<n; ++i ) out[i] = (std::exp(m_betaWion*dQdx[i]) - m_alpha)/m_beta;
+}
+
+//**********************************************************************
+
+void BirksRecombination::dEdx(const double* dQdx, double* out, size_t n) const {
+  for ( size_t i=0; i<n; ++i ) out[i] = dQdx[i]/(m_a - m_b*dQdx[i]);
+}
+
+//**********************************************************************
+
+}  // end namespace spdp
@@ -0,0 +1,118 @@
+// DriftRecombination.h
+//
+// Drift velocity and recombination corrections used by
+// DetectorPropertiesProtoDUNEsp, without the framework.
+//
+// driftVelocityParam evaluates the drift velocity parametrization. Range
+// warnings are left to the caller.
+//
+// DriftVelocityTable interpolates the same parametrization over E-field and
+// temperature. Above the low-field branch the parametrization is linear in
+// temperature. The table therefore keeps, at each E-field node, the
+// velocity at the lowest temperature and its temperature slope. Only the
+// E-field is interpolated, linearly, on nodes that include the branch
+// boundaries at 0.619 and 0.699 kV/cm. The low-field branch is evaluated
+// directly. The largest relative error, found at the midpoints between the
+// nodes when the table is built, is reported by maxRelError().
+//
+// ModBoxRecombination and BirksRecombination hold the constants of the
+// corrections for one E-field and density. They convert a dQ/dx or a block
+// of them with the same arithmetic as the single-value corrections.
+
+#ifndef DriftRecombination_H
+#define DriftRecombination_H
+
+#include <cmath>
+#include <cstddef>
+#include <vector>
+
+namespace spdp {
+
+// Electron drift velocity in LAr [cm/us] for efield [kV/cm] and
+// temperature [K].
+double driftVelocityParam(double efield, double temperature);
+
+class DriftVelocityTable {
+
+public:
+
+  // Table for E-fields up to emax [kV/cm] with node spacing estep and
+  // temperatures in [tmin, tmax] [K]. The nodes are at multiples of estep
+  // from the first one at or below 0.05 kV/cm, which is below the low-field
+  // branch over the whole temperature range.
+  DriftVelocityTable(double emax = 4.0, double estep = 0.0005,
+                     double tmin = 87.0, double tmax = 94.0);
+
+  // Whether (efield, temperature) is in the table.
+  bool covers(double efield, double temperature) const {
+    return efield <= m_emax && temperature >= m_tmin && temperature <= m_tmax;
+  }
+
+  // Interpolated drift velocity [cm/us]. Only for points the table covers.
+  double operator()(double efield, double temperature) const;
+
+  // Largest relative difference from driftVelocityParam at the node
+  // midpoints, for the lowest, middle and highest temperatures.
+  double maxRelError() const { return m_maxRelError; }
+
+  size_t size() const { return m_vel.size(); }
+
+private:
+
+  double m_emax;
+  double m_estep;
+  double m_tmin;
+  double m_tmax;
+  size_t m_first;                // index of the first node, at m_first*m_estep
+  std::vector<double> m_vel;     // velocity at m_tmin
+  std::vector<double> m_slope;   // velocity change per kelvin
+  double m_maxRelError = 0.0;
+
+};
+
+// Modified box model: dE/dx [MeV/cm] for dQ/dx [electrons/cm].
+class ModBoxRecombination {
+
+public:
+
+  // A and B are the model parameters, wion the ionization energy [MeV/e],
+  // rho the density [g/cm^3] and efield [kV/cm].
+  ModBoxRecombination(double A, double B, double wion, double rho, double efield)
+  : m_alpha(A), m_beta(B/(rho*efield)), m_betaWion(m_beta*wion) { }
+
+  double dEdx(double dQdx) const { return (std::exp(m_betaWion*dQdx) - m_alpha)/m_beta; }
+
+  void dEdx(const double* dQdx, double* dEdx, size_t n) const;
+
+private:
+
+  double m_alpha;
+  double m_beta;
+  double m_betaWion;
+
+};
+
+// Birks model: dE/dx [MeV/cm] for dQ/dx [electrons/cm].
+class BirksRecombination {
+
+public:
+
+  // A and k are the model parameters, wion the ionization energy [MeV/e],
+  // rho the density [g/cm^3] and efield [kV/cm].
+  BirksRecombination(double A, double k, double wion, double rho, double efield)
+  : m_a(A/wion), m_b(k/rho/efield) { }
+
+  double dEdx(double dQdx) const { return dQdx/(m_a - m_b*dQdx); }
+
+  void dEdx(const double* dQdx, double* dEdx, size_t n) const;
+
+private:
+
+  double m_a;
+  double m_b;
+
+};
+
+}  // end namespace spdp
+
+#endif
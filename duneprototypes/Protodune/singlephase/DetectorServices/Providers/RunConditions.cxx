@@ -0,0 +1,292 @@
+// RunConditions.cxx
+
+#include "RunConditions.h"
+#include <algorithm>
+#include <cctype>
+#include <cstdio>
+#include <cstdlib>
+#include <sstream>
+#include <stdexcept>
+
+using std::string;
+using std::vector;
+using std::runtime_error;
+
+namespace {
+
+const char* header = "# run  hv[kV]  readout_window[ms]  temperature[K]  efield[kV/cm]";
+
+// Shortest text that reads back as x.
+string formatValue(double x) {
+  if ( std::isnan(x) ) return "-";
+  char buf[32];
+  for ( int prec=6; prec<=17; ++prec ) {
+    std::snprintf(buf, sizeof(buf), "%.*g", prec, x);
+    if ( std::strtod(buf, nullptr) == x ) break;
+  }
+  return buf;
+}
+
+// Whole-word number, or NaN for "-".
+bool parseValue(const string& word, double& x) {
+  if ( word == "-" ) {
+    x = std::numeric_limits<double>::quiet_NaN();
+    return true;
+  }
+  char* end = nullptr;
+  x = std::strtod(word.c_str(), &end);
+  return !word.empty() && *end == '\0' && !std::isnan(x);
+}
+
+bool isComment(const string& line) {
+  size_t pos = line.find_first_not_of(" \t\r");
+  return pos == string::npos || line[pos] == '#';
+}
+
+// Run number of a store line, read without parsing the rest.
+bool lineRun(const string& line, int& run) {
+  std::istringstream ssin(line);
+  string word;
+  if ( !(ssin >> word) ) return false;
+  char* end = nullptr;
+  long val = std::strtol(word.c_str(), &end, 10);
+  if ( *end != '\0' || val < 0 || val > std::numeric_limits<int>::max() ) return false;
+  run = val;
+  return true;
+}
+
+}  // end unnamed namespace
+
+namespace spdp {
+
+//**********************************************************************
+
+string formatRunConditions(const RunConditions& rc) {
+  std::ostringstream sout;
+  sout << rc.run << " " << formatValue(rc.hv) << " " << formatValue(rc.readoutWindow)
+       << " " << formatValue(rc.temperature) << " ";
+  if ( rc.efield.empty() ) sout << "-";
+  for ( size_t igap=0; igap<rc.efield.size(); ++igap ) {
+    if ( igap ) sout << ",";
+    sout << formatValue(rc.efield[igap]);
+  }
+  return sout.str();
+}
+
+//**********************************************************************
+
+bool parseRunConditions(const string& line, RunConditions& rc) {
+  std::istringstream ssin(line);
+  string srun, shv, swin, stem, sefi, extra;
+  if ( !(ssin >> srun >> shv >> swin >> stem >> sefi) || (ssin >> extra) ) return false;
+  RunConditions out;
+  if ( !lineRun(srun, out.run) ) return false;
+  if ( !parseValue(shv, out.hv) ) return false;
+  if ( !parseValue(swin, out.readoutWindow) ) return false;
+  if ( !parseValue(stem, out.temperature) ) return false;
+  if ( sefi != "-" ) {
+    std::istringstream sefin(sefi);
+    string sval;
+    while ( std::getline(sefin, sval, ',') ) {
+      double val;
+      if ( sval == "-" || !parseValue(sval, val) ) return false;
+      out.efield.push_back(val);
+    }
+    if ( out.efield.empty() || sefi.back() == ',' ) return false;
+  }
+  rc = std::move(out);
+  return true;
+}
+
+//**********************************************************************
+
+bool runConditionsFromMetadata(const string& metadata, RunConditions& rc) {
+  bool found = false;
+  string run_str = "Runs: ";
+  size_t n1 = metadata.find(run_str);
+  if ( n1 != string::npos ) {
+    n1 += run_str.length();
+    size_t n2 = metadata.find(".", n1);
+    rc.run = std::stoi(metadata.substr(n1, n2-n1));
+    found = true;
+  }
+  string hv_str = "detector.hv_value: ";
+  n1 = metadata.find(hv_str);
+  if ( n1 != string::npos ) {
+    n1 += hv_str.length();
+    size_t n2 = metadata.find("\n", n1);
+    rc.hv = std::stod(metadata.substr(n1, n2-n1));
+    found = true;
+  }
+  string window_str = "DUNE_data.readout_window: ";
+  n1 = metadata.find(window_str);
+  if ( n1 != string::npos ) {
+    n1 += window_str.length();
+    size_t n2 = metadata.find("\n", n1);
+    rc.readoutWindow = std::stod(metadata.substr(n1, n2-n1));
+    found = true;
+  }
+  return found;
+}
+
+//**********************************************************************
+
+int runFromFileName(const string& fname) {
+  size_t start = fname.rfind("/");
+  start = start == string::npos ? 0 : start + 1;
+  for ( size_t pos = fname.find("run", start); pos != string::npos; pos = fname.find("run", pos + 1) ) {
+    // "run" must start a field, so that e.g. "rerun1" is not taken for run 1.
+    if ( pos > start && fname[pos - 1] != '_' && fname[pos - 1] != '-' && fname[pos - 1] != '.' ) continue;
+    size_t ndig = 0;
+    while ( pos + 3 + ndig < fname.size() && std::isdigit(static_cast<unsigned char>(fname[pos + 3 + ndig])) ) ++ndig;
+    if ( ndig > 0 && ndig < 10 ) return std::stoi(fname.substr(pos + 3, ndig));
+  }
+  return -1;
+}
+
+//**********************************************************************
+
+bool runTemperature(int run, double& temperature) {
+  // Before 11/17/18, temperature = 87.68 and is stable
+  // Between 11/17/18 and 3/1/19, temperature = 87.36 and has a rather large fluctuation. first run in this period 5903
+  // After 3/1/19, temperature = 87.65 and is stable.  first run 6930
+  if ( run > 5903 && run < 6930 ) {
+    temperature = 87.36;
+    return true;
+  }
+  if ( run >= 6930 ) {
+    temperature = 87.65;
+    return true;
+  }
+  return false;
+}
+
+//**********************************************************************
+
+vector<double> planeGapFields(double hv, int run) {
+  double Gplane_bias=(-0.665);
+  double Uplane_bias=(-0.370);
+  double Vplane_bias=0;
+  double Xplane_bias=(0.820);
+  vector<double> efield = {hv/360, std::fabs(Gplane_bias-Uplane_bias)/0.47625,
+                           std::fabs(Uplane_bias-Vplane_bias)/0.47625, std::fabs(Vplane_bias-Xplane_bias)/0.47625};
+  if ( std::abs(hv-180) < 1e-6 ) {
+    // Use the corrected E field from Flavio, Francesco and Stefania
+    // Ref: https://indico.fnal.gov/event/20939/contribution/1/material/slides/0.pdf
+    if ( run < 6725 ) {  // first run in Feb 8, 2019
+      efield[0] = 0.4867;
+    } else {
+      efield[0] = 0.4995;
+    }
+  }
+  return efield;
+}
+
+//**********************************************************************
+
+RunConditionsStore::RunConditionsStore(size_t cacheSize)
+: m_capacity(std::max(cacheSize, size_t(1))) { }
+
+//**********************************************************************
+
+RunConditionsStore::RunConditionsStore(const string& fname, size_t cacheSize)
+: m_fname(fname), m_file(fname), m_capacity(std::max(cacheSize, size_t(1))) {
+  if ( !m_file ) throw runtime_error("RunConditionsStore: unable to open " + fname);
+  string line;
+  int iline = 0;
+  std::streamoff pos = m_file.tellg();
+  while ( std::getline(m_file, line) ) {
+    ++iline;
+    if ( !isComment(line) ) {
+      int run = -1;
+      if ( !lineRun(line, run) ) {
+        throw runtime_error("RunConditionsStore: invalid line " + std::to_string(iline) + " in " + fname);
+      }
+      m_index.emplace_back(run, pos);
+    }
+    pos = m_file.tellg();
+  }
+  m_file.clear();
+  // The last line of a run is the one used.
+  std::stable_sort(m_index.begin(), m_index.end(),
+                   [](const auto& lhs, const auto& rhs) { return lhs.first < rhs.first; });
+  auto last = std::unique(m_index.rbegin(), m_index.rend(),
+                          [](const auto& lhs, const auto& rhs) { return lhs.first == rhs.first; });
+  m_index.erase(m_index.begin(), last.base());
+}
+
+//**********************************************************************
+
+const RunConditions* RunConditionsStore::find(int run) {
+  auto icac = m_cached.find(run);
+  if ( icac != m_cached.end() ) {
+    m_lru.splice(m_lru.begin(), m_lru, icac->second);
+    ++m_nhit;
+    return &m_lru.front();
+  }
+  auto iind = std::lower_bound(m_index.begin(), m_index.end(), run,
+                               [](const auto& ent, int r) { return ent.first < r; });
+  if ( iind == m_index.end() || iind->first != run ) return nullptr;
+  m_file.clear();
+  m_file.seekg(iind->second);
+  string line;
+  RunConditions rc;
+  if ( !std::getline(m_file, line) || !parseRunConditions(line, rc) ) {
+    throw runtime_error("RunConditionsStore: invalid line for run " + std::to_string(run) + " in " + m_fname);
+  }
+  ++m_nread;
+  return cache(rc);
+}
+
+//**********************************************************************
+
+void RunConditionsStore::insert(const RunConditions& rc) {
+  cache(rc);
+}
+
+//**********************************************************************
+
+const RunConditions* RunConditionsStore::cache(const RunConditions& rc) {
+  auto icac = m_cached.find(rc.run);
+  if ( icac != m_cached.end() ) {
+    *icac->second = rc;
+    m_lru.splice(m_lru.begin(), m_lru, icac->second);
+    return &m_lru.front();
+  }
+  if ( m_lru.size() >= m_capacity ) {
+    m_cached.erase(m_lru.back().run);
+    m_lru.pop_back();
+  }
+  m_lru.push_front(rc);
+  m_cached[rc.run] = m_lru.begin();
+  return &m_lru.front();
+}
+
+//**********************************************************************
+
+void RunConditionsStore::write(const string& fname, vector<RunConditions> rcs) {
+  std::stable_sort(rcs.begin(), rcs.end(),
+                   [](const RunConditions& lhs, const RunConditions& rhs) { return lhs.run < rhs.run; });
+  auto last = std::unique(rcs.rbegin(), rcs.rend(),
+                          [](const RunConditions& lhs, const RunConditions& rhs) { return lhs.run == rhs.run; });
+  rcs.erase(rcs.begin(), last.base());
+  std::ofstream fout(fname);
+  if ( !fout ) throw runtime_error("RunConditionsStore: unable to open " + fname + " for writing");
+  fout << header << "\n";
+  for ( const RunConditions& rc : rcs ) fout << formatRunConditions(rc) << "\n";
+  fout.close();
+  if ( !fout ) throw runtime_error("RunConditionsStore: error writing " + fname);
+}
+
+//**********************************************************************
+
+vector<RunConditions> RunConditionsStore::readAll(const string& fname) {
+  RunConditionsStore store(fname, 1);
+  vector<RunConditions> rcs;
+  for ( const auto& ent : store.m_index ) rcs.push_back(*store.find(ent.first));
+  return rcs;
+}
+
+//**********************************************************************
+
+}  // end namespace spdp
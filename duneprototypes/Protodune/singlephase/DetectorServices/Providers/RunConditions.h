@@ -0,0 +1,135 @@
+// RunConditions.h
+//
+// Run conditions used by DetectorPropertiesProtoDUNEsp: the cathode HV, the
+// E-fields in the plane gaps, the readout window and the argon temperature.
+//
+// RunConditionsStore reads a flat text file with one run per line:
+//
+//   # run  hv[kV]  readout_window[ms]  temperature[K]  efield[kV/cm]
+//   5387   180     3                   87.68           0.4867,0.6194,0.7769,1.7218
+//
+// The E-fields are the comma-separated fields in the plane gaps, as in the
+// Efield parameter. A "-" marks a value that is not known, e.g. a run with
+// no HV entry in its metadata. Lines starting with '#' are comments. If a
+// run appears more than once, the last line is used, so runs can be
+// appended to a store to update it.
+//
+// The file is indexed by run when the store is opened, and a line is only
+// parsed when its run is first asked for. Parsed runs are kept in a small
+// LRU cache together with runs added by the caller from other sources (the
+// samweb metadata), so a job reading many files of the same run looks its
+// conditions up only once. Runs are looked up by the run number of the data,
+// not one guessed from a file name.
+//
+// makeRunConditionsStore fills a store from the samweb metadata of a list
+// of files.
+
+#ifndef RunConditions_H
+#define RunConditions_H
+
+#include <cmath>
+#include <cstddef>
+#include <fstream>
+#include <limits>
+#include <list>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace spdp {
+
+struct RunConditions {
+  int run = -1;
+  double hv = std::numeric_limits<double>::quiet_NaN();             // cathode HV [kV]
+  double readoutWindow = std::numeric_limits<double>::quiet_NaN();  // [ms]
+  double temperature = std::numeric_limits<double>::quiet_NaN();    // [K]
+  std::vector<double> efield;                                       // [kV/cm], empty if not known
+
+  bool hasHV() const { return !std::isnan(hv); }
+  bool hasReadoutWindow() const { return !std::isnan(readoutWindow); }
+  bool hasTemperature() const { return !std::isnan(temperature); }
+  bool hasEfield() const { return !efield.empty(); }
+};
+
+// Line of a store for rc, without the end of line.
+std::string formatRunConditions(const RunConditions& rc);
+
+// Parse a store line. Returns false if it is not a valid line.
+bool parseRunConditions(const std::string& line, RunConditions& rc);
+
+// Run number, HV and readout window from the samweb metadata text of a file
+// (the "Runs:", "detector.hv_value:" and "DUNE_data.readout_window:"
+// entries). The other values are left unknown. Returns false if none of
+// them is found.
+bool runConditionsFromMetadata(const std::string& metadata, RunConditions& rc);
+
+// Run number in a file name, e.g. 5387 for np04_raw_run005387_0041_dl7.root,
+// or -1 if the base name has no field starting with "run" followed by
+// digits. A field starts the base name or follows '_', '-' or '.'. The name
+// is only a hint: the run of the data is the art run or the metadata run.
+int runFromFileName(const std::string& fname);
+
+// ProtoDUNE-SP argon temperature for a run, for the runs after November 17
+// 2018 when it differed from the configured value. Returns false for the
+// other runs.
+bool runTemperature(int run, double& temperature);
+
+// ProtoDUNE-SP E-fields in the four plane gaps for a cathode HV [kV]. At the
+// nominal 180 kV the drift field is the measured one for the run.
+std::vector<double> planeGapFields(double hv, int run);
+
+class RunConditionsStore {
+
+public:
+
+  // A store with only the cache.
+  explicit RunConditionsStore(size_t cacheSize = 64);
+
+  // Index fname. Throws std::runtime_error if it cannot be read or has a
+  // line that does not start with a run number. The rest of a line is
+  // checked when it is parsed, and find throws if it is not valid.
+  explicit RunConditionsStore(const std::string& fname, size_t cacheSize = 64);
+
+  RunConditionsStore(const RunConditionsStore&) = delete;
+  RunConditionsStore& operator=(const RunConditionsStore&) = delete;
+
+  // Conditions for a run, nullptr if neither the cache nor the file has it.
+  // The pointer is valid until the next call to find or insert.
+  const RunConditions* find(int run);
+
+  // Add or replace the conditions of rc.run in the cache.
+  void insert(const RunConditions& rc);
+
+  const std::string& fileName() const { return m_fname; }
+  size_t fileRunCount() const { return m_index.size(); }
+  size_t cacheCount() const { return m_lru.size(); }
+
+  // Number of lookups answered from the cache and from the file.
+  size_t cacheHits() const { return m_nhit; }
+  size_t fileReads() const { return m_nread; }
+
+  // Write rcs sorted by run to fname. Throws std::runtime_error on failure.
+  static void write(const std::string& fname, std::vector<RunConditions> rcs);
+
+  // Read every run in fname. Throws as the constructor.
+  static std::vector<RunConditions> readAll(const std::string& fname);
+
+private:
+
+  const RunConditions* cache(const RunConditions& rc);
+
+  std::string m_fname;
+  std::ifstream m_file;
+  std::vector<std::pair<int, std::streamoff>> m_index;  // sorted by run
+  size_t m_capacity;
+  std::list<RunConditions> m_lru;  // most recent first
+  std::unordered_map<int, std::list<RunConditions>::iterator> m_cached;
+  size_t m_nhit = 0;
+  size_t m_nread = 0;
+
+};
+
+}  // end namespace spdp
+
+#endif
@@ -0,0 +1,101 @@
+// makeRunConditionsStore.cxx
+//
+// Fill a run conditions store (see RunConditions.h) from the samweb
+// metadata of a list of files.
+//
+// Usage: makeRunConditionsStore STORE FILE [FILE ...]
+//
+// A FILE of "-" reads the file names from standard input, one per line.
+// The metadata is fetched once per run: files whose name gives a run that
+// is already done are skipped. A run parsed from a file name is only
+// trusted once the metadata of that file has confirmed it. If STORE exists, its runs are kept and
+// those found here are added or replaced.
+//
+// The HV and readout window come from the metadata. The temperature and
+// E-fields are the ones DetectorPropertiesProtoDUNEsp derives for the run,
+// and may be edited afterwards, e.g. to put in measured values.
+
+#include "RunConditions.h"
+#include "ifdh.h"
+
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <string>
+#include <vector>
+
+using std::string;
+using std::vector;
+using std::cout;
+using std::cerr;
+using std::endl;
+using spdp::RunConditions;
+using spdp::RunConditionsStore;
+
+//**********************************************************************
+
+int main(int argc, char** argv) {
+  const string myname = "makeRunConditionsStore: ";
+  if ( argc < 3 || string(argv[1]) == "-h" ) {
+    cout << "Usage: " << argv[0] << " STORE FILE [FILE ...]" << endl;
+    cout << "  Adds the run conditions from the samweb metadata of the files to STORE." << endl;
+    cout << "  A FILE of - reads the file names from standard input." << endl;
+    return argc == 2 ? 0 : 1;
+  }
+  string storename = argv[1];
+  vector<string> fnames;
+  for ( int iarg=2; iarg<argc; ++iarg ) {
+    string arg = argv[iarg];
+    if ( arg == "-" ) {
+      string line;
+      while ( std::getline(std::cin, line) ) if ( line.size() ) fnames.push_back(line);
+    } else {
+      fnames.push_back(arg);
+    }
+  }
+  std::map<int, RunConditions> runs;
+  if ( std::ifstream(storename).good() ) {
+    try {
+      for ( const RunConditions& rc : RunConditionsStore::readAll(storename) ) runs[rc.run] = rc;
+    } catch ( const std::exception& e ) {
+      cerr << myname << "ERROR: " << e.what() << endl;
+      return 2;
+    }
+    cout << myname << "Read " << runs.size() << " runs from " << storename << endl;
+  }
+  std::map<int, bool> done;
+  ifdh_ns::ifdh fetcher;
+  unsigned int nfetch = 0;
+  for ( const string& fname : fnames ) {
+    int run = spdp::runFromFileName(fname);
+    if ( run >= 0 && done.count(run) ) continue;
+    string basename = fname.substr(fname.rfind("/") == string::npos ? 0 : fname.rfind("/") + 1);
+    string metadata = fetcher.getMetadata(basename);
+    ++nfetch;
+    RunConditions rc;
+    if ( ! spdp::runConditionsFromMetadata(metadata, rc) || rc.run < 0 ) {
+      cerr << myname << "WARNING: No run number in the metadata of " << basename << endl;
+      continue;
+    }
+    double temperature = 0.0;
+    if ( spdp::runTemperature(rc.run, temperature) ) rc.temperature = temperature;
+    if ( rc.hasHV() ) rc.efield = spdp::planeGapFields(rc.hv, rc.run);
+    runs[rc.run] = rc;
+    done[rc.run] = true;
+    if ( run >= 0 && run != rc.run ) {
+      cerr << myname << "WARNING: " << basename << " is for run " << rc.run << ", not the "
+           << run << " in its name" << endl;
+    }
+  }
+  vector<RunConditions> rcs;
+  for ( const auto& ent : runs ) rcs.push_back(ent.second);
+  try {
+    RunConditionsStore::write(storename, rcs);
+  } catch ( const std::exception& e ) {
+    cerr << myname << "ERROR: " << e.what() << endl;
+    return 3;
+  }
+  cout << myname << "Wrote " << rcs.size() << " runs to " << storename << " after "
+       << nfetch << " metadata queries for " << fnames.size() << " files" << endl;
+  return 0;
+}
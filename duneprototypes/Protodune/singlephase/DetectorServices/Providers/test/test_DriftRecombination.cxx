@@ -0,0 +1,119 @@
+// test_DriftRecombination.cxx
+//
+// Check the drift velocity table against the parametrization within the
+// error it reports, and the block recombination corrections against the
+// single-value formulas of DetectorPropertiesProtoDUNEsp.
+
+#include <string>
+#include <iostream>
+#include <random>
+#include <vector>
+#include <cmath>
+#include <algorithm>
+#include "duneprototypes/Protodune/singlephase/DetectorServices/Providers/DriftRecombination.h"
+
+#undef NDEBUG
+#include <cassert>
+
+using std::string;
+using std::cout;
+using std::endl;
+using std::vector;
+using spdp::DriftVelocityTable;
+using spdp::ModBoxRecombination;
+using spdp::BirksRecombination;
+
+//**********************************************************************
+
+int test_DriftRecombination(unsigned int npoint) {
+  const string myname = "test_DriftRecombination: ";
+#ifdef NDEBUG
+  cout << myname << "NDEBUG must be off." << endl;
+  abort();
+#endif
+  string line = "-----------------------------";
+  std::mt19937 gen(20241018);
+
+  cout << myname << line << endl;
+  cout << myname << "Drift velocity table." << endl;
+  DriftVelocityTable tab;
+  cout << myname << "  Nodes: " << tab.size() << ", reported error: " << tab.maxRelError() << endl;
+  assert( tab.maxRelError() > 0.0 );
+  assert( tab.maxRelError() < 1.e-5 );
+  assert( tab.covers(0.5, 87.0) && tab.covers(4.0, 94.0) );
+  assert( ! tab.covers(4.01, 88.0) );
+  assert( ! tab.covers(0.5, 86.9) && ! tab.covers(0.5, 94.1) );
+  // ProtoDUNE-SP values.
+  for ( double efield : {0.4867, 0.4995, 0.5} ) {
+    for ( double temp : {87.36, 87.65, 87.68} ) {
+      double exact = spdp::driftVelocityParam(efield, temp);
+      assert( std::fabs(tab(efield, temp) - exact) <= tab.maxRelError()*exact );
+    }
+  }
+  // Random points, including the branch boundaries.
+  std::uniform_real_distribution<double> efields(0.0, 4.0);
+  std::uniform_real_distribution<double> temps(87.0, 94.0);
+  double maxerr = 0.0;
+  for ( unsigned int ipt=0; ipt<npoint; ++ipt ) {
+    double efield = ipt % 100 == 0 ? 0.619 + 0.0001*(ipt % 3) : efields(gen);
+    double temp = temps(gen);
+    double exact = spdp::driftVelocityParam(efield, temp);
+    double err = std::fabs(tab(efield, temp) - exact)/std::fabs(exact);
+    maxerr = std::max(maxerr, err);
+  }
+  cout << myname << "  Largest error at " << npoint << " points: " << maxerr << endl;
+  assert( maxerr <= 1.01*tab.maxRelError() );
+  // The low-field branch is not interpolated.
+  for ( double efield : {-0.1, 0.01, 0.04, 0.06} ) {
+    assert( tab(efield, 87.0) == spdp::driftVelocityParam(efield, 87.0) );
+  }
+
+  cout << myname << line << endl;
+  cout << myname << "Recombination." << endl;
+  const double wion = 1000./4.237e7;
+  const double rho = -0.00615*87.68 + 1.928;
+  std::uniform_real_distribution<double> charges(1.e3, 5.e5);
+  vector<double> dqdx(npoint/10 + 3);
+  for ( double& q : dqdx ) q = charges(gen);
+  for ( double efield : {0.4867, 0.5} ) {
+    ModBoxRecombination modbox(0.93, 0.212, wion, rho, efield);
+    BirksRecombination birks(0.800, 0.0486, wion, rho, efield);
+    vector<double> demod(dqdx.size());
+    vector<double> debir(dqdx.size());
+    modbox.dEdx(dqdx.data(), demod.data(), dqdx.size());
+    birks.dEdx(dqdx.data(), debir.data(), dqdx.size());
+    for ( size_t i=0; i<dqdx.size(); ++i ) {
+      // As DetectorPropertiesProtoDUNEsp computed them.
+      double beta = 0.212/(rho*efield);
+      double expmod = (exp(beta*wion*dqdx[i]) - 0.93)/beta;
+      double k3t = 0.0486;
+      k3t /= rho;
+      double expbir = dqdx[i]/(0.800/wion - k3t/efield*dqdx[i]);
+      assert( modbox.dEdx(dqdx[i]) == expmod );
+      assert( demod[i] == expmod );
+      assert( birks.dEdx(dqdx[i]) == expbir );
+      assert( debir[i] == expbir );
+    }
+  }
+
+  cout << myname << line << endl;
+  cout << myname << "Done." << endl;
+  return 0;
+}
+
+//**********************************************************************
+
+int main(int argc, char* argv[]) {
+  unsigned int npoint = 100000;
+  if ( argc > 1 ) {
+    string sarg(argv[1]);
+    if ( sarg == "-h" ) {
+      cout << "Usage: " << argv[0] << " [NPOINT]" << endl;
+      return 0;
+    }
+    npoint = std::stoi(sarg);
+  }
+  return test_DriftRecombination(npoint);
+}
+
+//**********************************************************************
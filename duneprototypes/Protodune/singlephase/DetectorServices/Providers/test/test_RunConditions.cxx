@@ -0,0 +1,211 @@
+// test_RunConditions.cxx
+//
+// Check the run conditions store: write and read back, lookups through the
+// LRU cache, updates by appended lines and rejection of invalid files. Also
+// check the metadata and file name parsing used by
+// DetectorPropertiesProtoDUNEsp.
+
+#include <string>
+#include <iostream>
+#include <fstream>
+#include <map>
+#include <vector>
+#include <cmath>
+#include <stdexcept>
+#include "duneprototypes/Protodune/singlephase/DetectorServices/Providers/RunConditions.h"
+
+#undef NDEBUG
+#include <cassert>
+
+using std::string;
+using std::cout;
+using std::endl;
+using std::vector;
+using spdp::RunConditions;
+using spdp::RunConditionsStore;
+
+namespace {
+
+bool same(double x1, double x2) {
+  return (std::isnan(x1) && std::isnan(x2)) || x1 == x2;
+}
+
+bool same(const RunConditions& rc1, const RunConditions& rc2) {
+  return rc1.run == rc2.run && same(rc1.hv, rc2.hv) && same(rc1.readoutWindow, rc2.readoutWindow) &&
+         same(rc1.temperature, rc2.temperature) && rc1.efield == rc2.efield;
+}
+
+bool throws(const string& fname) {
+  try {
+    RunConditionsStore store(fname);
+    store.find(100);
+  } catch ( const std::runtime_error& ) {
+    return true;
+  }
+  return false;
+}
+
+}  // end unnamed namespace
+
+//**********************************************************************
+
+int test_RunConditions(unsigned int nrun) {
+  const string myname = "test_RunConditions: ";
+#ifdef NDEBUG
+  cout << myname << "NDEBUG must be off." << endl;
+  abort();
+#endif
+  string line = "-----------------------------";
+
+  cout << myname << line << endl;
+  cout << myname << "Derived conditions." << endl;
+  double temp = 87.68;
+  assert( ! spdp::runTemperature(5387, temp) );
+  assert( temp == 87.68 );
+  assert( spdp::runTemperature(6000, temp) && temp == 87.36 );
+  assert( spdp::runTemperature(6930, temp) && temp == 87.65 );
+  vector<double> efield = spdp::planeGapFields(180, 5387);
+  assert( efield.size() == 4 );
+  assert( efield[0] == 0.4867 );
+  assert( spdp::planeGapFields(180, 6725)[0] == 0.4995 );
+  assert( spdp::planeGapFields(120, 6725)[0] == 120.0/360 );
+  assert( efield[3] == std::fabs(0 - 0.820)/0.47625 );
+
+  cout << myname << line << endl;
+  cout << myname << "Metadata and file names." << endl;
+  string metadata = "Name: np04_raw_run005387_0041_dl7.root\n"
+                    "Runs: 5387.0001 (protodune-sp)\n"
+                    "detector.hv_value: 180\n"
+                    "DUNE_data.readout_window: 5.0\n";
+  RunConditions rcmd;
+  assert( spdp::runConditionsFromMetadata(metadata, rcmd) );
+  assert( rcmd.run == 5387 );
+  assert( rcmd.hv == 180.0 );
+  assert( rcmd.readoutWindow == 5.0 );
+  assert( ! rcmd.hasTemperature() && ! rcmd.hasEfield() );
+  RunConditions rcnone;
+  assert( ! spdp::runConditionsFromMetadata("Name: x.root\n", rcnone) );
+  assert( rcnone.run == -1 && ! rcnone.hasHV() );
+  assert( spdp::runFromFileName("np04_raw_run005387_0041_dl7.root") == 5387 );
+  assert( spdp::runFromFileName("/pnfs/run123/np04_raw_run005387_0041_dl7_reco1.root") == 5387 );
+  assert( spdp::runFromFileName("/data/run123/np04_hd_001.root") == -1 );
+  assert( spdp::runFromFileName("prunes_run42.root") == 42 );
+  assert( spdp::runFromFileName("np04_rerun1_run005387_0041.root") == 5387 );
+  assert( spdp::runFromFileName("np04_raw_rerun2.root") == -1 );
+  assert( spdp::runFromFileName("run77_np04.root") == 77 );
+
+  cout << myname << line << endl;
+  cout << myname << "Write and read " << nrun << " runs." << endl;
+  std::map<int, RunConditions> runs;
+  vector<RunConditions> rcs;
+  for ( unsigned int irun=0; irun<nrun; ++irun ) {
+    RunConditions rc;
+    rc.run = 5800 + 29*((irun*13) % nrun);
+    if ( irun % 5 ) rc.hv = irun % 3 ? 180.0 : 120.0 + irun/10.0;
+    if ( irun % 4 ) rc.readoutWindow = 3.0;
+    if ( irun % 2 ) spdp::runTemperature(rc.run, rc.temperature);
+    if ( rc.hasHV() ) rc.efield = spdp::planeGapFields(rc.hv, rc.run);
+    rcs.push_back(rc);
+    runs[rc.run] = rc;
+  }
+  // A duplicate: the last one is kept.
+  RunConditions rcdup = rcs.front();
+  rcdup.readoutWindow = 6.0;
+  rcs.push_back(rcdup);
+  runs[rcdup.run] = rcdup;
+  string fname = "test_RunConditions.txt";
+  RunConditionsStore::write(fname, rcs);
+  for ( const RunConditions& rc : rcs ) {
+    RunConditions rcin;
+    assert( spdp::parseRunConditions(spdp::formatRunConditions(rc), rcin) );
+    assert( same(rc, rcin) );
+  }
+  vector<RunConditions> rcsin = RunConditionsStore::readAll(fname);
+  assert( rcsin.size() == runs.size() );
+  for ( const RunConditions& rc : rcsin ) assert( same(rc, runs[rc.run]) );
+
+  cout << myname << line << endl;
+  cout << myname << "Lookups with a cache of 3 runs." << endl;
+  {
+    RunConditionsStore store(fname, 3);
+    assert( store.fileRunCount() == runs.size() );
+    for ( const auto& ent : runs ) {
+      const RunConditions* prc = store.find(ent.first);
+      assert( prc != nullptr && same(*prc, ent.second) );
+      prc = store.find(ent.first);
+      assert( prc != nullptr && same(*prc, ent.second) );
+      assert( store.cacheCount() <= 3 );
+    }
+    assert( store.fileReads() == runs.size() );
+    assert( store.cacheHits() == runs.size() );
+    assert( store.find(4999) == nullptr );
+    // Runs added from the metadata are found, and replace those of the file.
+    RunConditions rcadd = rcmd;
+    rcadd.run = 9999;
+    store.insert(rcadd);
+    assert( store.find(9999) != nullptr && same(*store.find(9999), rcadd) );
+    rcadd.run = runs.begin()->first;
+    store.insert(rcadd);
+    assert( same(*store.find(rcadd.run), rcadd) );
+  }
+
+  cout << myname << line << endl;
+  cout << myname << "Appended update." << endl;
+  {
+    RunConditions rcnew = runs.begin()->second;
+    rcnew.temperature = 88.0;
+    rcnew.efield = {0.5, 0.6, 0.7, 0.8};
+    std::ofstream(fname, std::ios::app) << "# update\n" << spdp::formatRunConditions(rcnew) << "\n";
+    RunConditionsStore store(fname);
+    assert( store.fileRunCount() == runs.size() );
+    assert( same(*store.find(rcnew.run), rcnew) );
+  }
+
+  cout << myname << line << endl;
+  cout << myname << "Cache-only store." << endl;
+  {
+    RunConditionsStore store(2);
+    assert( store.fileRunCount() == 0 );
+    for ( int run=1; run<=3; ++run ) {
+      RunConditions rc;
+      rc.run = run;
+      store.insert(rc);
+    }
+    assert( store.cacheCount() == 2 );
+    assert( store.find(1) == nullptr );
+    assert( store.find(3) != nullptr );
+  }
+
+  cout << myname << line << endl;
+  cout << myname << "Invalid files." << endl;
+  assert( throws("test_RunConditions_missing.txt") );
+  std::ofstream("test_RunConditions_bad1.txt") << "# run hv\nfirst 180 3 - -\n";
+  assert( throws("test_RunConditions_bad1.txt") );
+  std::ofstream("test_RunConditions_bad2.txt") << "100 180 3 -\n";
+  assert( throws("test_RunConditions_bad2.txt") );
+  std::ofstream("test_RunConditions_bad3.txt") << "100 180 3 - 0.5,,0.7\n";
+  assert( throws("test_RunConditions_bad3.txt") );
+  std::ofstream("test_RunConditions_good.txt") << "100 180 3 - 0.5,0.6,0.7,0.8\n";
+  assert( ! throws("test_RunConditions_good.txt") );
+
+  cout << myname << line << endl;
+  cout << myname << "Done." << endl;
+  return 0;
+}
+
+//**********************************************************************
+
+int main(int argc, char* argv[]) {
+  unsigned int nrun = 50;
+  if ( argc > 1 ) {
+    string sarg(argv[1]);
+    if ( sarg == "-h" ) {
+      cout << "Usage: " << argv[0] << " [NRUN]" << endl;
+      return 0;
+    }
+    nrun = std::stoi(sarg);
+  }
+  return test_RunConditions(nrun);
+}
+
+//**********************************************************************
@@ -73,7 +73,8 @@ namespace spdp{
     private:
       std::unique_ptr<spdp::DetectorPropertiesProtoDUNEsp> fProp;
       fhicl::ParameterSet   fPS;       ///< Original parameter set.
-      bool isNewRun;
+      std::string fFileName;          ///< base name of the last file opened
+      unsigned int fInheritedNumberTimeSamples = 0; ///< NumberTimeSamples inherited from that file, 0 if none
       bool fInheritNumberTimeSamples; ///< Flag saying whether to inherit NumberTimeSamples
       
       bool isDetectorPropertiesServiceProtoDUNEsp(const fhicl::ParameterSet& ps) const;
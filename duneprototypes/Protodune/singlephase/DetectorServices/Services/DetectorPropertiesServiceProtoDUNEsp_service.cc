@@ -39,7 +39,6 @@ namespace spdp{
     reg.sPreBeginRun.watch (this, &DetectorPropertiesServiceProtoDUNEsp::preBeginRun);
 
 
-    isNewRun=true;
 /*
     // obtain the required dependency service providers and create our own
     const geo::GeometryCore* geo = lar::providerFrom<geo::Geometry>();
@@ -78,7 +77,6 @@ namespace spdp{
 
     void DetectorPropertiesServiceProtoDUNEsp::preBeginRun(const art::Run& run)
   {
-      isNewRun=true;
       std::cout<<"New run, Num is: "<<run.run()<<" Updating DetectorProperties."<<std::endl;
       // make it into a TTimeStamp
 
@@ -88,6 +86,17 @@ namespace spdp{
       // Between 11/17/18 and 3/1/19, temperature = 87.36 and has a rather large fluctuation. first run in this period 5903
       // After 3/1/19, temperature = 87.65 and is stable.  first run 6930
       fProp->UpdateTemp(run.run());
+
+      // The HV and readout window are looked up by the art run, with the file
+      // opened last for the MetaData (postOpenFile comes before preBeginRun).
+      if(!fFileName.empty()){
+        fProp->UpdateHV(fFileName, run.run()); //update HV value from the run conditions or MetaData (if requested)
+        auto const clockData = art::ServiceHandle<detinfo::DetectorClocksService const>()->DataForJob();
+        fProp->UpdateReadoutWindowSize(clockData, fFileName, run.run()); //update Readout window value
+        // A NumberTimeSamples inherited from the file takes precedence, as it did
+        // when the readout window was set on opening the file.
+        if(fInheritedNumberTimeSamples != 0) fProp->SetNumberTimeSamples(fInheritedNumberTimeSamples);
+      }
     }
 
 
@@ -103,29 +112,21 @@ namespace spdp{
 
 
 
-    // std::cout<<"new run?"<<isNewRun<<std::endl;
-    if(isNewRun){
-
-      auto start = filename.rfind("/"); //finds the final "/"
-      if (start == std::string::npos)
-        {
-          start = 0;
-        }
-      else
-        {
-          start += 1;
-        }
-
-      int end = filename.length(); //last postion
-      std::string filename_s=(filename.substr(start, end-start)); //creates string of just file name, not path
-      // std::cout<<"filename:"<<filename_s<<std::endl;
-      art::ServiceHandle<ifdh_ns::IFDH> ifdh;
-      fProp->UpdateHV(filename_s); //pass file name to be able update HV value from MetaData (if requested)
-      auto const clockData = art::ServiceHandle<detinfo::DetectorClocksService const>()->DataForJob();
-      fProp->UpdateReadoutWindowSize(clockData, filename_s); //update Readout window value from filename
-      isNewRun=false;
+    // The file name is kept for the MetaData lookup in preBeginRun, where the
+    // run is known.
+    auto start = filename.rfind("/"); //finds the final "/"
+    if (start == std::string::npos)
+      {
+        start = 0;
+      }
+    else
+      {
+        start += 1;
+      }
 
-    }
+    int end = filename.length(); //last postion
+    fFileName=(filename.substr(start, end-start)); //creates string of just file name, not path
+    fInheritedNumberTimeSamples=0;
 
 
     // Use this method to figure out whether to inherit configuration
@@ -196,6 +197,7 @@ namespace spdp{
             << "  Configured value:        " << fProp->NumberTimeSamples() << "\n"
             << "  Historical (used) value: " << iNumberTimeSamples << "\n";
           fProp->SetNumberTimeSamples(iNumberTimeSamples);
+          fInheritedNumberTimeSamples = iNumberTimeSamples;
         }
       }
       // Close file.
@@ -0,0 +1,104 @@
+// MonitorFFT.h
+//
+// FFT spectra for the TPC nearline monitors
+// (TpcMonitor, PDHDTPCMonitor).
+//
+// MonitorFFT computes the dB spectra the monitors used to get from
+// TH1::FFT(..., "MAG") one channel at a time: 20*log10(|X_k|/n) for the
+// first n/2 frequencies of an n-sample waveform. One real-to-complex plan is
+// kept for each waveform length, and a batch of waveforms stored one after
+// the other is transformed with it.
+//
+// Making a plan is not thread safe, transforming with it is. Monitors that
+// transform in worker threads give each worker its own MonitorFFT and call
+// prepare() for the lengths they need before the workers start.
+//
+// The spectrum histogram sums are in MonitorSums.h.
+
+#ifndef MonitorFFT_H
+#define MonitorFFT_H
+
+#include <cmath>
+#include <cstddef>
+#include <map>
+#include <sstream>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+#include "TVirtualFFT.h"
+#include "duneprototypes/Protodune/singlephase/NearlineMonitor/MonitorSums.h"
+
+namespace tpc_monitor {
+
+//**********************************************************************
+
+class MonitorFFT {
+
+public:
+
+  MonitorFFT() = default;
+
+  ~MonitorFFT() {
+    for ( auto& plan : m_plans ) delete plan.second;
+  }
+
+  MonitorFFT(const MonitorFFT&) = delete;
+  MonitorFFT& operator=(const MonitorFFT&) = delete;
+
+  MonitorFFT(MonitorFFT&& rhs) : m_plans(std::move(rhs.m_plans)) { rhs.m_plans.clear(); }
+
+  // Spectra of nwav waveforms of nsam samples stored one after the other in
+  // wavs. The nsam/2 values of each spectrum are stored the same way in db.
+  void spectra(const double* wavs, size_t nwav, size_t nsam, std::vector<double>& db) {
+    const size_t nfreq = nsam/2;
+    db.resize(nwav*nfreq);
+    if ( nfreq == 0 ) return;
+    TVirtualFFT* fft = plan(nsam);
+    const double norm = 1.0/double(nsam);
+    for ( size_t iwav=0; iwav<nwav; ++iwav ) {
+      fft->SetPoints(wavs + iwav*nsam);
+      fft->Transform();
+      double* out = &db[iwav*nfreq];
+      for ( size_t ifrq=0; ifrq<nfreq; ++ifrq ) {
+        double re = 0.0;
+        double im = 0.0;
+        fft->GetPointComplex(ifrq, re, im);
+        out[ifrq] = 20*log10(std::sqrt(re*re + im*im)*norm);
+      }
+    }
+  }
+
+  // Make the plan for length nsam now rather than on first use.
+  void prepare(size_t nsam) {
+    if ( nsam/2 > 0 ) plan(nsam);
+  }
+
+  size_t planCount() const { return m_plans.size(); }
+
+private:
+
+  // Plan for length nsam, made on first use. Same type and flag as
+  // TH1::FFT, kept ("K") so that other TVirtualFFT users do not delete it.
+  TVirtualFFT* plan(size_t nsam) {
+    auto iplan = m_plans.find(nsam);
+    if ( iplan != m_plans.end() ) return iplan->second;
+    int n = nsam;
+    TVirtualFFT* fft = TVirtualFFT::FFT(1, &n, "R2C ES K");
+    if ( fft == nullptr ) {
+      std::ostringstream ssmsg;
+      ssmsg << "MonitorFFT: unable to make an FFT of length " << nsam;
+      throw std::runtime_error(ssmsg.str());
+    }
+    m_plans[nsam] = fft;
+    return fft;
+  }
+
+  std::map<size_t, TVirtualFFT*> m_plans;
+
+};
+
+//**********************************************************************
+
+}  // end namespace tpc_monitor
+
+#endif
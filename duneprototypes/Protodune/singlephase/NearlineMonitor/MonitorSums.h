@@ -0,0 +1,391 @@
+// MonitorSums.h
+//
+// Histogram sums for the TPC nearline monitors (TpcMonitor, PDHDTPCMonitor).
+//
+// FixedAxis, Hist1Sum, Hist2Sum, ProfileSum and Profile2Sum hold what
+// TH1::Fill, TH2::Fill, TProfile::Fill and TProfile2D::Fill add to a
+// histogram with fixed bins (contents, sums of squares, entries and
+// statistics, with the same under/overflow rules) in plain arrays. Flush()
+// adds them to the histogram and clears them. Filling the sums and flushing
+// once gives the same histogram as filling it directly.
+//
+// A sum is not shared between threads: each worker fills its own and the
+// sums are flushed one after the other once the workers are done.
+
+#ifndef MonitorSums_H
+#define MonitorSums_H
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <vector>
+
+namespace tpc_monitor {
+
+//**********************************************************************
+
+// Fixed bins as in TAxis: 0 is underflow, nbins+1 is overflow.
+class FixedAxis {
+
+public:
+
+  FixedAxis() = default;
+
+  FixedAxis(int nbins, double xmin, double xmax)
+  : m_nbins(nbins), m_xmin(xmin), m_xmax(xmax) { }
+
+  template<class AXIS>
+  static FixedAxis of(const AXIS* pax) { return FixedAxis(pax->GetNbins(), pax->GetXmin(), pax->GetXmax()); }
+
+  int nbins() const { return m_nbins; }
+
+  // As TAxis::FindBin.
+  int findBin(double x) const {
+    if ( x < m_xmin ) return 0;
+    if ( !(x < m_xmax) ) return m_nbins + 1;
+    return 1 + int(m_nbins*(x - m_xmin)/(m_xmax - m_xmin));
+  }
+
+  bool inRange(int bin) const { return bin > 0 && bin <= m_nbins; }
+
+private:
+
+  int m_nbins = 0;
+  double m_xmin = 0.0;
+  double m_xmax = 1.0;
+
+};
+
+//**********************************************************************
+
+// Fills of a TH1 with contents of type CONTENT (float for TH1F).
+template<class CONTENT>
+class Hist1Sum {
+
+public:
+
+  Hist1Sum() : Hist1Sum(FixedAxis()) { }
+
+  explicit Hist1Sum(const FixedAxis& xax)
+  : m_xax(xax), m_sumw(xax.nbins() + 2, 0) { }
+
+  template<class H>
+  explicit Hist1Sum(const H* ph) : Hist1Sum(FixedAxis::of(ph->GetXaxis())) { }
+
+  // As TH1::Fill(x, w).
+  void fill(double x, double w = 1.0) {
+    const int bin = m_xax.findBin(x);
+    ++m_entries;
+    // The first weighted fill starts the sums of squares, as TH1::Sumw2().
+    if ( w != 1.0 && m_sumw2.empty() ) m_sumw2.assign(m_sumw.begin(), m_sumw.end());
+    if ( ! m_sumw2.empty() ) m_sumw2[bin] += w*w;
+    m_sumw[bin] += CONTENT(w);
+    if ( ! m_xax.inRange(bin) ) return;
+    m_stats[0] += w;
+    m_stats[1] += w*w;
+    m_stats[2] += w*x;
+    m_stats[3] += w*x*x;
+  }
+
+  double entries() const { return m_entries; }
+
+  // Add to histogram ph, which has the binning of this sum, and clear.
+  // The fills are dropped if ph is null.
+  template<class H>
+  void flush(H* ph) {
+    if ( m_entries == 0.0 ) return;
+    if ( ph == nullptr ) return clear();
+    // Stats first: TH1::GetStats may recompute them from the bin contents.
+    double stats[13];  // TH1::kNstat
+    ph->GetStats(stats);
+    for ( int ista=0; ista<4; ++ista ) stats[ista] += m_stats[ista];
+    if ( ! m_sumw2.empty() && ph->GetSumw2N() == 0 && ! ph->TestBit(H::kIsNotW) ) ph->Sumw2();
+    double* psumw2 = ph->GetSumw2N() ? ph->GetSumw2()->GetArray() : nullptr;
+    for ( size_t bin=0; bin<m_sumw.size(); ++bin ) {
+      if ( m_sumw[bin] != 0 ) ph->AddBinContent(bin, m_sumw[bin]);
+      if ( psumw2 != nullptr ) psumw2[bin] += m_sumw2.empty() ? double(m_sumw[bin]) : m_sumw2[bin];
+    }
+    ph->PutStats(stats);
+    ph->SetEntries(ph->GetEntries() + m_entries);
+    clear();
+  }
+
+  void clear() {
+    std::fill(m_sumw.begin(), m_sumw.end(), 0);
+    m_sumw2.clear();
+    std::fill(m_stats, m_stats + 4, 0.0);
+    m_entries = 0.0;
+  }
+
+private:
+
+  FixedAxis m_xax;
+  std::vector<CONTENT> m_sumw;
+  std::vector<double> m_sumw2;  // Empty until a weighted fill
+  double m_stats[4] = {0.0, 0.0, 0.0, 0.0};
+  double m_entries = 0.0;
+
+};
+
+//**********************************************************************
+
+// Fills of a TH2 with contents of type CONTENT (float for TH2F).
+template<class CONTENT>
+class Hist2Sum {
+
+public:
+
+  Hist2Sum() : Hist2Sum(FixedAxis(), FixedAxis()) { }
+
+  Hist2Sum(const FixedAxis& xax, const FixedAxis& yax)
+  : m_xax(xax), m_yax(yax), m_sumw(size_t(xax.nbins() + 2)*(yax.nbins() + 2), 0) { }
+
+  template<class H>
+  explicit Hist2Sum(const H* ph) : Hist2Sum(FixedAxis::of(ph->GetXaxis()), FixedAxis::of(ph->GetYaxis())) { }
+
+  // As TH2::Fill(x, y, w).
+  void fill(double x, double y, double w = 1.0) {
+    const int binx = m_xax.findBin(x);
+    const int biny = m_yax.findBin(y);
+    const size_t bin = size_t(biny)*(m_xax.nbins() + 2) + binx;
+    ++m_entries;
+    // The first weighted fill starts the sums of squares, as TH1::Sumw2().
+    if ( w != 1.0 && m_sumw2.empty() ) m_sumw2.assign(m_sumw.begin(), m_sumw.end());
+    if ( ! m_sumw2.empty() ) m_sumw2[bin] += w*w;
+    m_sumw[bin] += CONTENT(w);
+    if ( ! m_xax.inRange(binx) || ! m_yax.inRange(biny) ) return;
+    m_stats[0] += w;
+    m_stats[1] += w*w;
+    m_stats[2] += w*x;
+    m_stats[3] += w*x*x;
+    m_stats[4] += w*y;
+    m_stats[5] += w*y*y;
+    m_stats[6] += w*x*y;
+  }
+
+  double entries() const { return m_entries; }
+
+  // Add to histogram ph, which has the binning of this sum, and clear.
+  // The fills are dropped if ph is null.
+  template<class H>
+  void flush(H* ph) {
+    if ( m_entries == 0.0 ) return;
+    if ( ph == nullptr ) return clear();
+    // Stats first: TH1::GetStats may recompute them from the bin contents.
+    double stats[13];  // TH1::kNstat
+    ph->GetStats(stats);
+    for ( int ista=0; ista<7; ++ista ) stats[ista] += m_stats[ista];
+    if ( ! m_sumw2.empty() && ph->GetSumw2N() == 0 && ! ph->TestBit(H::kIsNotW) ) ph->Sumw2();
+    double* psumw2 = ph->GetSumw2N() ? ph->GetSumw2()->GetArray() : nullptr;
+    for ( size_t bin=0; bin<m_sumw.size(); ++bin ) {
+      if ( m_sumw[bin] != 0 ) ph->AddBinContent(bin, m_sumw[bin]);
+      if ( psumw2 != nullptr ) psumw2[bin] += m_sumw2.empty() ? double(m_sumw[bin]) : m_sumw2[bin];
+    }
+    ph->PutStats(stats);
+    ph->SetEntries(ph->GetEntries() + m_entries);
+    clear();
+  }
+
+  void clear() {
+    std::fill(m_sumw.begin(), m_sumw.end(), 0);
+    m_sumw2.clear();
+    std::fill(m_stats, m_stats + 7, 0.0);
+    m_entries = 0.0;
+  }
+
+private:
+
+  FixedAxis m_xax;
+  FixedAxis m_yax;
+  std::vector<CONTENT> m_sumw;
+  std::vector<double> m_sumw2;  // Empty until a weighted fill
+  double m_stats[7] = {0.0, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0};
+  double m_entries = 0.0;
+
+};
+
+//**********************************************************************
+
+// Fills of a TProfile.
+class ProfileSum {
+
+public:
+
+  ProfileSum() : ProfileSum(FixedAxis(), 0.0, 0.0) { }
+
+  // ymin == ymax for a profile without y limits.
+  ProfileSum(const FixedAxis& xax, double ymin, double ymax)
+  : m_xax(xax), m_ymin(ymin), m_ymax(ymax),
+    m_sumy(xax.nbins() + 2, 0.0), m_sumy2(xax.nbins() + 2, 0.0), m_count(xax.nbins() + 2, 0.0) { }
+
+  template<class P>
+  explicit ProfileSum(const P* pp) : ProfileSum(FixedAxis::of(pp->GetXaxis()), pp->GetYmin(), pp->GetYmax()) { }
+
+  // As TProfile::Fill(x, y).
+  void fill(double x, double y) {
+    if ( m_ymin != m_ymax && (y < m_ymin || y > m_ymax || std::isnan(y)) ) return;
+    const int bin = m_xax.findBin(x);
+    ++m_entries;
+    m_sumy[bin] += y;
+    m_sumy2[bin] += y*y;
+    m_count[bin] += 1.0;
+    if ( ! m_xax.inRange(bin) ) return;
+    m_stats[0] += 1.0;
+    m_stats[1] += 1.0;
+    m_stats[2] += x;
+    m_stats[3] += x*x;
+    m_stats[4] += y;
+    m_stats[5] += y*y;
+  }
+
+  double entries() const { return m_entries; }
+
+  // Add to profile pp, which has the binning of this sum, and clear.
+  // The fills are dropped if pp is null.
+  template<class P>
+  void flush(P* pp) {
+    if ( m_entries == 0.0 ) return;
+    if ( pp == nullptr ) return clear();
+    double stats[13];  // TH1::kNstat
+    pp->GetStats(stats);
+    for ( int ista=0; ista<6; ++ista ) stats[ista] += m_stats[ista];
+    double* pw = pp->GetW();
+    double* pw2 = pp->GetW2();
+    double* pb = pp->GetB();
+    double* pb2 = pp->GetB2();
+    for ( size_t bin=0; bin<m_count.size(); ++bin ) {
+      if ( m_count[bin] == 0.0 ) continue;
+      pw[bin] += m_sumy[bin];
+      pw2[bin] += m_sumy2[bin];
+      pb[bin] += m_count[bin];
+      if ( pb2 != nullptr ) pb2[bin] += m_count[bin];
+    }
+    pp->PutStats(stats);
+    pp->SetEntries(pp->GetEntries() + m_entries);
+    clear();
+  }
+
+  void clear() {
+    std::fill(m_sumy.begin(), m_sumy.end(), 0.0);
+    std::fill(m_sumy2.begin(), m_sumy2.end(), 0.0);
+    std::fill(m_count.begin(), m_count.end(), 0.0);
+    std::fill(m_stats, m_stats + 6, 0.0);
+    m_entries = 0.0;
+  }
+
+private:
+
+  FixedAxis m_xax;
+  double m_ymin = 0.0;
+  double m_ymax = 0.0;
+  std::vector<double> m_sumy;
+  std::vector<double> m_sumy2;
+  std::vector<double> m_count;
+  double m_stats[6] = {0.0, 0.0, 0.0, 0.0, 0.0, 0.0};
+  double m_entries = 0.0;
+
+};
+
+//**********************************************************************
+
+// Fills of a TProfile2D.
+class Profile2Sum {
+
+public:
+
+  Profile2Sum() : Profile2Sum(FixedAxis(), FixedAxis(), 0.0, 0.0) { }
+
+  // zmin == zmax for a profile without z limits.
+  Profile2Sum(const FixedAxis& xax, const FixedAxis& yax, double zmin, double zmax)
+  : m_xax(xax), m_yax(yax), m_zmin(zmin), m_zmax(zmax),
+    m_sumz(size_t(xax.nbins() + 2)*(yax.nbins() + 2), 0.0),
+    m_sumz2(m_sumz.size(), 0.0), m_count(m_sumz.size(), 0.0) { }
+
+  template<class P>
+  explicit Profile2Sum(const P* pp)
+  : Profile2Sum(FixedAxis::of(pp->GetXaxis()), FixedAxis::of(pp->GetYaxis()), pp->GetZmin(), pp->GetZmax()) { }
+
+  // As TProfile2D::Fill(x, y, z).
+  void fill(double x, double y, double z) {
+    if ( m_zmin != m_zmax && (z < m_zmin || z > m_zmax || std::isnan(z)) ) return;
+    fillMany(x, y, 1.0, z, z*z);
+  }
+
+  // As n calls to TProfile2D::Fill(x, y, z) with values z inside the z
+  // limits whose sum is sumz and sum of squares is sumz2. The statistics are
+  // those of the n calls up to rounding, and exact for integer x, y and z.
+  void fillMany(double x, double y, double n, double sumz, double sumz2) {
+    if ( n == 0.0 ) return;
+    const int binx = m_xax.findBin(x);
+    const int biny = m_yax.findBin(y);
+    const size_t bin = size_t(biny)*(m_xax.nbins() + 2) + binx;
+    m_entries += n;
+    m_sumz[bin] += sumz;
+    m_sumz2[bin] += sumz2;
+    m_count[bin] += n;
+    if ( ! m_xax.inRange(binx) || ! m_yax.inRange(biny) ) return;
+    m_stats[0] += n;
+    m_stats[1] += n;
+    m_stats[2] += n*x;
+    m_stats[3] += n*x*x;
+    m_stats[4] += n*y;
+    m_stats[5] += n*y*y;
+    m_stats[6] += n*x*y;
+    m_stats[7] += sumz;
+    m_stats[8] += sumz2;
+  }
+
+  double entries() const { return m_entries; }
+
+  // Add to profile pp, which has the binning of this sum, and clear.
+  // The fills are dropped if pp is null.
+  template<class P>
+  void flush(P* pp) {
+    if ( m_entries == 0.0 ) return;
+    if ( pp == nullptr ) return clear();
+    double stats[13];  // TH1::kNstat
+    pp->GetStats(stats);
+    for ( int ista=0; ista<9; ++ista ) stats[ista] += m_stats[ista];
+    double* pw = pp->GetW();
+    double* pw2 = pp->GetW2();
+    double* pb = pp->GetB();
+    double* pb2 = pp->GetB2();
+    for ( size_t bin=0; bin<m_count.size(); ++bin ) {
+      if ( m_count[bin] == 0.0 ) continue;
+      pw[bin] += m_sumz[bin];
+      pw2[bin] += m_sumz2[bin];
+      pb[bin] += m_count[bin];
+      if ( pb2 != nullptr ) pb2[bin] += m_count[bin];
+    }
+    pp->PutStats(stats);
+    pp->SetEntries(pp->GetEntries() + m_entries);
+    clear();
+  }
+
+  void clear() {
+    std::fill(m_sumz.begin(), m_sumz.end(), 0.0);
+    std::fill(m_sumz2.begin(), m_sumz2.end(), 0.0);
+    std::fill(m_count.begin(), m_count.end(), 0.0);
+    std::fill(m_stats, m_stats + 9, 0.0);
+    m_entries = 0.0;
+  }
+
+private:
+
+  FixedAxis m_xax;
+  FixedAxis m_yax;
+  double m_zmin = 0.0;
+  double m_zmax = 0.0;
+  std::vector<double> m_sumz;
+  std::vector<double> m_sumz2;
+  std::vector<double> m_count;
+  double m_stats[9] = {0.0, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0};
+  double m_entries = 0.0;
+
+};
+
+//**********************************************************************
+
+}  // end namespace tpc_monitor
+
+#endif
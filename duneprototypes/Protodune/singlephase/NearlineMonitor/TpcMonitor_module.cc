@@ -34,6 +34,8 @@
 #include "messagefacility/MessageLogger/MessageLogger.h"
 #include "fhiclcpp/ParameterSet.h"
 #include "dunepdlegacy/Services/ChannelMap/PdspChannelMapService.h"
+#include "duneprototypes/Protodune/singlephase/NearlineMonitor/MonitorFFT.h"
+#include "tbb/parallel_for.h"
 
 // ROOT includes.
 #include "TH1.h"
@@ -56,6 +58,7 @@
 #include <string>
 #include <sstream>
 #include <cmath>
+#include <map>
 
 #ifdef __MAKECINT__
 #pragma link C++ class vector<vector<int> >+;
@@ -178,10 +181,64 @@ namespace tpc_monitor{
     int fRebinX;
     int fRebinY; 
 
-    // define nADC counts for uncompressed vs compressed
-    unsigned int nADC_comp;
-    unsigned int nADC_uncomp;
-    unsigned int nADC_uncompPed;
+    // FFTs: waveforms are transformed in batches of fFFTBatchSize channels and the
+    // spectra are summed in arrays, which are added to the FFT histograms above every
+    // fFFTSnapshotInterval events (0 for only at the end of the job)
+    struct FFTChannel {
+      unsigned int apa;
+      uint32_t chan;
+      int fiber;
+      geo::View_t view;
+    };
+    int fFFTBatchSize;
+    int fFFTSnapshotInterval;
+    int fNEventsSinceSnapshot = 0;
+
+    // The digits of an event are split by offline APA. The channel map is read and the
+    // digits are sorted into the APA shards serially. Each shard is then unpacked by its
+    // own task, run with tbb::parallel_for (on art's scheduler) if fParallelAPAs is set.
+    // A task writes only to its shard and to the summaries of its own digits, so no
+    // locks are needed. When all are done the summaries are filled into the histograms
+    // in digit order.
+    struct DigitInfo {
+      const raw::RawDigit* digit;
+      unsigned int apa;
+      uint32_t chan;
+      geo::View_t view;
+      int fiber;
+      int xBin;
+      int yBin;
+      int slotID;
+      uint32_t slotChan;
+    };
+    struct DigitSummary {
+      float mean;
+      float rms;
+      float fracstuckoff;
+      float fracstuckon;
+      int nBitFills[12];   // samples giving a fill of fBitValue, for each bit
+      int nBitOn[12];      // samples with the bit on
+    };
+    struct APAShard {
+      std::vector<size_t> digits;   // indices in fDigitInfo
+      std::vector<short> uncompressed;
+      std::vector<short> uncompPed;
+      MonitorFFT fft;
+      std::vector<double> fftWaveforms;
+      std::vector<double> fftSpectra;
+      std::vector<FFTChannel> fftChannels;
+      size_t fftNSamples = 0;
+      Hist2Sum<float> chanFFTUSum;
+      Hist2Sum<float> chanFFTVSum;
+      Hist2Sum<float> chanFFTZSum;
+      Hist2Sum<float> persistentFFTSum;
+      std::map<int, ProfileSum> fiberFFTSum;   // by fiber, added as fibers are seen
+    };
+    bool fParallelAPAs;
+    std::vector<APAShard> fShards;      // index is offline APA
+    std::vector<DigitInfo> fDigitInfo;
+    std::vector<DigitSummary> fDigitSummary;
+    std::vector<Profile2Sum> fBitValueSum;
 
     TH1F *fNTicksTPC;
 
@@ -214,7 +271,10 @@ namespace tpc_monitor{
     // define functions
     float rmsADC(std::vector< short > & uncompressed);
     float meanADC(std::vector< short > & uncompressed);
-    void calculateFFT(TH1D* hist_waveform, TH1D* graph_frequency);
+    void processDigit(APAShard& shard, const DigitInfo& info, DigitSummary& summary);
+    void addFFTChannel(APAShard& shard, const std::vector<short>& waveform, const FFTChannel& chaninfo);
+    void transformFFTBatch(APAShard& shard);
+    void snapshotFFT();
     void FillChannelHistos(TProfile* h1, double mean, double sigma, int& ndeadchannels, int& nnoisychannels_sigma, int& nnoisychannels_counts);
     geo::GeometryCore const * fGeom = &*(art::ServiceHandle<geo::Geometry>());
 
@@ -280,6 +340,7 @@ namespace tpc_monitor{
       <<"U: "<< fNUCh<<"  V:  "<<fNVCh<<"  Z0:  "<<fNZ0Ch << "  Z1:  " <<fNZ1Ch << std::endl;
     
     //Mean/RMS by offline channel for each view in each APA
+    fShards.resize(fNofAPA);
     for(unsigned int i=0;i<fNofAPA;i++)
       {
 	UChMin=fUChanMin + i*fChansPerAPA;
@@ -357,6 +418,9 @@ namespace tpc_monitor{
 	fChanFFTU[i]->Rebin2D(fRebinX, fRebinY);
 	fChanFFTV[i]->Rebin2D(fRebinX, fRebinY);
 	fChanFFTZ[i]->Rebin2D(fRebinX, fRebinY);
+	fShards[i].chanFFTUSum = Hist2Sum<float>(fChanFFTU[i]);
+	fShards[i].chanFFTVSum = Hist2Sum<float>(fChanFFTV[i]);
+	fShards[i].chanFFTZSum = Hist2Sum<float>(fChanFFTZ[i]);
       }
     
     //All in one view
@@ -384,6 +448,7 @@ namespace tpc_monitor{
 	fBitValue[i]->GetXaxis()->SetBinLabel(40, "3"); fBitValue[i]->GetXaxis()->SetBinLabel(120, "2"); fBitValue[i]->GetXaxis()->SetBinLabel(200, "1");
 	fBitValue[i]->GetYaxis()->SetBinLabel(5, "U"); fBitValue[i]->GetYaxis()->SetBinLabel(15, "V"); fBitValue[i]->GetYaxis()->SetBinLabel(26, "Z");
 	fBitValue[i]->GetYaxis()->SetBinLabel(37, "U"); fBitValue[i]->GetYaxis()->SetBinLabel(47, "V"); fBitValue[i]->GetYaxis()->SetBinLabel(58, "Z");
+	fBitValueSum.emplace_back(fBitValue[i]);
       }
 
     // Mean/RMS by slot channel number for each slot
@@ -423,6 +488,7 @@ namespace tpc_monitor{
 	fPersistentFFT_by_APA.push_back(tfs->make<TH2F>(Form("Persistent_FFT_APA_%d", fApaLabelNum[i]), Form("FFT APA%d ", fApaLabelNum[i]), fNticks/2, 0, fNticks/2*fBinWidth, 150, -100, 50));
         fPersistentFFT_by_APA[i]->GetXaxis()->SetTitle("Frequency [kHz]"); 
 	fPersistentFFT_by_APA[i]->GetYaxis()->SetTitle("Amplitude [dB]"); 
+	if (i < (int)fShards.size()) fShards[i].persistentFFTSum = Hist2Sum<float>(fPersistentFFT_by_APA[i]);
       }
 
     fNTicksTPC = tfs->make<TH1F>("NTicksTPC","NTicks in TPC Channels",100,0,20000);
@@ -502,6 +568,9 @@ namespace tpc_monitor{
     fNoiseLevelMinNCountsV = p.get<int>("NoiseLevelMinNCountsV");
     fNoiseLevelMinNCountsZ = p.get<int>("NoiseLevelMinNCountsZ");
     fNoiseLevelNSigma     = p.get<double>("NoiseLevelNSigma");
+    fFFTBatchSize         = p.get<int>("FFTBatchSize", 64);
+    fFFTSnapshotInterval  = p.get<int>("FFTSnapshotInterval", 0);
+    fParallelAPAs         = p.get<bool>("ParallelAPAs", true);
     auto const clockData = art::ServiceHandle<detinfo::DetectorClocksService const>()->DataForJob();
     auto const detProp = art::ServiceHandle<detinfo::DetectorPropertiesService const>()->DataForJob(clockData);
     fNticks         = detProp.NumberTimeSamples();
@@ -564,7 +633,11 @@ namespace tpc_monitor{
 	//std::cout << "RDStatus:  Status Word " << rdstatus.GetStatWord() << std::endl; 
       }
 
-    // Loop over all RawRCEDigits (entire channels)                                                                                                        
+    // Sort the RawRCEDigits (entire channels) into the APA shards, with what they need
+    // from the geometry and the channel map
+    fDigitInfo.clear();
+    fDigitInfo.reserve(RawDigits.size());
+    for (auto& shard : fShards) shard.digits.clear();
     for(auto const & dptr : RawDigits) {
       const raw::RawDigit & digit = *dptr;
       
@@ -574,63 +647,15 @@ namespace tpc_monitor{
       int nSamples = digit.Samples();
       fNTicksTPC->Fill(nSamples);
       unsigned int apa = std::floor( chan/fChansPerAPA );	  
-      //int pedestal = (int)digit.GetPedestal();
-      int pedestal = 0;  
-
-      std::vector<short> uncompressed(nSamples);
-      // with pedestal	  
-      raw::Uncompress(digit.ADCs(), uncompressed, pedestal, digit.Compression());
-
-      // number of compressed ADCs
-      nADC_comp=digit.NADC();
-      // number of ADC uncompressed
-      nADC_uncomp=uncompressed.size();	  
-      // subtract pedestals
-      std::vector<short> uncompPed(nSamples);
-
-      int nstuckoff=0;
-      int nstuckon=0;
-      for (int i=0; i<nSamples; i++) 
-	{ 
-	  auto adc=uncompressed.at(i);
-	  auto adcl6b = adc & 0x3F;
-	  if (adcl6b == 0) ++nstuckoff;
-	  if (adcl6b == 0x3F) ++nstuckon;
-	  uncompPed.at(i) = adc - pedestal;
-        }
-      float fracstuckoff = ((float) nstuckoff)/((float) nSamples);
-      float fracstuckon = ((float) nstuckon)/((float) nSamples);
-
-      // number of ADC uncompressed without pedestal
-      nADC_uncompPed=uncompPed.size();	 
-      
-      // wavefrom histogram   
-      int FiberID = channelMap->FiberIdFromOfflineChannel(chan);
-      TH1D* histwav=new TH1D(Form("wav%d",(int)chan),Form("wav%d",(int)chan),nSamples,0,nSamples); 
-      
-      for(int k=0;k<(int)nADC_uncompPed;k++) {
-	histwav->SetBinContent(k+1, uncompPed.at(k));
-	// Fill Persistent waveform by fiber -- skip as it takes too much RAM
-	//fPersistentWav_by_Fiber.at(FiberID)->Fill(k+1, uncompPed.at(k));
+      if (apa >= fShards.size()) {
+	MF_LOG_WARNING("TpcMonitor") << "Skipping channel " << chan << " in APA " << apa;
+	continue;
       }
-	    
-      // Do FFT for single waveforms
-      TH1D* histfft=new TH1D(Form("fft%d",(int)chan),Form("fft%d",(int)chan),nSamples,0,nSamples*fBinWidth); 
-      calculateFFT(histwav, histfft);
-      // Fill persistent/overlay FFT for each fiber/FEMB
-      for(int k=0;k<(int)nADC_uncompPed/2;k++) {
-	fPersistentFFT_by_APA.at(apa)->Fill((k+0.5)*fBinWidth, histfft->GetBinContent(k+1));    // offline apa number.  Plot labels are online
-	fFFT_by_Fiber_pfx.at(FiberID % 120)->Fill((k+0.5)*fBinWidth, histfft->GetBinContent(k+1));
-      }
-
-      // summary stuck code fraction distributions by APA -- here the APA is the offline APA number.  The plot labels contain the mapping
+      APAShard& shard = fShards[apa];
 
-      fStuckCodeOffFrac[apa]->Fill(fracstuckoff);
-      fStuckCodeOnFrac[apa]->Fill(fracstuckon);
- 
-      // Mean and RMS
-      float mean = meanADC(uncompPed);
-      float rms = rmsADC(uncompPed);
+      int FiberID = channelMap->FiberIdFromOfflineChannel(chan);
+      int fiber = FiberID % 120;
+      if (shard.fiberFFTSum.count(fiber) == 0) shard.fiberFFTSum.emplace(fiber, ProfileSum(fFFT_by_Fiber_pfx.at(fiber)));
 
       //get ready to fill the summary plots
       //get the channel's FEMB and WIB
@@ -643,92 +668,96 @@ namespace tpc_monitor{
       int xBin = ((FEMBchanToHistogramMap(FEMBchan,0))+(iFEMB*4)+xEdgeAPA[apa]); // (fembchan location on histogram) + shift from mobo + shift from apa
       int yBin = ((FEMBchanToHistogramMap(FEMBchan,1))+yEdgeAPA[(apa%2)]); //(fembchan location on histogram) + shift from apa 
 
-      fAllChanMean->Fill(xBin,yBin,mean); //histogram the mean
-      fAllChanRMS->Fill(xBin,yBin,rms); //histogram the rms
-
-      for (int i=0; i<nSamples; i++) //histogram the 12 bits
-	{ 
-	  auto adc=uncompressed.at(i);
-	  int bitstring = adc;
-	  for(int mm=0;mm<12;mm++)
-	    {
-	      // get the bit value from the adc
-	      int bit = (bitstring%2);
-	      fBitValue[mm]->Fill(xBin,yBin,bit);
-	      bitstring = (bitstring/2);
-	    }
+      // Mean/RMS by slot
+      int SlotID = channelMap->SlotIdFromOfflineChannel(chan);
+      int FiberNumber = channelMap->FEMBFromOfflineChannel(chan) - 1;
+      int FiberChannelNumber = channelMap->FEMBChannelFromOfflineChannel(chan);
+      uint32_t SlotChannelNumber = FiberNumber*128 + FiberChannelNumber; //128 channels per fiber
+
+      // FFT plans are made here as making one is not thread safe
+      shard.fft.prepare(nSamples);
+      shard.digits.push_back(fDigitInfo.size());
+      fDigitInfo.push_back({&digit, apa, chan, fGeom->View(chan), fiber, xBin, yBin, SlotID, SlotChannelNumber});
+    } // RawDigits
+
+    // Unpack the digits of each APA: stuck codes, mean, RMS, bits and FFTs
+
+    fDigitSummary.resize(fDigitInfo.size());
+    auto processShard = [&](size_t iapa)
+      {
+	APAShard& shard = fShards[iapa];
+	for (size_t idig : shard.digits) processDigit(shard, fDigitInfo[idig], fDigitSummary[idig]);
+	transformFFTBatch(shard);
+      };
+    if (fParallelAPAs) tbb::parallel_for(size_t(0), fShards.size(), processShard);
+    else for (size_t iapa=0; iapa<fShards.size(); ++iapa) processShard(iapa);
+
+    // Fill the per-channel histograms
+
+    for (size_t idig=0; idig<fDigitInfo.size(); ++idig) {
+      const DigitInfo& info = fDigitInfo[idig];
+      const DigitSummary& summary = fDigitSummary[idig];
+      unsigned int apa = info.apa;
+      uint32_t chan = info.chan;
+      float mean = summary.mean;
+      float rms = summary.rms;
+      float fracstuckoff = summary.fracstuckoff;
+      float fracstuckon = summary.fracstuckon;
+
+      // summary stuck code fraction distributions by APA -- here the APA is the offline APA number.  The plot labels contain the mapping
+
+      fStuckCodeOffFrac[apa]->Fill(fracstuckoff);
+      fStuckCodeOnFrac[apa]->Fill(fracstuckon);
+
+      fAllChanMean->Fill(info.xBin,info.yBin,mean); //histogram the mean
+      fAllChanRMS->Fill(info.xBin,info.yBin,rms); //histogram the rms
+
+      for(int mm=0;mm<12;mm++) //histogram the 12 bits
+	{
+	  fBitValueSum[mm].fillMany(info.xBin,info.yBin,summary.nBitFills[mm],summary.nBitOn[mm],summary.nBitOn[mm]);
 	}
 
-	     
       // U View, induction Plane	  
-      if( fGeom->View(chan) == geo::kU){	
+      if( info.view == geo::kU){	
 	fChanMeanU_pfx[apa]->Fill(chan, mean, 1);
 	fChanRMSU_pfx[apa]->Fill(chan, rms, 1);
 	fChanMeanDistU[apa]->Fill(mean);
 	fChanRMSDistU[apa]->Fill(rms);
 	fChanStuckCodeOffFracU[apa]->Fill(chan,fracstuckoff,1);
 	fChanStuckCodeOnFracU[apa]->Fill(chan,fracstuckon,1);
-	      
-	//fft
-	for(int l=0;l<nSamples/2;l++) { 
-	  //for the 2D histos
-	  fChanFFTU[apa]->Fill(chan, (l+0.5)*fBinWidth, histfft->GetBinContent(l+1));
-	}
 
       }// end of U View
 
       // V View, induction Plane
-      if( fGeom->View(chan) == geo::kV){
+      if( info.view == geo::kV){
         fChanRMSV_pfx[apa]->Fill(chan, rms, 1);
 	fChanMeanV_pfx[apa]->Fill(chan, mean, 1);
 	fChanMeanDistV[apa]->Fill(mean);
 	fChanRMSDistV[apa]->Fill(rms);
 	fChanStuckCodeOffFracV[apa]->Fill(chan,fracstuckoff,1);
 	fChanStuckCodeOnFracV[apa]->Fill(chan,fracstuckon,1);
-	      
-	//fft
-	for(int l=0;l<nSamples/2;l++) { 
-	  //for the 2D histos
-	  fChanFFTV[apa]->Fill(chan, (l+0.5)*fBinWidth, histfft->GetBinContent(l+1));
-	}
 
       }// end of V View               
 
       // Z View, collection Plane
-      if( fGeom->View(chan) == geo::kZ){
+      if( info.view == geo::kZ){
 	fChanMeanZ_pfx[apa]->Fill(chan, mean, 1);
 	fChanRMSZ_pfx[apa]->Fill(chan, rms, 1);
 	fChanMeanDistZ[apa]->Fill(mean);
 	fChanRMSDistZ[apa]->Fill(rms);
 	fChanStuckCodeOffFracZ[apa]->Fill(chan,fracstuckoff,1);
 	fChanStuckCodeOnFracZ[apa]->Fill(chan,fracstuckon,1);
-	      
-	//fft
-	for(int l=0;l<nSamples/2;l++) {
-	  //for the 2D histos
-	  fChanFFTZ[apa]->Fill(chan, (l+0.5)*fBinWidth, histfft->GetBinContent(l+1));
-	}
 
       }// end of Z View
       
       // Mean/RMS by slot
-      int SlotID = channelMap->SlotIdFromOfflineChannel(chan);
-      int FiberNumber = channelMap->FEMBFromOfflineChannel(chan) - 1;
-      int FiberChannelNumber = channelMap->FEMBChannelFromOfflineChannel(chan);
-      uint32_t SlotChannelNumber = FiberNumber*128 + FiberChannelNumber; //128 channels per fiber
-      fSlotChanMean_pfx.at(SlotID)->Fill(SlotChannelNumber, mean, 1);
-      fSlotChanRMS_pfx.at(SlotID)->Fill(SlotChannelNumber, rms, 1);
+      fSlotChanMean_pfx.at(info.slotID)->Fill(info.slotChan, mean, 1);
+      fSlotChanRMS_pfx.at(info.slotID)->Fill(info.slotChan, rms, 1);
       
-      // FFT by slot
-      for(int l=0;l<nSamples/2;l++) {
-	//for the 2D histos
-	// fSlotChanFFT.at(SlotID)->Fill(SlotChannelNumber, (l+0.5)*fBinWidth, histfft->GetBinContent(l+1));
-      }
-      
-      histwav->Delete(); 
-      histfft->Delete();                                                                                                                    
-      
-    } // RawDigits
+    }
+    for (size_t mm=0; mm<fBitValueSum.size(); ++mm) fBitValueSum[mm].flush(fBitValue[mm]);
+
+    if (fFFTSnapshotInterval > 0 && ++fNEventsSinceSnapshot >= fFFTSnapshotInterval) snapshotFFT();
     
     return;
   }
@@ -765,32 +794,123 @@ namespace tpc_monitor{
   }
   
   //-----------------------------------------------------------------------  
-  //calculate FFT
-  void TpcMonitor::calculateFFT(TH1D* hist_waveform, TH1D* hist_frequency) {
-  
-    int n_bins = hist_waveform->GetNbinsX();
-    TH1* hist_transform = 0;
+  // unpack one digit of an APA shard into its summary and the shard's FFT sums.
+  // Runs in the shard's task, so it writes to nothing else.
+  void TpcMonitor::processDigit(APAShard& shard, const DigitInfo& info, DigitSummary& summary) {
+    const raw::RawDigit & digit = *info.digit;
+    int nSamples = digit.Samples();
+    //int pedestal = (int)digit.GetPedestal();
+    int pedestal = 0;  
+
+    // with pedestal	  
+    shard.uncompressed.assign(nSamples, 0);
+    raw::Uncompress(digit.ADCs(), shard.uncompressed, pedestal, digit.Compression());
+
+    // subtract pedestals
+    shard.uncompPed.resize(nSamples);
+
+    int nstuckoff=0;
+    int nstuckon=0;
+    for (int i=0; i<nSamples; i++) 
+      { 
+	auto adc=shard.uncompressed[i];
+	auto adcl6b = adc & 0x3F;
+	if (adcl6b == 0) ++nstuckoff;
+	if (adcl6b == 0x3F) ++nstuckon;
+	shard.uncompPed[i] = adc - pedestal;
+      }
+    summary.fracstuckoff = ((float) nstuckoff)/((float) nSamples);
+    summary.fracstuckon = ((float) nstuckon)/((float) nSamples);
+
+    // FFT of the waveform, done with the rest of its batch
+    addFFTChannel(shard, shard.uncompPed, {info.apa, info.chan, info.fiber, info.view});
+
+    // Mean and RMS
+    summary.mean = meanADC(shard.uncompPed);
+    summary.rms = rmsADC(shard.uncompPed);
+
+    // the 12 bits: each sample fills fBitValue with its bit value, 0 or 1.  The value
+    // taken by % and / from a negative ADC may be -1, which the profile's limits reject.
+    std::fill(summary.nBitFills, summary.nBitFills + 12, 0);
+    std::fill(summary.nBitOn, summary.nBitOn + 12, 0);
+    for (int i=0; i<nSamples; i++)
+      { 
+	int bitstring = shard.uncompressed[i];
+	if (bitstring >= 0)
+	  {
+	    for(int mm=0;mm<12;mm++) summary.nBitOn[mm] += (bitstring >> mm) & 1;
+	    for(int mm=0;mm<12;mm++) ++summary.nBitFills[mm];
+	    continue;
+	  }
+	for(int mm=0;mm<12;mm++)
+	  {
+	    // get the bit value from the adc
+	    int bit = (bitstring%2);
+	    if (bit >= 0)
+	      {
+		++summary.nBitFills[mm];
+		summary.nBitOn[mm] += bit;
+	      }
+	    bitstring = (bitstring/2);
+	  }
+      }
+  }
 
-    // Create hist_transform from the input hist_waveform
-    hist_transform = hist_waveform->FFT(hist_transform, "MAG");
-    hist_transform -> Scale (1.0 / float(n_bins));
-    int nFFT=hist_transform->GetNbinsX();
-  
-    double frequency;
-    double amplitude;
-    double amplitudeLog;
-  
-    // Loop on the hist_transform to fill the hist_transform_frequency                                                                                        
-    for (int k = 0; k < nFFT/2; k++){
+  //-----------------------------------------------------------------------  
+  // queue a waveform for the FFT, transforming the batch when it is full
+  void TpcMonitor::addFFTChannel(APAShard& shard, const std::vector<short>& waveform, const FFTChannel& chaninfo) {
+    if (waveform.size() != shard.fftNSamples) {
+      transformFFTBatch(shard);
+      shard.fftNSamples = waveform.size();
+    }
+    shard.fftWaveforms.insert(shard.fftWaveforms.end(), waveform.begin(), waveform.end());
+    shard.fftChannels.push_back(chaninfo);
+    if ((int)shard.fftChannels.size() >= fFFTBatchSize) transformFFTBatch(shard);
+  }
 
-      frequency =  (k+0.5)*fBinWidth; // kHz
-      amplitude = hist_transform->GetBinContent(k+1); 
-      amplitudeLog = 20*log10(amplitude); // dB
-      hist_frequency->Fill(frequency, amplitudeLog);
+  //-----------------------------------------------------------------------  
+  // FFT of the queued waveforms, summed into the shard's FFT sums
+  void TpcMonitor::transformFFTBatch(APAShard& shard) {
+    if (shard.fftChannels.empty()) return;
+    shard.fft.spectra(shard.fftWaveforms.data(), shard.fftChannels.size(), shard.fftNSamples, shard.fftSpectra);
+    int nfreq = shard.fftNSamples/2;
+    for (size_t ich=0; ich<shard.fftChannels.size(); ++ich) {
+      const FFTChannel& ci = shard.fftChannels[ich];
+      const double* spectrum = shard.fftSpectra.data() + ich*nfreq;
+      // Fill persistent/overlay FFT for each fiber/FEMB
+      auto& persistentsum = shard.persistentFFTSum;    // offline apa number.  Plot labels are online
+      auto& fibersum = shard.fiberFFTSum.at(ci.fiber);
+      for (int k=0; k<nfreq; k++) {
+	persistentsum.fill((k+0.5)*fBinWidth, spectrum[k]);
+	fibersum.fill((k+0.5)*fBinWidth, spectrum[k]);
+      }
+      // FFT by channel in each view
+      Hist2Sum<float>* chansum = nullptr;
+      if (ci.view == geo::kU) chansum = &shard.chanFFTUSum;
+      if (ci.view == geo::kV) chansum = &shard.chanFFTVSum;
+      if (ci.view == geo::kZ) chansum = &shard.chanFFTZSum;
+      if (chansum == nullptr) continue;
+      for (int l=0; l<nfreq; l++) {
+	chansum->fill(ci.chan, (l+0.5)*fBinWidth, spectrum[l]);
+      }
     }
+    shard.fftWaveforms.clear();
+    shard.fftChannels.clear();
+  }
 
-    hist_transform->Delete();
-  
+  //-----------------------------------------------------------------------  
+  // add the summed spectra to the FFT histograms
+  void TpcMonitor::snapshotFFT() {
+    for (size_t i=0; i<fShards.size(); ++i) {
+      APAShard& shard = fShards[i];
+      transformFFTBatch(shard);
+      shard.chanFFTUSum.flush(fChanFFTU[i]);
+      shard.chanFFTVSum.flush(fChanFFTV[i]);
+      shard.chanFFTZSum.flush(fChanFFTZ[i]);
+      shard.persistentFFTSum.flush(i < fPersistentFFT_by_APA.size() ? fPersistentFFT_by_APA[i] : nullptr);
+      for (auto& sum : shard.fiberFFTSum) sum.second.flush(fFFT_by_Fiber_pfx[sum.first]);
+    }
+    fNEventsSinceSnapshot = 0;
   }
   
   //-----------------------------------------------------------------------
@@ -885,6 +1005,8 @@ namespace tpc_monitor{
   //-----------------------------------------------------------------------  
   void TpcMonitor::endJob() {
 
+    snapshotFFT();
+
     // Find dead/noisy channels. Do this separately for each APA and for each view.
     std::vector<double> fURMS_mean; std::vector<double> fURMS_sigma;
     std::vector<double> fVRMS_mean; std::vector<double> fVRMS_sigma;
@@ -0,0 +1,172 @@
+// test_MonitorFFT.cxx
+//
+// Check the monitor FFT spectra against TH1::FFT as the monitors used it,
+// and the spectrum histogram sums against direct fills of the histograms.
+
+#include <string>
+#include <iostream>
+#include <random>
+#include <vector>
+#include <cmath>
+#include <algorithm>
+#include "duneprototypes/Protodune/singlephase/NearlineMonitor/MonitorFFT.h"
+#include "TH1D.h"
+#include "TH2F.h"
+#include "TProfile.h"
+
+#undef NDEBUG
+#include <cassert>
+
+using std::string;
+using std::cout;
+using std::endl;
+using std::vector;
+using tpc_monitor::MonitorFFT;
+using tpc_monitor::Hist2Sum;
+using tpc_monitor::ProfileSum;
+
+namespace {
+
+bool near(double x1, double x2, double tol) {
+  if ( x1 == x2 ) return true;
+  return std::fabs(x1 - x2) <= tol*std::max(1.0, std::fabs(x1) + std::fabs(x2));
+}
+
+// Contents, errors, entries and the first nstat statistics must agree.
+void checkSame(const TH1* ph1, const TH1* ph2, int nstat, double tol) {
+  assert( ph1->GetNcells() == ph2->GetNcells() );
+  for ( int bin=0; bin<ph1->GetNcells(); ++bin ) {
+    assert( near(ph1->GetBinContent(bin), ph2->GetBinContent(bin), tol) );
+    assert( near(ph1->GetBinError(bin), ph2->GetBinError(bin), tol) );
+  }
+  assert( ph1->GetEntries() == ph2->GetEntries() );
+  double stats1[TH1::kNstat];
+  double stats2[TH1::kNstat];
+  ph1->GetStats(stats1);
+  ph2->GetStats(stats2);
+  for ( int ista=0; ista<nstat; ++ista ) assert( near(stats1[ista], stats2[ista], tol) );
+}
+
+}  // end unnamed namespace
+
+//**********************************************************************
+
+int test_MonitorFFT(unsigned int nwav) {
+  const string myname = "test_MonitorFFT: ";
+#ifdef NDEBUG
+  cout << myname << "NDEBUG must be off." << endl;
+  abort();
+#endif
+  string line = "-----------------------------";
+  TH1::AddDirectory(false);
+  std::mt19937 gen(20240817);
+  std::normal_distribution<double> noise(0.0, 4.0);
+
+  const int nsam = 600;
+  const int nfreq = nsam/2;
+  const float binWidth = 1.0/(nsam*0.5*1.0e-6);
+
+  cout << myname << line << endl;
+  cout << myname << "Spectra of " << nwav << " waveforms." << endl;
+  vector<double> wavs;
+  for ( unsigned int iwav=0; iwav<nwav; ++iwav ) {
+    for ( int isam=0; isam<nsam; ++isam ) {
+      wavs.push_back(short(noise(gen) + 10.0*std::sin(0.05*(iwav + 1)*isam)));
+    }
+  }
+  // One waveform of zeros, whose spectrum is -inf.
+  wavs.insert(wavs.end(), nsam, 0.0);
+  ++nwav;
+  MonitorFFT fft;
+  vector<double> db;
+  fft.spectra(wavs.data(), nwav, nsam, db);
+  assert( db.size() == nwav*nfreq );
+  assert( fft.planCount() == 1 );
+  for ( unsigned int iwav=0; iwav<nwav; ++iwav ) {
+    // As the monitors did it.
+    TH1D hwav("hwav", "hwav", nsam, 0, nsam);
+    for ( int isam=0; isam<nsam; ++isam ) hwav.SetBinContent(isam + 1, wavs[iwav*nsam + isam]);
+    TH1* htra = hwav.FFT(nullptr, "MAG");
+    htra->Scale(1.0/float(nsam));
+    for ( int ifrq=0; ifrq<nfreq; ++ifrq ) {
+      double expdb = 20*log10(htra->GetBinContent(ifrq + 1));
+      double gotdb = db[iwav*nfreq + ifrq];
+      if ( std::isinf(expdb) ) assert( gotdb == expdb );
+      else assert( near(gotdb, expdb, 1.e-9) );
+    }
+    delete htra;
+  }
+
+  cout << myname << line << endl;
+  cout << myname << "Histogram sums." << endl;
+  TH2F h2dir("h2dir", "h2dir", 50, -0.5, 49.5, nfreq, 0, nfreq*binWidth);
+  TH2F h2sum("h2sum", "h2sum", 50, -0.5, 49.5, nfreq, 0, nfreq*binWidth);
+  h2dir.Rebin2D(1, 10);
+  h2sum.Rebin2D(1, 10);
+  TH2F hpdir("hpdir", "hpdir", nfreq, 0, nfreq*binWidth, 150, -100.0, 50.0);
+  TH2F hpsum("hpsum", "hpsum", nfreq, 0, nfreq*binWidth, 150, -100.0, 50.0);
+  TProfile hfdir("hfdir", "hfdir", nfreq, 0, nfreq*binWidth);
+  TProfile hfsum("hfsum", "hfsum", nfreq, 0, nfreq*binWidth);
+  TProfile hldir("hldir", "hldir", nfreq, 0, nfreq*binWidth, -100, 50);
+  TProfile hlsum("hlsum", "hlsum", nfreq, 0, nfreq*binWidth, -100, 50);
+  Hist2Sum<float> s2(&h2sum);
+  Hist2Sum<float> sp(&hpsum);
+  ProfileSum sf(&hfsum);
+  ProfileSum sl(&hlsum);
+  // Flush partway through and at the end, as with a snapshot interval.
+  for ( unsigned int iwav=0; iwav<nwav; ++iwav ) {
+    int chan = iwav % 60;
+    for ( int k=0; k<nfreq; ++k ) {
+      double bc = db[iwav*nfreq + k];
+      if ( bc > -1E6 && bc < 1E6 ) {
+        h2dir.Fill(chan, (k+0.5)*binWidth, bc);
+        s2.fill(chan, (k+0.5)*binWidth, bc);
+        hpdir.Fill((k+0.5)*binWidth, bc);
+        sp.fill((k+0.5)*binWidth, bc);
+        hfdir.Fill((k+0.5)*binWidth, bc);
+        sf.fill((k+0.5)*binWidth, bc);
+      }
+      hldir.Fill((k+0.5)*binWidth, bc);
+      sl.fill((k+0.5)*binWidth, bc);
+    }
+    if ( iwav == nwav/2 ) {
+      s2.flush(&h2sum);
+      sp.flush(&hpsum);
+      sf.flush(&hfsum);
+      sl.flush(&hlsum);
+      assert( s2.entries() == 0.0 );
+    }
+  }
+  s2.flush(&h2sum);
+  sp.flush(&hpsum);
+  sf.flush(&hfsum);
+  sl.flush(&hlsum);
+  // Float contents are summed in a different order after the first flush.
+  checkSame(&h2dir, &h2sum, 7, 1.e-4);
+  checkSame(&hpdir, &hpsum, 7, 1.e-4);
+  checkSame(&hfdir, &hfsum, 6, 1.e-9);
+  checkSame(&hldir, &hlsum, 6, 1.e-9);
+  assert( h2sum.GetSumw2N() > 0 );
+  assert( hpsum.GetSumw2N() == hpdir.GetSumw2N() );
+
+  cout << myname << line << endl;
+  cout << myname << "Done." << endl;
+  return 0;
+}
+
+//**********************************************************************
+
+int main(int argc, char* argv[]) {
+  unsigned int nwav = 100;
+  if ( argc > 1 ) {
+    string sarg(argv[1]);
+    if ( sarg == "-h" ) {
+      cout << "Usage: " << argv[0] << " [NWAV]" << endl;
+      return 0;
+    }
+    nwav = std::stoi(sarg);
+  }
+  return test_MonitorFFT(nwav);
+}
+
+//**********************************************************************
@@ -0,0 +1,171 @@
+// test_MonitorSums.cxx
+//
+// Check the monitor histogram sums against direct fills of the histograms.
+// The fills are split between several sums, as between the APA shards of
+// the monitors, and the sums are flushed one after the other.
+
+#include <string>
+#include <iostream>
+#include <random>
+#include <vector>
+#include <cmath>
+#include <algorithm>
+#include "duneprototypes/Protodune/singlephase/NearlineMonitor/MonitorSums.h"
+#include "TH1D.h"
+#include "TH1F.h"
+#include "TProfile2D.h"
+
+#undef NDEBUG
+#include <cassert>
+
+using std::string;
+using std::cout;
+using std::endl;
+using std::vector;
+using tpc_monitor::Hist1Sum;
+using tpc_monitor::Profile2Sum;
+
+namespace {
+
+bool near(double x1, double x2, double tol) {
+  if ( x1 == x2 ) return true;
+  return std::fabs(x1 - x2) <= tol*std::max(1.0, std::fabs(x1) + std::fabs(x2));
+}
+
+// Contents, errors, entries and the first nstat statistics must agree.
+void checkSame(const TH1* ph1, const TH1* ph2, int nstat, double tol) {
+  assert( ph1->GetNcells() == ph2->GetNcells() );
+  for ( int bin=0; bin<ph1->GetNcells(); ++bin ) {
+    assert( near(ph1->GetBinContent(bin), ph2->GetBinContent(bin), tol) );
+    assert( near(ph1->GetBinError(bin), ph2->GetBinError(bin), tol) );
+  }
+  assert( ph1->GetEntries() == ph2->GetEntries() );
+  double stats1[TH1::kNstat];
+  double stats2[TH1::kNstat];
+  ph1->GetStats(stats1);
+  ph2->GetStats(stats2);
+  for ( int ista=0; ista<nstat; ++ista ) assert( near(stats1[ista], stats2[ista], tol) );
+}
+
+}  // end unnamed namespace
+
+//**********************************************************************
+
+int test_MonitorSums(unsigned int nevt) {
+  const string myname = "test_MonitorSums: ";
+#ifdef NDEBUG
+  cout << myname << "NDEBUG must be off." << endl;
+  abort();
+#endif
+  string line = "-----------------------------";
+  TH1::AddDirectory(false);
+  std::mt19937 gen(20240901);
+  std::normal_distribution<double> noise(0.0, 4.0);
+  const unsigned int nshard = 4;
+  const int nchan = 200;
+  const int nsam = 100;
+
+  cout << myname << line << endl;
+  cout << myname << "ADC, mean and bit sums for " << nevt << " events in " << nshard << " shards." << endl;
+  TH1D hadir("hadir", "hadir", 600, 499.5, 1099.5);
+  TH1D hasum("hasum", "hasum", 600, 499.5, 1099.5);
+  TH1F hmdir("hmdir", "hmdir", 100, 0, 10000);
+  TH1F hmsum("hmsum", "hmsum", 100, 0, 10000);
+  TProfile2D hcdir("hcdir", "hcdir", 240, -0.5, 239.5, 64, -0.5, 63.5);
+  TProfile2D hcsum("hcsum", "hcsum", 240, -0.5, 239.5, 64, -0.5, 63.5);
+  TProfile2D hbdir("hbdir", "hbdir", 240, -0.5, 239.5, 64, -0.5, 63.5, 0, 1);
+  TProfile2D hbsum("hbsum", "hbsum", 240, -0.5, 239.5, 64, -0.5, 63.5, 0, 1);
+  vector<Hist1Sum<double>> adcsums(nshard, Hist1Sum<double>(&hasum));
+  vector<Hist1Sum<float>> meansums(nshard, Hist1Sum<float>(&hmsum));
+  vector<Profile2Sum> chansums(nshard, Profile2Sum(&hcsum));
+  Profile2Sum bitsum(&hbsum);
+  for ( unsigned int ievt=0; ievt<nevt; ++ievt ) {
+    for ( int ichan=0; ichan<nchan; ++ichan ) {
+      unsigned int ishard = ichan % nshard;
+      int x = gen() % 250;
+      int y = gen() % 70;
+      double ped = 800.0 + 10.0*(ichan % 7);
+      int non = 0;
+      int nfill = 0;
+      for ( int isam=0; isam<nsam; ++isam ) {
+        // Some samples far off, and some negative, as from a bad unpacking.
+        short adc = short(ped + noise(gen));
+        if ( gen() % 50 == 0 ) adc = short(gen() % 2000) - 200;
+        hadir.Fill(adc);
+        adcsums[ishard].fill(adc);
+        // The bit 3 fills of TpcMonitor: a negative ADC may give -1.
+        int bit = (adc/8) % 2;
+        hbdir.Fill(x, y, bit);
+        if ( bit >= 0 ) {
+          ++nfill;
+          non += bit;
+        }
+      }
+      bitsum.fillMany(x, y, nfill, non, non);
+      double mean = ped + noise(gen);
+      if ( ichan == 0 ) mean = 12000.0;
+      hmdir.Fill(mean);
+      meansums[ishard].fill(mean);
+      hcdir.Fill(x, y, mean);
+      chansums[ishard].fill(x, y, mean);
+    }
+    // Merge at the end of each event.
+    for ( unsigned int ishard=0; ishard<nshard; ++ishard ) {
+      adcsums[ishard].flush(&hasum);
+      meansums[ishard].flush(&hmsum);
+      chansums[ishard].flush(&hcsum);
+      assert( adcsums[ishard].entries() == 0.0 );
+    }
+    bitsum.flush(&hbsum);
+  }
+  // Integer fills are exact; the sums of the means are taken in another order.
+  checkSame(&hadir, &hasum, 4, 0.0);
+  checkSame(&hmdir, &hmsum, 4, 1.e-9);
+  checkSame(&hcdir, &hcsum, 9, 1.e-9);
+  checkSame(&hbdir, &hbsum, 9, 0.0);
+  assert( hasum.GetSumw2N() == 0 );
+
+  cout << myname << line << endl;
+  cout << myname << "Weighted fills." << endl;
+  TH1F hwdir("hwdir", "hwdir", 50, -5.0, 5.0);
+  TH1F hwsum("hwsum", "hwsum", 50, -5.0, 5.0);
+  Hist1Sum<float> wsum(&hwsum);
+  for ( int ifil=0; ifil<1000; ++ifil ) {
+    double x = noise(gen)/2.0;
+    double w = ifil < 10 ? 1.0 : 0.5 + 0.1*(ifil % 5);
+    hwdir.Fill(x, w);
+    wsum.fill(x, w);
+    if ( ifil == 500 ) wsum.flush(&hwsum);
+  }
+  wsum.flush(&hwsum);
+  checkSame(&hwdir, &hwsum, 4, 1.e-5);
+  assert( hwsum.GetSumw2N() > 0 );
+
+  cout << myname << line << endl;
+  cout << myname << "Null histogram." << endl;
+  Hist1Sum<float> nsum;
+  nsum.fill(1.0);
+  nsum.flush(static_cast<TH1F*>(nullptr));
+  assert( nsum.entries() == 0.0 );
+
+  cout << myname << line << endl;
+  cout << myname << "Done." << endl;
+  return 0;
+}
+
+//**********************************************************************
+
+int main(int argc, char* argv[]) {
+  unsigned int nevt = 20;
+  if ( argc > 1 ) {
+    string sarg(argv[1]);
+    if ( sarg == "-h" ) {
+      cout << "Usage: " << argv[0] << " [NEVT]" << endl;
+      return 0;
+    }
+    nevt = std::stoi(sarg);
+  }
+  return test_MonitorSums(nevt);
+}
+
+//**********************************************************************
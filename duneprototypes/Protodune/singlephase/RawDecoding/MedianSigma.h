@@ -0,0 +1,190 @@
+// MedianSigma.h
+//
+// Pedestal estimate of a raw TPC waveform, shared by the TPC decoders.
+//
+// The decoders used to compute it with TMath::Median, which copies and
+// partially sorts the waveform, and TMath::RMS, and then made another pass
+// over the waveform for the median correction suggested by David Adams
+// (May 6, 2019):
+//
+//   imed   = floor(median)
+//   median = imed - 0.5 + (0.5*n - n(adc < imed))/n(adc == imed)
+//
+// Here the ADC values are histogrammed once. The histogram gives the
+// median, the counts below and at imed, and the sum, hence the mean. The
+// RMS is then accumulated over the samples in their order, exactly as
+// TMath::RMS does, so that sigma is the same to the bit. Waveforms with
+// values outside [0, 2^14), i.e. not 12- or 14-bit ADCs, fall back to a
+// sort-based median with the same result.
+//
+// The histogram has 2^14 bins and is kept between calls. Only the bins
+// between the smallest and largest value of a waveform are cleared
+// afterwards. The free functions use one histogram per thread, so they may
+// be called from parallel unpacking.
+
+#ifndef MedianSigma_H
+#define MedianSigma_H
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace dune {
+
+class MedianSigma {
+
+public:
+
+  static constexpr unsigned int kBits = 14;
+  static constexpr unsigned int kBins = 1u << kBits;
+
+  MedianSigma() : m_counts(kBins, 0) { }
+
+  // Median with the Adams correction and RMS of adcs[0..n). If pmcorr is
+  // not null, it receives the correction that was added to floor(median).
+  void medianSigma(const short* adcs, size_t n, float& median, float& sigma,
+                   float* pmcorr = nullptr) {
+    if ( pmcorr != nullptr ) *pmcorr = 0.0;
+    if ( n == 0 ) {
+      median = 0;
+      sigma = 0;
+      return;
+    }
+    Stats sta = fill(adcs, n);
+    int imed = sta.median + 0.01;  // add an offset to make sure the floor gets the right integer
+    median = imed;
+    sigma = rms(adcs, n, sta.mean);
+    size_t s1 = 0;
+    size_t sm = 0;
+    if ( sta.inRange ) {
+      for ( int iadc=sta.min; iadc<imed; ++iadc ) s1 += m_counts[iadc];
+      sm = m_counts[imed];
+      clear(sta);
+    } else {
+      for ( size_t i=0; i<n; ++i ) {
+        if ( adcs[i] < imed ) s1++;
+        if ( adcs[i] == imed ) sm++;
+      }
+    }
+    if ( sm > 0 ) {
+      float mcorr = (-0.5 + (0.5*(float) n - (float) s1)/ ((float) sm) );
+      if ( pmcorr != nullptr ) *pmcorr = mcorr;
+      median += mcorr;
+    }
+  }
+
+  // Median and RMS of adcs[0..n), as TMath::Median and TMath::RMS.
+  void medianRMS(const short* adcs, size_t n, float& median, float& sigma) {
+    if ( n == 0 ) {
+      median = 0;
+      sigma = 0;
+      return;
+    }
+    Stats sta = fill(adcs, n);
+    median = sta.median;
+    sigma = rms(adcs, n, sta.mean);
+    if ( sta.inRange ) clear(sta);
+  }
+
+private:
+
+  struct Stats {
+    bool inRange;
+    int min;
+    int max;
+    double mean;
+    double median;
+  };
+
+  // Histogram the samples and find the mean and median. If a value is out
+  // of range, the histogram is cleared and the median found by sorting.
+  Stats fill(const short* adcs, size_t n) {
+    Stats sta;
+    uint32_t* counts = m_counts.data();
+    int64_t sum = 0;
+    int amin = adcs[0];
+    int amax = adcs[0];
+    for ( size_t i=0; i<n; ++i ) {
+      int adc = adcs[i];
+      ++counts[adc & (kBins - 1)];
+      sum += adc;
+      amin = std::min(amin, adc);
+      amax = std::max(amax, adc);
+    }
+    sta.min = amin;
+    sta.max = amax;
+    // TMath::Mean sums in double, which is exact for these sums.
+    sta.mean = double(sum)/double(n);
+    sta.inRange = amin >= 0 && amax < int(kBins);
+    if ( ! sta.inRange ) {
+      std::fill(m_counts.begin(), m_counts.end(), 0);
+      std::vector<short> work(adcs, adcs + n);
+      auto imid = work.begin() + n/2;
+      std::nth_element(work.begin(), imid, work.end());
+      short hi = *imid;
+      if ( n%2 == 1 ) {
+        sta.median = hi;
+      } else {
+        short lo = *std::max_element(work.begin(), imid);
+        sta.median = 0.5*(lo + hi);
+      }
+      return sta;
+    }
+    // Values at ranks n/2 - 1 and n/2.
+    size_t khi = n/2;
+    size_t klo = n%2 == 1 ? khi : khi - 1;
+    int lo = -1;
+    int hi = -1;
+    size_t cum = 0;
+    for ( int iadc=amin; iadc<=amax; ++iadc ) {
+      cum += counts[iadc];
+      if ( lo < 0 && cum > klo ) lo = iadc;
+      if ( cum > khi ) {
+        hi = iadc;
+        break;
+      }
+    }
+    sta.median = n%2 == 1 ? double(hi) : 0.5*(lo + hi);
+    return sta;
+  }
+
+  // Sample standard deviation, summed in sample order as TMath::RMS does.
+  static double rms(const short* adcs, size_t n, double mean) {
+    double tot = 0;
+    for ( size_t i=0; i<n; ++i ) {
+      double x = double(adcs[i]);
+      tot += (x - mean)*(x - mean);
+    }
+    return n > 1 ? std::sqrt(tot/(double(n) - 1)) : 0.0;
+  }
+
+  void clear(const Stats& sta) {
+    std::fill(m_counts.begin() + sta.min, m_counts.begin() + sta.max + 1, 0);
+  }
+
+  std::vector<uint32_t> m_counts;
+
+};
+
+// The kernel of the calling thread.
+inline MedianSigma& threadMedianSigma() {
+  thread_local MedianSigma ms;
+  return ms;
+}
+
+// Median with the Adams correction and RMS.
+inline void computeMedianSigma(const std::vector<short>& adcs, float& median, float& sigma,
+                               float* pmcorr = nullptr) {
+  threadMedianSigma().medianSigma(adcs.data(), adcs.size(), median, sigma, pmcorr);
+}
+
+// Median and RMS, as TMath::Median and TMath::RMS.
+inline void computeMedianRMS(const std::vector<short>& adcs, float& median, float& sigma) {
+  threadMedianSigma().medianRMS(adcs.data(), adcs.size(), median, sigma);
+}
+
+}  // end namespace dune
+
+#endif
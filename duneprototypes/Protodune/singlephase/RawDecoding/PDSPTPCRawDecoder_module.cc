@@ -32,6 +32,7 @@
 #include "TH1.h"
 #include "TStyle.h"
 #include "TMath.h"
+#include "duneprototypes/Protodune/singlephase/RawDecoding/MedianSigma.h"
 
 // artdaq and dunepdlegacy includes
 #include "dunepdlegacy/Overlays/RceFragment.hh"
@@ -1442,88 +1443,8 @@ bool PDSPTPCRawDecoder::_process_FELIX_AUX(const artdaq::Fragment& frag, RawDigi
 
 void PDSPTPCRawDecoder::computeMedianSigma(raw::RawDigit::ADCvector_t &v_adc, float &median, float &sigma)
 {
-  size_t asiz = v_adc.size();
-  int imed=0;
-  if (asiz == 0)
-    {
-      median = 0;
-      sigma = 0;
-    }
-  else
-    {
-      // this is actually faster than the code below by about one second per event.
-      // the RMS includes tails from bad samples and signals and may not be the best RMS calc.
-
-      imed = TMath::Median(asiz,v_adc.data()) + 0.01;  // add an offset to make sure the floor gets the right integer
-      median = imed;
-      sigma = TMath::RMS(asiz,v_adc.data());
-
-      // add in a correction suggested by David Adams, May 6, 2019
-
-      size_t s1 = 0;
-      size_t sm = 0;
-      for (size_t i=0; i<asiz; ++i)
-	{
-	  if (v_adc[i] < imed) s1++;
-	  if (v_adc[i] == imed) sm++;
-	}
-      if (sm > 0)
-	{
-	  float mcorr = (-0.5 + (0.5*(float) asiz - (float) s1)/ ((float) sm) );
-	  //if (std::abs(mcorr)>1.0) std::cout << "mcorr: " << mcorr << std::endl;
-	  median += mcorr;
-	}
-    }
-
-
-
-  // never do this, but keep the code around in case we want it later
-
-  // if (asiz > 100000000)
-  //   {
-  //     size_t mednum = asiz/2;
-  //     size_t m1snum = mednum - ( (float) asiz )*0.34;
-  //     size_t p1snum = mednum + ( (float) asiz )*0.34;
-
-  //     std::map<size_t,size_t> adcmap;
-  //     for (auto const adc : v_adc)
-  // 	{
-  // 	  auto mapiter = adcmap.find(adc);
-  // 	  if (mapiter != adcmap.end())
-  // 	    {
-  // 	      mapiter->second ++;
-  // 	    }
-  // 	  else
-  // 	    {
-  // 	      adcmap[adc] = 1;
-  // 	    }
-  // 	}
-
-  //     // find quantiles, -1 sigma, median, plus 1 sigma
-  //     size_t sum = 0;
-  //     size_t m1s = 0;
-  //     size_t p1s = 0;
-  //     size_t m = 0;
-  //     for (auto const &mv : adcmap)
-  // 	{
-  // 	  sum += mv.second;
-  // 	  if (m1s == 0 && sum >= m1snum) 
-  // 	    {
-  // 	      m1s = mv.first;
-  // 	    }
-  // 	  if (m == 0 && sum >= mednum)
-  // 	    {
-  // 	      m = mv.first;
-  // 	    }
-  // 	  if (p1s == 0 && sum >= p1snum)
-  // 	    {
-  // 	      p1s = mv.first;
-  // 	      break;
-  // 	    }
-  // 	}
-  //     median = (float) m;
-  //     sigma = ((float) (p1s - m1s))/2.0;
-  //   }
+  // median with the correction suggested by David Adams, May 6, 2019, and RMS
+  dune::computeMedianSigma(v_adc, median, sigma);
 }
 
 DEFINE_ART_MODULE(PDSPTPCRawDecoder)
@@ -43,6 +43,8 @@
 // C++ Includes
 #include <memory>
 #include <map>
+#include <cmath>
+#include <algorithm>
 
 namespace dune {
   class SSPRawDecoder;
@@ -89,6 +91,30 @@ public:
   };
   void readHeader(const SSPDAQ::EventHeader* daqHeader, struct trig_variables* tv);
 
+  // Number of ADC values in the packet following the header.
+  static unsigned int packetADCs(const SSPDAQ::EventHeader* daqHeader);
+
+  // Numbers of packets in the SSP fragments, read from the packet headers
+  // only, so the output collections can be sized before decoding.
+  struct packet_counts {
+    size_t all = 0;
+    size_t external = 0;
+    size_t internal = 0;
+  };
+  packet_counts countPackets(const std::vector<artdaq::Fragment>& fragments) const;
+
+  // Baseline, integral and peak sums over the sample windows set by
+  // i1, i2, m1 and m2, with the maximum ADC and its (last) sample.
+  struct adc_sums {
+    unsigned long basesum = 0;
+    unsigned long intsum = 0;
+    unsigned int peaksum = 0;
+    unsigned short maxadc = 0;
+    unsigned short peaktime = 0;
+    uint64_t total = 0;
+  };
+  void sumADCs(const unsigned short* adcs, size_t nADC, adc_sums& sums) const;
+
   void getFragments(art::Event &evt,std::vector<artdaq::Fragment>* fragments);
   void beginJob() override;
   void endJob() override;
@@ -125,6 +151,7 @@ private:
 
   uint32_t         verb_adcs_;
   bool             verb_meta_;
+  bool             verb_waveforms_;  // book a histogram for each waveform
   bool             timed_;
 
   TH1D * n_event_packets_; //diagnostic histos
@@ -217,6 +244,7 @@ void dune::SSPRawDecoder::reconfigure(fhicl::ParameterSet const& pset) {
 
   verb_adcs_=pset.get<uint32_t>        ("verbose_adcs", 10000); 
   verb_meta_=pset.get<bool>            ("verbose_metadata", false); 
+  verb_waveforms_=pset.get<bool>       ("verbose_waveforms", false);
   n_adc_counter_=0; 
   adc_cumulative_=0; 
   
@@ -314,6 +342,84 @@ void dune::SSPRawDecoder::readHeader(const SSPDAQ::EventHeader* daqHeader, struc
   
 }
 
+unsigned int dune::SSPRawDecoder::packetADCs(const SSPDAQ::EventHeader* daqHeader){
+  unsigned short length = daqHeader->length;  // in unsigned ints, including the header
+  return (length-sizeof(SSPDAQ::EventHeader)/sizeof(unsigned int))*2;
+}
+
+dune::SSPRawDecoder::packet_counts
+dune::SSPRawDecoder::countPackets(const std::vector<artdaq::Fragment>& fragments) const {
+  // Walk the packets exactly as produce does, reading only the headers.
+  packet_counts counts;
+  for(auto const& frag: fragments){
+    if((unsigned)frag.type() != 3) continue;
+    dune::SSPFragment sspf(frag);
+    const SSPDAQ::MillisliceHeader* meta=0;
+    if(frag.hasMetadata()) meta = &(frag.metadata<SSPFragment::Metadata>()->sliceHeader);
+    const unsigned int* dataPointer = sspf.dataBegin();
+    unsigned int packetsProcessed=0;
+    while(( meta==0 || packetsProcessed<meta->nTriggers) && dataPointer<sspf.dataEnd() ){
+      const SSPDAQ::EventHeader* daqHeader=reinterpret_cast<const SSPDAQ::EventHeader*>(dataPointer);
+      unsigned short type = ((daqHeader->group1 & 0xFF00) >> 8);
+      ++counts.all;
+      if (type == 48) ++counts.external;
+      else if (type == 16) ++counts.internal;
+      dataPointer+=sizeof(SSPDAQ::EventHeader)/sizeof(unsigned int);
+      dataPointer+=packetADCs(daqHeader)/2;
+      ++packetsProcessed;
+    }
+  }
+  return counts;
+}
+
+void dune::SSPRawDecoder::sumADCs(const unsigned short* adcs, size_t nADC, adc_sums& sums) const {
+  // Sample windows as index ranges [begin, end):
+  //   baseline  idata < i1
+  //   integral  i1+m1 < idata <= i1+m1+i2
+  //   peak      i1+m1+m2 <= idata <= i1+2*m1+m2
+  auto bound = [nADC](double x) -> size_t {
+    if ( !(x > 0.0) ) return 0;
+    if ( x >= double(nADC) ) return nADC;
+    return size_t(x);
+  };
+  const size_t baseEnd = bound(std::ceil(i1));
+  const size_t intBegin = bound(std::floor(i1+m1) + 1.0);
+  const size_t intEnd = bound(std::floor(i1+m1+i2) + 1.0);
+  const size_t peakBegin = bound(std::ceil(i1+m1+m2));
+  const size_t peakEnd = bound(std::floor(i1+2*m1+m2) + 1.0);
+
+  // One branch-free pass over the ADC block.
+  unsigned long basesum = 0;
+  unsigned long intsum = 0;
+  unsigned int peaksum = 0;
+  unsigned short maxadc = 0;
+  uint64_t total = 0;
+  for(size_t idata = 0; idata < nADC; idata++) {
+    const unsigned short adc = adcs[idata];
+    total += adc;
+    basesum += idata < baseEnd ? adc : 0;
+    intsum += (idata >= intBegin && idata < intEnd) ? adc : 0;
+    peaksum += (idata >= peakBegin && idata < peakEnd) ? adc : 0;
+    maxadc = std::max(maxadc, adc);
+  }
+
+  // The peak time is the last sample at the maximum.
+  size_t peaktime = 0;
+  for(size_t idata = nADC; idata > 0; --idata) {
+    if (adcs[idata-1] == maxadc) {
+      peaktime = idata-1;
+      break;
+    }
+  }
+
+  sums.basesum = basesum;
+  sums.intsum = intsum;
+  sums.peaksum = peaksum;
+  sums.maxadc = maxadc;
+  sums.peaktime = peaktime;
+  sums.total = total;
+}
+
 void dune::SSPRawDecoder::getFragments(art::Event &evt, std::vector<artdaq::Fragment> *fragments){
 
   art::EventNumber_t eventNumber = evt.event();
@@ -465,6 +571,22 @@ void dune::SSPRawDecoder::produce(art::Event & evt){
   std::vector<recob::OpHit> ext_hits;
   std::vector<recob::OpHit> int_hits;
 
+  /// Size the collections from the packet headers
+  packet_counts npackets = countPackets(fragments);
+  if (!fSplitTriggers) {
+    waveforms.reserve(npackets.all);
+    waveform_timestamps.reserve(npackets.all);
+    hits.reserve(npackets.all);
+  }
+  else {
+    ext_waveforms.reserve(npackets.external);
+    ext_waveform_timestamps.reserve(npackets.external);
+    ext_hits.reserve(npackets.external);
+    int_waveforms.reserve(npackets.internal);
+    int_waveform_timestamps.reserve(npackets.internal);
+    int_hits.reserve(npackets.internal);
+  }
+
   /// Process all packets:
   
   auto const clockData = art::ServiceHandle<detinfo::DetectorClocksService const>()->DataFor(evt);
@@ -536,20 +658,12 @@ void dune::SSPRawDecoder::produce(art::Event & evt){
       ///> increment the data pointer past the packet header
       dataPointer+=sizeof(SSPDAQ::EventHeader)/sizeof(unsigned int);
       
-      //>get the information from the data
-      bool verb_values = false;
-      
       ///> get the number of ADC values in the packet
-      unsigned int nADC=(trig.length-sizeof(SSPDAQ::EventHeader)/sizeof(unsigned int))*2;
+      unsigned int nADC=packetADCs(daqHeader);
       
       ///> get a pointer to the first ADC value
       const unsigned short* adcPointer=reinterpret_cast<const unsigned short*>(dataPointer);
       
-      char histname[100];
-      sprintf(histname,"evt%i_frag%d_wav%d",eventNumber, frag.fragmentID(), packetsProcessed);
-      
-      TH1D* hist=new TH1D("hist","hist",nADC,0,nADC);
-      
       // map the channel number to offline if requested
       
       unsigned int mappedchannel = channel;
@@ -558,52 +672,59 @@ void dune::SSPRawDecoder::produce(art::Event & evt){
       // Get information from the header, //added by Jingbo
       
       unsigned short     OpChannel   =  (unsigned short) mappedchannel;   ///< Derived Optical channel
-      raw::OpDetWaveform Waveform(time, OpChannel, nADC);
-      
+
+      // Choose the collections for this packet.
+      // Split into internal and external triggers if that has been set.
+      std::vector<raw::OpDetWaveform>* pwaveforms = nullptr;
+      std::vector<raw::RDTimeStamp>* ptimestamps = nullptr;
+      std::vector<recob::OpHit>* phits = nullptr;
+      if (!fSplitTriggers) {
+        pwaveforms = &waveforms;
+        ptimestamps = &waveform_timestamps;
+        phits = &hits;
+      }
+      else if (trig.type == 48) {
+        pwaveforms = &ext_waveforms;
+        ptimestamps = &ext_waveform_timestamps;
+        phits = &ext_hits;
+      }
+      else if (trig.type == 16) {
+        pwaveforms = &int_waveforms;
+        ptimestamps = &int_waveform_timestamps;
+        phits = &int_hits;
+      }
+
+      ///> copy the waveform into its place in the output collection, //added by Jingbo
+      if (pwaveforms != nullptr) {
+        pwaveforms->emplace_back(time, OpChannel, nADC);
+        pwaveforms->back().assign(adcPointer, adcPointer + nADC);
+      }
+      waveform_counter += nADC;
+
       //calculating relevant values in decoder because what comes out of the trigger header seems incorrect-Bryan Ramson
-      unsigned long calbasesum = 0;
-      unsigned short maxadc = 0;
-      unsigned long calintsum = 0;
-      unsigned short  calpeaktime = 0;
-      unsigned int calpeaksum =0;
-      ///> copy the waveforms
-      for(size_t idata = 0; idata < nADC; idata++) {
-        ///> get the 'idata-th' ADC value
-        const unsigned short* adc = adcPointer + idata;
-        if(idata < i1) calbasesum +=  static_cast<unsigned long>(*adc); //added by Bryan Ramson
-        if(idata > i1+m1 && idata <= i2+i1+m1) calintsum += static_cast<unsigned long>(*adc); //added by Bryan Ramson
-        if(idata >= i1+m1+m2 && idata <= i1+2*m1+m2) calpeaksum += static_cast<unsigned int>(*adc); //added by Bryan Ramson
-        
-        maxadc = std::max(maxadc,*adc); //added by Bryan Ramson
-        if(maxadc == *adc) calpeaktime = idata; //added by Bryan Ramson
-        Waveform.push_back(*adc); //added by Jingbo
-        waveform_counter++;
-        
-        n_adc_counter_++;
-        adc_cumulative_ += (uint64_t)(*adc);
-        
-        ///> Waveform 
-        hist->SetBinContent(idata+1,*adc);
-        
-        if (idata >= verb_adcs_) verb_values = false;
-        
-        verb_values = false; //don't print adc. Added by J.Wang
-        if(verb_values) {
-          if(idata == 0&&verb_adcs_>0) std::cout << "Printing the " << nADC << " ADC values saved with the packet:" << std::endl;
-          std::cout << *adc << " ";
-        }
-      }// idata
+      adc_sums sums;
+      sumADCs(adcPointer, nADC, sums);
+      n_adc_counter_ += nADC;
+      adc_cumulative_ += sums.total;
+
+      ///> Waveform histogram, only if requested
+      if (verb_waveforms_) {
+        char histname[100];
+        sprintf(histname,"evt%i_frag%d_wav%d",eventNumber, frag.fragmentID(), packetsProcessed);
+        TH1D* hist = tFileService->make<TH1D>(histname,histname,nADC,0,nADC);
+        for(size_t idata = 0; idata < nADC; idata++) hist->SetBinContent(idata+1,adcPointer[idata]);
+      }
 
       // pedestal, area and peak (according to the Register table, the  SSP User Manual has i1 and i2 inverted)
-      double pedestal = calbasesum / ((double)i1);    
-      double area = calintsum-(pedestal*i2);
+      double pedestal = sums.basesum / ((double)i1);    
+      double area = sums.intsum-(pedestal*i2);
       if(area<0) area=0; //On external triggers area over "peak" less pedestal could be negative which is nonsense.
-      double peak = maxadc;
+      double peak = sums.maxadc;
      
-      trig.baselinesum = calbasesum;
-      trig.intsum = calintsum;
-      trig.peaktime = calpeaktime;
-      trig.peaksum = calpeaksum;
+      trig.baselinesum = sums.basesum;
+      trig.intsum = sums.intsum;
+      trig.peaktime = sums.peaktime;
+      trig.peaksum = sums.peaksum;
       
       if(verb_meta_) {
         std::cout
@@ -638,30 +759,14 @@ void dune::SSPRawDecoder::produce(art::Event & evt){
       ///> increment the data pointer to the end of the current packet (to the start of the next packet header, if available)
       dataPointer+=nADC/2;
       
-      // Put waveform and ophit into collections
-      // Split into internal and external triggers if that has been set.
-      if (!fSplitTriggers) {
-        waveforms.emplace_back( Waveform );
-        waveform_timestamps.emplace_back(trig.timestamp_nova,0);
-        hits.emplace_back( ConstructOpHit(clockData, trig, mappedchannel) );
+      // Put the time stamp and ophit into the collections of the waveform
+      if (pwaveforms != nullptr) {
+        ptimestamps->emplace_back(trig.timestamp_nova,0);
+        phits->emplace_back( ConstructOpHit(clockData, trig, mappedchannel) );
       }
-      else{
-        if (trig.type == 48 ) {
-          ext_waveforms.emplace_back( Waveform );
-          ext_waveform_timestamps.emplace_back(trig.timestamp_nova,0);
-          ext_hits.emplace_back( ConstructOpHit(clockData, trig, mappedchannel) );
-        }
-        else if (trig.type == 16) {
-          int_waveforms.emplace_back( Waveform );
-          int_waveform_timestamps.emplace_back(trig.timestamp_nova,0);
-          int_hits.emplace_back( ConstructOpHit(clockData, trig, mappedchannel) );
-        }
-        else {
-          std::cerr << "Unknown trigger type " << trig.type << ", cannot assign to appropriate data product with SplitTriggers enabled." << std::endl;
-        }
+      else {
+        std::cerr << "Unknown trigger type " << trig.type << ", cannot assign to appropriate data product with SplitTriggers enabled." << std::endl;
       }
-
-      hist->Delete();
     
       ++packetsProcessed; // packets
     }
@@ -0,0 +1,74 @@
+// bench_MedianSigma.cxx
+//
+// Time per channel of the pedestal estimate of the TPC decoders: TMath
+// median and RMS plus the Adams correction pass, compared with the
+// histogram kernel.
+// Usage: bench_MedianSigma [NCHAN] [NTICK] [NREP]
+
+#include <string>
+#include <iostream>
+#include <iomanip>
+#include <random>
+#include <vector>
+#include <chrono>
+#include "TMath.h"
+#include "duneprototypes/Protodune/singlephase/RawDecoding/MedianSigma.h"
+
+using std::string;
+using std::cout;
+using std::endl;
+using AdcVector = std::vector<short>;
+using Clock = std::chrono::steady_clock;
+
+int main(int argc, char* argv[]) {
+  const string myname = "bench_MedianSigma: ";
+  unsigned int nchan = argc > 1 ? std::stoi(argv[1]) : 2560;
+  unsigned int ntick = argc > 2 ? std::stoi(argv[2]) : 6000;
+  unsigned int nrep = argc > 3 ? std::stoi(argv[3]) : 10;
+
+  std::mt19937 gen(1);
+  std::uniform_real_distribution<double> peds(500.0, 9000.0);
+  std::vector<AdcVector> wfs(nchan, AdcVector(ntick));
+  for ( AdcVector& wf : wfs ) {
+    std::normal_distribution<double> noise(peds(gen), 4.0);
+    for ( short& adc : wf ) adc = noise(gen);
+  }
+  double sum = 0;
+
+  auto report = [&](string name, Clock::time_point t0) {
+    double sec = std::chrono::duration<double>(Clock::now() - t0).count();
+    cout << myname << std::setw(10) << name << ": " << std::setw(8) << std::fixed << std::setprecision(2)
+         << 1.e6*sec/(nchan*nrep) << " us/channel" << endl;
+  };
+
+  auto t0 = Clock::now();
+  for ( unsigned int irep=0; irep<nrep; ++irep ) {
+    for ( const AdcVector& v_adc : wfs ) {
+      size_t asiz = v_adc.size();
+      int imed = TMath::Median(asiz,v_adc.data()) + 0.01;
+      float median = imed;
+      float sigma = TMath::RMS(asiz,v_adc.data());
+      size_t s1 = 0;
+      size_t sm = 0;
+      for (size_t i = 0; i < asiz; ++i) {
+        if (v_adc[i] < imed) s1++;
+        if (v_adc[i] == imed) sm++;
+      }
+      if (sm > 0) median += (-0.5 + (0.5*(float) asiz - (float) s1)/ ((float) sm) );
+      sum += median + sigma;
+    }
+  }
+  report("TMath", t0);
+
+  t0 = Clock::now();
+  for ( unsigned int irep=0; irep<nrep; ++irep ) {
+    for ( const AdcVector& v_adc : wfs ) {
+      float median = 0, sigma = 0;
+      dune::computeMedianSigma(v_adc, median, sigma);
+      sum += median + sigma;
+    }
+  }
+  report("histogram", t0);
+  cout << myname << "Checksum: " << sum << endl;
+  return 0;
+}
@@ -0,0 +1,155 @@
+// test_MedianSigma.cxx
+//
+// Check that the histogram pedestal kernel gives the same median and sigma,
+// to the bit, as TMath::Median and TMath::RMS with the Adams correction that
+// the TPC decoders applied.
+
+#include <string>
+#include <iostream>
+#include <random>
+#include <vector>
+#include <cstring>
+#include "TMath.h"
+#include "duneprototypes/Protodune/singlephase/RawDecoding/MedianSigma.h"
+
+#undef NDEBUG
+#include <cassert>
+
+using std::string;
+using std::cout;
+using std::endl;
+using std::vector;
+using AdcVector = std::vector<short>;
+
+namespace {
+
+// As the decoders computed it.
+void tmathMedianSigma(const AdcVector& v_adc, float& median, float& sigma, bool adams) {
+  size_t asiz = v_adc.size();
+  if (asiz == 0) {
+    median = 0;
+    sigma = 0;
+    return;
+  }
+  if ( ! adams ) {
+    median = TMath::Median(asiz,v_adc.data());
+    sigma = TMath::RMS(asiz,v_adc.data());
+    return;
+  }
+  int imed = TMath::Median(asiz,v_adc.data()) + 0.01;
+  median = imed;
+  sigma = TMath::RMS(asiz,v_adc.data());
+  size_t s1 = 0;
+  size_t sm = 0;
+  for (size_t i = 0; i < asiz; ++i) {
+    if (v_adc[i] < imed) s1++;
+    if (v_adc[i] == imed) sm++;
+  }
+  if (sm > 0) {
+    float mcorr = (-0.5 + (0.5*(float) asiz - (float) s1)/ ((float) sm) );
+    median += mcorr;
+  }
+}
+
+bool same(float x1, float x2) {
+  return std::memcmp(&x1, &x2, sizeof(float)) == 0;
+}
+
+}  // end unnamed namespace
+
+//**********************************************************************
+
+int test_MedianSigma(unsigned int nwf) {
+  const string myname = "test_MedianSigma: ";
+#ifdef NDEBUG
+  cout << myname << "NDEBUG must be off." << endl;
+  abort();
+#endif
+  string line = "-----------------------------";
+  std::mt19937 gen(20190506);
+
+  // Pedestal noise with signals, sticky codes, odd and even lengths,
+  // saturation and, for some, values outside the histogram.
+  vector<AdcVector> wfs;
+  wfs.push_back(AdcVector());
+  wfs.push_back(AdcVector(1, 900));
+  wfs.push_back(AdcVector{900, 901});
+  wfs.push_back(AdcVector(6000, 4095));
+  wfs.push_back(AdcVector(6000, 0));
+  std::uniform_int_distribution<int> lens(2, 10000);
+  std::uniform_real_distribution<double> peds(300.0, 16000.0);
+  std::uniform_real_distribution<double> noises(0.3, 30.0);
+  std::uniform_real_distribution<double> flat(0.0, 1.0);
+  for ( unsigned int iwf=0; iwf<nwf; ++iwf ) {
+    size_t len = iwf % 3 ? 6000 + (iwf % 2) : lens(gen);
+    std::normal_distribution<double> noise(peds(gen), noises(gen));
+    AdcVector wf(len);
+    for ( short& adc : wf ) {
+      double val = noise(gen);
+      if ( flat(gen) < 0.02 ) val += 2000.0*flat(gen);
+      if ( iwf % 7 == 0 && (int(val) & 0x3f) == 0 ) val += 1.0;
+      adc = std::min(std::max(int(val), 0), 16383);
+    }
+    if ( iwf % 11 == 0 ) wf[len/3] = -5;
+    if ( iwf % 13 == 0 ) wf[len/2] = 20000;
+    wfs.push_back(wf);
+  }
+
+  for ( bool adams : {true, false} ) {
+    cout << myname << line << endl;
+    cout << myname << "Checking " << wfs.size() << " waveforms " << (adams ? "with" : "without")
+         << " the Adams correction." << endl;
+    unsigned int nbad = 0;
+    for ( const AdcVector& wf : wfs ) {
+      float expmed = -1, expsig = -1;
+      float med = -2, sig = -2;
+      tmathMedianSigma(wf, expmed, expsig, adams);
+      if ( adams ) dune::computeMedianSigma(wf, med, sig);
+      else dune::computeMedianRMS(wf, med, sig);
+      if ( ! same(med, expmed) || ! same(sig, expsig) ) {
+        cout << myname << "  Size " << wf.size() << ": " << med << " != " << expmed << " or "
+             << sig << " != " << expsig << endl;
+        ++nbad;
+      }
+    }
+    cout << myname << "Mismatches: " << nbad << endl;
+    assert( nbad == 0 );
+  }
+
+  cout << myname << line << endl;
+  cout << myname << "Checking the correction and the cleared histogram." << endl;
+  dune::MedianSigma ms;
+  AdcVector wf{100, 101, 101, 101, 102, 200};
+  float med1 = 0, sig1 = 0, mcorr = 0;
+  ms.medianSigma(wf.data(), wf.size(), med1, sig1, &mcorr);
+  assert( mcorr == float(-0.5 + (3.0 - 1.0)/3.0) );
+  assert( med1 == 101 + mcorr );
+  for ( const AdcVector& other : wfs ) {
+    float med = 0, sig = 0;
+    ms.medianSigma(other.data(), other.size(), med, sig);
+  }
+  float med2 = 0, sig2 = 0;
+  ms.medianSigma(wf.data(), wf.size(), med2, sig2);
+  assert( same(med1, med2) && same(sig1, sig2) );
+
+  cout << myname << line << endl;
+  cout << myname << "Done." << endl;
+  return 0;
+}
+
+//**********************************************************************
+
+int main(int argc, char* argv[]) {
+  unsigned int nwf = 2000;
+  if ( argc > 1 ) {
+    string sarg(argv[1]);
+    if ( sarg == "-h" ) {
+      cout << "Usage: " << argv[0] << " [NWAVEFORM]" << endl;
+      return 0;
+    }
+    nwf = std::stoi(sarg);
+  }
+  return test_MedianSigma(nwf);
+}
+
+//**********************************************************************